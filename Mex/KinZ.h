@@ -23,8 +23,21 @@
 ///         Mar/21/2020: Setup the project
 
 ///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_H__
+#define __KINZ_H__
 #include <k4a/k4a.h>
 #include <vector>
+#include <chrono>
+#include <memory>
+#include <map>
+#include <functional>
+#include <string>
+#include <atomic>
+#include <thread>
+#include "thread_pool.hpp"
+#include "KinZ_kernels.h"
+#include "KinZ_filters.h"
+#include "KinZ_background.h"
 
 #ifdef BODY
 #include <k4abt.h>
@@ -49,9 +62,118 @@ namespace kz
         D_WFOV = 1024,
         IMU_ON = 2048,
         BODY_TRACKING = 4096,
-        BODY_INDEX = 8192
+        BODY_INDEX = 8192,
+        ASYNC_INIT = 16384,     // initialize on a background thread
+        WARM_UP = 32768         // process a first capture during init
     };
     typedef unsigned short int Flags;
+
+    class ShmReader;    // see KinZ_shm.h
+    struct ShmFrame;
+    class ArchiveWriter;    // see KinZ_archive.h
+    class CloudWriter;      // see KinZ_cloudwriter.h
+    struct CloudWriterStats;
+    class Reprojector;      // see KinZ_reproject.h
+    struct ReprojectionReport;
+    class Undistorter;      // see KinZ_undistort.h
+    struct Frame;           // frame pinned by KinZ::pin_frame
+    class FrameScope;
+
+    const int NUM_JOINTS = 32;
+
+    // Skeleton of one tracked body packed for copying to Matlab.
+    // 2D positions are -1 when the joint does not project into the image.
+    struct Body {
+        uint32_t id;
+        float position3d[NUM_JOINTS][3];
+        float orientation[NUM_JOINTS][4];
+        uint32_t confidence[NUM_JOINTS];
+        int32_t position2d_rgb[NUM_JOINTS][2];
+        int32_t position2d_depth[NUM_JOINTS][2];
+    };
+
+    // Options of the body tracker. The defaults are those of
+    // K4ABT_TRACKER_CONFIG_DEFAULT.
+    struct TrackerConfig {
+        int processing_mode = 0;        // k4abt_tracker_processing_mode_t (GPU)
+        int sensor_orientation = 0;     // k4abt_sensor_orientation_t
+        int gpu_device_id = 0;
+        bool lite_model = false;        // faster, less accurate network
+        std::string model_path;         // when not empty, used instead
+        float smoothing = 0.0f;         // temporal smoothing of the joints [0, 1]
+    };
+
+    // Output buffers filled by KinZ::get_all.
+    // A null pointer skips the conversion of that stream.
+    struct Products {
+        uint16_t *depth = nullptr;
+        uint64_t depth_time = 0;
+        bool depth_valid = false;
+        uint8_t *color = nullptr;
+        uint64_t color_time = 0;
+        bool color_valid = false;
+        uint16_t *infrared = nullptr;
+        uint64_t infrared_time = 0;
+        bool infrared_valid = false;
+        bool bodies_requested = false;
+        std::vector<Body> bodies;
+    };
+
+    // Output stacks of KinZ::get_burst for n frames. Images are
+    // (h x w x n) Matlab arrays, (h x w x 3 x n) for color; a null pointer
+    // skips the stream. time and valid are (n x 3) arrays with the columns
+    // depth, color and infrared; time is the device timestamp in usec.
+    struct BurstStacks {
+        int n = 0;
+        uint16_t *depth = nullptr;
+        uint8_t *color = nullptr;
+        uint16_t *infrared = nullptr;
+        uint64_t *time = nullptr;
+        uint8_t *valid = nullptr;
+    };
+
+    // Called by KinZ::get_pointcloud_color once the number of points is
+    // known. Must return a (num_points x 3) xyz array and a (num_points x 3)
+    // rgb array, or a null rgb to skip the colors.
+    typedef std::function<void(size_t num_points, double *&xyz, uint8_t *&rgb)> PointCloudAllocator;
+
+    // Duration of the steps of KinZ::init in ms. Steps not run are 0.
+    struct InitTiming {
+        bool ok = false;                // the cameras started
+        double open_ms = 0;
+        double calibration_ms = 0;      // calibration and transformation
+        double start_ms = 0;            // k4a_device_start_cameras
+        double imu_ms = 0;
+        double tracker_ms = 0;          // k4abt_tracker_create
+        double warmup_ms = 0;           // first capture, see KinZ::warm_up
+        double total_ms = 0;
+    };
+
+    // Frame accounting of get_frames from the device timestamps.
+    // Missing frames are those absent from the sequence of device
+    // timestamps. They count as skipped by the consumer when get_frames
+    // was called too late to receive them, and as dropped by the sensor
+    // otherwise.
+    struct FrameStats {
+        uint64_t captured = 0;              // captures received
+        uint64_t timeouts = 0;              // get_frames without a capture in time
+        uint64_t failures = 0;              // captures failed, e.g. unplugged device
+        uint64_t sensor_dropped = 0;
+        uint64_t consumer_skipped = 0;
+        uint32_t period_usec = 0;           // expected period from camera_fps
+        uint64_t last_timestamp_usec = 0;   // device timestamp of last frame
+
+        // |gap between frames - expected gap| in usec
+        uint64_t intervals = 0;
+        double jitter_mean_usec = 0;
+        double jitter_max_usec = 0;
+
+        // color - depth device timestamp in usec
+        uint64_t synced = 0;                // captures with depth and color
+        int64_t sync_offset_usec = 0;
+        double sync_offset_mean_usec = 0;
+        int64_t sync_offset_max_usec = 0;   // largest in absolute value
+    };
 }
 
 struct Imu_sample {
@@ -77,25 +199,156 @@ class KinZ
 
 public:   
     KinZ(uint16_t sources);   // Constructor    
+    explicit KinZ(const char *shm_name);  // Client of a KinZ_server
+    // Offline KinZ without a device. The calibration is read from the
+    // cached raw calibration (see KinZ_calibration.h) of a serial number,
+    // or a calibration file, for the depth mode and color resolution of
+    // sources. Frames are given with set_depth and set_color.
+    KinZ(uint16_t sources, const char *calibration);
     ~KinZ();                // Destructor
     
     void init();   			// Initialize Kinect
 	void close(); 			// Close Kinect
+
+    // With the ASYNC_INIT source flag the constructor returns at once
+    // and init runs on a background thread. is_ready polls it; any other
+    // method must be called after wait_ready.
+    bool is_ready() const { return m_init_done.load(); }
+    void wait_ready();
+    kz::InitTiming get_init_timing() const { return m_init_timing; }
     
     /************ Data Sources *************/
     void get_frames(uint16_t capture_flags, uint8_t valid[]);
-    void get_depth(uint16_t depth[], uint64_t& time, bool& valid_depth);
-    void get_depth_aligned(uint16_t depth[], uint64_t& time, bool& valid_depth);
-    void get_color(uint8_t rgbImage[], uint64_t& time, bool& valid_color);
-    void get_color_aligned(uint8_t color[], uint64_t& time, bool& valid);
-    void get_infrared(uint16_t infrared[], uint64_t& time, bool& valid_infrared);
+
+    // Frame handles. pin_frame keeps the capture of the last get_frames
+    // (images, IMU sample and body frame) alive and returns its handle,
+    // or 0 when there is no capture or max_pinned frames are already
+    // pinned. While a kz::FrameScope of the handle exists, every getter
+    // reads that frame instead of the last one. Pinned frames hold SDK
+    // buffers until release_frame. A client of a KinZ_server pins copies
+    // of the images, as the server reuses its slots.
+    uint64_t pin_frame();
+    bool release_frame(uint64_t handle);
+    void release_frames();
+    void set_max_pinned_frames(size_t max_pinned);
+    size_t get_max_pinned_frames() const { return m_max_pinned; }
+    size_t get_pinned_frames() const { return m_pinned.size(); }
+    void get_all(uint16_t capture_flags, kz::Products &products, uint8_t valid[]);
+    // Capture stacks.n consecutive frames and convert each one into its
+    // slice of the stacks on m_pool while the next ones are captured.
+    // Returns the number of captures received; the last one stays the
+    // current frame.
+    int get_burst(uint16_t capture_flags, const kz::BurstStacks &stacks);
+    void get_depth(uint16_t depth[], uint64_t& time, bool& valid_depth,
+                   const kz::Region &roi = kz::Region());
+    void get_depth_aligned(uint16_t depth[], uint64_t& time, bool& valid_depth,
+                           const kz::Region &roi = kz::Region());
+    void get_color(uint8_t rgbImage[], uint64_t& time, bool& valid_color,
+                   const kz::Region &roi = kz::Region());
+    void get_color_aligned(uint8_t color[], uint64_t& time, bool& valid,
+                           const kz::Region &roi = kz::Region());
+    void get_infrared(uint16_t infrared[], uint64_t& time, bool& valid_infrared,
+                      const kz::Region &roi = kz::Region());
+    // Images of the pinhole cameras with the intrinsics of the depth and
+    // color cameras and no distortion (see KinZ_undistort.h): nearest
+    // neighbor for depth, bilinear for infrared and color
+    void get_depth_undistorted(uint16_t depth[], uint64_t& time, bool& valid_depth);
+    void get_infrared_undistorted(uint16_t infrared[], uint64_t& time, bool& valid_infrared);
+    void get_color_undistorted(uint8_t rgb[], uint64_t& time, bool& valid_color);
+    // Depth or infrared of the last get_frames compressed with
+    // kz::codec_encode, without converting to the Matlab layout
+    void get_depth_encoded(std::vector<uint8_t> &data, uint64_t& time, bool& valid_depth);
+    void get_infrared_encoded(std::vector<uint8_t> &data, uint64_t& time, bool& valid_infrared);
     void get_calibration(k4a_calibration_t &calibration);
-    void get_pointcloud(double pointcloud[], unsigned char colors[], bool color, bool& valid_data);   
+    void get_pointcloud(double pointcloud[], unsigned char colors[], bool color, bool& valid_data,
+                        const kz::Region &roi = kz::Region(), double normals[] = NULL,
+                        int normal_radius = 3, float max_depth_change = 0.02f);
+    void get_pointcloud_color(const kz::Region &roi, bool compact,
+                              const kz::PointCloudAllocator &allocate, bool &valid_data);
     void get_sensor_data(Imu_sample &imu_data);
 
+    // Sparse lookups on the depth of the frame. pixels is an (n x 2)
+    // Matlab array of subpixel (x, y) in the image of camera (depth or
+    // color), 0-based. Outputs (n x 3) points in mm in the frame of that
+    // camera and the (n x 2) pixels in the other camera, NaN where the
+    // lookup fails, and valid (n) for the points. Pixels that are not
+    // finite or fall outside the image fail. Returns false without depth.
+    bool map_pixels(k4a_calibration_type_t camera, const double *pixels, size_t n,
+                    double *points, double *other, uint8_t *valid);
+
+    // Queue the point cloud of the last get_frames to be written to a PLY
+    // or PCD file (from the extension of path) on the writer thread.
+    // Returns false without depth data; queued is false when the cloud was
+    // dropped because the queue was full.
+    bool save_pointcloud(const char *path, bool color, bool compact, bool &queued);
+    void set_cloud_writer(int queue_size, bool block);
+    void get_cloud_writer_stats(kz::CloudWriterStats &stats);
+    void flush_clouds();
+    bool set_threads(unsigned num_threads, const std::vector<int> &cpus);
+    void set_depth_filter(const kz::DepthFilterConfig &config);
+    void get_depth_filter_times(kz::DepthFilterTimes &last, kz::DepthFilterTimes &mean, uint64_t &frames);
+
+    // Background model learned from the depth of each get_frames and
+    // set_depth (see KinZ_background.h). set_background starts a new model.
+    void set_background(const kz::BackgroundConfig &config);
+    void reset_background();
+    // Foreground mask of the depth of the frame as an (h x w) Matlab array
+    void get_foreground(uint8_t mask[], uint64_t& time, bool& valid_data);
+    // Mean and standard deviation of the model, (h x w) Matlab arrays
+    void get_background(float mean[], float deviation[], uint64_t &frames, bool &valid_data);
+    // Compact point cloud of the foreground pixels of the region roi
+    // (step only), row by row, with the aligned color if color is set
+    void get_foreground_pointcloud(const kz::Region &roi, bool color,
+                                   const kz::PointCloudAllocator &allocate, bool &valid_data);
+
+    void get_frame_stats(kz::FrameStats &stats);
+    void reset_frame_stats();
+    void get_image_sizes(int &depth_width, int &depth_height, int &color_width, int &color_height);
+
+    // Serial number of the device, or of the calibration of an offline KinZ
+    const std::string &get_serial_number() const { return m_serial_number; }
+    bool is_offline() const { return m_offline; }
+
+    // Replace the depth or color image of the frame with a Matlab array of
+    // the size of the calibration, e.g. a stored frame for the aligned
+    // images and point clouds of an offline KinZ. Returns false when the
+    // size does not match.
+    bool set_depth(const uint16_t *depth, int width, int height);
+    bool set_color(const uint8_t *rgb, int width, int height);
+
+    // Geometry of n stored depth images, a (height x width x n) Matlab
+    // array of the size of the depth camera, in parallel over the frames
+    // (see KinZ_batch.h). Return false when the size does not match or
+    // the calibration does not allow it.
+    bool batch_pointcloud(const uint16_t *depth, int width, int height, int n, float *xyz);
+    bool batch_depth_aligned(const uint16_t *depth, int width, int height, int n,
+                             uint16_t *aligned);
+    bool batch_undistort_depth(const uint16_t *depth, int width, int height, int n,
+                               uint16_t *out);
+
+    // Compute the aligned images with kz::Reprojector instead of the SDK
+    // transformation. validate_reprojection compares both on the frames
+    // of the last get_frames; it returns false without depth and color.
+    void set_reprojection(bool native) { m_native_reprojection = native; }
+    bool get_reprojection() const { return m_native_reprojection; }
+    bool validate_reprojection(kz::ReprojectionReport &report);
+
+    // Images of the last get_frames, owned by KinZ (used by KinZ_server)
+    void get_images(k4a_image_t &depth, k4a_image_t &color, k4a_image_t &infrared);
+    const k4a_device_configuration_t &get_configuration() const { return m_config; }
+
+    // Frame archive (see KinZ_archive.h). archive_write stores the frames
+    // of the last get_frames; it returns false on a write error.
+    bool archive_open(const char *path, uint32_t streams);
+    bool archive_write(uint64_t &frame, uint32_t &valid);
+    uint64_t archive_close();
+
     #ifdef BODY
+    // Restart the body tracker with config. Returns false if the tracker
+    // was running and does not start with the new options.
+    bool set_tracker_config(const kz::TrackerConfig &config);
     void get_num_bodies(uint32_t &num_bodies);
-    void get_bodies(k4abt_frame_t &body_frame, k4a_calibration_t &calibration);
+    void get_bodies(std::vector<kz::Body> &bodies);
     void get_body_index_map(bool return_id, uint8_t body_index[], uint64_t& time, bool& valid_data);
     #endif
     
@@ -105,7 +358,8 @@ private:
 	k4a_device_configuration_t m_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     
     k4a_capture_t m_capture = NULL; 	// Capture device
-	//std::string m_serial_number;		// Serial number
+	std::string m_serial_number;		// Serial number
+    bool m_offline = false;             // no device, see set_depth
 
 	const int32_t TIMEOUT_IN_MS = 1000; // Max timeout
 
@@ -124,6 +378,62 @@ private:
     // calibration and transformation object
     k4a_calibration_t m_calibration;
     k4a_transformation_t m_transformation = NULL;
+    std::vector<float> m_depth_rays;    // see depth_rays()
+    std::vector<float> m_color_rays;    // see color_rays()
+
+    // Native reprojection, configured on first use, and the buffers of
+    // the aligned images it returns
+    bool m_native_reprojection = false;
+    std::unique_ptr<kz::Reprojector> m_reprojector;
+    std::vector<uint16_t> m_aligned_depth;
+    std::vector<uint8_t> m_aligned_color;
+
+    // Remap tables of the undistorted depth and infrared, and color,
+    // built on first use
+    std::unique_ptr<kz::Undistorter> m_depth_undistorter;
+    std::unique_ptr<kz::Undistorter> m_color_undistorter;
+
+    // Workers for get_all and the tiled conversions of large frames
+    kz::ThreadPool m_pool;
+
+    // Filters applied to m_image_d after each capture
+    kz::DepthFilter m_depth_filter;
+
+    // Background model learned after the filters, and the depth buffer
+    // and timestamp of the frame its mask belongs to
+    kz::BackgroundModel m_background;
+    const uint8_t *m_background_buffer = nullptr;
+    uint64_t m_background_time = 0;
+
+    // Frame accounting, see update_frame_stats()
+    kz::FrameStats m_frame_stats;
+    std::chrono::steady_clock::time_point m_last_capture_call;
+
+    // Frames read from the shared memory of a KinZ_server instead of the
+    // device. m_shm_frame is the frame wrapped by the images.
+    std::unique_ptr<kz::ShmReader> m_shm;
+    std::unique_ptr<kz::ShmFrame> m_shm_frame;
+
+    // Archive opened by archive_open and the double point cloud converted
+    // to single precision in its records
+    std::unique_ptr<kz::ArchiveWriter> m_archive;
+    std::vector<double> m_archive_cloud;
+
+    // Frames pinned by pin_frame and the one swapped in by select_frame
+    std::map<uint64_t, std::unique_ptr<kz::Frame> > m_pinned;
+    uint64_t m_next_handle = 1;
+    size_t m_max_pinned = 4;
+    kz::Frame *m_selected = nullptr;
+
+    // Writer thread of save_pointcloud, started on first use
+    std::unique_ptr<kz::CloudWriter> m_cloud_writer;
+
+    // Background initialization (ASYNC_INIT). m_init_cancel stops it
+    // between steps when the object is destroyed first.
+    std::thread m_init_thread;
+    std::atomic<bool> m_init_done{false};
+    std::atomic<bool> m_init_cancel{false};
+    kz::InitTiming m_init_timing;
 
     // Body tracking
     #ifdef BODY
@@ -132,13 +442,61 @@ private:
     bool m_body_tracking_available;
     uint32_t m_num_bodies;
     k4a_image_t m_body_index = nullptr;
+    kz::TrackerConfig m_tracker_config;
     #endif
     
 	int initialize(int resolution, bool wide_fov, bool binned, uint8_t framerate, uint8_t device_index);
     bool align_depth_to_color(int width, int height, k4a_image_t &transformed_depth_image);
     bool align_color_to_depth(int width, int height, k4a_image_t &transformed_color_image);
     bool depth_image_to_point_cloud(int width, int height, k4a_image_t &xyz_image);
-    void change_body_index_to_body_id(uint8_t* image_data, int width, int height);
+    const std::vector<float> &depth_rays();
+    const std::vector<float> &color_rays();
+    kz::Reprojector *reprojector();
+    kz::Undistorter *depth_undistorter();
+    kz::Undistorter *color_undistorter();
+    void filter_depth();
+    void update_background();
+    const uint8_t *foreground_mask(std::vector<uint8_t> &scratch);
+    void update_frame_stats(std::chrono::steady_clock::time_point call_time,
+                            bool has_depth, uint64_t depth_usec,
+                            bool has_color, uint64_t color_usec);
+    void init_device();
+    void configure_from_flags();
+    void init_offline(const char *calibration);
+    void warm_up();
+    void init_shm(const char *name);
+    bool get_frames_shm(uint16_t capture_flags, std::chrono::steady_clock::time_point call_time);
+    bool frame_intact();
+    bool select_frame(uint64_t handle);
+    void unselect_frame();
+    void swap_frame(kz::Frame &frame);
+    friend class kz::FrameScope;
     
 }; // KinZ class definition
 
+namespace kz
+{
+    // Makes the getters of kinz read the pinned frame handle while the
+    // scope exists. handle 0 keeps the frame of the last get_frames.
+    // get_frames and get_all must not be called inside the scope.
+    class FrameScope
+    {
+    public:
+        FrameScope(KinZ &kinz, uint64_t handle)
+            : m_kinz(kinz), m_selected(handle != 0 && kinz.select_frame(handle)) {}
+        ~FrameScope() { if (m_selected) m_kinz.unselect_frame(); }
+        bool selected() const { return m_selected; }
+
+        // Restore the last frame if a scope was left without running its
+        // destructor (a Matlab error raised inside it)
+        static void reset(KinZ &kinz) { kinz.unselect_frame(); }
+
+    private:
+        FrameScope(const FrameScope &);
+        FrameScope &operator=(const FrameScope &);
+        KinZ &m_kinz;
+        bool m_selected;
+    };
+}
+
+#endif // __KINZ_H__
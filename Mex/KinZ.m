@@ -74,6 +74,46 @@ classdef KinZ < handle
             % Example: Create a KinZ object to get color, depth and
             % infrared frames:
             % k2 = KinZ('color','depth','infrared');
+            %
+            % KinZ('shm') or KinZ('shm', name) reads the frames published
+            % by a KinZ_server in the shared memory name ('/kinz') instead
+            % of opening the device, so several sessions can use the same
+            % Kinect. Start the server first, e.g. ./KinZ_server --synthetic
+            %
+            % 'async' returns at once and opens the device on a background
+            % thread; poll isready, other methods wait for it to finish.
+            % 'warmup' runs a first capture through the transformation and
+            % the body tracker during the initialization, so the first
+            % frames are not slower. See getinittiming.
+            % Example: kz = KinZ('720p', 'bodyTracking', 'async', 'warmup');
+            %          while ~kz.isready, drawnow; end
+            %
+            % KinZ('offline', calibration, ...) works without a device with
+            % the calibration cached when the Kinect of serial number
+            % calibration was last opened (in ~/.cache/kinz or
+            % %LOCALAPPDATA%\KinZ, or $KINZ_CALIBRATION_DIR), or a copied
+            % .json calibration file. The color resolution and depth mode
+            % options select the calibration; give the frames with
+            % setdepth and setcolor to use the aligned images and point
+            % clouds.
+            % Example: kz = KinZ('offline', '000123456712', '720p');
+            %          kz.setdepth(depth); pc = kz.getpointcloud;
+            offline = '';
+            if numel(varargin) > 1 && strcmp(varargin{1}, 'offline')
+                offline = varargin{2};
+                varargin = varargin(3:end);
+            elseif ~isempty(varargin) && strcmp(varargin{1}, 'shm')
+                name = '/kinz';
+                if numel(varargin) > 1
+                    name = varargin{2};
+                end
+                [this.objectHandle, sizes] = KinZ_mex('newshm', name);
+                this.DepthWidth = sizes(1);
+                this.DepthHeight = sizes(2);
+                this.ColorWidth = sizes(3);
+                this.ColorHeight = sizes(4);
+                return
+            end
             
             % Get the flags
             this.flagRes720 = ismember('720p',varargin);
@@ -86,6 +126,8 @@ classdef KinZ < handle
             this.flagDepthWfov = ismember('wfov',varargin);
             this.flagImuOn = ismember('imu_on', varargin);
             this.flagBodyTracking = ismember('bodyTracking', varargin);
+            flagAsync = ismember('async', varargin);
+            flagWarmup = ismember('warmup', varargin);
             flags = uint16(0);
             
             if this.flagRes720
@@ -122,6 +164,8 @@ classdef KinZ < handle
             if this.flagDepthWfov, flags = flags + 2^10; end
             if this.flagImuOn, flags = flags + 2^11; end
             if this.flagBodyTracking, flags = flags + 2^12; end
+            if flagAsync, flags = flags + 2^14; end
+            if flagWarmup, flags = flags + 2^15; end
             
             if this.flagDepthWfov && this.flagDepthBinned
                 this.DepthWidth = 512;     
@@ -143,6 +187,13 @@ classdef KinZ < handle
                 this.DepthHeight = 576;
             end 
             
+            if ~isempty(offline)
+                [this.objectHandle, sizes] = KinZ_mex('newoffline', flags, offline);
+                if sizes(1) == 0
+                    warning('KinZ:offline', 'Cannot read the calibration %s', offline);
+                end
+                return
+            end
             this.objectHandle = KinZ_mex('new', flags);
             
         end
@@ -152,11 +203,79 @@ classdef KinZ < handle
             KinZ_mex('delete', this.objectHandle);            
         end
         
+        function ready = isready(this)
+            % ready = isready - true once the initialization of a KinZ
+            % created with 'async' finished, successfully or not. Does not
+            % wait.
+            ready = KinZ_mex('isready', this.objectHandle);
+        end
+        
+        function timing = getinittiming(this)
+            % timing = getinittiming - duration of the initialization
+            % steps in ms: open_ms, calibration_ms, start_ms, imu_ms,
+            % tracker_ms, warmup_ms and total_ms. ok is false if the
+            % cameras did not start. Waits for an 'async' initialization.
+            timing = KinZ_mex('getinittiming', this.objectHandle);
+        end
+        
+        function serial = getserialnumber(this)
+            % serial = getserialnumber - serial number of the Kinect, the
+            % name of its cached calibration for KinZ('offline', serial).
+            serial = KinZ_mex('getserialnumber', this.objectHandle);
+        end
+        
+        function setdepth(this, depth)
+            % setdepth(depth) - replace the depth frame with depth, a
+            % DepthHeight x DepthWidth uint16 image, e.g. a stored frame
+            % for the aligned images and point clouds of KinZ('offline').
+            KinZ_mex('setdepth', this.objectHandle, depth);
+            this.flagDepth = true;
+        end
+        
+        function setcolor(this, color)
+            % setcolor(color) - replace the color frame with color, a
+            % ColorHeight x ColorWidth x 3 uint8 RGB image.
+            KinZ_mex('setcolor', this.objectHandle, color);
+            this.flagColor = true;
+        end
+        
+        function pc = batchpointcloud(this, depth)
+            % pc = batchpointcloud(depth) - point clouds of stored depth
+            % frames, depth being DepthHeight x DepthWidth x N uint16.
+            % pc is a single (DepthWidth*DepthHeight x 3 x N) array in mm,
+            % the points of each frame ordered as in getpointcloud.
+            % Frames are processed in parallel; works offline, see
+            % KinZ('offline', ...).
+            pc = KinZ_mex('batchpointcloud', this.objectHandle, depth);
+        end
+        
+        function aligned = batchdepthaligned(this, depth)
+            % aligned = batchdepthaligned(depth) - stored depth frames
+            % (DepthHeight x DepthWidth x N uint16) aligned to the color
+            % camera, ColorHeight x ColorWidth x N, with the native
+            % reprojection (see setreprojection).
+            aligned = KinZ_mex('batchdepthaligned', this.objectHandle, depth);
+        end
+        
+        function undistorted = batchundistort(this, depth)
+            % undistorted = batchundistort(depth) - stored depth frames
+            % (DepthHeight x DepthWidth x N uint16) without the lens
+            % distortion: the images of a pinhole camera with the fx, fy,
+            % cx and cy of the depth camera (see getcalibration), nearest
+            % neighbor.
+            undistorted = KinZ_mex('batchundistort', this.objectHandle, depth);
+        end
+        
         %% video Sources        
         function varargout = getframes(this, varargin)
             % updateData - Capture Kinect data. 
             % Call this function before grabbing new data.
             % Return: flag indicating valid data.
+            % [validData, frame] = getframes(...) also pins the frame and
+            % returns its handle (0 if not valid). The getters read it with
+            % 'frame', frame while newer frames are captured, until
+            % releaseframe(frame). Up to setmaxpinnedframes frames (4) are
+            % kept; the SDK holds their images, so release them promptly.
             this.flagDepth = ismember('depth',varargin);
             this.flagColor = ismember('color',varargin);
             this.flagInfrared = ismember('infrared',varargin);
@@ -175,11 +294,117 @@ classdef KinZ < handle
 
             [varargout{1:nargout}] = KinZ_mex('getframes', this.objectHandle, capture_flags);
         end
+        
+        function numReleased = releaseframe(this, frames)
+            % numReleased = releaseframe(frames) - release the frames
+            % pinned by getframes. releaseframe or releaseframe('all')
+            % releases all of them.
+            if nargin < 2 || (ischar(frames) && strcmp(frames, 'all'))
+                frames = uint64([]);
+            end
+            numReleased = KinZ_mex('releaseframe', this.objectHandle, uint64(frames));
+        end
+        
+        function setmaxpinnedframes(this, n)
+            % setmaxpinnedframes(n) - frames that getframes may keep pinned
+            % (4). getframes returns frame 0 when the limit is reached.
+            KinZ_mex('setmaxpinnedframes', this.objectHandle, double(n));
+        end
+        
+        function [pinned, maxPinned] = getpinnedframes(this)
+            % [pinned, maxPinned] = getpinnedframes - number of frames
+            % currently pinned and the limit.
+            counts = KinZ_mex('getpinnedframes', this.objectHandle);
+            pinned = counts(1);
+            maxPinned = counts(2);
+        end
+        
+        function data = getall(this, varargin)
+            % data = getall - Capture Kinect data and return all the
+            % requested streams in a single call.
+            % Accepts the same sources as getframes: 'color', 'depth',
+            % 'infrared', 'imu', 'bodies', 'bodyIndex'.
+            % Color, depth, infrared and bodies are converted in parallel.
+            % Return: structure with the fields valid, depth,
+            % depth_timestamp, color, color_timestamp, infrared,
+            % infrared_timestamp and bodies. Streams that were not
+            % requested or are not valid are empty.
+            % The getters can still be called afterwards for the same frame.
+            % See getallSpeed.m
+            this.flagDepth = ismember('depth',varargin);
+            this.flagColor = ismember('color',varargin);
+            this.flagInfrared = ismember('infrared',varargin);
+            this.flagImu = ismember('imu', varargin);
+            this.flagGetBodies = ismember('bodies', varargin);
+            this.flagGetBodyIndex = ismember('bodyIndex', varargin);
+            capture_flags = uint16(0);
+            
+            if this.flagColor, capture_flags = capture_flags + 1; end
+            if this.flagDepth, capture_flags = capture_flags + 2; end
+            if this.flagInfrared, capture_flags = capture_flags + 2^2; end
+            if this.flagImu, capture_flags = capture_flags + 2^11; end
+            if this.flagGetBodies, capture_flags = capture_flags + 2^12; end
+            if this.flagGetBodyIndex, capture_flags = capture_flags + 2^13; end
+            
+            colorHeight = 0; colorWidth = 0;
+            if ~isempty(this.ColorHeight)
+                colorHeight = this.ColorHeight;
+                colorWidth = this.ColorWidth;
+            end
+            
+            data = KinZ_mex('getall', this.objectHandle, capture_flags, ...
+                            this.DepthHeight, this.DepthWidth, ...
+                            colorHeight, colorWidth);
+        end
+                
+        function burst = getburst(this, n, varargin)
+            % burst = getburst(n, streams...) - Capture n consecutive
+            % frames in one call, as fast as the device delivers them.
+            % streams are 'color', 'depth' and 'infrared'. Each frame is
+            % converted on the worker threads (see setthreads) while the
+            % next ones are captured, into arrays allocated before the
+            % first capture.
+            % Return: structure with the fields depth and infrared
+            % (DepthHeight x DepthWidth x n), color
+            % (ColorHeight x ColorWidth x 3 x n), timestamps (n x 3 uint64
+            % device timestamps in usec) and valid (n x 3 logical), the
+            % columns being depth, color and infrared, and captured, the
+            % number of captures received. Streams that were not requested
+            % are empty. The last frame stays the current one for the
+            % getters.
+            % Example: burst = kz.getburst(90, 'depth', 'color');
+            this.flagDepth = ismember('depth',varargin);
+            this.flagColor = ismember('color',varargin);
+            this.flagInfrared = ismember('infrared',varargin);
+            capture_flags = uint16(0);
+            if this.flagColor, capture_flags = capture_flags + 1; end
+            if this.flagDepth, capture_flags = capture_flags + 2; end
+            if this.flagInfrared, capture_flags = capture_flags + 2^2; end
+            
+            colorHeight = 0; colorWidth = 0;
+            if ~isempty(this.ColorHeight)
+                colorHeight = this.ColorHeight;
+                colorWidth = this.ColorWidth;
+            end
+            
+            burst = KinZ_mex('getburst', this.objectHandle, capture_flags, n, ...
+                             this.DepthHeight, this.DepthWidth, ...
+                             colorHeight, colorWidth);
+        end
                 
         function varargout = getdepth(this, varargin)
             % depth = getDepth - returns a 512 x 512 16-bit depth frame frame from Kinect for Azure. 
             % You must call updateData before and verify that there is valid data.
             % See videoDemo.m
+            % Name-Value Pair Arguments:
+            %   'roi' - [x y width height] region to return, where x and y
+            %   are the 1-based column and row of its top-left pixel.
+            %   [] (default) returns the whole frame.
+            %   'step' - return one pixel every step pixels in x and y (1).
+            %   'scale' - downscale by 1/2, 1/4 or 1/8 averaging the valid
+            %   (non-zero) depth of each block of pixels (1).
+            %   'frame' - handle returned by getframes to read instead of
+            %   the last frame (0).
             
             % Verify that the depth source was selected
             if ~this.flagDepth
@@ -187,13 +412,23 @@ classdef KinZ < handle
                 error('No depth source selected!');
             end
             
-            [varargout{1:nargout}] = KinZ_mex('getdepth', this.objectHandle, this.DepthHeight, this.DepthWidth);
+            [region, frame] = this.parseregion(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getdepth', this.DepthHeight, this.DepthWidth, region{:});
         end
         
         function varargout = getdepthaligned(this, varargin)
             % depth = getDepth - returns a 512 x 512 16-bit depth frame frame from Kinect for Azure. 
             % You must call updateData before and verify that there is valid data.
             % See videoDemo.m
+            % Name-Value Pair Arguments:
+            %   'roi' - [x y width height] region to return, where x and y
+            %   are the 1-based column and row of its top-left pixel.
+            %   [] (default) returns the whole frame.
+            %   'step' - return one pixel every step pixels in x and y (1).
+            %   'scale' - downscale by 1/2, 1/4 or 1/8 averaging the valid
+            %   (non-zero) depth of each block of pixels (1).
+            %   'frame' - handle returned by getframes to read instead of
+            %   the last frame (0).
             
             % Verify that the depth source was selected
             if ~this.flagDepth
@@ -201,13 +436,23 @@ classdef KinZ < handle
                 error('No depth source selected!');
             end
             
-            [varargout{1:nargout}] = KinZ_mex('getdepth_aligned', this.objectHandle, this.ColorHeight, this.ColorWidth);
+            [region, frame] = this.parseregion(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getdepthaligned', this.ColorHeight, this.ColorWidth, region{:});
         end
                 
         function varargout = getcolor(this, varargin)
             % color = getColor - returns a 1280 x 720 3-channel color frame frame from Kinect for Azure. 
             % You must call updateData before and verify that there is valid data.
             % See videoDemo.m
+            % Name-Value Pair Arguments:
+            %   'roi' - [x y width height] region to return, where x and y
+            %   are the 1-based column and row of its top-left pixel.
+            %   [] (default) returns the whole frame.
+            %   'step' - return one pixel every step pixels in x and y (1).
+            %   'scale' - downscale by 1/2, 1/4 or 1/8 averaging each block
+            %   of pixels (1). Cannot be combined with 'step'.
+            %   'frame' - handle returned by getframes to read instead of
+            %   the last frame (0).
             
             % Verify that the color source was selected
             if ~this.flagColor
@@ -215,13 +460,23 @@ classdef KinZ < handle
                 error('No color source selected!');
             end
             
-            [varargout{1:nargout}] = KinZ_mex('getcolor', this.objectHandle,this.ColorHeight, this.ColorWidth);
+            [region, frame] = this.parseregion(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getcolor', this.ColorHeight, this.ColorWidth, region{:});
         end
         
         function varargout = getcoloraligned(this, varargin)
             % depth = getDepth - returns a 512 x 512 16-bit depth frame frame from Kinect for Azure. 
             % You must call updateData before and verify that there is valid data.
             % See videoDemo.m
+            % Name-Value Pair Arguments:
+            %   'roi' - [x y width height] region to return, where x and y
+            %   are the 1-based column and row of its top-left pixel.
+            %   [] (default) returns the whole frame.
+            %   'step' - return one pixel every step pixels in x and y (1).
+            %   'scale' - downscale by 1/2, 1/4 or 1/8 averaging each block
+            %   of pixels (1). Cannot be combined with 'step'.
+            %   'frame' - handle returned by getframes to read instead of
+            %   the last frame (0).
             
             % Verify that the depth source was selected
             if ~this.flagDepth
@@ -229,7 +484,8 @@ classdef KinZ < handle
                 error('No depth source selected!');
             end
             
-            [varargout{1:nargout}] = KinZ_mex('getcoloraligned', this.objectHandle, this.DepthHeight, this.DepthWidth);
+            [region, frame] = this.parseregion(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getcoloraligned', this.DepthHeight, this.DepthWidth, region{:});
         end
                 
         function varargout = getinfrared(this, varargin)
@@ -237,13 +493,344 @@ classdef KinZ < handle
             % [infrared, timeStamp] = getInfrared - also returns the relative timestamp.
             % You must call updateData before and verify that there is valid data.
             % See videoDemo.m
+            % Name-Value Pair Arguments:
+            %   'roi' - [x y width height] region to return, where x and y
+            %   are the 1-based column and row of its top-left pixel.
+            %   [] (default) returns the whole frame.
+            %   'step' - return one pixel every step pixels in x and y (1).
+            %   'scale' - downscale by 1/2, 1/4 or 1/8 averaging each block
+            %   of pixels (1). Cannot be combined with 'step'.
+            %   'frame' - handle returned by getframes to read instead of
+            %   the last frame (0).
             
             % Verify that the infrared source was selected
             if ~this.flagInfrared
                 this.delete;
                 error('No infrared source selected!');
             end
-            [varargout{1:nargout}] = KinZ_mex('getinfrared', this.objectHandle, this.DepthHeight, this.DepthWidth);
+            [region, frame] = this.parseregion(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getinfrared', this.DepthHeight, this.DepthWidth, region{:});
+        end
+        
+        function varargout = getdepthundistorted(this, varargin)
+            % [depth, timeStamp] = getdepthundistorted - depth frame without
+            % the lens distortion: the image of a pinhole camera with the
+            % fx, fy, cx and cy of the depth camera (see getcalibration).
+            % Pixels take the depth of the nearest source pixel; those
+            % outside of the field of view are 0. The remap table is built
+            % on the first call.
+            % Name-Value Pair Arguments:
+            %   'frame' - handle returned by getframes to read instead of
+            %   the last frame (0).
+            if ~this.flagDepth
+                this.delete;
+                error('No depth source selected!');
+            end
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getdepthundistorted');
+        end
+        
+        function varargout = getinfraredundistorted(this, varargin)
+            % [infrared, timeStamp] = getinfraredundistorted - infrared
+            % frame without the lens distortion, bilinear interpolation.
+            % See getdepthundistorted.
+            if ~this.flagInfrared
+                this.delete;
+                error('No infrared source selected!');
+            end
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getinfraredundistorted');
+        end
+        
+        function varargout = getcolorundistorted(this, varargin)
+            % [color, timeStamp] = getcolorundistorted - color frame
+            % without the lens distortion, bilinear interpolation, for the
+            % intrinsics of the color camera. See getdepthundistorted.
+            if ~this.flagColor
+                this.delete;
+                error('No color source selected!');
+            end
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getcolorundistorted');
+        end
+        
+        function varargout = getdepthencoded(this, varargin)
+            % [data, timeStamp] = getdepthencoded - depth frame of the last
+            % getframes compressed losslessly in C++ (uint8 vector), for
+            % recording or transport. Restore it with decompress.
+            % getdepthencoded('frame', handle) encodes a pinned frame.
+            if ~this.flagDepth
+                this.delete;
+                error('No depth source selected!');
+            end
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getdepthencoded');
+        end
+        
+        function varargout = getinfraredencoded(this, varargin)
+            % [data, timeStamp] = getinfraredencoded - infrared frame of the
+            % last getframes compressed losslessly, see getdepthencoded.
+            if ~this.flagInfrared
+                this.delete;
+                error('No infrared source selected!');
+            end
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getinfraredencoded');
+        end
+        
+        function data = compress(~, images)
+            % data = compress(images) - compress a uint16 (H x W x N) stack
+            % of depth or infrared frames without loss. data is a 1 x N
+            % cell of uint8 vectors. Frames are compressed in parallel.
+            data = KinZ_mex('compress', images);
+        end
+        
+        function images = decompress(~, data)
+            % images = decompress(data) - uint16 (H x W x N) frames of a
+            % cell (or a single vector) returned by compress,
+            % getdepthencoded or getinfraredencoded.
+            images = KinZ_mex('decompress', data);
+        end
+        
+        function setthreads(this, numThreads, varargin)
+            % setthreads - set the number of threads used to convert the
+            % frames. 0 uses one thread per core.
+            % Name-Value Pair Arguments:
+            %   'affinity' - vector of cpu indices (0-based). Worker i is
+            %   pinned to affinity(mod(i, numel(affinity)) + 1).
+            %   [] (default) lets the OS schedule the workers.
+            % Example: kz.setthreads(4, 'affinity', [2 3 4 5]);
+            p = inputParser;
+            p.addParameter('affinity', [], @isnumeric);
+            p.parse(varargin{:});
+            
+            KinZ_mex('setthreads', this.objectHandle, double(numThreads), ...
+                     double(p.Results.affinity));
+        end
+        
+        function setreprojection(this, engine)
+            % setreprojection - engine used by getdepthaligned,
+            % getcoloraligned and the colored point clouds:
+            %   'sdk' (default) - k4a transformation of the Azure Kinect SDK
+            %   'native' - KinZ engine computed from the calibration, on
+            %   all the threads of setthreads
+            % Use validatereprojection to compare both on your device.
+            engine = validatestring(engine, {'sdk', 'native'});
+            KinZ_mex('setreprojection', this.objectHandle, ...
+                     double(strcmp(engine, 'native')));
+        end
+        
+        function report = validatereprojection(this)
+            % report = validatereprojection - run the SDK and the native
+            % reprojection on the frames of the last getframes and compare
+            % them. Requires depth and color.
+            % depth_*: depth aligned to color. Pixels with depth in both
+            % images (depth_common) or in one only, mean and 99th
+            % percentile of the absolute difference in mm, and fraction
+            % of common pixels within max(2 mm, 1% of the depth).
+            % color_*: color aligned to depth. Pixels colored in both,
+            % mean absolute difference in levels and fraction of pixels
+            % with every channel within 8 levels.
+            % *_sdk_ms, *_native_ms: execution times.
+            % pass is true when both agreements are at least 98%.
+            report = KinZ_mex('validatereprojection', this.objectHandle);
+        end
+        
+        function setdepthfilter(this, varargin)
+            % setdepthfilter - configure the depth filters applied in C++
+            % after each getframes. All the getters, the alignment and the
+            % point cloud use the filtered depth.
+            % Name-Value Pair Arguments:
+            %   'temporal' - per-pixel exponential average (false)
+            %   'temporalAlpha' - weight of the new frame in (0,1] (0.4)
+            %   'temporalDelta' - changes larger than this (mm) reset the
+            %       pixel instead of averaging (20)
+            %   'spatial' - edge-preserving spatial smoothing (false)
+            %   'spatialRadius' - window radius in pixels, 1 to 5 (2)
+            %   'spatialSigmaSpace' - gaussian sigma in pixels (1.5)
+            %   'spatialSigmaRange' - depth difference (mm) at which a
+            %       neighbor weight halves (20)
+            %   'holeFilling' - fill invalid pixels with the farthest
+            %       valid neighbor (false)
+            %   'holeFillingRadius' - window radius in pixels, 1 to 5 (1)
+            % Example: kz.setdepthfilter('temporal', true, 'holeFilling', true);
+            p = inputParser;
+            p.addParameter('temporal', false, @islogical);
+            p.addParameter('temporalAlpha', 0.4, @isnumeric);
+            p.addParameter('temporalDelta', 20, @isnumeric);
+            p.addParameter('spatial', false, @islogical);
+            p.addParameter('spatialRadius', 2, @isnumeric);
+            p.addParameter('spatialSigmaSpace', 1.5, @isnumeric);
+            p.addParameter('spatialSigmaRange', 20, @isnumeric);
+            p.addParameter('holeFilling', false, @islogical);
+            p.addParameter('holeFillingRadius', 1, @isnumeric);
+            p.parse(varargin{:});
+            r = p.Results;
+            
+            config = struct('temporal', r.temporal, ...
+                            'temporal_alpha', r.temporalAlpha, ...
+                            'temporal_delta', r.temporalDelta, ...
+                            'spatial', r.spatial, ...
+                            'spatial_radius', r.spatialRadius, ...
+                            'spatial_sigma_space', r.spatialSigmaSpace, ...
+                            'spatial_sigma_range', r.spatialSigmaRange, ...
+                            'hole_filling', r.holeFilling, ...
+                            'hole_filling_radius', r.holeFillingRadius);
+            KinZ_mex('setdepthfilter', this.objectHandle, config);
+        end
+        
+        function setbackground(this, varargin)
+            % setbackground - learn a per-pixel model of the background
+            % depth in C++ on every getframes (and setdepth), after the
+            % depth filters, and classify each frame into foreground, see
+            % getforeground.
+            % Every call starts a new model.
+            % Name-Value Pair Arguments:
+            %   'enabled' - maintain the model (true)
+            %   'learningRate' - weight of the new frame in (0,1]. The
+            %       first frames are averaged until it is reached (0.02)
+            %   'foregroundLearningRate' - same for foreground pixels;
+            %       0 never absorbs objects that stay still (0)
+            %   'threshold' - a pixel is foreground when it is closer
+            %       than the background by this many standard deviations
+            %   (3) and at least
+            %   'minDeviation' - mm (20), and
+            %   'relativeDeviation' - fraction of the background depth
+            %       (0.01)
+            % setbackground('enabled', false) frees the model.
+            % Example: kz.setbackground; ... mask = kz.getforeground;
+            p = inputParser;
+            p.addParameter('enabled', true, @islogical);
+            p.addParameter('learningRate', 0.02, @isnumeric);
+            p.addParameter('foregroundLearningRate', 0, @isnumeric);
+            p.addParameter('threshold', 3, @isnumeric);
+            p.addParameter('minDeviation', 20, @isnumeric);
+            p.addParameter('relativeDeviation', 0.01, @isnumeric);
+            p.parse(varargin{:});
+            r = p.Results;
+            if ~this.flagDepth
+                this.delete;
+                error('No depth source selected!');
+            end
+            
+            config = struct('enabled', r.enabled, ...
+                            'learning_rate', r.learningRate, ...
+                            'foreground_learning_rate', r.foregroundLearningRate, ...
+                            'threshold', r.threshold, ...
+                            'min_deviation', r.minDeviation, ...
+                            'relative_deviation', r.relativeDeviation);
+            KinZ_mex('setbackground', this.objectHandle, config);
+        end
+        
+        function resetbackground(this)
+            % resetbackground - forget the learned background, e.g. after
+            % the camera moved, keeping the options of setbackground
+            KinZ_mex('resetbackground', this.objectHandle);
+        end
+        
+        function varargout = getforeground(this, varargin)
+            % [mask, timeStamp] = getforeground - logical foreground mask
+            % of the depth of the last getframes (depth height x width),
+            % see setbackground. Empty until the model learned a frame.
+            % getforeground('frame', handle) classifies a pinned frame
+            % against the current model.
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getforeground');
+        end
+        
+        function [background, deviation, frames] = getbackground(this)
+            % [background, deviation, frames] = getbackground - mean depth
+            % and its standard deviation in mm (single, depth height x
+            % width), 0 where no depth was learned, and the number of
+            % frames learned since setbackground or resetbackground.
+            [background, deviation, frames] = KinZ_mex('getbackground', this.objectHandle);
+        end
+        
+        function stats = getdepthfilterstats(this)
+            % stats = getdepthfilterstats - time in ms of each depth
+            % filter stage for the last frame and averaged since the last
+            % setdepthfilter call.
+            stats = KinZ_mex('getdepthfilterstats', this.objectHandle);
+        end
+        
+        function stats = getframestats(this)
+            % stats = getframestats - frame accounting of getframes since
+            % the start or the last resetframestats, computed from the
+            % device timestamps:
+            %   captured - captures received
+            %   timeouts - getframes calls that got no capture in time
+            %   failures - getframes calls where the capture failed, e.g.
+            %       the device was unplugged
+            %   sensor_dropped - frames missing in the device timestamps
+            %   consumer_skipped - missing frames lost because getframes
+            %       was called too late to receive them
+            %   period_usec - expected frame period
+            %   jitter_mean_usec, jitter_max_usec - deviation of the time
+            %       between frames from a multiple of the period
+            %   sync_offset_usec - color minus depth timestamp of the last
+            %       capture, with its mean and largest absolute value
+            stats = KinZ_mex('getframestats', this.objectHandle);
+        end
+        
+        function resetframestats(this)
+            % resetframestats - restart the counters of getframestats
+            KinZ_mex('resetframestats', this.objectHandle);
+        end
+        
+        function archiveopen(this, filename, varargin)
+            % archiveopen - create a frame archive. Each archivewrite
+            % appends the frames of the last getframes already converted
+            % to the layout of the getters, so KinZArchive can map any
+            % frame without decoding.
+            % Streams to store (all false by default):
+            %   'depth', 'infrared', 'color', 'pointcloud' (single), 'bodies'
+            % Example: kz.archiveopen('session.kza', 'depth', 'color');
+            names = {'depth', 'color', 'infrared', 'pointcloud', 'bodies'};
+            streams = 0;
+            for i = 1:numel(varargin)
+                idx = find(strcmpi(varargin{i}, names));
+                if isempty(idx)
+                    error('Unknown archive stream %s', varargin{i});
+                end
+                streams = bitor(streams, 2^(idx - 1));
+            end
+            KinZ_mex('archiveopen', this.objectHandle, filename, double(streams));
+        end
+        
+        function varargout = archivewrite(this, varargin)
+            % [frame, valid] = archivewrite - append the frames of the last
+            % getframes to the archive. frame is the 1-based number of the
+            % record and valid the bit mask of the streams stored
+            % (1 depth, 2 color, 4 infrared, 8 pointcloud, 16 bodies).
+            % archivewrite('frame', handle) appends a pinned frame.
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'archivewrite');
+        end
+        
+        function varargout = archiveclose(this)
+            % numFrames = archiveclose - write the index of the archive and
+            % close it.
+            [varargout{1:nargout}] = KinZ_mex('archiveclose', this.objectHandle);
+        end
+        
+        function varargout = drainlog(~)
+            % drainlog - print the pending KinZ messages. They are also
+            % printed at the start and end of every KinZ call.
+            % log = drainlog - return them instead as a struct array with
+            % fields level, time (seconds), message and suppressed (number
+            % of rate-limited messages of the same origin).
+            [varargout{1:nargout}] = KinZ_mex('drainlog');
+        end
+        
+        function setloglevel(~, level)
+            % setloglevel - most detailed messages logged:
+            % 'error', 'warning', 'info' (default) or 'debug'.
+            levels = {'error', 'warning', 'info', 'debug'};
+            idx = find(strcmpi(level, levels));
+            if isempty(idx)
+                error('Unknown log level %s', level);
+            end
+            KinZ_mex('setloglevel', idx - 1);
         end
         
         function varargout = getcalibration(this, varargin)
@@ -288,6 +875,40 @@ classdef KinZ < handle
             %   camera on the Kin2 object creation. Otherwise it will
             %   trigger a warning each time the method is called.
             %
+            %   'roi' - [x y width height] region of the depth image to
+            %   convert, where x and y are the 1-based column and row of
+            %   its top-left pixel. [] (default) converts the whole image.
+            %   'step' - use one depth pixel every step pixels (1).
+            %   Points are ordered row by row of the region.
+            %
+            %   'geometry' - camera of the cloud, 'depth' (default) or
+            %   'color'. 'color' transforms the depth to the color camera
+            %   and returns one point per color pixel of the region, with
+            %   its own color, in the color camera frame; 'roi' and 'step'
+            %   then refer to the color image. Normals are not available.
+            %   'compact' - with 'color' geometry, return only the valid
+            %   points (false). Points stay ordered row by row.
+            %
+            %   'foreground' - only the points of the foreground pixels
+            %   of getforeground, compacted in C++ (false). Needs
+            %   setbackground; depth geometry only, without normals.
+            %
+            %   'normals' - estimate the normal of each point from its
+            %   neighbors on the depth grid (false). With 'raw' output the
+            %   normals are returned as a third n x 3 output, which also
+            %   enables them: [pc, colors, normals] = kz.getpointcloud;
+            %   With 'pointCloud' output they fill its Normal property.
+            %   Normals point toward the camera and are 0 where undefined.
+            %   'normalRadius' - distance in depth pixels of the neighbors
+            %   used for the normals, at least 'step' (3). Larger values
+            %   smooth the depth noise.
+            %   'maxDepthChange' - neighbors whose depth differs by more
+            %   than maxDepthChange * depth * normalRadius are across a depth
+            %   discontinuity and not used for the normals (0.02).
+            %
+            %   'frame' - handle returned by getframes to convert instead
+            %   of the last frame (0).
+            %
             %   You must call updateData before and verify that there is valid data.
             %   See pointCloudDemo.m and pointCloudDemo2.m
             
@@ -300,7 +921,20 @@ classdef KinZ < handle
             
             p.addParameter('output',defaultOutput,@(x) any(validatestring(x,expectedOutputs)));
             p.addParameter('color',defaultColor,@(x) any(validatestring(x,expectedColors)));
+            p.addParameter('roi', [], @isnumeric);
+            p.addParameter('step', 1, @isnumeric);
+            p.addParameter('normals', false, @islogical);
+            p.addParameter('geometry', 'depth', @(x) any(validatestring(x, {'depth', 'color'})));
+            p.addParameter('compact', false, @islogical);
+            p.addParameter('foreground', false, @islogical);
+            p.addParameter('normalRadius', 3, @isnumeric);
+            p.addParameter('maxDepthChange', 0.02, @isnumeric);
+            p.addParameter('frame', 0, @isnumeric);
             p.parse(varargin{:});
+            frame = p.Results.frame;
+            region = this.parseregion('roi', p.Results.roi, 'step', p.Results.step);
+            withNormals = p.Results.normals || ...
+                (nargout > 2 && strcmp(p.Results.output, 'raw'));
             
             % Required color?
             if strcmp(p.Results.color,'true')
@@ -318,9 +952,35 @@ classdef KinZ < handle
             end
             
             % Get the pointcloud from the Kinect V2 as a nx3 matrix
-            [varargout{1:2}] = KinZ_mex('getpointcloud', this.objectHandle, ...
-                                        this.DepthHeight, this.DepthWidth, ... 
-                                        withColor);
+            if strcmp(p.Results.geometry, 'color')
+                if withNormals
+                    error('Normals are not available in color geometry.');
+                end
+                if p.Results.foreground
+                    error('The foreground cloud is only available in depth geometry.');
+                end
+                [varargout{1:2}] = this.framecall(frame, 'getpointcloudcolor', ...
+                                            this.ColorHeight, this.ColorWidth, ...
+                                            double(withColor), double(p.Results.compact), ...
+                                            region{:});
+            elseif p.Results.foreground
+                if withNormals
+                    error('Normals are not available for the foreground cloud.');
+                end
+                [varargout{1:2}] = this.framecall(frame, 'getforegroundpointcloud', ...
+                                            this.DepthHeight, this.DepthWidth, ...
+                                            double(withColor), region{:});
+            elseif withNormals
+                [varargout{1:3}] = this.framecall(frame, 'getpointcloud', ...
+                                            this.DepthHeight, this.DepthWidth, ...
+                                            withColor, region{:}, ...
+                                            double(p.Results.normalRadius), ...
+                                            double(p.Results.maxDepthChange));
+            else
+                [varargout{1:2}] = this.framecall(frame, 'getpointcloud', ...
+                                            this.DepthHeight, this.DepthWidth, ... 
+                                            withColor, region{:});
+            end
             
             % If the required output is a pointCloud object,            
             if strcmp(p.Results.output,'pointCloud')
@@ -331,15 +991,109 @@ classdef KinZ < handle
                 % pointCloud object supported!
                 else
                     % Convert nx3 matrix to pointCloud MATLAB object with colors
+                    args = {};
                     if withColor == 1
-                        varargout{1} = pointCloud(varargout{1},'Color',varargout{2});
-                    else
-                        varargout{1} = pointCloud(varargout{1});
+                        args = [args, {'Color', varargout{2}}];
+                    end
+                    if withNormals
+                        args = [args, {'Normal', varargout{3}}];
                     end
+                    varargout{1} = pointCloud(varargout{1}, args{:});
                 end  
             end                     
         end        
 
+        function [points, pixels, valid] = mappixels(this, pixels, varargin)
+            % [points, pixels, valid] = mappixels(pixels) - 3D points of
+            % a few pixels of the depth of the last getframes, e.g.
+            % detected keypoints, without computing the point cloud.
+            % pixels is n x 2 [x y] (1-based, subpixel) in the depth image.
+            % points (n x 3, mm) are in the depth camera frame and pixels
+            % are returned in the color image.
+            % mappixels(pixels, 'color') takes color pixels instead: their
+            % depth pixel is found along the epipolar line, points are in
+            % the color camera frame and pixels in the depth image.
+            % Lookups that fail are NaN and valid (n x 1) is false.
+            % mappixels(..., 'frame', handle) uses a pinned frame.
+            if ~this.flagDepth
+                this.delete;
+                error('No depth source selected!');
+            end
+            camera = 'depth';
+            if ~isempty(varargin) && any(strcmp(varargin{1}, {'depth', 'color'}))
+                camera = varargin{1};
+                varargin = varargin(2:end);
+            end
+            if strcmp(camera, 'color') && ~this.flagColor
+                this.delete;
+                error('No color source selected!');
+            end
+            frame = this.parseframe(varargin{:});
+            [points, pixels, valid] = this.framecall(frame, 'mappixels', ...
+                1 + strcmp(camera, 'color'), double(pixels) - 1);
+            pixels = pixels + 1;
+        end
+
+        function queued = savepointcloud(this, filename, varargin)
+            % queued = savepointcloud(filename) - write the point cloud of
+            % the last getframes to a binary PLY or PCD file (from the
+            % extension of filename), in mm. The cloud is built in C++ and
+            % written on a background thread, so the call returns without
+            % waiting for the disk. queued is false when the writer queue
+            % was full and the cloud was dropped (see setcloudwriter).
+            % Name-Value Pair Arguments:
+            %   'color' - add the color of each point (false)
+            %   'compact' - write only the valid points (false). Otherwise
+            %   invalid points are NaN and PCD files are organized.
+            %   'frame' - handle returned by getframes to save instead of
+            %   the last frame (0).
+            % Example: kz.savepointcloud(sprintf('cloud%04d.pcd', n), 'color', true);
+            p = inputParser;
+            p.addParameter('color', false, @islogical);
+            p.addParameter('compact', false, @islogical);
+            p.addParameter('frame', 0, @isnumeric);
+            p.parse(varargin{:});
+            
+            if ~this.flagDepth
+                this.delete;
+                error('No depth source selected!');
+            end
+            withColor = p.Results.color;
+            if withColor && ~this.flagColor
+                warning('color source is not selected.');
+                withColor = false;
+            end
+            queued = this.framecall(p.Results.frame, 'savepointcloud', filename, ...
+                                    double(withColor), double(p.Results.compact));
+        end
+        
+        function setcloudwriter(this, varargin)
+            % setcloudwriter - configure the writer of savepointcloud.
+            % Name-Value Pair Arguments:
+            %   'queueSize' - clouds waiting to be written (4)
+            %   'block' - when the queue is full, wait for a free place
+            %   instead of dropping the cloud (false)
+            p = inputParser;
+            p.addParameter('queueSize', 4, @isnumeric);
+            p.addParameter('block', false, @islogical);
+            p.parse(varargin{:});
+            KinZ_mex('setcloudwriter', this.objectHandle, ...
+                     double(p.Results.queueSize), double(p.Results.block));
+        end
+        
+        function stats = getcloudwriterstats(this)
+            % stats = getcloudwriterstats - counters of savepointcloud:
+            % submitted, written, failed, dropped (queue full), waited and
+            % wait_ms (time blocked on a full queue), write_ms_mean,
+            % bytes, queue_size, pending and max_pending.
+            stats = KinZ_mex('getcloudwriterstats', this.objectHandle);
+        end
+        
+        function flushclouds(this)
+            % flushclouds - wait until the queued clouds were written
+            KinZ_mex('flushclouds', this.objectHandle);
+        end
+        
         function varargout = getsensordata(this, varargin)
             % imu_data = getSensorData - returns a structure containing the sensor
             % data
@@ -351,7 +1105,8 @@ classdef KinZ < handle
                 this.delete;
                 error('No IMU source selected!');
             end
-            [varargout{1:nargout}] = KinZ_mex('getsensordata', this.objectHandle);
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getsensordata');
         end
         
         function varargout = getnumbodies(this, varargin)
@@ -364,7 +1119,8 @@ classdef KinZ < handle
                 this.delete;
                 error('No Bodies source selected!');
             end
-            [varargout{1:nargout}] = KinZ_mex('getnumbodies', this.objectHandle);
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getnumbodies');
         end
         
         function varargout = getbodies(this, varargin)
@@ -378,7 +1134,19 @@ classdef KinZ < handle
                 this.delete;
                 error('No Bodies source selected!');
             end
-            [varargout{1:nargout}] = KinZ_mex('getbodies', this.objectHandle);
+            frame = this.parseframe(varargin{:});
+            [varargout{1:nargout}] = this.framecall(frame, 'getbodies');
+        end
+        
+        function ok = settrackerconfig(this, varargin)
+            % settrackerconfig - restart the body tracker with new options.
+            % ok is false if the tracker does not start with them.
+            % Name-Value Pair Arguments (see KinZ.trackrecording):
+            %   'processingMode', 'orientation', 'gpuDevice', 'liteModel',
+            %   'smoothing', 'modelPath'
+            % Example: kz.settrackerconfig('processingMode', 'cpu', 'liteModel', true);
+            [options, modelPath] = KinZ.trackeroptions(varargin{:});
+            ok = KinZ_mex('settrackerconfig', this.objectHandle, options, modelPath);
         end
         
         function varargout = getbodyindexmap(this, varargin)
@@ -392,6 +1160,7 @@ classdef KinZ < handle
             expectedInputs = {'true','false'};
             
             p.addParameter('withIds',defaultInput,@(x) any(validatestring(x,expectedInputs)));
+            p.addParameter('frame', 0, @isnumeric);
             p.parse(varargin{:});
             
             % If the required output is a pointCloud object,            
@@ -407,7 +1176,7 @@ classdef KinZ < handle
                 this.delete;
                 error('No Body index source selected!');
             end
-            [varargout{1:nargout}] = KinZ_mex('getbodyindexmap', this.objectHandle, this.DepthHeight, this.DepthWidth, returnIds);
+            [varargout{1:nargout}] = this.framecall(p.Results.frame, 'getbodyindexmap', this.DepthHeight, this.DepthWidth, returnIds);
         end
         
         function drawbodies(this,handle,bodies,destination,jointsSize, limbsThickness)
@@ -455,7 +1224,149 @@ classdef KinZ < handle
             end
         end
                 
-    end % protected methods
+    end % public methods
+    
+    methods(Static)
+        function tracked = trackrecording(filename, varargin)
+            % tracked = KinZ.trackrecording(filename) - body tracking of
+            % every capture of an Azure Kinect recording (.mkv), as fast as
+            % the tracker runs. Does not need a device nor a KinZ object.
+            % Requires KinZ compiled with USE_BODY = true.
+            % Name-Value Pair Arguments:
+            %   'processingMode' - 'gpu' (default), 'cpu', 'cuda',
+            %   'tensorrt' or 'directml'
+            %   'orientation' - mounting of the sensor: 'default',
+            %   'clockwise90', 'counterclockwise90' or 'flip180'
+            %   'gpuDevice' - index of the GPU (0)
+            %   'liteModel' - use the lite network, faster and less
+            %   accurate (false)
+            %   'smoothing' - temporal smoothing of the joints, 0 to 1 (0)
+            %   'modelPath' - network file, overrides liteModel ('')
+            % tracked has N frames and up to B bodies per frame:
+            %   Timestamps (N x 1, device usec), NumBodies (N x 1),
+            %   Id (B x N, 0 = no body), Position3d (3 x 32 x B x N, mm),
+            %   Orientation (4 x 32 x B x N), Confidence (32 x B x N),
+            %   Position2d_rgb and Position2d_depth (2 x 32 x B x N, -1
+            %   outside the image). Missing bodies are NaN.
+            %   frames, captures (read), skipped (no depth or infrared),
+            %   failed (rejected by the tracker), seconds and fps.
+            % Example: t = KinZ.trackrecording('session.mkv', 'processingMode', 'cpu');
+            [options, modelPath] = KinZ.trackeroptions(varargin{:});
+            tracked = KinZ_mex('trackrecording', filename, options, modelPath);
+        end
+
+        function isa = setkernelisa(isa)
+            % isa = KinZ.setkernelisa(name) - instruction set of the frame
+            % conversion kernels: 'auto' (default, the best supported by
+            % the CPU), 'avx2' or 'baseline'. An instruction set not
+            % supported falls back to the best one below it. Returns the
+            % one in use; KinZ.setkernelisa only returns it.
+            if nargin < 1
+                isa = KinZ_mex('setkernelisa');
+            else
+                isa = KinZ_mex('setkernelisa', isa);
+            end
+        end
+
+        function ok = setframepool(enable, varargin)
+            % ok = KinZ.setframepool(true) - let the SDK allocate the
+            % capture images from a pool of recycled, 64-byte aligned
+            % buffers instead of fresh memory on every frame. The SDK
+            % accepts the pool only while it holds no image: enable it
+            % before creating the KinZ objects and disable it with
+            % KinZ.setframepool(false) after deleting all of them.
+            % ok is false when the SDK refused the change.
+            % Name-Value Pair Arguments:
+            %   'hugePages' - back the buffers of 2 MB and more with huge
+            %   pages, when the system provides them (true)
+            %   'maxCachedMB' - free buffers kept for reuse (1024)
+            % Example: KinZ.setframepool(true); kz = KinZ('3072p', 'color');
+            p = inputParser;
+            p.addParameter('hugePages', true, @islogical);
+            p.addParameter('maxCachedMB', 1024, @isnumeric);
+            p.parse(varargin{:});
+            ok = KinZ_mex('setframepool', double(enable), ...
+                          double(p.Results.hugePages), double(p.Results.maxCachedMB));
+        end
+
+        function stats = getframepoolstats(reset)
+            % stats = KinZ.getframepoolstats - counters of the frame pool:
+            % allocations, hits (recycled buffers), misses (new buffers),
+            % frees, released (returned to the system), huge_page_buffers,
+            % outstanding (held by the SDK), bytes_in_use, bytes_cached,
+            % peak_bytes and page_faults (of the whole process).
+            % KinZ.getframepoolstats(true) restarts the counters after
+            % reading them.
+            stats = KinZ_mex('getframepoolstats');
+            if nargin > 0 && reset
+                KinZ_mex('resetframepoolstats');
+            end
+        end
+    end % static methods
+    
+    methods(Static, Access = private)
+        function [options, modelPath] = trackeroptions(varargin)
+            % Convert the tracker Name-Value pairs to the vector of
+            % options and the model path expected by KinZ_mex.
+            modes = {'gpu', 'cpu', 'cuda', 'tensorrt', 'directml'};
+            orientations = {'default', 'clockwise90', 'counterclockwise90', 'flip180'};
+            p = inputParser;
+            p.addParameter('processingMode', 'gpu', @ischar);
+            p.addParameter('orientation', 'default', @ischar);
+            p.addParameter('gpuDevice', 0, @isnumeric);
+            p.addParameter('liteModel', false, @islogical);
+            p.addParameter('smoothing', 0, @(x) isscalar(x) && x >= 0 && x <= 1);
+            p.addParameter('modelPath', '', @ischar);
+            p.parse(varargin{:});
+            
+            mode = find(strcmp(validatestring(p.Results.processingMode, modes), modes)) - 1;
+            orientation = find(strcmp(validatestring(p.Results.orientation, orientations), ...
+                                      orientations)) - 1;
+            options = [mode, orientation, double(p.Results.gpuDevice), ...
+                       double(p.Results.liteModel), double(p.Results.smoothing)];
+            modelPath = p.Results.modelPath;
+        end
+    end
+    
+    methods(Access = private)
+        function [region, frame] = parseregion(~, varargin)
+            % Convert the 'roi', 'step' and 'scale' arguments of the
+            % getters to the 0-based region, step and downscale factor
+            % expected by KinZ_mex. frame is the 'frame' handle (0).
+            p = inputParser;
+            p.addParameter('roi', [], @(x) isempty(x) || numel(x) == 4);
+            p.addParameter('step', 1, @(x) isscalar(x) && x >= 1);
+            p.addParameter('scale', 1, @(x) any(x == [1 1/2 1/4 1/8]));
+            p.addParameter('frame', 0, @(x) isscalar(x) && isnumeric(x));
+            p.parse(varargin{:});
+            
+            roi = double(p.Results.roi);
+            if ~isempty(roi)
+                roi(1:2) = roi(1:2) - 1;
+            end
+            region = {roi, double(p.Results.step), round(1 / p.Results.scale)};
+            frame = p.Results.frame;
+        end
+        
+        function frame = parseframe(~, varargin)
+            % 'frame' argument of the getters without other options
+            p = inputParser;
+            p.addParameter('frame', 0, @(x) isscalar(x) && isnumeric(x));
+            p.parse(varargin{:});
+            frame = p.Results.frame;
+        end
+        
+        function varargout = framecall(this, frame, cmd, varargin)
+            % Call KinZ_mex command cmd on the pinned frame, or on the
+            % last frame if frame is 0.
+            if frame == 0
+                [varargout{1:nargout}] = KinZ_mex(cmd, this.objectHandle, varargin{:});
+            else
+                [varargout{1:nargout}] = KinZ_mex('withframe', this.objectHandle, ...
+                                                  uint64(frame), cmd, varargin{:});
+            end
+        end
+    end % private methods
 end % KinZ class
 
     
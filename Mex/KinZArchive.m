@@ -0,0 +1,168 @@
+classdef KinZArchive < handle
+    % KinZArchive - random access reader of the frame archives written by
+    % KinZ.archiveopen / archivewrite / archiveclose.
+    % The records are mapped with memmapfile, so reading a frame only
+    % touches the pages of that frame and nothing is decoded. The arrays
+    % have the layout returned by the KinZ getters.
+    %
+    % Example:
+    %   ar = KinZArchive('session.kza');
+    %   f = ar.frame(120);
+    %   imshow(f.color);
+    %
+    % A file that was not closed (e.g. MATLAB crashed while recording) has
+    % no index; its complete records are found from the file size.
+    
+    properties (SetAccess = private)
+        Filename
+        NumFrames = 0
+        Streams             % struct of logicals: depth, color, infrared, pointcloud, bodies
+        DepthWidth
+        DepthHeight
+        ColorWidth
+        ColorHeight
+    end
+    
+    properties (Access = private)
+        map                 % memmapfile over the records
+        maxBodies
+        bodySize
+    end
+    
+    properties (Constant, Access = private)
+        HeaderBlock = 4096  % ARCHIVE_ALIGN in KinZ_archive.h
+    end
+    
+    methods
+        function this = KinZArchive(filename)
+            fid = fopen(filename, 'r', 'ieee-le');
+            if fid < 0
+                error('Cannot open %s', filename);
+            end
+            magic = fread(fid, [1 8], '*char');
+            if ~strcmp(magic, 'KINZARC1')
+                fclose(fid);
+                error('%s is not a KinZ archive', filename);
+            end
+            version = fread(fid, 1, 'uint32');
+            streams = fread(fid, 1, 'uint32');
+            sizes = fread(fid, 4, 'int32');
+            this.maxBodies = fread(fid, 1, 'uint32');
+            this.bodySize = fread(fid, 1, 'uint32');
+            recordSize = fread(fid, 1, 'uint64');
+            frameCount = fread(fid, 1, 'uint64');
+            indexOffset = fread(fid, 1, 'uint64');
+            offsets = fread(fid, 5, 'uint64');  % depth, infrared, color, pointcloud, bodies
+            fseek(fid, 0, 'eof');
+            fileSize = ftell(fid);
+            fclose(fid);
+            if version ~= 1
+                error('Unsupported archive version %d', version);
+            end
+            
+            this.Filename = filename;
+            this.DepthWidth = sizes(1);
+            this.DepthHeight = sizes(2);
+            this.ColorWidth = sizes(3);
+            this.ColorHeight = sizes(4);
+            this.Streams = struct('depth', bitand(streams, 1) > 0, ...
+                                  'color', bitand(streams, 2) > 0, ...
+                                  'infrared', bitand(streams, 4) > 0, ...
+                                  'pointcloud', bitand(streams, 8) > 0, ...
+                                  'bodies', bitand(streams, 16) > 0);
+            
+            if indexOffset > 0
+                this.NumFrames = frameCount;
+            else
+                this.NumFrames = floor((fileSize - this.HeaderBlock) / recordSize);
+            end
+            if this.NumFrames == 0
+                return;
+            end
+            
+            % Record layout: the 64-byte frame info, then the streams at
+            % their offsets, padded to recordSize
+            dw = this.DepthWidth; dh = this.DepthHeight;
+            fields = {'uint64', [1 1], 'frame'; ...
+                      'uint64', [1 1], 'depth_timestamp'; ...
+                      'uint64', [1 1], 'color_timestamp'; ...
+                      'uint64', [1 1], 'infrared_timestamp'; ...
+                      'uint32', [1 1], 'valid'; ...
+                      'uint32', [1 1], 'num_bodies'; ...
+                      'uint8', [1 24], 'reserved'};
+            streamFields = {'uint16', [dh dw], 'depth', 2*dw*dh; ...
+                            'uint16', [dh dw], 'infrared', 2*dw*dh; ...
+                            'uint8', [this.ColorHeight this.ColorWidth 3], 'color', ...
+                                3*this.ColorWidth*this.ColorHeight; ...
+                            'single', [dw*dh 3], 'pointcloud', 12*dw*dh; ...
+                            'uint8', [this.bodySize this.maxBodies], 'bodies', ...
+                                this.bodySize*this.maxBodies};
+            stored = find(bitand(streams, [1 4 2 8 16]) > 0);
+            [~, order] = sort(offsets(stored));
+            pos = 64;
+            for s = stored(order)
+                if offsets(s) > pos
+                    fields(end+1, :) = {'uint8', [1 offsets(s)-pos], sprintf('pad%d', s)};
+                end
+                fields(end+1, :) = streamFields(s, 1:3);
+                pos = offsets(s) + streamFields{s, 4};
+            end
+            if recordSize > pos
+                fields(end+1, :) = {'uint8', [1 recordSize-pos], 'padEnd'};
+            end
+            
+            this.map = memmapfile(filename, 'Format', fields, ...
+                                  'Offset', this.HeaderBlock, ...
+                                  'Repeat', this.NumFrames);
+        end
+        
+        function f = frame(this, i)
+            % f = frame(i) - struct with the frame number i (1-based):
+            % timestamps, valid (see KinZ.archivewrite) and the stored
+            % streams. bodies has the fields returned by KinZ.getbodies.
+            if i < 1 || i > this.NumFrames
+                error('Frame %d is outside of 1..%d', i, this.NumFrames);
+            end
+            r = this.map.Data(i);
+            f = rmfield(r, intersect(fieldnames(r), ...
+                {'reserved', 'pad1', 'pad2', 'pad3', 'pad4', 'pad5', 'padEnd'}));
+            if this.Streams.bodies
+                f.bodies = this.parsebodies(r.bodies, r.num_bodies);
+            end
+        end
+        
+        function t = timestamps(this)
+            % t = timestamps - timestamps of every frame as returned by the
+            % getters, one row per frame: [depth color infrared]
+            t = zeros(this.NumFrames, 3, 'uint64');
+            for i = 1:this.NumFrames
+                r = this.map.Data(i);
+                t(i, :) = [r.depth_timestamp r.color_timestamp r.infrared_timestamp];
+            end
+        end
+    end
+    
+    methods (Access = private)
+        function bodies = parsebodies(this, raw, numBodies)
+            % Unpack kz::Body records (see KinZ.h)
+            numJoints = 32;
+            bodies = struct('Id', {}, 'Position3d', {}, 'Position2d_rgb', {}, ...
+                            'Position2d_depth', {}, 'Orientation', {}, 'Confidence', {});
+            for b = 1:min(numBodies, this.maxBodies)
+                bytes = raw(:, b);
+                take = @(at, n, type) typecast(bytes(at:at+4*n-1), type);
+                at = 1 + 4;
+                bodies(b).Id = take(1, 1, 'uint32');
+                bodies(b).Position3d = double(reshape(take(at, 3*numJoints, 'single'), 3, []));
+                at = at + 12*numJoints;
+                bodies(b).Orientation = double(reshape(take(at, 4*numJoints, 'single'), 4, []));
+                at = at + 16*numJoints;
+                bodies(b).Confidence = reshape(take(at, numJoints, 'uint32'), 1, []);
+                at = at + 4*numJoints;
+                bodies(b).Position2d_rgb = reshape(take(at, 2*numJoints, 'uint32'), 2, []);
+                at = at + 8*numJoints;
+                bodies(b).Position2d_depth = reshape(take(at, 2*numJoints, 'uint32'), 2, []);
+            end
+        end
+    end
+end
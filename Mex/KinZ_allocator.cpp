@@ -0,0 +1,361 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_allocator.cpp
+///
+///		Description:
+///			Pool of SDK image buffers, see KinZ_allocator.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_allocator.h"
+#include "KinZ_log.h"
+#include <k4a/k4a.h>
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+namespace kz
+{
+
+namespace
+{
+// Classes 4 KiB, then four per power of two: 5, 6, 7, 8 KiB, 10, 12, ...
+// up to the 2 GiB the SDK can request
+const int NUM_CLASSES = 1 + 4 * 20;
+
+// How a buffer was obtained
+enum {
+    BUFFER_HEAP = 0,        // aligned malloc
+    BUFFER_MAP = 1,         // mmap
+    BUFFER_THP = 2,         // mmap, 2 MiB aligned, transparent huge pages
+    BUFFER_HUGETLB = 3      // mmap of explicit huge pages
+};
+
+size_t class_size(int size_class)
+{
+    if (size_class == 0)
+        return POOL_MIN_CLASS;
+    size_t base = POOL_MIN_CLASS << ((size_class - 1) / 4);
+    return base / 4 * (4 + (size_class - 1) % 4 + 1);
+}
+
+int size_class(size_t size)
+{
+    if (size <= POOL_MIN_CLASS)
+        return 0;
+    int first = 1;
+    size_t base = POOL_MIN_CLASS;
+    while (size > 2 * base) {
+        base *= 2;
+        first += 4;
+    }
+    int c = first;
+    while (class_size(c) < size)
+        c++;
+    return c;
+}
+
+size_t huge_page_length(size_t size)
+{
+    return (size + POOL_HUGE_PAGE - 1) & ~(POOL_HUGE_PAGE - 1);
+}
+
+// The SDK passes the context of a buffer back to the destroy callback
+inline void *encode_context(int size_class, int kind)
+{
+    return (void *)(uintptr_t)((size_class << 2) | kind);
+}
+
+inline void decode_context(void *context, int &size_class, int &kind)
+{
+    uintptr_t value = (uintptr_t)context;
+    size_class = (int)(value >> 2);
+    kind = (int)(value & 3);
+}
+}
+
+///////// Function: processPageFaults /////////////////////////////////////
+uint64_t process_page_faults()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PageFaultCount;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (uint64_t)usage.ru_minflt + (uint64_t)usage.ru_majflt;
+    return 0;
+#endif
+} // end processPageFaults
+
+FramePool &FramePool::instance()
+{
+    // Never destroyed: the SDK may free buffers of the pool while the
+    // process exits
+    static FramePool *pool = new FramePool();
+    return *pool;
+}
+
+///////// Function: enable ////////////////////////////////////////////////
+bool FramePool::enable(const FramePoolConfig &config)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_config = config;
+        if (m_free.empty())
+            m_free.resize(NUM_CLASSES);
+        if (m_enabled) {
+            trim_locked();
+            return true;
+        }
+    }
+    if (k4a_set_allocator(sdk_allocate, sdk_destroy) != K4A_RESULT_SUCCEEDED) {
+        KZ_LOG(LOG_ERROR, "The SDK did not accept the frame pool, its images are still allocated");
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_enabled = true;
+    return true;
+} // end enable
+
+///////// Function: disable ///////////////////////////////////////////////
+bool FramePool::disable()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_enabled)
+            return true;
+        if (m_stats.outstanding)
+            return false;
+    }
+    if (k4a_set_allocator(NULL, NULL) != K4A_RESULT_SUCCEEDED)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_enabled = false;
+    size_t max_cached = m_config.max_cached_bytes;
+    m_config.max_cached_bytes = 0;
+    trim_locked();
+    m_config.max_cached_bytes = max_cached;
+    return true;
+} // end disable
+
+void FramePool::trim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t max_cached = m_config.max_cached_bytes;
+    m_config.max_cached_bytes = 0;
+    trim_locked();
+    m_config.max_cached_bytes = max_cached;
+}
+
+// Release cached buffers, largest first, until max_cached_bytes are left
+void FramePool::trim_locked()
+{
+    for (int c = (int)m_free.size() - 1; c >= 0; c--) {
+        std::vector<Buffer> &buffers = m_free[c];
+        while (!buffers.empty() && m_stats.bytes_cached > m_config.max_cached_bytes) {
+            release_buffer(buffers.back(), c);
+            buffers.pop_back();
+            m_stats.bytes_cached -= class_size(c);
+        }
+    }
+}
+
+FramePoolStats FramePool::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FramePoolStats stats = m_stats;
+    stats.page_faults = process_page_faults();
+    return stats;
+}
+
+void FramePool::reset_stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The state of the pool is kept, only the counters restart
+    FramePoolStats stats;
+    stats.outstanding = m_stats.outstanding;
+    stats.bytes_in_use = m_stats.bytes_in_use;
+    stats.bytes_cached = m_stats.bytes_cached;
+    stats.peak_bytes = m_stats.bytes_in_use + m_stats.bytes_cached;
+    m_stats = stats;
+}
+
+///////// Function: allocate //////////////////////////////////////////////
+uint8_t *FramePool::allocate(size_t size, void **context)
+{
+    int c = size_class(size);
+    if (c >= NUM_CLASSES)
+        return NULL;
+    size_t bytes = class_size(c);
+
+    Buffer buffer = {NULL, BUFFER_HEAP};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.allocations++;
+        if (!m_free[c].empty()) {
+            buffer = m_free[c].back();
+            m_free[c].pop_back();
+            m_stats.hits++;
+            m_stats.bytes_cached -= bytes;
+            m_stats.outstanding++;
+            m_stats.bytes_in_use += bytes;
+        }
+    }
+
+    // New buffers are obtained outside the lock, the system may take a
+    // while to map and fault them
+    if (!buffer.data) {
+        buffer = new_buffer(c);
+        if (!buffer.data)
+            return NULL;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.misses++;
+        if (buffer.kind == BUFFER_THP || buffer.kind == BUFFER_HUGETLB)
+            m_stats.huge_page_buffers++;
+        m_stats.outstanding++;
+        m_stats.bytes_in_use += bytes;
+        m_stats.peak_bytes = std::max(m_stats.peak_bytes, m_stats.bytes_in_use + m_stats.bytes_cached);
+    }
+
+    *context = encode_context(c, buffer.kind);
+    return buffer.data;
+} // end allocate
+
+///////// Function: destroy ///////////////////////////////////////////////
+void FramePool::destroy(void *data, void *context)
+{
+    int c, kind;
+    decode_context(context, c, kind);
+    Buffer buffer = {(uint8_t *)data, kind};
+    size_t bytes = class_size(c);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.frees++;
+    m_stats.outstanding--;
+    m_stats.bytes_in_use -= bytes;
+    if (m_stats.bytes_cached + bytes <= m_config.max_cached_bytes) {
+        m_free[c].push_back(buffer);
+        m_stats.bytes_cached += bytes;
+    }
+    else
+        release_buffer(buffer, c);
+} // end destroy
+
+///////// Function: newBuffer /////////////////////////////////////////////
+FramePool::Buffer FramePool::new_buffer(int c)
+{
+    size_t size = class_size(c);
+    Buffer buffer = {NULL, BUFFER_HEAP};
+#if defined(_WIN32)
+    // Large pages need the "Lock pages in memory" privilege, which users
+    // rarely have, so Windows only gets the recycling
+    buffer.data = (uint8_t *)_aligned_malloc(size, POOL_ALIGNMENT);
+#else
+    if (size < POOL_HUGE_PAGE) {
+        void *p = NULL;
+        if (posix_memalign(&p, POOL_ALIGNMENT, size) == 0)
+            buffer.data = (uint8_t *)p;
+        return buffer;
+    }
+
+    bool huge_pages;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        huge_pages = m_config.huge_pages;
+    }
+    if (huge_pages) {
+        size_t length = huge_page_length(size);
+#ifdef MAP_HUGETLB
+        void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            buffer.data = (uint8_t *)p;
+            buffer.kind = BUFFER_HUGETLB;
+            return buffer;
+        }
+#endif
+        // No reserved huge pages: map 2 MiB aligned and ask for
+        // transparent ones
+        void *q = mmap(NULL, length + POOL_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (q != MAP_FAILED) {
+            uintptr_t start = (uintptr_t)q;
+            uintptr_t aligned = (start + POOL_HUGE_PAGE - 1) & ~(uintptr_t)(POOL_HUGE_PAGE - 1);
+            if (aligned > start)
+                munmap(q, aligned - start);
+            size_t tail = (start + length + POOL_HUGE_PAGE) - (aligned + length);
+            if (tail)
+                munmap((void *)(aligned + length), tail);
+#ifdef MADV_HUGEPAGE
+            madvise((void *)aligned, length, MADV_HUGEPAGE);
+#endif
+#ifdef MADV_POPULATE_WRITE
+            madvise((void *)aligned, length, MADV_POPULATE_WRITE);
+#endif
+            buffer.data = (uint8_t *)aligned;
+            buffer.kind = BUFFER_THP;
+            return buffer;
+        }
+    }
+
+    // Fault the whole buffer in at once instead of page by page while the
+    // SDK writes it
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p != MAP_FAILED) {
+        buffer.data = (uint8_t *)p;
+        buffer.kind = BUFFER_MAP;
+    }
+#endif
+    return buffer;
+} // end newBuffer
+
+void FramePool::release_buffer(const Buffer &buffer, int c)
+{
+    m_stats.released++;
+#if defined(_WIN32)
+    _aligned_free(buffer.data);
+#else
+    switch (buffer.kind) {
+    case BUFFER_HEAP:
+        free(buffer.data);
+        break;
+    case BUFFER_MAP:
+        munmap(buffer.data, class_size(c));
+        break;
+    default:
+        munmap(buffer.data, huge_page_length(class_size(c)));
+        break;
+    }
+#endif
+}
+
+uint8_t *FramePool::sdk_allocate(int size, void **context)
+{
+    if (size <= 0)
+        return NULL;
+    return instance().allocate((size_t)size, context);
+}
+
+void FramePool::sdk_destroy(void *buffer, void *context)
+{
+    if (buffer)
+        instance().destroy(buffer, context);
+}
+
+} // namespace kz
@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_allocator.h
+///
+///		Description:
+///			Pool of image buffers registered with k4a_set_allocator, so the
+///         SDK recycles the memory of the captures and of the images KinZ
+///         creates instead of mapping, faulting and zeroing fresh pages on
+///         every frame.
+///
+///         Requests are rounded up to size classes, four per power of
+///         two from 4 KiB, so a buffer freed by one frame fits the same
+///         image of the next frame even when compressed (MJPEG) sizes
+///         vary. Buffers are 64-byte aligned. Classes of 2 MiB and more
+///         are mapped directly, 2 MiB aligned, and backed by huge pages
+///         when enabled: explicit huge pages if the system reserved them,
+///         transparent huge pages otherwise. Freed buffers are kept in the
+///         free list of their class until max_cached_bytes are cached;
+///         beyond that they go back to the system.
+///
+///         The SDK has a single, process wide, allocator and only accepts
+///         a new one while none of its buffers is allocated, so the pool
+///         is enabled before opening a device and disabled after closing
+///         all of them.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_ALLOCATOR_H__
+#define __KINZ_ALLOCATOR_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+namespace kz
+{
+    const size_t POOL_ALIGNMENT = 64;
+    const size_t POOL_MIN_CLASS = 4096;
+    const size_t POOL_HUGE_PAGE = (size_t)2 << 20;
+    const size_t POOL_DEFAULT_CACHED = (size_t)1 << 30;
+
+    struct FramePoolConfig {
+        bool huge_pages = true;
+        size_t max_cached_bytes = POOL_DEFAULT_CACHED;
+    };
+
+    struct FramePoolStats {
+        uint64_t allocations = 0;
+        uint64_t hits = 0;              // served from a free list
+        uint64_t misses = 0;            // new buffer from the system
+        uint64_t frees = 0;
+        uint64_t released = 0;          // freed buffers returned to the system
+        uint64_t huge_page_buffers = 0; // misses backed by huge pages
+        uint64_t outstanding = 0;       // buffers held by the SDK
+        uint64_t bytes_in_use = 0;      // class sizes of the outstanding buffers
+        uint64_t bytes_cached = 0;
+        uint64_t peak_bytes = 0;        // in use + cached
+        uint64_t page_faults = 0;       // of the process, see process_page_faults
+    };
+
+    // Page faults of the process since it started (minor and major), or
+    // 0 where not available
+    uint64_t process_page_faults();
+
+    class FramePool
+    {
+    public:
+        static FramePool &instance();
+
+        // Register the pool with the SDK. Returns false if the SDK refused
+        // it because buffers of its current allocator are still allocated.
+        bool enable(const FramePoolConfig &config);
+        // Restore the SDK allocator and release the cached buffers.
+        // Returns false while the SDK holds buffers of the pool.
+        bool disable();
+        bool enabled() const { return m_enabled; }
+
+        // Release the cached buffers to the system
+        void trim();
+
+        FramePoolStats stats();
+        void reset_stats();
+
+    private:
+        // A buffer and how it was obtained, see release_buffer
+        struct Buffer {
+            uint8_t *data;
+            int kind;
+        };
+
+        std::mutex m_mutex;
+        bool m_enabled = false;
+        FramePoolConfig m_config;
+        std::vector<std::vector<Buffer> > m_free;  // by size class
+        FramePoolStats m_stats;
+
+        FramePool() {}
+        FramePool(const FramePool &) = delete;
+        FramePool &operator=(const FramePool &) = delete;
+
+        uint8_t *allocate(size_t size, void **context);
+        void destroy(void *buffer, void *context);
+        Buffer new_buffer(int size_class);
+        void release_buffer(const Buffer &buffer, int size_class);
+        void trim_locked();
+
+        // k4a_memory_allocate_cb_t and k4a_memory_destroy_cb_t
+        static uint8_t *sdk_allocate(int size, void **context);
+        static void sdk_destroy(void *buffer, void *context);
+    };
+}
+
+#endif // __KINZ_ALLOCATOR_H__
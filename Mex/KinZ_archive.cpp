@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_archive.cpp
+///
+///		Description:
+///			Writer of the frame archive, see KinZ_archive.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_archive.h"
+#include "KinZ.h"
+#include "KinZ_log.h"
+#include <cstring>
+
+namespace kz
+{
+
+static_assert(sizeof(ArchiveHeader) <= ARCHIVE_ALIGN, "archive header too large");
+static_assert(sizeof(ArchiveFrameInfo) == 64, "archive frame info must be 64 bytes");
+
+namespace
+{
+inline uint64_t align_up(uint64_t n, uint64_t a)
+{
+    return (n + a - 1) / a * a;
+}
+
+int seek(FILE *file, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+} // namespace
+
+bool ArchiveWriter::open(const char *path, uint32_t streams, int depth_width, int depth_height,
+                         int color_width, int color_height)
+{
+    close();
+
+    ArchiveHeader &h = m_header;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "KINZARC1", 8);
+    h.version = ARCHIVE_VERSION;
+    h.streams = streams;
+    h.depth_width = depth_width;
+    h.depth_height = depth_height;
+    h.color_width = color_width;
+    h.color_height = color_height;
+    h.max_bodies = ARCHIVE_MAX_BODIES;
+    h.body_size = sizeof(Body);
+
+    // Streams are 64-byte aligned inside the record
+    uint64_t depth_pixels = (uint64_t)depth_width * depth_height;
+    uint64_t offset = sizeof(ArchiveFrameInfo);
+    if (streams & ARCHIVE_DEPTH) {
+        h.depth_offset = offset;
+        offset = align_up(offset + 2 * depth_pixels, 64);
+    }
+    if (streams & ARCHIVE_INFRARED) {
+        h.infrared_offset = offset;
+        offset = align_up(offset + 2 * depth_pixels, 64);
+    }
+    if (streams & ARCHIVE_COLOR) {
+        h.color_offset = offset;
+        offset = align_up(offset + 3 * (uint64_t)color_width * color_height, 64);
+    }
+    if (streams & ARCHIVE_POINTCLOUD) {
+        h.pointcloud_offset = offset;
+        offset = align_up(offset + 3 * sizeof(float) * depth_pixels, 64);
+    }
+    if (streams & ARCHIVE_BODIES) {
+        h.bodies_offset = offset;
+        offset = align_up(offset + (uint64_t)h.max_bodies * h.body_size, 64);
+    }
+    h.record_size = align_up(offset, ARCHIVE_ALIGN);
+
+    m_file = fopen(path, "wb");
+    if (!m_file) {
+        KZ_LOG(LOG_ERROR, "Cannot create the archive %s", path);
+        return false;
+    }
+    setvbuf(m_file, NULL, _IOFBF, 1 << 20);
+
+    // The header is rewritten by close()
+    std::vector<uint8_t> block(ARCHIVE_ALIGN, 0);
+    memcpy(block.data(), &h, sizeof(h));
+    if (fwrite(block.data(), 1, block.size(), m_file) != block.size()) {
+        KZ_LOG(LOG_ERROR, "Cannot write the archive %s", path);
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+
+    m_record.assign(h.record_size, 0);
+    m_index.clear();
+    m_failed = false;
+    return true;
+}
+
+bool ArchiveWriter::append()
+{
+    if (!m_file || m_failed)
+        return false;
+
+    ArchiveFrameInfo &fi = info();
+    fi.frame = m_index.size();
+
+    ArchiveIndexEntry entry;
+    entry.offset = ARCHIVE_ALIGN + m_index.size() * m_header.record_size;
+    entry.time = (fi.valid & ARCHIVE_DEPTH) ? fi.depth_time : fi.color_time;
+
+    if (fwrite(m_record.data(), 1, m_record.size(), m_file) != m_record.size()) {
+        // A partial record would shift every later one: stop appending,
+        // close() writes the index over it
+        KZ_LOG(LOG_ERROR, "Failed to write frame %llu to the archive, no more frames are added",
+               (unsigned long long)fi.frame);
+        m_failed = true;
+        return false;
+    }
+    m_index.push_back(entry);
+    return true;
+}
+
+bool ArchiveWriter::close()
+{
+    if (!m_file)
+        return true;
+
+    m_header.frame_count = m_index.size();
+    m_header.index_offset = ARCHIVE_ALIGN + m_index.size() * m_header.record_size;
+
+    bool ok = seek(m_file, m_header.index_offset) == 0;
+    ok = ok && fwrite(m_index.data(), sizeof(ArchiveIndexEntry), m_index.size(), m_file) == m_index.size();
+    ok = ok && seek(m_file, 0) == 0;
+    ok = ok && fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+    ok = (fclose(m_file) == 0) && ok;
+    m_file = NULL;
+    m_index.clear();
+    if (!ok)
+        KZ_LOG(LOG_ERROR, "Failed to write the archive index");
+    return ok;
+}
+
+} // namespace kz
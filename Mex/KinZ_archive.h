@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_archive.h
+///
+///		Description:
+///			Append-only archive of frames already converted to the Matlab
+///         layout, for random access replay without decoding.
+///
+///         File layout (little endian):
+///          * ArchiveHeader, padded to ARCHIVE_ALIGN bytes.
+///          * One record per frame. Every record has the same size, a
+///            multiple of ARCHIVE_ALIGN, so frame i starts at
+///            ARCHIVE_ALIGN + i * record_size. A record holds an
+///            ArchiveFrameInfo followed by the streams selected at open,
+///            each at the offset given in the header:
+///              depth       uint16 [depth_height x depth_width]
+///              infrared    uint16 [depth_height x depth_width]
+///              color       uint8  [color_height x color_width x 3]
+///              pointcloud  single [depth_height*depth_width x 3]
+///              bodies      max_bodies x kz::Body
+///            Arrays are column-major, as returned by the getters.
+///          * The index, one ArchiveIndexEntry per frame, written by
+///            close() at index_offset.
+///         Matlab can map the records with memmapfile (see KinZArchive.m).
+///         A file that was not closed has index_offset = 0; its frames are
+///         still found from the file size.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_ARCHIVE_H__
+#define __KINZ_ARCHIVE_H__
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace kz
+{
+    const uint32_t ARCHIVE_VERSION = 1;
+    const uint64_t ARCHIVE_ALIGN = 4096;
+    const uint32_t ARCHIVE_MAX_BODIES = 8;
+
+    // Streams of an archive
+    enum {
+        ARCHIVE_DEPTH = 1,
+        ARCHIVE_COLOR = 2,
+        ARCHIVE_INFRARED = 4,
+        ARCHIVE_POINTCLOUD = 8,
+        ARCHIVE_BODIES = 16
+    };
+
+    struct ArchiveHeader {
+        char magic[8];              // "KINZARC1"
+        uint32_t version;
+        uint32_t streams;           // ARCHIVE_* stored in every record
+        int32_t depth_width, depth_height;
+        int32_t color_width, color_height;
+        uint32_t max_bodies;
+        uint32_t body_size;         // bytes of a kz::Body
+        uint64_t record_size;
+        uint64_t frame_count;       // written by close()
+        uint64_t index_offset;      // written by close(), 0 if not closed
+        uint64_t depth_offset;      // offsets of the streams in a record
+        uint64_t infrared_offset;
+        uint64_t color_offset;
+        uint64_t pointcloud_offset;
+        uint64_t bodies_offset;
+    };
+
+    // First 64 bytes of a record
+    struct ArchiveFrameInfo {
+        uint64_t frame;             // 0-based
+        uint64_t depth_time;        // timestamps returned by the getters
+        uint64_t color_time;
+        uint64_t infrared_time;
+        uint32_t valid;             // ARCHIVE_* holding valid data
+        uint32_t num_bodies;
+        uint64_t reserved[3];
+    };
+
+    struct ArchiveIndexEntry {
+        uint64_t offset;            // of the record in the file
+        uint64_t time;              // depth timestamp, or color if no depth
+    };
+
+    class ArchiveWriter
+    {
+    public:
+        ~ArchiveWriter() { close(); }
+
+        // Create the file and compute the record layout
+        bool open(const char *path, uint32_t streams, int depth_width, int depth_height,
+                  int color_width, int color_height);
+
+        // Buffer of record_size bytes where the next frame is converted
+        uint8_t *record() { return m_record.data(); }
+        ArchiveFrameInfo &info() { return *(ArchiveFrameInfo *)m_record.data(); }
+        const ArchiveHeader &header() const { return m_header; }
+
+        // Write the record. Returns false on a write error; after a
+        // failed write no more records are written.
+        bool append();
+
+        // Write the index and the final header
+        bool close();
+
+        bool is_open() const { return m_file != NULL; }
+        uint64_t frames() const { return m_index.size(); }
+
+    private:
+        FILE *m_file = NULL;
+        ArchiveHeader m_header;
+        std::vector<uint8_t> m_record;
+        std::vector<ArchiveIndexEntry> m_index;
+        bool m_failed = false;      // a record was partially written
+    };
+}
+
+#endif // __KINZ_ARCHIVE_H__
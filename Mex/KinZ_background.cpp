@@ -0,0 +1,259 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_background.cpp
+///
+///		Description:
+///			Running background depth model, see KinZ_background.h. The
+///         update and the classification process bands of rows in
+///         parallel, 4 pixels at a time with SSE2 when available. The
+///         scalar code does the same operations in the same order, so
+///         both give the same model and mask.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_background.h"
+#include "KinZ_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KZ_SSE2
+#endif
+
+namespace kz
+{
+
+namespace
+{
+struct Params {
+    float rate;         // learning_rate
+    float fg_rate;      // foreground_learning_rate
+    float k2;           // threshold^2
+    float min_dev;
+    float rel_dev;
+    float max_count;    // samples after which the rate is learning_rate
+};
+
+inline const uint16_t *row_ptr(const uint8_t *image, int stride, int y)
+{
+    return (const uint16_t *)(image + (size_t)y * stride);
+}
+
+inline bool is_foreground(float d, float mean, float var, float count, const Params &p)
+{
+    float diff = d - mean;
+    float dev = std::max(p.min_dev, p.rel_dev * mean);
+    float thr2 = std::max(p.k2 * var, dev * dev);
+    return d > 0 && count > 0 && diff < 0 && diff * diff > thr2;
+}
+
+inline uint8_t update_pixel(float d, float &mean, float &var, float &count, const Params &p)
+{
+    bool fg = is_foreground(d, mean, var, count, p);
+    if (d == 0)
+        return 0;
+    float diff = d - mean;
+    float rate = fg ? p.fg_rate : std::max(p.rate, 1.0f / (count + 1.0f));
+    mean += rate * diff;
+    var = (1.0f - rate) * (var + rate * (diff * diff));
+    count = std::min(count + (fg ? 0.0f : 1.0f), p.max_count);
+    return fg;
+}
+
+#ifdef KZ_SSE2
+inline __m128 load4_u16(const uint16_t *p)
+{
+    __m128i v = _mm_loadl_epi64((const __m128i *)p);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// 4 float masks to 4 bytes 0 or 1
+inline void store4_mask(uint8_t *dst, __m128 mask)
+{
+    __m128i m = _mm_castps_si128(mask);
+    m = _mm_packs_epi32(m, m);
+    m = _mm_packs_epi16(m, m);
+    m = _mm_and_si128(m, _mm_set1_epi8(1));
+    int32_t bytes = _mm_cvtsi128_si32(m);
+    memcpy(dst, &bytes, 4);
+}
+
+// Vector form of is_foreground; diff2 is (d - mean)^2
+struct VParams {
+    __m128 zero, one, rate, fg_rate, k2, min_dev, rel_dev, max_count;
+    explicit VParams(const Params &p)
+        : zero(_mm_setzero_ps()), one(_mm_set1_ps(1.0f)), rate(_mm_set1_ps(p.rate)),
+          fg_rate(_mm_set1_ps(p.fg_rate)), k2(_mm_set1_ps(p.k2)), min_dev(_mm_set1_ps(p.min_dev)),
+          rel_dev(_mm_set1_ps(p.rel_dev)), max_count(_mm_set1_ps(p.max_count)) {}
+};
+
+inline __m128 is_foreground4(__m128 d, __m128 mean, __m128 var, __m128 count,
+                             __m128 diff, __m128 diff2, const VParams &v)
+{
+    __m128 dev = _mm_max_ps(v.min_dev, _mm_mul_ps(v.rel_dev, mean));
+    __m128 thr2 = _mm_max_ps(_mm_mul_ps(v.k2, var), _mm_mul_ps(dev, dev));
+    __m128 fg = _mm_and_ps(_mm_cmpgt_ps(d, v.zero), _mm_cmpgt_ps(count, v.zero));
+    return _mm_and_ps(fg, _mm_and_ps(_mm_cmplt_ps(diff, v.zero), _mm_cmpgt_ps(diff2, thr2)));
+}
+#endif
+
+void update_rows(const uint8_t *depth, int w, int stride, int y0, int y1, float *mean,
+                 float *var, float *count, uint8_t *mask, const Params &p)
+{
+    for (int y = y0; y < y1; y++) {
+        const uint16_t *row = row_ptr(depth, stride, y);
+        size_t i = (size_t)y * w;
+        int x = 0;
+    #ifdef KZ_SSE2
+        const VParams v(p);
+        for (; x + 4 <= w; x += 4) {
+            size_t k = i + x;
+            __m128 d = load4_u16(row + x);
+            __m128 m = _mm_loadu_ps(mean + k);
+            __m128 s = _mm_loadu_ps(var + k);
+            __m128 n = _mm_loadu_ps(count + k);
+            __m128 diff = _mm_sub_ps(d, m);
+            __m128 diff2 = _mm_mul_ps(diff, diff);
+            __m128 fg = is_foreground4(d, m, s, n, diff, diff2, v);
+
+            __m128 learn = _mm_max_ps(v.rate, _mm_div_ps(v.one, _mm_add_ps(n, v.one)));
+            __m128 valid = _mm_cmpgt_ps(d, v.zero);
+            __m128 r = _mm_and_ps(valid, select(fg, v.fg_rate, learn));
+            m = _mm_add_ps(m, _mm_mul_ps(r, diff));
+            s = _mm_mul_ps(_mm_sub_ps(v.one, r), _mm_add_ps(s, _mm_mul_ps(r, diff2)));
+            n = _mm_min_ps(_mm_add_ps(n, _mm_and_ps(_mm_andnot_ps(fg, valid), v.one)), v.max_count);
+
+            _mm_storeu_ps(mean + k, m);
+            _mm_storeu_ps(var + k, s);
+            _mm_storeu_ps(count + k, n);
+            store4_mask(mask + k, fg);
+        }
+    #endif
+        for (; x < w; x++)
+            mask[i + x] = update_pixel(row[x], mean[i + x], var[i + x], count[i + x], p);
+    }
+}
+
+void classify_rows(const uint8_t *depth, int w, int stride, int y0, int y1, const float *mean,
+                   const float *var, const float *count, uint8_t *mask, const Params &p)
+{
+    for (int y = y0; y < y1; y++) {
+        const uint16_t *row = row_ptr(depth, stride, y);
+        size_t i = (size_t)y * w;
+        int x = 0;
+    #ifdef KZ_SSE2
+        const VParams v(p);
+        for (; x + 4 <= w; x += 4) {
+            size_t k = i + x;
+            __m128 d = load4_u16(row + x);
+            __m128 m = _mm_loadu_ps(mean + k);
+            __m128 diff = _mm_sub_ps(d, m);
+            __m128 fg = is_foreground4(d, m, _mm_loadu_ps(var + k), _mm_loadu_ps(count + k),
+                                       diff, _mm_mul_ps(diff, diff), v);
+            store4_mask(mask + k, fg);
+        }
+    #endif
+        for (; x < w; x++)
+            mask[i + x] = is_foreground(row[x], mean[i + x], var[i + x], count[i + x], p);
+    }
+}
+
+Params make_params(const BackgroundConfig &c)
+{
+    Params p;
+    p.rate = c.learning_rate;
+    p.fg_rate = c.foreground_learning_rate;
+    p.k2 = c.threshold * c.threshold;
+    p.min_dev = c.min_deviation;
+    p.rel_dev = c.relative_deviation;
+    p.max_count = std::ceil(1.0f / c.learning_rate);
+    return p;
+}
+}
+
+void BackgroundModel::configure(const BackgroundConfig &config)
+{
+    m_config = config;
+    m_config.learning_rate = std::min(1.0f, std::max(0.0001f, m_config.learning_rate));
+    m_config.foreground_learning_rate = std::min(1.0f, std::max(0.0f, m_config.foreground_learning_rate));
+    m_config.threshold = std::max(0.0f, m_config.threshold);
+    m_config.min_deviation = std::max(0.0f, m_config.min_deviation);
+    m_config.relative_deviation = std::max(0.0f, m_config.relative_deviation);
+    if (!m_config.enabled) {
+        m_width = m_height = 0;
+        m_mean.clear();
+        m_variance.clear();
+        m_count.clear();
+        m_mask.clear();
+        m_frames = 0;
+    }
+}
+
+void BackgroundModel::reset()
+{
+    std::fill(m_mean.begin(), m_mean.end(), 0.0f);
+    std::fill(m_variance.begin(), m_variance.end(), 0.0f);
+    std::fill(m_count.begin(), m_count.end(), 0.0f);
+    std::fill(m_mask.begin(), m_mask.end(), 0);
+    m_frames = 0;
+}
+
+void BackgroundModel::update(const uint8_t *depth, int w, int h, int stride, ThreadPool &pool)
+{
+    if (!enabled())
+        return;
+
+    size_t n = (size_t)w * h;
+    if (w != m_width || h != m_height) {
+        m_width = w;
+        m_height = h;
+        m_mean.assign(n, 0.0f);
+        m_variance.assign(n, 0.0f);
+        m_count.assign(n, 0.0f);
+        m_mask.assign(n, 0);
+        m_frames = 0;
+    }
+
+    Params p = make_params(m_config);
+    parallel_rows(pool, h, [&](int y0, int y1) {
+        update_rows(depth, w, stride, y0, y1, m_mean.data(), m_variance.data(),
+                    m_count.data(), m_mask.data(), p);
+    });
+    m_frames++;
+}
+
+bool BackgroundModel::classify(const uint8_t *depth, int w, int h, int stride,
+                               uint8_t *mask, ThreadPool &pool) const
+{
+    if (w != m_width || h != m_height || w == 0)
+        return false;
+
+    Params p = make_params(m_config);
+    parallel_rows(pool, h, [&](int y0, int y1) {
+        classify_rows(depth, w, stride, y0, y1, m_mean.data(), m_variance.data(),
+                      m_count.data(), mask, p);
+    });
+    return true;
+}
+
+void BackgroundModel::get_model(float *mean, float *deviation, ThreadPool &pool) const
+{
+    int w = m_width, h = m_height;
+    parallel_columns(pool, w, [&](int x0, int x1) {
+        for (int x = x0; x < x1; x++)
+            for (int y = 0; y < h; y++) {
+                size_t i = (size_t)y * w + x;
+                size_t k = (size_t)x * h + y;
+                mean[k] = m_mean[i];
+                deviation[k] = std::sqrt(m_variance[i]);
+            }
+    });
+}
+
+} // namespace kz
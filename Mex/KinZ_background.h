@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_background.h
+///
+///		Description:
+///			Per-pixel model of the background depth, updated with each
+///         depth frame, and the foreground mask of the frame.
+///         Each pixel keeps a running mean and variance of its depth. The
+///         first samples are averaged (rate 1/n) until the rate reaches
+///         learning_rate, then the average is exponential.
+///         A pixel is foreground when it is closer than the mean by more
+///         than threshold standard deviations, and at least
+///         max(min_deviation, relative_deviation * mean) mm. Farther
+///         pixels are background uncovered by an object and are learned.
+///         Foreground pixels are learned at foreground_learning_rate, so
+///         objects that stay still are absorbed slowly, or never with 0.
+///         Invalid (zero) pixels are neither foreground nor learned.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_BACKGROUND_H__
+#define __KINZ_BACKGROUND_H__
+#include <stdint.h>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace kz
+{
+    struct BackgroundConfig {
+        bool enabled = false;
+        float learning_rate = 0.02f;            // weight of the new frame (0, 1]
+        float foreground_learning_rate = 0.0f;  // same for foreground pixels
+        float threshold = 3.0f;                 // standard deviations
+        float min_deviation = 20.0f;            // mm
+        float relative_deviation = 0.01f;       // fraction of the depth
+    };
+
+    class BackgroundModel
+    {
+    public:
+        void configure(const BackgroundConfig &config);
+        const BackgroundConfig &config() const { return m_config; }
+        bool enabled() const { return m_config.enabled; }
+
+        // Learn the 16-bit depth image and classify it into mask()
+        void update(const uint8_t *depth, int width, int height, int stride, ThreadPool &pool);
+
+        // Classify a depth image against the model without learning it.
+        // mask holds width * height bytes, 1 for foreground, in the order
+        // of the image. Returns false if the model has another size.
+        bool classify(const uint8_t *depth, int width, int height, int stride,
+                      uint8_t *mask, ThreadPool &pool) const;
+
+        // Forget the background, e.g. after the camera moved
+        void reset();
+
+        // Mask of the last update, in the order of the image
+        const std::vector<uint8_t> &mask() const { return m_mask; }
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        uint64_t frames() const { return m_frames; }
+
+        // Mean and standard deviation of the background in mm, (h x w)
+        // Matlab arrays, 0 where no depth was learned yet
+        void get_model(float *mean, float *deviation, ThreadPool &pool) const;
+
+    private:
+        BackgroundConfig m_config;
+        std::vector<float> m_mean;
+        std::vector<float> m_variance;
+        std::vector<float> m_count;     // samples learned, up to 1 / learning_rate
+        std::vector<uint8_t> m_mask;
+        int m_width = 0, m_height = 0;
+        uint64_t m_frames = 0;
+    };
+}
+
+#endif // __KINZ_BACKGROUND_H__
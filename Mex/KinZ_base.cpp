@@ -22,10 +22,61 @@
 ///         Sep/27/2020: Add body tracking
 ///////////////////////////////////////////////////////////////////////////
 #include "KinZ.h"
-#include "mex.h"
-#include "class_handle.hpp"
+#include "KinZ_kernels.h"
+#include "KinZ_log.h"
+#include "KinZ_shm.h"
+#include "KinZ_archive.h"
+#include "KinZ_codec.h"
+#include "KinZ_cloudwriter.h"
+#include "KinZ_reproject.h"
+#include "KinZ_bodytrack.h"
+#include "KinZ_calibration.h"
+#include "KinZ_batch.h"
+#include "KinZ_undistort.h"
 #include <vector>
 #include <memory>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace kz
+{
+    // Capture pinned by KinZ::pin_frame. It holds its own references to
+    // the SDK objects; KinZ::swap_frame exchanges them with the current
+    // frame of KinZ.
+    struct Frame {
+        k4a_capture_t capture = NULL;
+        k4a_image_t depth = NULL;
+        k4a_image_t color = NULL;
+        k4a_image_t infrared = NULL;
+        Imu_sample imu;
+        #ifdef BODY
+        k4abt_frame_t body_frame = NULL;
+        k4a_image_t body_index = NULL;
+        uint32_t num_bodies = 0;
+        #endif
+        std::unique_ptr<ShmFrame> shm_frame;   // clients of a KinZ_server
+
+        ~Frame()
+        {
+            #ifdef BODY
+            if (body_index)
+                k4a_image_release(body_index);
+            if (body_frame)
+                k4abt_frame_release(body_frame);
+            #endif
+            if (depth)
+                k4a_image_release(depth);
+            if (color)
+                k4a_image_release(color);
+            if (infrared)
+                k4a_image_release(infrared);
+            if (capture)
+                k4a_capture_release(capture);
+        }
+    };
+}
 
  // Constructor
 KinZ::KinZ(uint16_t sources)
@@ -33,12 +84,38 @@ KinZ::KinZ(uint16_t sources)
     m_flags = (kz::Flags)sources;
     
     // Initialize Kinect
-    init();
+    if (m_flags & kz::ASYNC_INIT)
+        m_init_thread = std::thread([this] { init(); });
+    else
+        init();
+} // end constructor
+
+// Constructor of a client of the KinZ_server publishing in shm_name
+KinZ::KinZ(const char *shm_name)
+{
+    m_flags = 0;
+    init_shm(shm_name);
+    m_init_done = true;
+} // end constructor
+
+// Constructor of an offline KinZ
+KinZ::KinZ(uint16_t sources, const char *calibration)
+{
+    m_flags = (kz::Flags)(sources & ~(kz::ASYNC_INIT | kz::WARM_UP));
+    init_offline(calibration);
+    m_init_done = true;
 } // end constructor
         
 // Destructor. Release all buffers
 KinZ::~KinZ()
 {    
+    m_init_cancel = true;
+    wait_ready();
+
+    if (m_selected)
+        unselect_frame();
+    release_frames();
+
     #ifdef BODY
     if (m_tracker != NULL) {
         k4abt_tracker_shutdown(m_tracker);
@@ -77,43 +154,149 @@ KinZ::~KinZ()
         m_capture = NULL;
     }
 
-    mexPrintf("Kinect Object destroyed\n");
+    KZ_LOG(kz::LOG_INFO, "Kinect Object destroyed\n");
 
 } // end destructor
 
 ///////// Function: init ///////////////////////////////////////////
-// Initialize Kinect2 and frame reader
+// Initialize Kinect2 and frame reader, timing each step
 //////////////////////////////////////////////////////////////////////////
 void KinZ::init()
 {
+    auto start = std::chrono::steady_clock::now();
+    init_device();
+    if (m_device && (m_flags & kz::WARM_UP) && !m_init_cancel) {
+        auto warm_start = std::chrono::steady_clock::now();
+        warm_up();
+        m_init_timing.warmup_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - warm_start).count();
+    }
+    m_init_timing.ok = m_device != NULL;
+    m_init_timing.total_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    m_init_done = true;
+} // end init
+
+void KinZ::wait_ready()
+{
+    if (m_init_thread.joinable())
+        m_init_thread.join();
+}
+
+///////// Function: initDevice ////////////////////////////////////////////
+// Open and start the device, IMU and body tracker. Stops between steps
+// when m_init_cancel is set; the destructor releases what was created.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::init_device()
+{
+    auto last = std::chrono::steady_clock::now();
+    // Time since the previous call
+    auto lap = [&last]() {
+        auto now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - last).count();
+        last = now;
+        return ms;
+    };
+
     uint32_t m_device_count = k4a_device_get_installed_count();
     if (m_device_count == 0) {
-        mexPrintf("No K4A m_devices found\n");
+        KZ_LOG(kz::LOG_ERROR, "No K4A m_devices found\n");
         return;
     }
 
     if (K4A_RESULT_SUCCEEDED != k4a_device_open(0, &m_device)) {
-        mexPrintf("Failed to open m_device\n");
+        KZ_LOG(kz::LOG_ERROR, "Failed to open m_device\n");
         if (m_device != NULL) {
             k4a_device_close(m_device);
             m_device = NULL;
             return;
         }
     }
+    m_init_timing.open_ms = lap();
+    if (m_init_cancel)
+        return;
+
+    // Refresh the cached calibration of this device for offline use
+    std::vector<char> raw;
+    if (kz::read_device_calibration(m_device, m_serial_number, raw)) {
+        KZ_LOG(kz::LOG_INFO, "Opened device SN: %s\n", m_serial_number.c_str());
+        kz::save_raw_calibration(kz::calibration_cache_path(m_serial_number), raw);
+    }
+
+    configure_from_flags();
+
+    // Get calibration
+    if (K4A_RESULT_SUCCEEDED !=
+        k4a_device_get_calibration(m_device, m_config.depth_mode, m_config.color_resolution, &m_calibration)) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to get calibration\n");
+        if (m_device) {
+            k4a_device_close(m_device);
+            m_device = NULL;
+            return;
+        }
+    }
+
+    // get transformation to map from depth to color
+    m_transformation = k4a_transformation_create(&m_calibration);
+    m_init_timing.calibration_ms = lap();
+    if (m_init_cancel)
+        return;
+
+    if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(m_device, &m_config)) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to start m_device\n");
+        if (m_device) {
+            k4a_device_close(m_device);
+            m_device = NULL;
+            return;
+        }
+    }
+    else
+        KZ_LOG(kz::LOG_INFO, "Kinect for Azure started successfully!!\n");
+    m_init_timing.start_ms = lap();
 
-    // Get serial number
-    //size_t serial_size = 0;
-    //k4a_device_get_serialnum(m_device, NULL, &serial_size);
+    reset_frame_stats();
+
+    // Activate IMU sensors
+    m_imu_sensors_available = false;
+    if (m_flags & kz::IMU_ON) {
+        if(k4a_device_start_imu(m_device) == K4A_RESULT_SUCCEEDED) {
+            KZ_LOG(kz::LOG_INFO, "IMU sensors started succesfully.");
+            m_imu_sensors_available = true;
+        }
+        else {
+            KZ_LOG(kz::LOG_ERROR, "IMU SENSORES FAILED INITIALIZATION");
+            m_imu_sensors_available = false;
+        }
+    }
+    m_init_timing.imu_ms = lap();
 
-    // Allocate memory for the serial, then acquire it
-    //char *serial = (char*)(malloc(serial_size));
-    //k4a_device_get_serialnum(m_device,serial,&serial_size);
-    // printf("Opened device SN: %s\n",serial);
-    //this->m_serial_number = serial;
-    //free(serial);
+    // Start body tracker
+    #ifdef BODY    
+    m_body_tracking_available = false;
+    m_num_bodies = 0;
+    if ((m_flags & kz::BODY_TRACKING || m_flags & kz::BODY_INDEX) && !m_init_cancel) {
+        k4abt_tracker_configuration_t tracker_config = kz::tracker_configuration(m_tracker_config);
+        if(k4abt_tracker_create(&m_calibration, tracker_config, &m_tracker) == K4A_RESULT_SUCCEEDED) {
+            KZ_LOG(kz::LOG_INFO, "Body tracking started succesfully.\n");
+            k4abt_tracker_set_temporal_smoothing(m_tracker, m_tracker_config.smoothing);
+            m_body_tracking_available = true;
+        }
+        else {
+            KZ_LOG(kz::LOG_ERROR, "BODY TRACKING FAILED TO INITIALIZE!\n");
+            m_body_tracking_available = false;
+        }
+        m_init_timing.tracker_ms = lap();
+    }
+    #endif
+} // end initDevice
 
+///////// Function: configureFromFlags ////////////////////////////////////
+// Device configuration of the color resolution and depth mode flags
+//////////////////////////////////////////////////////////////////////////
+void KinZ::configure_from_flags()
+{
     k4a_fps_t kin_fps = K4A_FRAMES_PER_SECOND_30;
-    k4a_device_configuration_t m_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+    m_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     m_config.color_format = K4A_IMAGE_FORMAT_COLOR_BGRA32;
     m_config.synchronized_images_only = true;
     m_config.camera_fps = kin_fps;
@@ -144,85 +327,448 @@ void KinZ::init()
     
     if(wide_fov && binned) {
         m_config.depth_mode = K4A_DEPTH_MODE_WFOV_2X2BINNED;
-        mexPrintf("K4A_DEPTH_MODE_WFOV_2X2BINNED\n");
+        KZ_LOG(kz::LOG_INFO, "K4A_DEPTH_MODE_WFOV_2X2BINNED\n");
     }
     if(wide_fov && !binned) {
         m_config.depth_mode = K4A_DEPTH_MODE_WFOV_UNBINNED;
         m_config.camera_fps = K4A_FRAMES_PER_SECOND_5;
-        mexPrintf("K4A_DEPTH_MODE_WFOV_UNBINNED\n");
+        KZ_LOG(kz::LOG_INFO, "K4A_DEPTH_MODE_WFOV_UNBINNED\n");
     }
     if(!wide_fov && binned) {
         m_config.depth_mode = K4A_DEPTH_MODE_NFOV_2X2BINNED;
-        mexPrintf("K4A_DEPTH_MODE_NFOV_2X2BINNED\n");
+        KZ_LOG(kz::LOG_INFO, "K4A_DEPTH_MODE_NFOV_2X2BINNED\n");
     }
     if(!wide_fov && !binned) {
         m_config.depth_mode = K4A_DEPTH_MODE_NFOV_UNBINNED;
-        mexPrintf("K4A_DEPTH_MODE_NFOV_UNBINNED\n");
+        KZ_LOG(kz::LOG_INFO, "K4A_DEPTH_MODE_NFOV_UNBINNED\n");
     }
+} // end configureFromFlags
 
-    // Get calibration
-    if (K4A_RESULT_SUCCEEDED !=
-        k4a_device_get_calibration(m_device, m_config.depth_mode, m_config.color_resolution, &m_calibration)) {
-        printf("Failed to get calibration\n");
-        if (m_device) {
-            k4a_device_close(m_device);
-            m_device = NULL;
-            return;
-        }
-    }
+///////// Function: initOffline ///////////////////////////////////////////
+// Calibration and transformation of an offline KinZ from the raw
+// calibration cached for a serial number or stored in a file
+//////////////////////////////////////////////////////////////////////////
+void KinZ::init_offline(const char *calibration)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_offline = true;
+    m_imu_sensors_available = false;
+    #ifdef BODY
+    m_body_tracking_available = false;
+    m_num_bodies = 0;
+    #endif
+    memset(&m_calibration, 0, sizeof(m_calibration));
+    configure_from_flags();
 
-    // get transformation to map from depth to color
+    std::string path = kz::calibration_cache_path(calibration);
+    std::vector<char> raw;
+    if (!kz::load_raw_calibration(path, raw)) {
+        KZ_LOG(kz::LOG_ERROR, "Cannot read the calibration %s\n", path.c_str());
+        return;
+    }
+    if (K4A_RESULT_SUCCEEDED != k4a_calibration_get_from_raw(raw.data(), raw.size(),
+            m_config.depth_mode, m_config.color_resolution, &m_calibration)) {
+        KZ_LOG(kz::LOG_ERROR, "Invalid calibration %s\n", path.c_str());
+        memset(&m_calibration, 0, sizeof(m_calibration));
+        return;
+    }
     m_transformation = k4a_transformation_create(&m_calibration);
-
-    if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(m_device, &m_config)) {
-        mexPrintf("Failed to start m_device\n");
-        if (m_device) {
-            k4a_device_close(m_device);
-            m_device = NULL;
-            return;
-        }
+    m_serial_number = calibration;
+
+    m_init_timing.calibration_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    m_init_timing.total_ms = m_init_timing.calibration_ms;
+    m_init_timing.ok = m_transformation != NULL;
+    reset_frame_stats();
+    KZ_LOG(kz::LOG_INFO, "Offline KinZ with the calibration %s\n", path.c_str());
+} // end initOffline
+
+///////// Function: warmUp ////////////////////////////////////////////////
+// Run a first capture through the transformation and the body tracker,
+// which set up their GPU resources on first use, so the first frame of
+// get_frames already has the steady-state latency. The capture is not
+// kept.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::warm_up()
+{
+    k4a_capture_t capture = NULL;
+    // The first captures take longer after the cameras start
+    if (k4a_device_get_capture(m_device, &capture, 5 * TIMEOUT_IN_MS) != K4A_WAIT_RESULT_SUCCEEDED) {
+        KZ_LOG(kz::LOG_WARNING, "Warm-up: no capture received\n");
+        return;
     }
-    else
-        mexPrintf("Kinect for Azure started successfully!!\n");
 
-    // Activate IMU sensors
-    m_imu_sensors_available = false;
-    if (m_flags & kz::IMU_ON) {
-        if(k4a_device_start_imu(m_device) == K4A_RESULT_SUCCEEDED) {
-            mexPrintf("IMU sensors started succesfully.");
-            m_imu_sensors_available = true;
+    k4a_image_t depth = k4a_capture_get_depth_image(capture);
+    k4a_image_t color = k4a_capture_get_color_image(capture);
+    if (depth && color && m_transformation) {
+        int dw = k4a_image_get_width_pixels(depth), dh = k4a_image_get_height_pixels(depth);
+        int cw = k4a_image_get_width_pixels(color), ch = k4a_image_get_height_pixels(color);
+        k4a_image_t depth_out = NULL, color_out = NULL;
+        if (k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16, cw, ch, cw * 2, &depth_out) == K4A_RESULT_SUCCEEDED) {
+            k4a_transformation_depth_image_to_color_camera(m_transformation, depth, depth_out);
+            k4a_image_release(depth_out);
         }
-        else {
-            mexPrintf("IMU SENSORES FAILED INITIALIZATION");
-            m_imu_sensors_available = false;
+        if (k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32, dw, dh, dw * 4, &color_out) == K4A_RESULT_SUCCEEDED) {
+            k4a_transformation_color_image_to_depth_camera(m_transformation, depth, color, color_out);
+            k4a_image_release(color_out);
         }
     }
+    if (depth)
+        k4a_image_release(depth);
+    if (color)
+        k4a_image_release(color);
 
-    // Start body tracker
-    #ifdef BODY    
+    #ifdef BODY
+    if (m_tracker && !m_init_cancel &&
+        k4abt_tracker_enqueue_capture(m_tracker, capture, K4A_WAIT_INFINITE) == K4A_WAIT_RESULT_SUCCEEDED) {
+        // Loading the network may take several seconds
+        k4abt_frame_t body_frame = NULL;
+        if (k4abt_tracker_pop_result(m_tracker, &body_frame, 30 * TIMEOUT_IN_MS) == K4A_WAIT_RESULT_SUCCEEDED)
+            k4abt_frame_release(body_frame);
+        else
+            KZ_LOG(kz::LOG_WARNING, "Warm-up: the body tracker did not return a result\n");
+    }
+    #endif
+    k4a_capture_release(capture);
+} // end warmUp
+
+///////// Function: initShm ///////////////////////////////////////////////
+// Connect to the shared memory ring of a KinZ_server. The configuration
+// and calibration come from the ring header.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::init_shm(const char *name)
+{
+    m_shm.reset(new kz::ShmReader);
+    m_shm_frame.reset(new kz::ShmFrame);
+    m_imu_sensors_available = false;
+    #ifdef BODY
     m_body_tracking_available = false;
     m_num_bodies = 0;
-    if (m_flags & kz::BODY_TRACKING || m_flags & kz::BODY_INDEX) {
-        k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
-        if(k4abt_tracker_create(&m_calibration, tracker_config, &m_tracker) == K4A_RESULT_SUCCEEDED) {
-            mexPrintf("Body tracking started succesfully.\n");
-            m_body_tracking_available = true;
-        }
-        else {
-            mexPrintf("BODY TRACKING FAILED TO INITIALIZE!\n");
-            m_body_tracking_available = false;
-        }
+    #endif
+
+    memset(&m_calibration, 0, sizeof(m_calibration));
+    if (!m_shm->open(name))
+        return;
+
+    const kz::ShmHeader &h = m_shm->header();
+    m_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+    m_config.camera_fps = (k4a_fps_t)h.camera_fps;
+    if (h.has_calibration) {
+        m_calibration = h.calibration;
+        m_config.depth_mode = m_calibration.depth_mode;
+        m_config.color_resolution = m_calibration.color_resolution;
+        m_transformation = k4a_transformation_create(&m_calibration);
+    }
+    else {
+        // Synthetic source: only the image sizes are known
+        m_calibration.depth_camera_calibration.resolution_width = h.depth.width;
+        m_calibration.depth_camera_calibration.resolution_height = h.depth.height;
+        m_calibration.color_camera_calibration.resolution_width = h.color.width;
+        m_calibration.color_camera_calibration.resolution_height = h.color.height;
     }
+
+    m_imu_sensors_available = (h.streams & kz::SHM_IMU) != 0;
+    #ifdef BODY
+    m_body_tracking_available = (h.streams & kz::SHM_BODIES) != 0;
     #endif
-    
 
-} // end init
+    reset_frame_stats();
+    KZ_LOG(kz::LOG_INFO, "Connected to the KinZ server at %s", name);
+} // end initShm
+
+// Image wrapping the shared memory slot at data, without copying it
+static k4a_image_t shm_image(k4a_image_format_t format, const kz::ShmImageFormat &f,
+                             uint8_t *data, uint64_t device_usec, uint64_t system_nsec)
+{
+    k4a_image_t image = NULL;
+    if (k4a_image_create_from_buffer(format, f.width, f.height, f.stride, data, f.size(),
+                                     NULL, NULL, &image) != K4A_RESULT_SUCCEEDED)
+        return NULL;
+
+    k4a_image_set_device_timestamp_usec(image, device_usec);
+    k4a_image_set_system_timestamp_nsec(image, system_nsec);
+    return image;
+}
+
+// Owned copy of an image and its timestamps, NULL if it cannot be created
+static k4a_image_t copy_image(k4a_image_t image)
+{
+    k4a_image_t copy = NULL;
+    if (k4a_image_create(k4a_image_get_format(image), k4a_image_get_width_pixels(image),
+                         k4a_image_get_height_pixels(image), k4a_image_get_stride_bytes(image),
+                         &copy) != K4A_RESULT_SUCCEEDED)
+        return NULL;
+    memcpy(k4a_image_get_buffer(copy), k4a_image_get_buffer(image), k4a_image_get_size(image));
+    k4a_image_set_device_timestamp_usec(copy, k4a_image_get_device_timestamp_usec(image));
+    k4a_image_set_system_timestamp_nsec(copy, k4a_image_get_system_timestamp_nsec(image));
+    return copy;
+}
+
+///////// Function: getFramesShm //////////////////////////////////////////
+// get_frames for a client of a KinZ_server: wrap the images of the
+// newest published frame without copying them.
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::get_frames_shm(uint16_t capture_flags, std::chrono::steady_clock::time_point call_time)
+{
+    kz::ShmFrame &frame = *m_shm_frame;
+    frame.sequence = 0;
+    if (!m_shm->acquire(frame, TIMEOUT_IN_MS)) {
+        m_frame_stats.timeouts++;
+        KZ_LOG(kz::LOG_WARNING, "Timed out waiting for a frame of the KinZ server\n");
+        return false;
+    }
+
+    const kz::ShmHeader &h = m_shm->header();
+    const kz::ShmFrameInfo &info = frame.info;
+    bool valid = true;
+
+    if (capture_flags & kz::DEPTH) {
+        if (info.streams & kz::SHM_DEPTH)
+            m_image_d = shm_image(K4A_IMAGE_FORMAT_DEPTH16, h.depth, frame.depth,
+                                  info.depth_timestamp_usec, info.depth_system_nsec);
+        valid = valid && m_image_d != NULL;
+    }
+    if (capture_flags & kz::COLOR) {
+        if (info.streams & kz::SHM_COLOR)
+            m_image_c = shm_image(K4A_IMAGE_FORMAT_COLOR_BGRA32, h.color, frame.color,
+                                  info.color_timestamp_usec, info.color_system_nsec);
+        valid = valid && m_image_c != NULL;
+    }
+    if (capture_flags & kz::INFRARED) {
+        if (info.streams & kz::SHM_INFRARED)
+            m_image_ir = shm_image(K4A_IMAGE_FORMAT_IR16, h.infrared, frame.infrared,
+                                   info.infrared_timestamp_usec, info.infrared_system_nsec);
+        valid = valid && m_image_ir != NULL;
+    }
+
+    if ((capture_flags & kz::IMU_ON) && (info.streams & kz::SHM_IMU))
+        m_imu_data = info.imu;
+
+    #ifdef BODY
+    m_num_bodies = (info.streams & kz::SHM_BODIES) ? info.num_bodies : 0;
+    #endif
+
+    update_frame_stats(call_time, (info.streams & kz::SHM_DEPTH) != 0, info.depth_timestamp_usec,
+                       (info.streams & kz::SHM_COLOR) != 0, info.color_timestamp_usec);
+
+    filter_depth();
+    update_background();
+
+    return valid && frame_intact();
+} // end getFramesShm
+
+///////// Function: frameIntact ////////////////////////////////////////////
+// False when the KinZ_server reused the slot of the current frame, so the
+// images may mix two frames. Always true for a device and for a pinned
+// frame, whose images were copied out of the slot.
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::frame_intact()
+{
+    if (!m_shm || m_selected)
+        return true;
+    if (m_shm->intact(*m_shm_frame))
+        return true;
+    m_shm->count_overrun();
+    KZ_LOG(kz::LOG_WARNING, "The KinZ server overwrote the frame while it was read\n");
+    return false;
+}
+
+///////// Function: pinFrame //////////////////////////////////////////////
+// Reference the objects of the current frame in a new kz::Frame. The
+// images of a KinZ_server wrap ring slots that are reused a few frames
+// later, so they are copied instead; 0 if the slot was already reused.
+//////////////////////////////////////////////////////////////////////////
+uint64_t KinZ::pin_frame()
+{
+    if (m_selected || (!m_capture && !m_image_d && !m_image_c && !m_image_ir))
+        return 0;
+    if (m_pinned.size() >= m_max_pinned) {
+        KZ_LOG(kz::LOG_WARNING, "%u frames are pinned, release one to pin a new frame\n",
+               (unsigned)m_pinned.size());
+        return 0;
+    }
+
+    // New reference, or a copy of an image in a ring slot
+    const kz::ShmFrame *slot = m_shm ? m_shm_frame.get() : NULL;
+    auto pin_image = [&](k4a_image_t image, const uint8_t *slot_data) {
+        if (slot && k4a_image_get_buffer(image) == slot_data)
+            return copy_image(image);
+        k4a_image_reference(image);
+        return image;
+    };
+
+    std::unique_ptr<kz::Frame> frame(new kz::Frame);
+    if (m_capture) {
+        k4a_capture_reference(m_capture);
+        frame->capture = m_capture;
+    }
+    if (m_image_d)
+        frame->depth = pin_image(m_image_d, slot ? slot->depth : NULL);
+    if (m_image_c)
+        frame->color = pin_image(m_image_c, slot ? slot->color : NULL);
+    if (m_image_ir)
+        frame->infrared = pin_image(m_image_ir, slot ? slot->infrared : NULL);
+    if ((m_image_d && !frame->depth) || (m_image_c && !frame->color) ||
+        (m_image_ir && !frame->infrared)) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to copy the images of the frame to pin\n");
+        return 0;
+    }
+    if (slot && !frame_intact())
+        return 0;
+    frame->imu = m_imu_data;
+    #ifdef BODY
+    if (m_body_frame) {
+        k4abt_frame_reference(m_body_frame);
+        frame->body_frame = m_body_frame;
+    }
+    if (m_body_index) {
+        k4a_image_reference(m_body_index);
+        frame->body_index = m_body_index;
+    }
+    frame->num_bodies = m_num_bodies;
+    #endif
+    if (m_shm)
+        frame->shm_frame.reset(new kz::ShmFrame(*m_shm_frame));
+
+    uint64_t handle = m_next_handle++;
+    m_pinned[handle] = std::move(frame);
+    return handle;
+} // end pinFrame
+
+///////// Function: releaseFrame //////////////////////////////////////////
+// Drop a pinned frame. False if the handle is unknown or in use by a
+// kz::FrameScope.
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::release_frame(uint64_t handle)
+{
+    auto it = m_pinned.find(handle);
+    if (it == m_pinned.end() || it->second.get() == m_selected)
+        return false;
+    m_pinned.erase(it);
+    return true;
+}
+
+void KinZ::release_frames()
+{
+    for (auto it = m_pinned.begin(); it != m_pinned.end(); ) {
+        if (it->second.get() == m_selected)
+            ++it;
+        else
+            it = m_pinned.erase(it);
+    }
+}
+
+///////// Function: setMaxPinnedFrames ////////////////////////////////////
+// Frames already pinned above the new limit stay until released
+//////////////////////////////////////////////////////////////////////////
+void KinZ::set_max_pinned_frames(size_t max_pinned)
+{
+    m_max_pinned = max_pinned;
+}
+
+///////// Function: selectFrame ///////////////////////////////////////////
+// Swap a pinned frame in as the current frame, see kz::FrameScope
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::select_frame(uint64_t handle)
+{
+    auto it = m_pinned.find(handle);
+    if (m_selected || it == m_pinned.end())
+        return false;
+    m_selected = it->second.get();
+    swap_frame(*m_selected);
+    return true;
+}
+
+void KinZ::unselect_frame()
+{
+    if (!m_selected)
+        return;
+    swap_frame(*m_selected);
+    m_selected = nullptr;
+}
+
+void KinZ::swap_frame(kz::Frame &frame)
+{
+    std::swap(m_capture, frame.capture);
+    std::swap(m_image_d, frame.depth);
+    std::swap(m_image_c, frame.color);
+    std::swap(m_image_ir, frame.infrared);
+    std::swap(m_imu_data, frame.imu);
+    #ifdef BODY
+    std::swap(m_body_frame, frame.body_frame);
+    std::swap(m_body_index, frame.body_index);
+    std::swap(m_num_bodies, frame.num_bodies);
+    #endif
+    if (m_shm)
+        std::swap(m_shm_frame, frame.shm_frame);
+}
+
+///////// Function: updateFrameStats /////////////////////////////////////
+// Account the new capture in m_frame_stats from the device timestamps of
+// its depth and color images. call_time is when get_frames was called,
+// used to tell frames skipped by a late consumer from frames dropped by
+// the sensor.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::update_frame_stats(std::chrono::steady_clock::time_point call_time,
+                              bool has_depth, uint64_t depth_usec,
+                              bool has_color, uint64_t color_usec)
+{
+    kz::FrameStats &st = m_frame_stats;
+
+    if (!has_depth && !has_color)
+        return;
+
+    uint64_t timestamp = has_depth ? depth_usec : color_usec;
+    double period = (double)st.period_usec;
+
+    if (st.captured > 0 && timestamp > st.last_timestamp_usec && period > 0) {
+        double gap = (double)(timestamp - st.last_timestamp_usec);
+        long frames = std::max(1L, std::lround(gap / period));
+        uint64_t missing = (uint64_t)(frames - 1);
+
+        // The SDK only queues a couple of captures, so a consumer that
+        // comes back after n periods could not receive the n-1 frames
+        // in between. The rest of the gap was lost by the sensor.
+        double since_last_call = std::chrono::duration<double, std::micro>(
+                                     call_time - m_last_capture_call).count();
+        long late = std::lround(since_last_call / period) - 1;
+        uint64_t skipped = late > 0 ? std::min(missing, (uint64_t)late) : 0;
+        st.consumer_skipped += skipped;
+        st.sensor_dropped += missing - skipped;
+
+        double jitter = std::fabs(gap - frames * period);
+        st.intervals++;
+        st.jitter_mean_usec += (jitter - st.jitter_mean_usec) / st.intervals;
+        st.jitter_max_usec = std::max(st.jitter_max_usec, jitter);
+    }
+
+    if (has_depth && has_color) {
+        int64_t offset = (int64_t)color_usec - (int64_t)depth_usec;
+        st.synced++;
+        st.sync_offset_usec = offset;
+        st.sync_offset_mean_usec += (offset - st.sync_offset_mean_usec) / st.synced;
+        if (std::llabs(offset) > std::llabs(st.sync_offset_max_usec))
+            st.sync_offset_max_usec = offset;
+    }
+
+    st.captured++;
+    st.last_timestamp_usec = timestamp;
+    m_last_capture_call = call_time;
+} // end updateFrameStats
 
 ///////// Function: updateData ///////////////////////////////////////////
 // Get current data from Kinect and save it in the member variables
 //////////////////////////////////////////////////////////////////////////
 void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
 {
+    std::chrono::steady_clock::time_point call_time = std::chrono::steady_clock::now();
+
+    // The frame of an offline KinZ is the one given to set_depth/set_color
+    if (m_offline) {
+        valid[0] = 0;
+        return;
+    }
+
     // Release images before next acquisition
     if (m_capture) {
         k4a_capture_release(m_capture);
@@ -251,6 +797,11 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
         m_body_frame = NULL;
     }
     #endif
+
+    if (m_shm) {
+        valid[0] = get_frames_shm(capture_flags, call_time) ? 1 : 0;
+        return;
+    }
     
     // Get a m_capture
     bool new_capture;
@@ -259,11 +810,13 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
             new_capture = true;
             break;
         case K4A_WAIT_RESULT_TIMEOUT:
-            mexPrintf("Timed out waiting for a m_capture\n");
+            m_frame_stats.timeouts++;
+            KZ_LOG(kz::LOG_WARNING, "Timed out waiting for a m_capture\n");
             new_capture = false;
             break;
         case K4A_WAIT_RESULT_FAILED:
-            mexPrintf("Failed to read a m_capture\n");
+            KZ_LOG(kz::LOG_ERROR, "Failed to read a m_capture\n");
+            m_frame_stats.failures++;
             new_capture = false;
             // mexPrintf("Restarting streaming ...");
             // k4a_device_stop_cameras	(m_device);	
@@ -285,7 +838,7 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
             m_image_d = k4a_capture_get_depth_image(m_capture);
             if (m_image_d == NULL) {
                 new_depth_data = false;
-                mexPrintf("Could not read depth image\n");
+                KZ_LOG(kz::LOG_ERROR, "Could not read depth image\n");
             }
         }
 
@@ -295,7 +848,7 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
             m_image_c = k4a_capture_get_color_image(m_capture);
             if (m_image_c == NULL) {
                 new_color_data = false;
-                mexPrintf("Could not read color image\n");
+                KZ_LOG(kz::LOG_ERROR, "Could not read color image\n");
             }
         }
         
@@ -305,9 +858,21 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
             m_image_ir = k4a_capture_get_ir_image(m_capture);
             if (m_image_ir == NULL) {
                 new_infrared_data = false;
-                mexPrintf("Could not read IR image");
+                KZ_LOG(kz::LOG_ERROR, "Could not read IR image");
             }
         }
+
+        // Device timestamps of the capture, also when the images are not
+        // requested by get_frames
+        k4a_image_t depth = m_image_d ? m_image_d : k4a_capture_get_depth_image(m_capture);
+        k4a_image_t color = m_image_c ? m_image_c : k4a_capture_get_color_image(m_capture);
+        update_frame_stats(call_time,
+                           depth != NULL, depth ? k4a_image_get_device_timestamp_usec(depth) : 0,
+                           color != NULL, color ? k4a_image_get_device_timestamp_usec(color) : 0);
+        if (depth && depth != m_image_d)
+            k4a_image_release(depth);
+        if (color && color != m_image_c)
+            k4a_image_release(color);
     }
 
     if((capture_flags & kz::IMU_ON) && m_imu_sensors_available) {
@@ -321,10 +886,10 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
         case K4A_WAIT_RESULT_SUCCEEDED:
             break;
         case K4A_WAIT_RESULT_TIMEOUT:
-            mexPrintf("Timed out waiting for a imu sample\n");
+            KZ_LOG(kz::LOG_WARNING, "Timed out waiting for a imu sample\n");
             break;
         case K4A_WAIT_RESULT_FAILED:
-            mexPrintf("Failed to read a imu sample\n");
+            KZ_LOG(kz::LOG_ERROR, "Failed to read a imu sample\n");
             break;
         }
 
@@ -349,10 +914,10 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
         k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(m_tracker, m_capture, K4A_WAIT_INFINITE);
         if (queue_capture_result == K4A_WAIT_RESULT_TIMEOUT) {
             // It should never hit timeout when K4A_WAIT_INFINITE is set.
-            mexPrintf("Error! Add capture to tracker process queue timeout!\n");
+            KZ_LOG(kz::LOG_WARNING, "Error! Add capture to tracker process queue timeout!\n");
         }
         else if (queue_capture_result == K4A_WAIT_RESULT_FAILED) {
-            mexPrintf("Error! Add capture to tracker process queue failed!\n");
+            KZ_LOG(kz::LOG_ERROR, "Error! Add capture to tracker process queue failed!\n");
         }
         else {
             m_body_frame = NULL;
@@ -365,23 +930,27 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
                     m_body_index = k4abt_frame_get_body_index_map(m_body_frame);
 
                     if (m_body_index == NULL) {
-                        mexPrintf("Error: Fail to generate bodyindex map!\n");
+                        KZ_LOG(kz::LOG_ERROR, "Error: Fail to generate bodyindex map!\n");
                     }
                 }
             }
             else if (pop_frame_result == K4A_WAIT_RESULT_TIMEOUT)
             {
                 //  It should never hit timeout when K4A_WAIT_INFINITE is set.
-                mexPrintf("Error! Pop body frame result timeout!\n");
+                KZ_LOG(kz::LOG_WARNING, "Error! Pop body frame result timeout!\n");
             }
             else
             {
-                mexPrintf("Pop body frame result failed!\n");
+                KZ_LOG(kz::LOG_ERROR, "Pop body frame result failed!\n");
             }
         }
     } // body tracking
     #endif
 
+    // Filter the depth after the body tracker got the raw capture and
+    // before any getter, alignment or point cloud uses it
+    filter_depth();
+    update_background();
     
     if (new_depth_data && new_color_data && new_infrared_data)
         valid[0] = 1;
@@ -389,190 +958,502 @@ void KinZ::get_frames(uint16_t capture_flags, uint8_t valid[])
         valid[0] = 0;
 } // end updateData
 
-///////// Function: getColor ///////////////////////////////////////////
-// Copy color frame to Matlab matrix
-// You must call updateData first
+///////// Function: getAll ///////////////////////////////////////////////
+// Capture new frames and convert every requested stream to the Matlab
+// buffers in products. The conversions run concurrently on m_pool.
 //////////////////////////////////////////////////////////////////////////
-void KinZ::get_color(uint8_t rgb_image[], uint64_t& time, bool& valid_color)
+void KinZ::get_all(uint16_t capture_flags, kz::Products &products, uint8_t valid[])
 {
-    if(m_image_c) {
-        int w = k4a_image_get_width_pixels(m_image_c);
-        int h = k4a_image_get_height_pixels(m_image_c);
-        int stride = k4a_image_get_stride_bytes(m_image_c);
-        uint8_t* dataBuffer = k4a_image_get_buffer(m_image_c);
-        int numColorPix = w*h;
+    get_frames(capture_flags, valid);
 
-        // copy color buffer to Matlab output
-        // sweep the entire matrix copying data to output matrix
-        int col_size = 4*w;
-        for (int x=0, k=0; x < w*4; x+=4)
-            for (int y=0; y <h; y++,k++)
-            {
-                int idx = y * col_size + x;
-                rgb_image[k] = dataBuffer[idx+2];
-                rgb_image[numColorPix + k] = dataBuffer[idx+1];
-                rgb_image[numColorPix*2 + k] = dataBuffer[idx];                   
-            }
-        valid_color = true;
-        time = k4a_image_get_system_timestamp_nsec(m_image_c);
-    }
-    else
-        valid_color = false;
+    kz::ThreadPool::Group group;
+    if ((capture_flags & kz::COLOR) && products.color)
+        m_pool.submit(group, [&] {
+            get_color(products.color, products.color_time, products.color_valid); });
 
-} // end getColor
+    if ((capture_flags & kz::DEPTH) && products.depth)
+        m_pool.submit(group, [&] {
+            get_depth(products.depth, products.depth_time, products.depth_valid); });
 
-///////// Function: getDepth ///////////////////////////////////////////
-// Copy depth frame to Matlab matrix
-// You must call updateData first
+    if ((capture_flags & kz::INFRARED) && products.infrared)
+        m_pool.submit(group, [&] {
+            get_infrared(products.infrared, products.infrared_time, products.infrared_valid); });
+
+    #ifdef BODY
+    if ((capture_flags & kz::BODY_TRACKING) && products.bodies_requested)
+        m_pool.submit(group, [&] { get_bodies(products.bodies); });
+    #endif
+
+    m_pool.wait(group);
+} // end getAll
+
+///////// Function: getBurst ////////////////////////////////////////////
+// Capture with get_frames and hand the images of each capture, with an
+// extra reference, to a conversion task writing its slice of the stacks.
+// Images of a KinZ_server point into its ring and are converted before
+// the next capture instead.
 //////////////////////////////////////////////////////////////////////////
-void KinZ::get_depth(uint16_t depth[], uint64_t& time, bool& valid_depth)
+int KinZ::get_burst(uint16_t capture_flags, const kz::BurstStacks &stacks)
 {
-    if(m_image_d) {
-        int w = k4a_image_get_width_pixels(m_image_d);
-        int h = k4a_image_get_height_pixels(m_image_d);
-        int stride = k4a_image_get_stride_bytes(m_image_d);
+    const int n = stacks.n;
+    int dw, dh, cw, ch;
+    get_image_sizes(dw, dh, cw, ch);
+    const size_t depth_pix = (size_t)dw * dh;
+    const size_t color_pix = (size_t)cw * ch;
+    memset(stacks.valid, 0, (size_t)n * 3);
+    memset(stacks.time, 0, (size_t)n * 3 * sizeof(uint64_t));
+
+    const bool async = !m_shm;
+    int received = 0;
+    kz::ThreadPool::Group group;
+    for (int f = 0; f < n; f++) {
+        uint8_t valid;
+        get_frames(capture_flags, &valid);
+        bool captured = m_shm ? valid != 0 : m_capture != NULL;
+        if (!captured)
+            continue;
+        received++;
+
+        k4a_image_t images[3] = {stacks.depth ? m_image_d : NULL,
+                                 stacks.color ? m_image_c : NULL,
+                                 stacks.infrared ? m_image_ir : NULL};
+        for (int s = 0; s < 3; s++) {
+            k4a_image_t image = images[s];
+            int w = s == 1 ? cw : dw, h = s == 1 ? ch : dh;
+            if (!image || k4a_image_get_width_pixels(image) != w ||
+                k4a_image_get_height_pixels(image) != h)
+                continue;
+            stacks.valid[f + (size_t)n * s] = 1;
+            stacks.time[f + (size_t)n * s] = k4a_image_get_device_timestamp_usec(image);
+
+            std::function<void()> convert = [=] {
+                const uint8_t *src = k4a_image_get_buffer(image);
+                int stride = k4a_image_get_stride_bytes(image);
+                kz::Region roi(w, h);
+                if (s == 0)
+                    kz::depth_to_matlab(src, stride, roi, stacks.depth + depth_pix * f, 0, w);
+                else if (s == 1)
+                    kz::bgra_to_rgb(src, stride, roi, stacks.color + 3 * color_pix * f, 0, w);
+                else
+                    kz::u16_to_matlab(src, stride, roi, stacks.infrared + depth_pix * f, 0, w);
+                if (async)
+                    k4a_image_release(image);
+            };
+            if (async) {
+                k4a_image_reference(image);
+                m_pool.submit(group, convert);
+            }
+            else
+                convert();
+        }
+    }
+    m_pool.wait(group);
+    return received;
+} // end getBurst
+
+///////// Function: archiveOpen ///////////////////////////////////////////
+// Create the archive path holding the kz::ARCHIVE_* streams with the image
+// sizes of the current configuration
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::archive_open(const char *path, uint32_t streams)
+{
+    #ifndef BODY
+    streams &= ~(uint32_t)kz::ARCHIVE_BODIES;
+    #endif
+
+    int dw, dh, cw, ch;
+    get_image_sizes(dw, dh, cw, ch);
+
+    if (!m_archive)
+        m_archive.reset(new kz::ArchiveWriter);
+    if (!m_archive->open(path, streams, dw, dh, cw, ch))
+        return false;
+
+    if (streams & kz::ARCHIVE_POINTCLOUD)
+        m_archive_cloud.resize((size_t)dw * dh * 3);
+    return true;
+}
+
+///////// Function: archiveWrite //////////////////////////////////////////
+// Convert the frames of the last get_frames into the next record of the
+// archive. The conversions run concurrently on m_pool, as in get_all.
+// Streams without a frame of the archive size are zeroed and not set in
+// valid.
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::archive_write(uint64_t &frame, uint32_t &valid)
+{
+    valid = 0;
+    if (!m_archive || !m_archive->is_open()) {
+        KZ_LOG(kz::LOG_ERROR, "No archive is open");
+        return false;
+    }
+
+    const kz::ArchiveHeader &h = m_archive->header();
+    uint8_t *record = m_archive->record();
+    kz::ArchiveFrameInfo &info = m_archive->info();
+    memset(&info, 0, sizeof(info));
+
+    auto has_size = [](k4a_image_t image, int width, int height) {
+        return image && k4a_image_get_width_pixels(image) == width &&
+               k4a_image_get_height_pixels(image) == height;
+    };
+    bool depth_ok = has_size(m_image_d, h.depth_width, h.depth_height);
+
+    bool valid_depth = false, valid_color = false, valid_infrared = false, valid_cloud = false;
+    uint64_t cloud_time = 0;
+    kz::ThreadPool::Group group;
+
+    if ((h.streams & kz::ARCHIVE_DEPTH) && depth_ok)
+        m_pool.submit(group, [&] {
+            get_depth((uint16_t *)(record + h.depth_offset), info.depth_time, valid_depth); });
+
+    if ((h.streams & kz::ARCHIVE_INFRARED) && has_size(m_image_ir, h.depth_width, h.depth_height))
+        m_pool.submit(group, [&] {
+            get_infrared((uint16_t *)(record + h.infrared_offset), info.infrared_time, valid_infrared); });
+
+    if ((h.streams & kz::ARCHIVE_COLOR) && has_size(m_image_c, h.color_width, h.color_height))
+        m_pool.submit(group, [&] {
+            get_color(record + h.color_offset, info.color_time, valid_color); });
+
+    if ((h.streams & kz::ARCHIVE_POINTCLOUD) && depth_ok)
+        m_pool.submit(group, [&] {
+            get_pointcloud(m_archive_cloud.data(), NULL, false, valid_cloud);
+            if (!valid_cloud)
+                return;
+            float *cloud = (float *)(record + h.pointcloud_offset);
+            for (size_t i = 0; i < m_archive_cloud.size(); i++)
+                cloud[i] = (float)m_archive_cloud[i];
+            cloud_time = k4a_image_get_system_timestamp_nsec(m_image_d);
+        });
+
+    #ifdef BODY
+    if (h.streams & kz::ARCHIVE_BODIES)
+        m_pool.submit(group, [&] {
+            std::vector<kz::Body> bodies;
+            get_bodies(bodies);
+            info.num_bodies = (uint32_t)std::min<size_t>(bodies.size(), h.max_bodies);
+            if (info.num_bodies)
+                memcpy(record + h.bodies_offset, bodies.data(), info.num_bodies * sizeof(kz::Body));
+        });
+    #endif
+
+    m_pool.wait(group);
+
+    // Invalid streams must not show the data of a previous record
+    size_t depth_bytes = 2 * (size_t)h.depth_width * h.depth_height;
+    if (h.streams & kz::ARCHIVE_DEPTH) {
+        if (valid_depth) valid |= kz::ARCHIVE_DEPTH;
+        else memset(record + h.depth_offset, 0, depth_bytes);
+    }
+    if (h.streams & kz::ARCHIVE_INFRARED) {
+        if (valid_infrared) valid |= kz::ARCHIVE_INFRARED;
+        else memset(record + h.infrared_offset, 0, depth_bytes);
+    }
+    if (h.streams & kz::ARCHIVE_COLOR) {
+        if (valid_color) valid |= kz::ARCHIVE_COLOR;
+        else memset(record + h.color_offset, 0, 3 * (size_t)h.color_width * h.color_height);
+    }
+    if (h.streams & kz::ARCHIVE_POINTCLOUD) {
+        if (valid_cloud) valid |= kz::ARCHIVE_POINTCLOUD;
+        else memset(record + h.pointcloud_offset, 0, 6 * depth_bytes);
+    }
+    if ((h.streams & kz::ARCHIVE_BODIES) && info.num_bodies)
+        valid |= kz::ARCHIVE_BODIES;
+    if (!valid_depth && valid_cloud)
+        info.depth_time = cloud_time;
+
+    info.valid = valid;
+    frame = m_archive->frames();
+    return m_archive->append();
+} // end archiveWrite
+
+///////// Function: archiveClose //////////////////////////////////////////
+// Write the index of the archive and close it. Returns the frames written.
+//////////////////////////////////////////////////////////////////////////
+uint64_t KinZ::archive_close()
+{
+    if (!m_archive || !m_archive->is_open())
+        return 0;
+    uint64_t frames = m_archive->frames();
+    m_archive->close();
+    m_archive_cloud.clear();
+    m_archive_cloud.shrink_to_fit();
+    return frames;
+}
+
+///////// Function: getColor ///////////////////////////////////////////
+// Copy the region roi of the color frame to Matlab matrix
+// You must call updateData first
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_color(uint8_t rgb_image[], uint64_t& time, bool& valid_color,
+                     const kz::Region &region)
+{
+    valid_color = false;
+    if(m_image_c) {
+        int w = k4a_image_get_width_pixels(m_image_c);
+        int h = k4a_image_get_height_pixels(m_image_c);
+        int stride = k4a_image_get_stride_bytes(m_image_c);
+        uint8_t* dataBuffer = k4a_image_get_buffer(m_image_c);
+
+        kz::Region roi = region;
+        if (!roi.clip(w, h))
+            return;
+
+        // copy color buffer to Matlab output in column tiles
+        kz::parallel_columns(m_pool, roi.out_width(), [&](int x0, int x1) {
+            kz::bgra_to_rgb(dataBuffer, stride, roi, rgb_image, x0, x1);
+        });
+        valid_color = frame_intact();
+        time = k4a_image_get_system_timestamp_nsec(m_image_c);
+    }
+} // end getColor
+
+///////// Function: getDepth ///////////////////////////////////////////
+// Copy the region roi of the depth frame to Matlab matrix
+// You must call updateData first
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_depth(uint16_t depth[], uint64_t& time, bool& valid_depth,
+                     const kz::Region &region)
+{
+    valid_depth = false;
+    if(m_image_d) {
+        int w = k4a_image_get_width_pixels(m_image_d);
+        int h = k4a_image_get_height_pixels(m_image_d);
+        int stride = k4a_image_get_stride_bytes(m_image_d);
         uint8_t* dataBuffer = k4a_image_get_buffer(m_image_d);
 
+        kz::Region roi = region;
+        if (!roi.clip(w, h))
+            return;
+
         // Copy Depth frame to output matrix
-        int col_size = 2*w;
-        for (int x=0, k=0;x<w*2;x+=2)
-            for (int y=0;y<h;y++,k++) {
-                int idx = y * col_size + x;
-                uint16_t lsb, msb;
-
-                lsb = dataBuffer[idx];
-                msb = dataBuffer[idx+1];
-                depth[k] = msb * 256 + lsb;
-            }
+        kz::depth_to_matlab(dataBuffer, stride, roi, depth, 0, roi.out_width());
 
-        valid_depth = true;
+        valid_depth = frame_intact();
         time = k4a_image_get_system_timestamp_nsec(m_image_d);
     }
-    else 
-        valid_depth = false;
 } // end getDepth
 
 ///////// Function: getDepthAligned ///////////////////////////////////////////
-// Copy depth aligned to color frame to Matlab matrix
+// Copy the region roi of the depth aligned to color frame to Matlab matrix
 // You must call updateData first
 //////////////////////////////////////////////////////////////////////////
-void KinZ::get_depth_aligned(uint16_t depth[], uint64_t& time, bool& valid_depth)
+void KinZ::get_depth_aligned(uint16_t depth[], uint64_t& time, bool& valid_depth,
+                             const kz::Region &region)
 {
-    if(m_image_d) {
-        k4a_image_t image_dc;
-        if(align_depth_to_color(k4a_image_get_width_pixels(m_image_c),
+    valid_depth = false;
+    if(m_image_d && m_image_c) {
+        kz::Region roi = region;
+        if (!roi.clip(k4a_image_get_width_pixels(m_image_c), k4a_image_get_height_pixels(m_image_c)))
+            return;
+
+        k4a_image_t image_dc = NULL;
+        if(!align_depth_to_color(k4a_image_get_width_pixels(m_image_c),
             k4a_image_get_height_pixels(m_image_c), image_dc)) {
+            KZ_LOG(kz::LOG_ERROR, "Failed to align depth to color\n");
+            if (image_dc)
+                k4a_image_release(image_dc);
+            return;
         }
-        else
-            mexPrintf("Failed to align depth to color\n");
-
 
-        int w = k4a_image_get_width_pixels(image_dc);
-        int h = k4a_image_get_height_pixels(image_dc);
         int stride = k4a_image_get_stride_bytes(image_dc);
         uint8_t* dataBuffer = k4a_image_get_buffer(image_dc);
 
-        // Copy Depth frame to output matrix
-        int col_size = 2*w;
-        for (int x=0, k=0;x<w*2;x+=2)
-            for (int y=0;y<h;y++,k++) {
-                int idx = y * col_size + x;
-                uint16_t lsb, msb;
-
-                lsb = dataBuffer[idx];
-                msb = dataBuffer[idx+1];
-                depth[k] = msb * 256 + lsb;
-            }
+        // Copy Depth frame to output matrix in column tiles
+        kz::parallel_columns(m_pool, roi.out_width(), [&](int x0, int x1) {
+            kz::depth_to_matlab(dataBuffer, stride, roi, depth, x0, x1);
+        });
+        k4a_image_release(image_dc);
 
-        valid_depth = true;
-        time = time = k4a_image_get_system_timestamp_nsec(m_image_c);
+        valid_depth = frame_intact();
+        time = k4a_image_get_system_timestamp_nsec(m_image_c);
     }
-    else 
-        valid_depth = false;
 } // end getDepthAligned
 
 
 ///////// Function: getColorAligned ///////////////////////////////////////////
-// Copy color aligned to depth frame to Matlab matrix
+// Copy the region roi of the color aligned to depth frame to Matlab matrix
 // You must call updateData first
 //////////////////////////////////////////////////////////////////////////
-void KinZ::get_color_aligned(uint8_t color[], uint64_t& time, bool& valid)
+void KinZ::get_color_aligned(uint8_t color[], uint64_t& time, bool& valid,
+                             const kz::Region &region)
 {
+    valid = false;
     if(m_image_d && m_image_c) {
-        k4a_image_t image_cd;
-        if(align_color_to_depth(k4a_image_get_width_pixels(m_image_d),
+        kz::Region roi = region;
+        if (!roi.clip(k4a_image_get_width_pixels(m_image_d), k4a_image_get_height_pixels(m_image_d)))
+            return;
+
+        k4a_image_t image_cd = NULL;
+        if(!align_color_to_depth(k4a_image_get_width_pixels(m_image_d),
             k4a_image_get_height_pixels(m_image_d), image_cd)) {
+            KZ_LOG(kz::LOG_ERROR, "Failed to align color to depth\n");
+            if (image_cd)
+                k4a_image_release(image_cd);
+            return;
         }
-        else
-            mexPrintf("Failed to align color to depth\n");
-
 
-        int w = k4a_image_get_width_pixels(image_cd);
-        int h = k4a_image_get_height_pixels(image_cd);
         int stride = k4a_image_get_stride_bytes(image_cd);
         uint8_t* dataBuffer = k4a_image_get_buffer(image_cd);
-        int numColorPix = w*h;
-
-        // Copy frame to output matrix
-        int col_size = 4*w;
-        for (int x=0, k=0; x < w*4; x+=4)
-            for (int y=0; y <h; y++,k++) {
-                int idx = y * col_size + x;
-                color[k] = dataBuffer[idx+2];
-                color[numColorPix + k] = dataBuffer[idx+1];
-                color[numColorPix*2 + k] = dataBuffer[idx];                   
-            }
 
-        valid = true;
+        // Copy frame to output matrix in column tiles
+        kz::parallel_columns(m_pool, roi.out_width(), [&](int x0, int x1) {
+            kz::bgra_to_rgb(dataBuffer, stride, roi, color, x0, x1);
+        });
+        k4a_image_release(image_cd);
+
+        valid = frame_intact();
         time = k4a_image_get_system_timestamp_nsec(m_image_d);
     }
-    else 
-        valid = false;
 } // end getColorAligned
 
 ///////// Function: getInfrared ///////////////////////////////////////////
-// Copy infrared frame to Matlab matrix
+// Copy the region roi of the infrared frame to Matlab matrix
 // You must call updateData first
 ///////////////////////////////////////////////////////////////////////////
-void KinZ::get_infrared(uint16_t infrared[], uint64_t& time, bool& valid_infrared)
+void KinZ::get_infrared(uint16_t infrared[], uint64_t& time, bool& valid_infrared,
+                        const kz::Region &region)
 {
+    valid_infrared = false;
     if(m_image_ir) {
         int w = k4a_image_get_width_pixels(m_image_ir);
         int h = k4a_image_get_height_pixels(m_image_ir);
         int stride = k4a_image_get_stride_bytes(m_image_ir);
         uint8_t* dataBuffer = k4a_image_get_buffer(m_image_ir);
 
+        kz::Region roi = region;
+        if (!roi.clip(w, h))
+            return;
+
         // copy dataBuffer to output matrix
-        int col_size = 2*w;
-        for (int x=0, k=0;x<w*2;x+=2)
-            for (int y=0;y<h;y++,k++) {
-                int idx = y * col_size + x;
-                uint16_t lsb, msb;
-
-                lsb = dataBuffer[idx];
-                msb = dataBuffer[idx+1];        
-                infrared[k] = msb * 256 + lsb;
-            }
+        kz::u16_to_matlab(dataBuffer, stride, roi, infrared, 0, roi.out_width());
         
-        valid_infrared = true;
+        valid_infrared = frame_intact();
         time = k4a_image_get_system_timestamp_nsec(m_image_ir);
     }
-    else
-        valid_infrared = false;
 } // end getInfrared
 
+///////// Function: getDepthUndistorted ////////////////////////////////////
+// Remap the depth frame, in column tiles on m_pool
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_depth_undistorted(uint16_t depth[], uint64_t& time, bool& valid_depth)
+{
+    valid_depth = false;
+    kz::Undistorter *undistorter = depth_undistorter();
+    if (!m_image_d || !undistorter ||
+        k4a_image_get_width_pixels(m_image_d) != undistorter->width() ||
+        k4a_image_get_height_pixels(m_image_d) != undistorter->height())
+        return;
+
+    const uint8_t *src = k4a_image_get_buffer(m_image_d);
+    size_t stride = k4a_image_get_stride_bytes(m_image_d);
+    kz::parallel_columns(m_pool, undistorter->width(), [&](int x0, int x1) {
+        undistorter->nearest_u16(src, stride, 2, depth, x0, x1);
+    });
+    valid_depth = frame_intact();
+    time = k4a_image_get_system_timestamp_nsec(m_image_d);
+} // end getDepthUndistorted
+
+void KinZ::get_infrared_undistorted(uint16_t infrared[], uint64_t& time, bool& valid_infrared)
+{
+    valid_infrared = false;
+    kz::Undistorter *undistorter = depth_undistorter();
+    if (!m_image_ir || !undistorter ||
+        k4a_image_get_width_pixels(m_image_ir) != undistorter->width() ||
+        k4a_image_get_height_pixels(m_image_ir) != undistorter->height())
+        return;
+
+    const uint8_t *src = k4a_image_get_buffer(m_image_ir);
+    int stride = k4a_image_get_stride_bytes(m_image_ir);
+    kz::parallel_columns(m_pool, undistorter->width(), [&](int x0, int x1) {
+        undistorter->bilinear_u16(src, stride, infrared, x0, x1);
+    });
+    valid_infrared = frame_intact();
+    time = k4a_image_get_system_timestamp_nsec(m_image_ir);
+}
+
+void KinZ::get_color_undistorted(uint8_t rgb[], uint64_t& time, bool& valid_color)
+{
+    valid_color = false;
+    kz::Undistorter *undistorter = color_undistorter();
+    if (!m_image_c || !undistorter ||
+        k4a_image_get_format(m_image_c) != K4A_IMAGE_FORMAT_COLOR_BGRA32 ||
+        k4a_image_get_width_pixels(m_image_c) != undistorter->width() ||
+        k4a_image_get_height_pixels(m_image_c) != undistorter->height())
+        return;
+
+    const uint8_t *src = k4a_image_get_buffer(m_image_c);
+    int stride = k4a_image_get_stride_bytes(m_image_c);
+    kz::parallel_columns(m_pool, undistorter->width(), [&](int x0, int x1) {
+        undistorter->bilinear_bgra_to_rgb(src, stride, rgb, x0, x1);
+    });
+    valid_color = frame_intact();
+    time = k4a_image_get_system_timestamp_nsec(m_image_c);
+}
+
+///////// Function: getDepthEncoded ////////////////////////////////////////
+// Compress the depth frame row by row, as stored by the SDK, for recording
+// or transport. kz::codec_decode returns it in the Matlab layout.
+// You must call updateData first
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_depth_encoded(std::vector<uint8_t> &data, uint64_t& time, bool& valid_depth)
+{
+    valid_depth = false;
+    if (m_image_d) {
+        kz::codec_encode(k4a_image_get_buffer(m_image_d),
+                         k4a_image_get_width_pixels(m_image_d),
+                         k4a_image_get_height_pixels(m_image_d),
+                         k4a_image_get_stride_bytes(m_image_d),
+                         kz::CODEC_ROW_MAJOR, data);
+        valid_depth = frame_intact();
+        time = k4a_image_get_system_timestamp_nsec(m_image_d);
+    }
+} // end getDepthEncoded
+
+///////// Function: getInfraredEncoded /////////////////////////////////////
+// Compress the infrared frame, see get_depth_encoded
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_infrared_encoded(std::vector<uint8_t> &data, uint64_t& time, bool& valid_infrared)
+{
+    valid_infrared = false;
+    if (m_image_ir) {
+        kz::codec_encode(k4a_image_get_buffer(m_image_ir),
+                         k4a_image_get_width_pixels(m_image_ir),
+                         k4a_image_get_height_pixels(m_image_ir),
+                         k4a_image_get_stride_bytes(m_image_ir),
+                         kz::CODEC_ROW_MAJOR, data);
+        valid_infrared = frame_intact();
+        time = k4a_image_get_system_timestamp_nsec(m_image_ir);
+    }
+} // end getInfraredEncoded
+
 bool KinZ::align_depth_to_color(int width, int height, k4a_image_t &transformed_depth_image){
+    kz::Reprojector *engine = m_native_reprojection ? reprojector() : NULL;
+    if (engine && width == engine->color_width() && height == engine->color_height()) {
+        // The image wraps m_aligned_depth, releasing it does not free it
+        m_aligned_depth.resize((size_t)width * height);
+        if (K4A_RESULT_SUCCEEDED != k4a_image_create_from_buffer(K4A_IMAGE_FORMAT_DEPTH16,
+                width, height, width * (int)sizeof(uint16_t), (uint8_t *)m_aligned_depth.data(),
+                m_aligned_depth.size() * sizeof(uint16_t), NULL, NULL, &transformed_depth_image)) {
+            KZ_LOG(kz::LOG_ERROR, "Failed to create aligned depth to color image\n");
+            return false;
+        }
+        engine->depth_to_color(k4a_image_get_buffer(m_image_d), k4a_image_get_stride_bytes(m_image_d),
+                               m_aligned_depth.data(), width * (int)sizeof(uint16_t), m_pool);
+        return true;
+    }
+
     if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16,
                                                 width, height, width * (int)sizeof(uint16_t),
                                                 &transformed_depth_image)) {
-        mexPrintf("Failed to create aligned depth to color image\n");
+        KZ_LOG(kz::LOG_ERROR, "Failed to create aligned depth to color image\n");
         return false;
     }
 
     if (K4A_RESULT_SUCCEEDED != k4a_transformation_depth_image_to_color_camera(m_transformation,
                                                                             m_image_d,
                                                                             transformed_depth_image)) {
-        mexPrintf("Failed to compute aligned depth to color image\n");
+        KZ_LOG(kz::LOG_ERROR, "Failed to compute aligned depth to color image\n");
         return false;
     }
 
@@ -580,11 +1461,27 @@ bool KinZ::align_depth_to_color(int width, int height, k4a_image_t &transformed_
 }
 
 bool KinZ::align_color_to_depth(int width, int height, k4a_image_t &transformed_color_image ){
+    kz::Reprojector *engine = m_native_reprojection ? reprojector() : NULL;
+    if (engine && depth_rays().size() == (size_t)width * height * 2) {
+        m_aligned_color.resize((size_t)width * height * 4);
+        if (K4A_RESULT_SUCCEEDED != k4a_image_create_from_buffer(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+                width, height, width * 4, m_aligned_color.data(), m_aligned_color.size(),
+                NULL, NULL, &transformed_color_image)) {
+            KZ_LOG(kz::LOG_ERROR, "Failed to create aligned color to depth image\n");
+            return false;
+        }
+        engine->color_to_depth(k4a_image_get_buffer(m_image_d), k4a_image_get_stride_bytes(m_image_d),
+                               m_depth_rays.data(), k4a_image_get_buffer(m_image_c),
+                               k4a_image_get_stride_bytes(m_image_c),
+                               m_aligned_color.data(), width * 4, m_pool);
+        return true;
+    }
+
     //k4a_image_t transformed_color_image = NULL;
     if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32,
                                                  width, height, width * 4 * (int)sizeof(uint8_t),
                                                  &transformed_color_image)) {
-        mexPrintf("Failed to create aligned color to depth image\n");
+        KZ_LOG(kz::LOG_ERROR, "Failed to create aligned color to depth image\n");
         return false;
     }
 
@@ -592,17 +1489,452 @@ bool KinZ::align_color_to_depth(int width, int height, k4a_image_t &transformed_
                                                                                m_image_d,
                                                                                m_image_c,
                                                                                transformed_color_image)) {
-        mexPrintf("Failed to compute color to depth image\n");
+        KZ_LOG(kz::LOG_ERROR, "Failed to compute color to depth image\n");
         return false;
     }
 
     return true;
 }
 
+///////// Function: reprojector //////////////////////////////////////////
+// Engine of the native reprojection, configured from m_calibration on
+// first use. NULL when the calibration does not allow it (synthetic
+// sources of a KinZ_server).
+///////////////////////////////////////////////////////////////////////////
+kz::Reprojector *KinZ::reprojector()
+{
+    if (!m_reprojector) {
+        m_reprojector.reset(new kz::Reprojector);
+        if (!m_reprojector->configure(m_calibration, m_pool))
+            KZ_LOG(kz::LOG_WARNING, "No calibration for the native reprojection, using the SDK\n");
+    }
+    return m_reprojector->configured() ? m_reprojector.get() : NULL;
+}
+
+///////// Function: depthUndistorter //////////////////////////////////////
+// Remap tables of the undistorted depth (nearest) and infrared (bilinear),
+// built from m_calibration on first use. NULL without a depth calibration.
+///////////////////////////////////////////////////////////////////////////
+kz::Undistorter *KinZ::depth_undistorter()
+{
+    if (!m_depth_undistorter) {
+        m_depth_undistorter.reset(new kz::Undistorter);
+        m_depth_undistorter->configure(m_calibration, K4A_CALIBRATION_TYPE_DEPTH,
+                                       kz::Undistorter::NEAREST | kz::Undistorter::BILINEAR,
+                                       m_pool);
+    }
+    return m_depth_undistorter->configured() ? m_depth_undistorter.get() : NULL;
+}
+
+///////// Function: colorUndistorter //////////////////////////////////////
+// Remap table of the undistorted color, 6 bytes per color pixel
+///////////////////////////////////////////////////////////////////////////
+kz::Undistorter *KinZ::color_undistorter()
+{
+    if (!m_color_undistorter) {
+        m_color_undistorter.reset(new kz::Undistorter);
+        m_color_undistorter->configure(m_calibration, K4A_CALIBRATION_TYPE_COLOR,
+                                       kz::Undistorter::BILINEAR, m_pool);
+    }
+    return m_color_undistorter->configured() ? m_color_undistorter.get() : NULL;
+}
+
+///////// Function: validateReprojection //////////////////////////////////
+// Run the SDK transformation and the native engine on the last frames and
+// compare them against the tolerance documented in KinZ_reproject.h
+///////////////////////////////////////////////////////////////////////////
+bool KinZ::validate_reprojection(kz::ReprojectionReport &report)
+{
+    typedef std::chrono::steady_clock Clock;
+    report = kz::ReprojectionReport();
+    kz::Reprojector *engine = reprojector();
+    if (!m_image_d || !m_image_c || !m_transformation || !engine)
+        return false;
+
+    int dw = k4a_image_get_width_pixels(m_image_d);
+    int dh = k4a_image_get_height_pixels(m_image_d);
+    int cw = k4a_image_get_width_pixels(m_image_c);
+    int ch = k4a_image_get_height_pixels(m_image_c);
+    if (cw != engine->color_width() || ch != engine->color_height() ||
+        depth_rays().size() != (size_t)dw * dh * 2)
+        return false;
+
+    k4a_image_t sdk_depth = NULL, sdk_color = NULL;
+    if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16, cw, ch,
+                                                 cw * (int)sizeof(uint16_t), &sdk_depth) ||
+        K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32, dw, dh,
+                                                 dw * 4, &sdk_color)) {
+        if (sdk_depth)
+            k4a_image_release(sdk_depth);
+        return false;
+    }
+
+    // Depth to color
+    Clock::time_point start = Clock::now();
+    bool ok = K4A_RESULT_SUCCEEDED ==
+              k4a_transformation_depth_image_to_color_camera(m_transformation, m_image_d, sdk_depth);
+    report.depth_sdk_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::vector<uint16_t> native_depth((size_t)cw * ch);
+    start = Clock::now();
+    engine->depth_to_color(k4a_image_get_buffer(m_image_d), k4a_image_get_stride_bytes(m_image_d),
+                           native_depth.data(), cw * (int)sizeof(uint16_t), m_pool);
+    report.depth_native_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if (ok) {
+        std::vector<float> diffs;
+        uint64_t within = 0;
+        const uint8_t *sdk = k4a_image_get_buffer(sdk_depth);
+        int sdk_stride = k4a_image_get_stride_bytes(sdk_depth);
+        for (int y = 0; y < ch; y++) {
+            const uint16_t *a = (const uint16_t *)(sdk + (size_t)y * sdk_stride);
+            const uint16_t *b = &native_depth[(size_t)y * cw];
+            for (int x = 0; x < cw; x++) {
+                if (a[x] && b[x]) {
+                    float d = std::fabs((float)a[x] - (float)b[x]);
+                    diffs.push_back(d);
+                    if (d <= std::max(kz::REPROJECTION_DEPTH_MIN_MM,
+                                      kz::REPROJECTION_DEPTH_TOLERANCE * a[x]))
+                        within++;
+                }
+                else if (a[x])
+                    report.depth_sdk_only++;
+                else if (b[x])
+                    report.depth_native_only++;
+            }
+        }
+        report.depth_common = diffs.size();
+        if (!diffs.empty()) {
+            double sum = 0;
+            for (size_t i = 0; i < diffs.size(); i++)
+                sum += diffs[i];
+            report.depth_mean_abs_mm = sum / diffs.size();
+            size_t k = std::min(diffs.size() - 1, (size_t)(0.99 * diffs.size()));
+            std::nth_element(diffs.begin(), diffs.begin() + k, diffs.end());
+            report.depth_p99_abs_mm = diffs[k];
+            report.depth_agreement = (double)within / diffs.size();
+        }
+    }
+
+    // Color to depth
+    start = Clock::now();
+    ok = K4A_RESULT_SUCCEEDED == k4a_transformation_color_image_to_depth_camera(m_transformation,
+                                                                  m_image_d, m_image_c, sdk_color);
+    report.color_sdk_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::vector<uint8_t> native_color((size_t)dw * dh * 4);
+    start = Clock::now();
+    engine->color_to_depth(k4a_image_get_buffer(m_image_d), k4a_image_get_stride_bytes(m_image_d),
+                           m_depth_rays.data(), k4a_image_get_buffer(m_image_c),
+                           k4a_image_get_stride_bytes(m_image_c), native_color.data(), dw * 4, m_pool);
+    report.color_native_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if (ok) {
+        uint64_t within = 0;
+        double sum = 0;
+        const uint8_t *sdk = k4a_image_get_buffer(sdk_color);
+        int sdk_stride = k4a_image_get_stride_bytes(sdk_color);
+        for (int y = 0; y < dh; y++) {
+            const uint8_t *a = sdk + (size_t)y * sdk_stride;
+            const uint8_t *b = &native_color[(size_t)y * dw * 4];
+            for (int x = 0; x < dw; x++, a += 4, b += 4) {
+                // Pixels without color are fully transparent
+                if (!a[3] || !b[3])
+                    continue;
+                report.color_common++;
+                int worst = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = std::abs((int)a[c] - (int)b[c]);
+                    sum += d;
+                    worst = std::max(worst, d);
+                }
+                if (worst <= kz::REPROJECTION_COLOR_TOLERANCE)
+                    within++;
+            }
+        }
+        if (report.color_common) {
+            report.color_mean_abs = sum / (3.0 * report.color_common);
+            report.color_agreement = (double)within / report.color_common;
+        }
+    }
+
+    k4a_image_release(sdk_depth);
+    k4a_image_release(sdk_color);
+
+    report.pass = report.depth_common > 0 && report.color_common > 0 &&
+                  report.depth_agreement >= kz::REPROJECTION_MIN_AGREEMENT &&
+                  report.color_agreement >= kz::REPROJECTION_MIN_AGREEMENT;
+    return true;
+}
+
+///////// Function: setThreads ///////////////////////////////////////////
+// Set the number of threads used for the conversions (0 = one per core).
+// Worker threads are pinned to the given cpus when the list is not empty.
+// Returns false, keeping the current threads, while the pool is busy.
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::set_threads(unsigned num_threads, const std::vector<int> &cpus)
+{
+    return m_pool.resize(num_threads, cpus);
+}
+
+///////// Function: setDepthFilter ///////////////////////////////////////
+// Configure the depth filters applied after each capture.
+// Resets the temporal history and the timing statistics.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::set_depth_filter(const kz::DepthFilterConfig &config)
+{
+    m_depth_filter.configure(config);
+    m_depth_filter.reset();
+}
+
+void KinZ::get_depth_filter_times(kz::DepthFilterTimes &last, kz::DepthFilterTimes &mean,
+                                  uint64_t &frames)
+{
+    last = m_depth_filter.last_times();
+    mean = m_depth_filter.mean_times();
+    frames = m_depth_filter.frames();
+}
+
+///////// Function: setBackground ////////////////////////////////////////
+// Configure the background model and forget the learned background
+//////////////////////////////////////////////////////////////////////////
+void KinZ::set_background(const kz::BackgroundConfig &config)
+{
+    m_background.configure(config);
+    reset_background();
+}
+
+void KinZ::reset_background()
+{
+    m_background.reset();
+    m_background_buffer = nullptr;
+}
+
+///////// Function: filterDepth //////////////////////////////////////////
+// Replace m_image_d by a filtered copy. The buffer of the capture or of
+// the server slot is only read, so the body tracker and the frames
+// pinned before keep the raw depth. Keeps the raw depth if the copy
+// cannot be allocated.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::filter_depth()
+{
+    if (!m_image_d || !m_depth_filter.enabled())
+        return;
+
+    int width = k4a_image_get_width_pixels(m_image_d);
+    int height = k4a_image_get_height_pixels(m_image_d);
+    k4a_image_t filtered = NULL;
+    if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16, width, height,
+                                                 width * (int)sizeof(uint16_t), &filtered)) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to create the filtered depth image\n");
+        return;
+    }
+    m_depth_filter.apply(k4a_image_get_buffer(m_image_d), k4a_image_get_stride_bytes(m_image_d),
+                         k4a_image_get_buffer(filtered), width, height,
+                         k4a_image_get_stride_bytes(filtered), m_pool);
+    k4a_image_set_device_timestamp_usec(filtered, k4a_image_get_device_timestamp_usec(m_image_d));
+    k4a_image_set_system_timestamp_nsec(filtered, k4a_image_get_system_timestamp_nsec(m_image_d));
+    k4a_image_release(m_image_d);
+    m_image_d = filtered;
+}
+
+///////// Function: updateBackground /////////////////////////////////////
+// Learn the depth of a new frame, after the depth filters
+//////////////////////////////////////////////////////////////////////////
+void KinZ::update_background()
+{
+    if (!m_image_d || !m_background.enabled())
+        return;
+    m_background.update(k4a_image_get_buffer(m_image_d),
+                        k4a_image_get_width_pixels(m_image_d),
+                        k4a_image_get_height_pixels(m_image_d),
+                        k4a_image_get_stride_bytes(m_image_d), m_pool);
+    m_background_buffer = k4a_image_get_buffer(m_image_d);
+    m_background_time = k4a_image_get_device_timestamp_usec(m_image_d);
+}
+
+///////// Function: foregroundMask ///////////////////////////////////////
+// Mask of the depth of the frame, in the order of the image: the one of
+// the last update, or a pinned frame classified into scratch. NULL
+// without depth or background model.
+//////////////////////////////////////////////////////////////////////////
+const uint8_t *KinZ::foreground_mask(std::vector<uint8_t> &scratch)
+{
+    if (!m_image_d || !m_background.enabled() || m_background.frames() == 0)
+        return NULL;
+    const uint8_t *depth = k4a_image_get_buffer(m_image_d);
+    if (depth == m_background_buffer &&
+        k4a_image_get_device_timestamp_usec(m_image_d) == m_background_time)
+        return m_background.mask().data();
+
+    int w = k4a_image_get_width_pixels(m_image_d);
+    int h = k4a_image_get_height_pixels(m_image_d);
+    scratch.resize((size_t)w * h);
+    if (!m_background.classify(depth, w, h, k4a_image_get_stride_bytes(m_image_d),
+                               scratch.data(), m_pool))
+        return NULL;
+    return scratch.data();
+}
+
+///////// Function: getForeground ////////////////////////////////////////
+// Foreground mask of the frame transposed to the Matlab layout
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_foreground(uint8_t mask[], uint64_t& time, bool& valid_data)
+{
+    valid_data = false;
+    std::vector<uint8_t> scratch;
+    const uint8_t *src = foreground_mask(scratch);
+    if (!src)
+        return;
+
+    int w = m_background.width();
+    int h = m_background.height();
+    kz::parallel_columns(m_pool, w, [&](int x0, int x1) {
+        for (int x = x0; x < x1; x++)
+            for (int y = 0; y < h; y++)
+                mask[(size_t)x * h + y] = src[(size_t)y * w + x];
+    });
+    time = k4a_image_get_system_timestamp_nsec(m_image_d);
+    valid_data = frame_intact();
+}
+
+void KinZ::get_background(float mean[], float deviation[], uint64_t &frames, bool &valid_data)
+{
+    frames = m_background.frames();
+    valid_data = m_background.enabled() && frames > 0;
+    if (valid_data)
+        m_background.get_model(mean, deviation, m_pool);
+}
+
+///////// Function: getFrameStats ////////////////////////////////////////
+// Frame accounting since the last reset
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_frame_stats(kz::FrameStats &stats)
+{
+    stats = m_frame_stats;
+}
+
+///////// Function: resetFrameStats //////////////////////////////////////
+// Restart the frame accounting. The expected frame period comes from the
+// configured camera frame rate.
+//////////////////////////////////////////////////////////////////////////
+void KinZ::reset_frame_stats()
+{
+    m_frame_stats = kz::FrameStats();
+    switch (m_config.camera_fps) {
+        case K4A_FRAMES_PER_SECOND_5:  m_frame_stats.period_usec = 200000; break;
+        case K4A_FRAMES_PER_SECOND_15: m_frame_stats.period_usec = 66667; break;
+        case K4A_FRAMES_PER_SECOND_30: m_frame_stats.period_usec = 33333; break;
+    }
+}
+
 void KinZ::get_calibration(k4a_calibration_t &calibration) {
     calibration = m_calibration;
 }
 
+void KinZ::get_image_sizes(int &depth_width, int &depth_height, int &color_width, int &color_height)
+{
+    depth_width = m_calibration.depth_camera_calibration.resolution_width;
+    depth_height = m_calibration.depth_camera_calibration.resolution_height;
+    color_width = m_calibration.color_camera_calibration.resolution_width;
+    color_height = m_calibration.color_camera_calibration.resolution_height;
+}
+
+///////// Function: setDepth ////////////////////////////////////////////
+// Depth image of the frame from a (height x width) Matlab array
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::set_depth(const uint16_t *depth, int width, int height)
+{
+    if (width != m_calibration.depth_camera_calibration.resolution_width ||
+        height != m_calibration.depth_camera_calibration.resolution_height || width <= 0)
+        return false;
+
+    k4a_image_t image = NULL;
+    if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16, width, height,
+                                                 width * (int)sizeof(uint16_t), &image)) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to create depth image\n");
+        return false;
+    }
+    uint8_t *buffer = k4a_image_get_buffer(image);
+    int stride = k4a_image_get_stride_bytes(image);
+    kz::parallel_columns(m_pool, width, [&](int x0, int x1) {
+        kz::matlab_to_u16(depth, width, height, buffer, stride, x0, x1);
+    });
+
+    if (m_image_d)
+        k4a_image_release(m_image_d);
+    m_image_d = image;
+    update_background();
+    return true;
+} // end setDepth
+
+///////// Function: setColor ////////////////////////////////////////////
+// Color image of the frame from a (height x width x 3) RGB Matlab array
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::set_color(const uint8_t *rgb, int width, int height)
+{
+    if (width != m_calibration.color_camera_calibration.resolution_width ||
+        height != m_calibration.color_camera_calibration.resolution_height || width <= 0)
+        return false;
+
+    k4a_image_t image = NULL;
+    if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32, width, height,
+                                                 width * 4, &image)) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to create color image\n");
+        return false;
+    }
+    uint8_t *buffer = k4a_image_get_buffer(image);
+    int stride = k4a_image_get_stride_bytes(image);
+    kz::parallel_columns(m_pool, width, [&](int x0, int x1) {
+        kz::matlab_to_bgra(rgb, width, height, buffer, stride, x0, x1);
+    });
+
+    if (m_image_c)
+        k4a_image_release(m_image_c);
+    m_image_c = image;
+    return true;
+} // end setColor
+
+bool KinZ::batch_pointcloud(const uint16_t *depth, int width, int height, int n, float *xyz)
+{
+    if (width != m_calibration.depth_camera_calibration.resolution_width ||
+        height != m_calibration.depth_camera_calibration.resolution_height ||
+        depth_rays().size() != (size_t)width * height * 2)
+        return false;
+    kz::batch_pointcloud(depth, width, height, n, m_depth_rays.data(), xyz, m_pool);
+    return true;
+}
+
+bool KinZ::batch_depth_aligned(const uint16_t *depth, int width, int height, int n,
+                               uint16_t *aligned)
+{
+    if (width != m_calibration.depth_camera_calibration.resolution_width ||
+        height != m_calibration.depth_camera_calibration.resolution_height)
+        return false;
+    kz::Reprojector *engine = reprojector();
+    if (!engine)
+        return false;
+    kz::batch_depth_to_color(*engine, depth, width, height, n, aligned, m_pool);
+    return true;
+}
+
+bool KinZ::batch_undistort_depth(const uint16_t *depth, int width, int height, int n,
+                                 uint16_t *out)
+{
+    kz::Undistorter *undistorter = depth_undistorter();
+    if (!undistorter || width != undistorter->width() || height != undistorter->height())
+        return false;
+    kz::batch_undistort(*undistorter, depth, n, out, m_pool);
+    return true;
+}
+
+void KinZ::get_images(k4a_image_t &depth, k4a_image_t &color, k4a_image_t &infrared)
+{
+    depth = m_image_d;
+    color = m_image_c;
+    infrared = m_image_ir;
+}
+
 /** Transforms the depth image into 3 planar images representing X, Y and Z-coordinates of corresponding 3d points.
 * Throws error on failure.
 *
@@ -613,7 +1945,7 @@ bool KinZ::depth_image_to_point_cloud(int width, int height, k4a_image_t &xyz_im
                                                  width, height,
                                                  width * 3 * (int)sizeof(int16_t),
                                                  &xyz_image)) {
-        printf("Failed to create transformed xyz image\n");
+        KZ_LOG(kz::LOG_ERROR, "Failed to create transformed xyz image\n");
         return false;
     }
 
@@ -624,80 +1956,537 @@ bool KinZ::depth_image_to_point_cloud(int width, int height, k4a_image_t &xyz_im
                                                       xyz_image);
 
     if (K4A_RESULT_SUCCEEDED != result) {
-        printf("Failed to transform depth image to point cloud!");
+        KZ_LOG(kz::LOG_ERROR, "Failed to transform depth image to point cloud!");
         return false;
     }
     return true;
 }
 
+///////// Function: buildRays ////////////////////////////////////////////
+// Unit-depth ray (x, y) of each pixel of a camera, NaN where the pixel
+// does not unproject. A 3D point is (x*z, y*z, z) in that camera.
+///////////////////////////////////////////////////////////////////////////
+static void build_rays(const k4a_calibration_t &calibration, k4a_calibration_type_t camera,
+                       int w, int h, std::vector<float> &rays, kz::ThreadPool &pool)
+{
+    rays.resize((size_t)w * h * 2);
+    kz::parallel_rows(pool, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++)
+            for (int x = 0; x < w; x++) {
+                size_t i = (size_t)y * w + x;
+                k4a_float2_t p;
+                k4a_float3_t ray;
+                int valid = 0;
+                p.xy.x = (float)x;
+                p.xy.y = (float)y;
+                k4a_calibration_2d_to_3d(&calibration, &p, 1.f, camera, camera, &ray, &valid);
+                rays[2 * i] = valid ? ray.xyz.x : NAN;
+                rays[2 * i + 1] = valid ? ray.xyz.y : NAN;
+            }
+    });
+}
+
+///////// Function: depthRays ///////////////////////////////////////////
+// Rays of the depth camera, see build_rays. Built on first use.
+///////////////////////////////////////////////////////////////////////////
+const std::vector<float> &KinZ::depth_rays()
+{
+    int w = m_calibration.depth_camera_calibration.resolution_width;
+    int h = m_calibration.depth_camera_calibration.resolution_height;
+    if (m_depth_rays.size() != (size_t)w * h * 2)
+        build_rays(m_calibration, K4A_CALIBRATION_TYPE_DEPTH, w, h, m_depth_rays, m_pool);
+    return m_depth_rays;
+}
+
+///////// Function: colorRays ///////////////////////////////////////////
+// Rays of the color camera, see build_rays. Built on first use; 8 bytes
+// per color pixel (66 MB at 2160p).
+///////////////////////////////////////////////////////////////////////////
+const std::vector<float> &KinZ::color_rays()
+{
+    int w = m_calibration.color_camera_calibration.resolution_width;
+    int h = m_calibration.color_camera_calibration.resolution_height;
+    if (m_color_rays.size() != (size_t)w * h * 2)
+        build_rays(m_calibration, K4A_CALIBRATION_TYPE_COLOR, w, h, m_color_rays, m_pool);
+    return m_color_rays;
+}
+
 ///////// Function: getPointCloud ///////////////////////////////////////////
-// Get camera points from depth frame and copy them to Matlab matrix
+// Get camera points from the region roi of the depth frame and copy them
+// to Matlab matrix. Points are ordered row by row of the region.
+// With normals, also estimate the normal of each point from its grid
+// neighbors normal_radius pixels away, or step pixels if larger (see
+// kz::organized_normals).
 // You must call updateData first and have depth activated
 ///////////////////////////////////////////////////////////////////////////
 void KinZ::get_pointcloud(double pointcloud[], unsigned char colors[], 
-                         bool color, bool& valid_data)
+                         bool color, bool& valid_data, const kz::Region &region,
+                         double normals[], int normal_radius, float max_depth_change)
 {   
     valid_data = false; 
     if(m_image_d) {
-        k4a_image_t point_cloud_image = NULL;
+        int w = k4a_image_get_width_pixels(m_image_d);
+        int h = k4a_image_get_height_pixels(m_image_d);
+        int stride = k4a_image_get_stride_bytes(m_image_d);
+        const uint8_t *depth_data = k4a_image_get_buffer(m_image_d);
+
+        kz::Region roi = region;
+        if (!roi.clip(w, h))
+            return;
+
+        const float *rays = depth_rays().data();
+        if (m_depth_rays.size() != (size_t)w * h * 2) {
+            KZ_LOG(kz::LOG_ERROR, "Error getting Pointcloud\n");
+            return;
+        }
+
+        // if the user want color, get the color image same size as depth image
         k4a_image_t color_image = NULL;
         bool valid_color_transform = false;
+        if(color)
+            valid_color_transform = align_color_to_depth(w, h, color_image);
+        const uint8_t *color_image_data = valid_color_transform ? k4a_image_get_buffer(color_image) : NULL;
+        int color_stride = valid_color_transform ? k4a_image_get_stride_bytes(color_image) : 0;
+
+        int out_w = roi.out_width();
+        size_t numPoints = (size_t)out_w * roi.out_height();
+
+        // Only the pixels of the region are unprojected
+        kz::parallel_rows(m_pool, roi.out_height(), [&](int y0, int y1) {
+            for (int oy = y0; oy < y1; oy++) {
+                int y = roi.y + oy * roi.step;
+                const uint16_t *depth_row = (const uint16_t *)(depth_data + (size_t)y * stride);
+                for (int ox = 0; ox < out_w; ox++) {
+                    int x = roi.x + ox * roi.step;
+                    size_t i = (size_t)oy * out_w + ox;
+                    size_t r = 2 * ((size_t)y * w + x);
+                    float z = depth_row[x];
+
+                    if (z > 0 && !std::isnan(rays[r])) {
+                        pointcloud[i] = std::floor(rays[r] * z + 0.5f);
+                        pointcloud[i + numPoints] = std::floor(rays[r + 1] * z + 0.5f);
+                        pointcloud[i + 2 * numPoints] = z;
+                    }
+                    else {
+                        pointcloud[i] = 0;
+                        pointcloud[i + numPoints] = 0;
+                        pointcloud[i + 2 * numPoints] = 0;
+                    }
 
-        // Get the point cloud
-        if(depth_image_to_point_cloud(k4a_image_get_width_pixels(m_image_d),
-            k4a_image_get_height_pixels(m_image_d), point_cloud_image)) {
-
-            // if the user want color
-            if(color) {
-                // get the color image same size as depth image
-                int depth_image_width_pixels = k4a_image_get_width_pixels(m_image_d);
-                int depth_image_height_pixels = k4a_image_get_height_pixels(m_image_d);
-                valid_color_transform = align_color_to_depth(depth_image_width_pixels, 
-                                                             depth_image_height_pixels,
-                                                             color_image);
+                    if (color_image_data) {
+                        const uint8_t *bgra = color_image_data + (size_t)y * color_stride + 4 * x;
+                        colors[i] = bgra[2];
+                        colors[i + numPoints] = bgra[1];
+                        colors[i + 2 * numPoints] = bgra[0];
+                    }
+                }
             }
+            if (normals)
+                kz::organized_normals(depth_data, stride, rays, w, h, roi,
+                                      std::max(normal_radius, roi.step), max_depth_change,
+                                      normals, y0, y1);
+        });
+
+        if (color_image)
+            k4a_image_release(color_image);
+        valid_data = frame_intact();
+    }
+}
 
-            int width = k4a_image_get_width_pixels(point_cloud_image);
-            int height = k4a_image_get_height_pixels(point_cloud_image);
-            int numDepthPoints = width * height;
+///////// Function: mapPixels /////////////////////////////////////////////
+// Depth pixels take the depth of their nearest pixel and are unprojected,
+// then projected in the color camera. Color pixels are found in the depth
+// image along their epipolar line by the SDK
+// (k4a_calibration_color_2d_to_depth_2d), and the depth point there is
+// moved to the color camera. Points are split in blocks on m_pool.
+///////////////////////////////////////////////////////////////////////////
+bool KinZ::map_pixels(k4a_calibration_type_t camera, const double *pixels, size_t n,
+                      double *points, double *other, uint8_t *valid)
+{
+    if (!m_image_d)
+        return false;
+    const int w = k4a_image_get_width_pixels(m_image_d);
+    const int h = k4a_image_get_height_pixels(m_image_d);
+    const int stride = k4a_image_get_stride_bytes(m_image_d);
+    const uint8_t *depth = k4a_image_get_buffer(m_image_d);
+    const int cw = m_calibration.color_camera_calibration.resolution_width;
+    const int ch = m_calibration.color_camera_calibration.resolution_height;
+    const bool has_color = cw > 0;
+
+    // Finite and rounding to a pixel of a width x height image, checked
+    // before any conversion to int
+    auto inside = [](double x, double y, int width, int height) {
+        return std::isfinite(x) && std::isfinite(y) && x >= -0.5 && x < width - 0.5 &&
+               y >= -0.5 && y < height - 0.5;
+    };
+
+    kz::parallel_rows(m_pool, (int)n, [&](int i0, int i1) {
+        for (size_t i = i0; i < (size_t)i1; i++) {
+            points[i] = points[i + n] = points[i + 2 * n] = NAN;
+            other[i] = other[i + n] = NAN;
+            valid[i] = 0;
+
+            bool is_color = camera == K4A_CALIBRATION_TYPE_COLOR;
+            if (!inside(pixels[i], pixels[i + n], is_color ? cw : w, is_color ? ch : h))
+                continue;
+
+            k4a_float2_t p, d;
+            p.xy.x = (float)pixels[i];
+            p.xy.y = (float)pixels[i + n];
+            int ok = 0;
+            if (is_color) {
+                if (!has_color || K4A_RESULT_SUCCEEDED != k4a_calibration_color_2d_to_depth_2d(
+                        &m_calibration, &p, m_image_d, &d, &ok) || !ok ||
+                    !inside(d.xy.x, d.xy.y, w, h))
+                    continue;
+            }
+            else
+                d = p;
+
+            int x = (int)std::floor(d.xy.x + 0.5f);
+            int y = (int)std::floor(d.xy.y + 0.5f);
+            if (x < 0 || x >= w || y < 0 || y >= h)
+                continue;   // float rounding at the last pixel
+            float z = ((const uint16_t *)(depth + (size_t)y * stride))[x];
+            k4a_float3_t q;
+            if (z == 0 || K4A_RESULT_SUCCEEDED != k4a_calibration_2d_to_3d(&m_calibration, &d, z,
+                    K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH, &q, &ok) || !ok)
+                continue;
+
+            if (is_color) {
+                k4a_float3_t c;
+                k4a_calibration_3d_to_3d(&m_calibration, &q, K4A_CALIBRATION_TYPE_DEPTH,
+                                         K4A_CALIBRATION_TYPE_COLOR, &c);
+                q = c;
+                other[i] = d.xy.x;
+                other[i + n] = d.xy.y;
+            }
+            else if (has_color) {
+                k4a_float2_t c;
+                if (K4A_RESULT_SUCCEEDED == k4a_calibration_3d_to_2d(&m_calibration, &q,
+                        K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_COLOR, &c, &ok) && ok) {
+                    other[i] = c.xy.x;
+                    other[i + n] = c.xy.y;
+                }
+            }
+            points[i] = q.xyz.x;
+            points[i + n] = q.xyz.y;
+            points[i + 2 * n] = q.xyz.z;
+            valid[i] = 1;
+        }
+    }, 64);
+    return frame_intact();
+} // end mapPixels
+
+///////// Function: getPointCloudColor //////////////////////////////////////
+// Point cloud in the color camera geometry: the depth is transformed to the
+// color camera and the pixels of the region roi (step only) of the color
+// image are unprojected with the color rays, each with its own color.
+// Coordinates are in mm in the color camera frame.
+// Rows are split in bands. With compact, a first pass counts the valid
+// points of each band so the second pass writes them, still row by row,
+// directly into the arrays of allocate; otherwise every pixel of the
+// region gives a point, 0 when invalid.
+// You must call updateData first and have depth and color activated
+///////////////////////////////////////////////////////////////////////////
+void KinZ::get_pointcloud_color(const kz::Region &region, bool compact,
+                                const kz::PointCloudAllocator &allocate, bool &valid_data)
+{
+    valid_data = false;
+    if (!m_image_d || !m_image_c)
+        return;
 
-            int16_t *point_cloud_image_data = (int16_t *)(void *)k4a_image_get_buffer(point_cloud_image);
-            uint8_t *color_image_data = k4a_image_get_buffer(color_image);
+    int w = k4a_image_get_width_pixels(m_image_c);
+    int h = k4a_image_get_height_pixels(m_image_c);
+    kz::Region roi = region;
+    if (!roi.clip(w, h))
+        return;
 
-            for (int i = 0; i < numDepthPoints; i++) {
-                int16_t X, Y, Z;  
-                X = point_cloud_image_data[3 * i + 0];
-                Y = point_cloud_image_data[3 * i + 1];
-                Z = point_cloud_image_data[3 * i + 2];
+    const float *rays = color_rays().data();
+    if (m_color_rays.size() != (size_t)w * h * 2)
+        return;
 
-                pointcloud[i] = X;
-                pointcloud[i + numDepthPoints] = Y;
-                pointcloud[i + numDepthPoints + numDepthPoints] = Z;
+    k4a_image_t depth_image = NULL;
+    if (!align_depth_to_color(w, h, depth_image)) {
+        if (depth_image)
+            k4a_image_release(depth_image);
+        return;
+    }
+    const uint8_t *depth_data = k4a_image_get_buffer(depth_image);
+    int depth_stride = k4a_image_get_stride_bytes(depth_image);
+    const uint8_t *color_data = k4a_image_get_buffer(m_image_c);
+    int color_stride = k4a_image_get_stride_bytes(m_image_c);
+
+    int out_w = roi.out_width();
+    int out_h = roi.out_height();
+    int num_bands = std::min(out_h, (int)m_pool.size() * 4);
+    int band_height = (out_h + num_bands - 1) / num_bands;
+
+    auto valid_point = [&](int x, int y) {
+        uint16_t z = ((const uint16_t *)(depth_data + (size_t)y * depth_stride))[x];
+        return z > 0 && !std::isnan(rays[2 * ((size_t)y * w + x)]);
+    };
+
+    // First pass: valid points of each band
+    std::vector<size_t> offsets(num_bands + 1, 0);
+    if (compact) {
+        m_pool.parallel_for(num_bands, [&](int b) {
+            size_t count = 0;
+            for (int oy = b * band_height; oy < std::min(out_h, (b + 1) * band_height); oy++) {
+                int y = roi.y + oy * roi.step;
+                for (int ox = 0; ox < out_w; ox++)
+                    count += valid_point(roi.x + ox * roi.step, y);
+            }
+            offsets[b + 1] = count;
+        });
+        for (int b = 0; b < num_bands; b++)
+            offsets[b + 1] += offsets[b];
+    }
+    size_t num_points = compact ? offsets[num_bands] : (size_t)out_w * out_h;
+
+    double *xyz = NULL;
+    uint8_t *rgb = NULL;
+    allocate(num_points, xyz, rgb);
+
+    // Second pass: unproject
+    if (num_points > 0)
+        m_pool.parallel_for(num_bands, [&](int b) {
+            size_t i = compact ? offsets[b] : (size_t)b * band_height * out_w;
+            for (int oy = b * band_height; oy < std::min(out_h, (b + 1) * band_height); oy++) {
+                int y = roi.y + oy * roi.step;
+                const uint16_t *depth_row = (const uint16_t *)(depth_data + (size_t)y * depth_stride);
+                const uint8_t *color_row = color_data + (size_t)y * color_stride;
+                for (int ox = 0; ox < out_w; ox++) {
+                    int x = roi.x + ox * roi.step;
+                    bool valid = valid_point(x, y);
+                    if (compact && !valid)
+                        continue;
+
+                    const float *ray = rays + 2 * ((size_t)y * w + x);
+                    float z = valid ? depth_row[x] : 0;
+                    // mm rounded like the other point clouds
+                    xyz[i] = valid ? std::floor(ray[0] * z + 0.5f) : 0;
+                    xyz[i + num_points] = valid ? std::floor(ray[1] * z + 0.5f) : 0;
+                    xyz[i + 2 * num_points] = z;
+                    if (rgb) {
+                        const uint8_t *bgra = color_row + 4 * x;
+                        rgb[i] = bgra[2];
+                        rgb[i + num_points] = bgra[1];
+                        rgb[i + 2 * num_points] = bgra[0];
+                    }
+                    i++;
+                }
+            }
+        });
 
-                if(color && valid_color_transform) {
-                    uint8_t R, G, B;
-                    B = color_image_data[4 * i + 0];
-                    G = color_image_data[4 * i + 1];
-                    R = color_image_data[4 * i + 2];
+    k4a_image_release(depth_image);
+    valid_data = frame_intact();
+} // end getPointCloudColor
 
-                    colors[i] = R;
-                    colors[i + numDepthPoints] = G;
-                    colors[i + numDepthPoints + numDepthPoints] = B;
+///////// Function: getForegroundPointCloud /////////////////////////////
+// Compact point cloud of the foreground pixels of the region roi, in the
+// depth camera frame. Like get_pointcloud_color, a first pass counts the
+// points of each band and the second one writes them row by row directly
+// into the arrays of allocate.
+///////////////////////////////////////////////////////////////////////////
+void KinZ::get_foreground_pointcloud(const kz::Region &region, bool color,
+                                     const kz::PointCloudAllocator &allocate, bool &valid_data)
+{
+    valid_data = false;
+    std::vector<uint8_t> scratch;
+    const uint8_t *mask = foreground_mask(scratch);
+    if (!mask)
+        return;
+
+    int w = k4a_image_get_width_pixels(m_image_d);
+    int h = k4a_image_get_height_pixels(m_image_d);
+    int stride = k4a_image_get_stride_bytes(m_image_d);
+    const uint8_t *depth_data = k4a_image_get_buffer(m_image_d);
+    kz::Region roi = region;
+    if (!roi.clip(w, h))
+        return;
+
+    const float *rays = depth_rays().data();
+    if (m_depth_rays.size() != (size_t)w * h * 2)
+        return;
+
+    k4a_image_t color_image = NULL;
+    if (color && !align_color_to_depth(w, h, color_image))
+        color_image = NULL;
+    const uint8_t *color_data = color_image ? k4a_image_get_buffer(color_image) : NULL;
+    int color_stride = color_image ? k4a_image_get_stride_bytes(color_image) : 0;
+
+    int out_w = roi.out_width();
+    int out_h = roi.out_height();
+    int num_bands = std::min(out_h, (int)m_pool.size() * 4);
+    int band_height = (out_h + num_bands - 1) / num_bands;
+
+    auto valid_point = [&](int x, int y) {
+        size_t i = (size_t)y * w + x;
+        return mask[i] && !std::isnan(rays[2 * i]);
+    };
+
+    // First pass: foreground points of each band
+    std::vector<size_t> offsets(num_bands + 1, 0);
+    m_pool.parallel_for(num_bands, [&](int b) {
+        size_t count = 0;
+        for (int oy = b * band_height; oy < std::min(out_h, (b + 1) * band_height); oy++) {
+            int y = roi.y + oy * roi.step;
+            for (int ox = 0; ox < out_w; ox++)
+                count += valid_point(roi.x + ox * roi.step, y);
+        }
+        offsets[b + 1] = count;
+    });
+    for (int b = 0; b < num_bands; b++)
+        offsets[b + 1] += offsets[b];
+    size_t num_points = offsets[num_bands];
+
+    double *xyz = NULL;
+    uint8_t *rgb = NULL;
+    allocate(num_points, xyz, rgb);
+    if (!color_data)
+        rgb = NULL;
+
+    // Second pass: unproject
+    if (num_points > 0)
+        m_pool.parallel_for(num_bands, [&](int b) {
+            size_t i = offsets[b];
+            for (int oy = b * band_height; oy < std::min(out_h, (b + 1) * band_height); oy++) {
+                int y = roi.y + oy * roi.step;
+                const uint16_t *depth_row = (const uint16_t *)(depth_data + (size_t)y * stride);
+                for (int ox = 0; ox < out_w; ox++) {
+                    int x = roi.x + ox * roi.step;
+                    if (!valid_point(x, y))
+                        continue;
+
+                    const float *ray = rays + 2 * ((size_t)y * w + x);
+                    float z = depth_row[x];
+                    xyz[i] = std::floor(ray[0] * z + 0.5f);
+                    xyz[i + num_points] = std::floor(ray[1] * z + 0.5f);
+                    xyz[i + 2 * num_points] = z;
+                    if (rgb) {
+                        const uint8_t *bgra = color_data + (size_t)y * color_stride + 4 * x;
+                        rgb[i] = bgra[2];
+                        rgb[i + num_points] = bgra[1];
+                        rgb[i + 2 * num_points] = bgra[0];
+                    }
+                    i++;
+                }
+            }
+        });
+
+    if (color_image)
+        k4a_image_release(color_image);
+    valid_data = frame_intact();
+} // end getForegroundPointCloud
+
+void KinZ::get_sensor_data(Imu_sample &imu_data) {
+    imu_data = m_imu_data;
+}
+
+///////// Function: savePointCloud ////////////////////////////////////////
+// Unproject the depth frame, with the aligned color if requested, into a
+// job of the cloud writer. Formatting and writing the file happen on the
+// writer thread.
+// You must call updateData first and have depth activated
+///////////////////////////////////////////////////////////////////////////
+bool KinZ::save_pointcloud(const char *path, bool color, bool compact, bool &queued)
+{
+    queued = false;
+    kz::CloudFormat format;
+    if (!kz::cloud_format(path, format)) {
+        KZ_LOG(kz::LOG_ERROR, "Unknown point cloud format of %s, use .ply or .pcd", path);
+        return false;
+    }
+    if (!m_image_d)
+        return false;
+
+    int w = k4a_image_get_width_pixels(m_image_d);
+    int h = k4a_image_get_height_pixels(m_image_d);
+    int stride = k4a_image_get_stride_bytes(m_image_d);
+    const uint8_t *depth_data = k4a_image_get_buffer(m_image_d);
+    const float *rays = depth_rays().data();
+    if (m_depth_rays.size() != (size_t)w * h * 2)
+        return false;
+
+    if (!m_cloud_writer)
+        m_cloud_writer.reset(new kz::CloudWriter);
+    kz::CloudJob *job = m_cloud_writer->acquire();
+    if (!job)
+        return true;    // dropped, counted by the writer
+
+    k4a_image_t color_image = NULL;
+    if (color && !align_color_to_depth(w, h, color_image))
+        color_image = NULL;
+    const uint8_t *color_data = color_image ? k4a_image_get_buffer(color_image) : NULL;
+    int color_stride = color_image ? k4a_image_get_stride_bytes(color_image) : 0;
+
+    job->path = path;
+    job->format = format;
+    job->color = color_data != NULL;
+    job->compact = compact;
+    job->width = w;
+    job->height = h;
+    job->xyz.resize((size_t)w * h * 3);
+    if (job->color)
+        job->rgb.resize((size_t)w * h * 3);
+
+    kz::parallel_rows(m_pool, h, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const uint16_t *depth_row = (const uint16_t *)(depth_data + (size_t)y * stride);
+            float *xyz = &job->xyz[(size_t)y * w * 3];
+            const float *ray = rays + (size_t)y * w * 2;
+            for (int x = 0; x < w; x++, xyz += 3, ray += 2) {
+                float z = depth_row[x];
+                if (z > 0 && !std::isnan(ray[0])) {
+                    xyz[0] = ray[0] * z;
+                    xyz[1] = ray[1] * z;
+                    xyz[2] = z;
+                }
+                else
+                    xyz[0] = xyz[1] = xyz[2] = 0;
+            }
+            if (color_data) {
+                const uint8_t *bgra = color_data + (size_t)y * color_stride;
+                uint8_t *rgb = &job->rgb[(size_t)y * w * 3];
+                for (int x = 0; x < w; x++, bgra += 4, rgb += 3) {
+                    rgb[0] = bgra[2];
+                    rgb[1] = bgra[1];
+                    rgb[2] = bgra[0];
                 }
             }
-            valid_data = true;
-        } 
-        else {
-            pointcloud[0] = 0;
-            pointcloud[1] = 0;
-            pointcloud[2] = 0;
-            mexPrintf("Error getting Pointcloud\n");
         }
+    });
+
+    if (color_image)
+        k4a_image_release(color_image);
+
+    if (!frame_intact()) {
+        m_cloud_writer->release(job);
+        return false;
     }
+    m_cloud_writer->submit(job);
+    queued = true;
+    return true;
+} // end savePointCloud
+
+void KinZ::set_cloud_writer(int queue_size, bool block)
+{
+    if (!m_cloud_writer)
+        m_cloud_writer.reset(new kz::CloudWriter);
+    m_cloud_writer->configure(queue_size, block);
 }
 
-void KinZ::get_sensor_data(Imu_sample &imu_data) {
-    imu_data = m_imu_data;
+void KinZ::get_cloud_writer_stats(kz::CloudWriterStats &stats)
+{
+    stats = m_cloud_writer ? m_cloud_writer->stats() : kz::CloudWriterStats();
+}
+
+// Wait until the queued clouds were written
+void KinZ::flush_clouds()
+{
+    if (m_cloud_writer)
+        m_cloud_writer->flush();
 }
 
 #ifdef BODY 
@@ -716,19 +2505,25 @@ void KinZ::get_body_index_map(bool returnId, uint8_t bodyIndex[],
         int w = k4a_image_get_width_pixels(m_body_index);
         int h = k4a_image_get_height_pixels(m_body_index);
         int stride = k4a_image_get_stride_bytes(m_body_index);
-        uint8_t* dataBuffer = k4a_image_get_buffer(m_body_index);
-
-        if (returnId)
-            change_body_index_to_body_id(dataBuffer, w, h);
+        const uint8_t* dataBuffer = k4a_image_get_buffer(m_body_index);
+
+        // The image may be shared with a pinned frame and read again, so
+        // the ids are mapped while copying and the buffer is not changed
+        uint8_t map[256];
+        uint32_t num_bodies = returnId ? k4abt_frame_get_num_bodies(m_body_frame) : 0;
+        for (uint32_t i = 0; i < 256; i++) {
+            if (!returnId)
+                map[i] = (uint8_t)i;
+            else if (i < num_bodies)
+                map[i] = (uint8_t)k4abt_frame_get_body_id(m_body_frame, i);
+            else
+                map[i] = (uint8_t)K4ABT_INVALID_BODY_ID;
+        }
 
         // Copy body index frame to output matrix
-        int col_size = w;
         for (int x=0, k=0; x<w; x++)
-            for (int y=0; y<h; y++,k++) {
-                int idx = y * col_size + x;
-
-                bodyIndex[k] = dataBuffer[idx];
-            }
+            for (int y=0; y<h; y++,k++)
+                bodyIndex[k] = map[dataBuffer[(size_t)y * stride + x]];
 
         valid_data = true;
         time = k4a_image_get_system_timestamp_nsec(m_body_index);
@@ -737,18 +2532,69 @@ void KinZ::get_body_index_map(bool returnId, uint8_t bodyIndex[],
         valid_data = false;
 } // end getDepth
 
-void KinZ::change_body_index_to_body_id(uint8_t* image_data, int width, int height) {
-    for(int i=0; i < width*height; i++) {
-        uint8_t index = *image_data;
+///////// Function: setTrackerConfig ////////////////////////////////////
+// Store the tracker options and restart the tracker if it is running.
+// The current body frame is released.
+//////////////////////////////////////////////////////////////////////////
+bool KinZ::set_tracker_config(const kz::TrackerConfig &config)
+{
+    m_tracker_config = config;
+    if (m_tracker == NULL)
+        return true;
+
+    if (m_body_index) {
+        k4a_image_release(m_body_index);
+        m_body_index = NULL;
+    }
+    if (m_body_frame) {
+        k4abt_frame_release(m_body_frame);
+        m_body_frame = NULL;
+    }
+    m_num_bodies = 0;
+    k4abt_tracker_shutdown(m_tracker);
+    k4abt_tracker_destroy(m_tracker);
+    m_tracker = NULL;
+
+    m_body_tracking_available = k4abt_tracker_create(&m_calibration,
+        kz::tracker_configuration(m_tracker_config), &m_tracker) == K4A_RESULT_SUCCEEDED;
+    if (!m_body_tracking_available) {
+        KZ_LOG(kz::LOG_ERROR, "Failed to restart the body tracker with the new options\n");
+        m_tracker = NULL;
+        return false;
+    }
+    k4abt_tracker_set_temporal_smoothing(m_tracker, m_tracker_config.smoothing);
+    return true;
+} // end setTrackerConfig
 
-        uint32_t body_id = k4abt_frame_get_body_id	(m_body_frame, (uint32_t)index);
-        *image_data = (uint8_t)body_id;
-        image_data++;
+///////// Function: getBodies ///////////////////////////////////////////
+// Pack the skeletons of the current body frame, including the projection
+// of each joint to the color and depth images.
+// You must call updateData first
+//////////////////////////////////////////////////////////////////////////
+void KinZ::get_bodies(std::vector<kz::Body> &bodies)
+{
+    bodies.clear();
+    if (m_shm) {
+        // Packed by the KinZ_server
+        const kz::ShmFrameInfo &info = m_shm_frame->info;
+        if (m_shm_frame->sequence && (info.streams & kz::SHM_BODIES))
+            bodies.assign(info.bodies, info.bodies + std::min<uint32_t>(info.num_bodies, kz::SHM_MAX_BODIES));
+        return;
     }
-}
+    if (m_body_frame == NULL)
+        return;
+
+    uint32_t num_bodies = k4abt_frame_get_num_bodies(m_body_frame);
+    bodies.reserve(num_bodies);
 
- void KinZ::get_bodies(k4abt_frame_t &body_frame, k4a_calibration_t &calibration) {
-     body_frame = m_body_frame;
-     calibration = m_calibration;
- }
+    for (uint32_t i = 0; i < num_bodies; i++) {
+        k4abt_skeleton_t skeleton;
+        if (k4abt_frame_get_body_skeleton(m_body_frame, i, &skeleton) != K4A_RESULT_SUCCEEDED)
+            continue;
+
+        kz::Body body;
+        kz::pack_body(skeleton, k4abt_frame_get_body_id(m_body_frame, i), m_calibration, body);
+        bodies.push_back(body);
+    }
+} // end getBodies
  #endif
\ No newline at end of file
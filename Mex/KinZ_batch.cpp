@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_batch.cpp
+///
+///		Description:
+///			Batch geometry of depth stacks, see KinZ_batch.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_batch.h"
+#include "KinZ_kernels.h"
+#include "KinZ_reproject.h"
+#include "KinZ_undistort.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace kz
+{
+
+namespace
+{
+// Run fn(worker, frame) for the n frames on min(n, pool size) workers,
+// each taking the next frame when it is done with one
+template <typename Fn>
+void for_each_frame(ThreadPool &pool, int n, Fn fn)
+{
+    std::atomic<int> next(0);
+    int workers = std::min((int)pool.size(), n);
+    pool.parallel_for(workers, [&](int worker) {
+        for (int f = next++; f < n; f = next++)
+            fn(worker, f);
+    });
+}
+} // namespace
+
+void batch_pointcloud(const uint16_t *depth, int w, int h, int n, const float *rays,
+                      float *xyz, ThreadPool &pool)
+{
+    const size_t num_pix = (size_t)w * h;
+    for_each_frame(pool, n, [&](int, int f) {
+        const uint16_t *frame = depth + num_pix * f;
+        float *x_out = xyz + 3 * num_pix * f;
+        float *y_out = x_out + num_pix;
+        float *z_out = y_out + num_pix;
+        // Rows of the output, read across the columns of the frame
+        for (int y = 0; y < h; y++) {
+            const float *ray = rays + 2 * (size_t)y * w;
+            size_t i = (size_t)y * w;
+            for (int x = 0; x < w; x++, i++, ray += 2) {
+                float z = frame[(size_t)x * h + y];
+                if (z > 0 && !std::isnan(ray[0])) {
+                    x_out[i] = std::floor(ray[0] * z + 0.5f);
+                    y_out[i] = std::floor(ray[1] * z + 0.5f);
+                    z_out[i] = z;
+                }
+                else
+                    x_out[i] = y_out[i] = z_out[i] = 0;
+            }
+        }
+    });
+}
+
+///////// Function: batchDepthToColor /////////////////////////////////////
+// Each worker has a copy of the configured reprojector, whose footprint
+// buffers are per frame, and runs it on a single thread
+///////////////////////////////////////////////////////////////////////////
+void batch_depth_to_color(const Reprojector &reprojector, const uint16_t *depth,
+                          int w, int h, int n, uint16_t *aligned, ThreadPool &pool)
+{
+    const int cw = reprojector.color_width();
+    const int ch = reprojector.color_height();
+    const size_t num_pix = (size_t)w * h;
+    const size_t num_color = (size_t)cw * ch;
+
+    struct Worker {
+        Worker(const Reprojector &r, size_t depth_bytes, size_t color_pixels)
+            : reprojector(r), serial(1), depth(depth_bytes), color(color_pixels) {}
+        Reprojector reprojector;
+        ThreadPool serial;
+        std::vector<uint8_t> depth;
+        std::vector<uint16_t> color;
+    };
+    std::vector<std::unique_ptr<Worker> > workers(std::min((int)pool.size(), n));
+    const Region color_roi(cw, ch);
+
+    for_each_frame(pool, n, [&](int i, int f) {
+        if (!workers[i]) {
+            workers[i].reset(new Worker(reprojector, 2 * num_pix, num_color));
+        }
+        Worker &wk = *workers[i];
+        matlab_to_u16(depth + num_pix * f, w, h, wk.depth.data(), 2 * w, 0, w);
+        wk.reprojector.depth_to_color(wk.depth.data(), 2 * w, wk.color.data(), 2 * cw, wk.serial);
+        u16_to_matlab((const uint8_t *)wk.color.data(), 2 * cw, color_roi,
+                      aligned + num_color * f, 0, cw);
+    });
+} // end batchDepthToColor
+
+void batch_undistort(const Undistorter &undistorter, const uint16_t *depth, int n,
+                     uint16_t *out, ThreadPool &pool)
+{
+    const int h = undistorter.height();
+    const size_t num_pix = (size_t)undistorter.width() * h;
+    for_each_frame(pool, n, [&](int, int f) {
+        undistorter.nearest_u16((const uint8_t *)(depth + num_pix * f), 2, 2 * (size_t)h,
+                                out + num_pix * f, 0, undistorter.width());
+    });
+}
+
+} // namespace kz
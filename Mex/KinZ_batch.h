@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_batch.h
+///
+///		Description:
+///			Geometry of stacks of stored depth images, e.g. a recording,
+///         without a capture. Stacks are Matlab arrays of n images,
+///         (h x w x n) column major, and the frames are processed in
+///         parallel, each worker taking the next frame with its own
+///         buffers; the outputs are stacked in the same order.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_BATCH_H__
+#define __KINZ_BATCH_H__
+#include <stdint.h>
+#include "thread_pool.hpp"
+
+namespace kz
+{
+    class Reprojector;
+    class Undistorter;
+
+    // Point clouds of the depth images: a (w*h x 3 x n) array of xyz in
+    // mm, the points of each frame ordered row by row as in
+    // KinZ::get_pointcloud, 0 without depth. rays are the unit-depth rays
+    // of the depth camera (see KinZ::depth_rays).
+    void batch_pointcloud(const uint16_t *depth, int w, int h, int n, const float *rays,
+                          float *xyz, ThreadPool &pool);
+
+    // Depth images aligned to the color camera with the native
+    // reprojection: a (color height x color width x n) array
+    void batch_depth_to_color(const Reprojector &reprojector, const uint16_t *depth,
+                              int w, int h, int n, uint16_t *aligned, ThreadPool &pool);
+
+    // Undistorted depth images, nearest neighbor
+    void batch_undistort(const Undistorter &undistorter, const uint16_t *depth, int n,
+                         uint16_t *out, ThreadPool &pool);
+}
+
+#endif // __KINZ_BATCH_H__
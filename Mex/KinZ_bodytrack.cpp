@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_bodytrack.cpp
+///
+///		Description:
+///			Tracker configuration, skeleton packing and batch tracking of
+///         recordings.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_bodytrack.h"
+#include <algorithm>
+#include <chrono>
+
+#ifdef BODY
+#include <k4arecord/playback.h>
+#endif
+
+namespace kz
+{
+
+uint32_t TrackedRecording::max_bodies() const
+{
+    size_t n = 0;
+    for (size_t i = 0; i < bodies.size(); i++)
+        n = std::max(n, bodies[i].size());
+    return (uint32_t)n;
+}
+
+#ifdef BODY
+///////// Function: trackerConfiguration //////////////////////////////////
+k4abt_tracker_configuration_t tracker_configuration(const TrackerConfig &config)
+{
+    k4abt_tracker_configuration_t c = K4ABT_TRACKER_CONFIG_DEFAULT;
+    c.processing_mode = (k4abt_tracker_processing_mode_t)config.processing_mode;
+    c.sensor_orientation = (k4abt_sensor_orientation_t)config.sensor_orientation;
+    c.gpu_device_id = config.gpu_device_id;
+    if (!config.model_path.empty())
+        c.model_path = config.model_path.c_str();
+    else if (config.lite_model)
+        c.model_path = TRACKER_LITE_MODEL;
+    return c;
+} // end trackerConfiguration
+
+///////// Function: packBody //////////////////////////////////////////////
+// 2D positions are -1 when the joint does not project into the image
+///////////////////////////////////////////////////////////////////////////
+void pack_body(const k4abt_skeleton_t &skeleton, uint32_t id,
+               const k4a_calibration_t &calibration, Body &body)
+{
+    body.id = id;
+    for (int j = 0; j < NUM_JOINTS; j++) {
+        const k4abt_joint_t &joint = skeleton.joints[j];
+        for (int c = 0; c < 3; c++)
+            body.position3d[j][c] = joint.position.v[c];
+        for (int c = 0; c < 4; c++)
+            body.orientation[j][c] = joint.orientation.v[c];
+        body.confidence[j] = (uint32_t)joint.confidence_level;
+
+        // project the 3D coordinates to the color and depth cameras
+        k4a_float2_t color_coords, depth_coords;
+        int val;
+        if (k4a_calibration_3d_to_2d(&calibration, &joint.position,
+                                     K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_COLOR,
+                                     &color_coords, &val) == K4A_RESULT_SUCCEEDED) {
+            body.position2d_rgb[j][0] = (int32_t)color_coords.xy.x;
+            body.position2d_rgb[j][1] = (int32_t)color_coords.xy.y;
+        }
+        else {
+            body.position2d_rgb[j][0] = -1;
+            body.position2d_rgb[j][1] = -1;
+        }
+
+        if (k4a_calibration_3d_to_2d(&calibration, &joint.position,
+                                     K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH,
+                                     &depth_coords, &val) == K4A_RESULT_SUCCEEDED) {
+            body.position2d_depth[j][0] = (int32_t)depth_coords.xy.x;
+            body.position2d_depth[j][1] = (int32_t)depth_coords.xy.y;
+        }
+        else {
+            body.position2d_depth[j][0] = -1;
+            body.position2d_depth[j][1] = -1;
+        }
+    }
+} // end packBody
+
+///////// Function: trackRecording ////////////////////////////////////////
+// Captures are enqueued without waiting. When the queue is full, the
+// oldest result is popped (waiting for it) and the capture retried.
+// Ready results are also collected after every capture.
+///////////////////////////////////////////////////////////////////////////
+bool track_recording(const char *path, const TrackerConfig &config,
+                     TrackedRecording &result, std::string &error)
+{
+    result = TrackedRecording();
+    k4a_playback_t playback = NULL;
+    if (k4a_playback_open(path, &playback) != K4A_RESULT_SUCCEEDED) {
+        error = "Cannot open the recording";
+        return false;
+    }
+    k4a_calibration_t calibration;
+    if (k4a_playback_get_calibration(playback, &calibration) != K4A_RESULT_SUCCEEDED) {
+        k4a_playback_close(playback);
+        error = "The recording has no calibration";
+        return false;
+    }
+    k4abt_tracker_t tracker = NULL;
+    if (k4abt_tracker_create(&calibration, tracker_configuration(config), &tracker) != K4A_RESULT_SUCCEEDED) {
+        k4a_playback_close(playback);
+        error = "Failed to create the body tracker";
+        return false;
+    }
+    k4abt_tracker_set_temporal_smoothing(tracker, config.smoothing);
+
+    uint64_t in_flight = 0;
+    // Pop one result; false on timeout or when the tracker failed
+    auto pop = [&](int32_t timeout_ms) {
+        k4abt_frame_t frame = NULL;
+        if (k4abt_tracker_pop_result(tracker, &frame, timeout_ms) != K4A_WAIT_RESULT_SUCCEEDED)
+            return false;
+        in_flight--;
+        result.timestamps_usec.push_back(k4abt_frame_get_device_timestamp_usec(frame));
+        result.bodies.push_back(std::vector<Body>());
+        std::vector<Body> &bodies = result.bodies.back();
+        uint32_t num_bodies = k4abt_frame_get_num_bodies(frame);
+        bodies.reserve(num_bodies);
+        for (uint32_t i = 0; i < num_bodies; i++) {
+            k4abt_skeleton_t skeleton;
+            if (k4abt_frame_get_body_skeleton(frame, i, &skeleton) != K4A_RESULT_SUCCEEDED)
+                continue;
+            bodies.push_back(Body());
+            pack_body(skeleton, k4abt_frame_get_body_id(frame, i), calibration, bodies.back());
+        }
+        k4abt_frame_release(frame);
+        return true;
+    };
+
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        k4a_capture_t capture = NULL;
+        k4a_stream_result_t read = k4a_playback_get_next_capture(playback, &capture);
+        if (read == K4A_STREAM_RESULT_EOF)
+            break;
+        if (read != K4A_STREAM_RESULT_SUCCEEDED) {
+            error = "Failed to read the recording";
+            ok = false;
+            break;
+        }
+        result.captures++;
+
+        k4a_image_t depth = k4a_capture_get_depth_image(capture);
+        k4a_image_t infrared = k4a_capture_get_ir_image(capture);
+        bool trackable = depth && infrared;
+        if (depth)
+            k4a_image_release(depth);
+        if (infrared)
+            k4a_image_release(infrared);
+
+        if (!trackable)
+            result.skipped++;
+        else {
+            for (;;) {
+                k4a_wait_result_t queued = k4abt_tracker_enqueue_capture(tracker, capture, 0);
+                if (queued == K4A_WAIT_RESULT_SUCCEEDED) {
+                    in_flight++;
+                    break;
+                }
+                if (queued == K4A_WAIT_RESULT_FAILED || !in_flight || !pop(K4A_WAIT_INFINITE)) {
+                    result.failed++;
+                    break;
+                }
+            }
+        }
+        k4a_capture_release(capture);
+
+        while (in_flight && pop(0)) {}
+    }
+
+    // The queued captures are still processed after the shutdown
+    k4abt_tracker_shutdown(tracker);
+    while (in_flight && pop(K4A_WAIT_INFINITE)) {}
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    k4abt_tracker_destroy(tracker);
+    k4a_playback_close(playback);
+    return ok;
+} // end trackRecording
+
+#else
+bool track_recording(const char *, const TrackerConfig &, TrackedRecording &result,
+                     std::string &error)
+{
+    result = TrackedRecording();
+    error = "KinZ was compiled without body tracking (USE_BODY = false)";
+    return false;
+}
+#endif
+
+} // namespace kz
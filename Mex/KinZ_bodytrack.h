@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_bodytrack.h
+///
+///		Description:
+///			Body tracker options and offline tracking of recordings.
+///         track_recording reads a recording with k4arecord and feeds it
+///         to its own tracker as fast as the tracker accepts captures:
+///         the input queue is kept full and results are popped whenever
+///         a capture does not fit, so the GPU (or CPU) never waits for
+///         the file. It does not need a device, so it runs on machines
+///         without a Kinect, e.g. in CPU processing mode.
+///
+///         Body tracking needs the BODY build; without it track_recording
+///         only reports the error.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_BODYTRACK_H__
+#define __KINZ_BODYTRACK_H__
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "KinZ.h"
+
+namespace kz
+{
+    // Lite network installed with the Body Tracking SDK
+    const char *const TRACKER_LITE_MODEL = "dnn_model_2_0_lite_op11.onnx";
+
+    // Skeletons of a recording tracked by track_recording
+    struct TrackedRecording {
+        std::vector<uint64_t> timestamps_usec;      // device timestamp of each frame
+        std::vector<std::vector<Body> > bodies;     // bodies of each frame
+        uint64_t captures = 0;      // captures read from the file
+        uint64_t skipped = 0;       // captures without depth or infrared
+        uint64_t failed = 0;        // captures rejected by the tracker
+        double seconds = 0;         // wall time from the first capture
+
+        double fps() const { return seconds > 0 ? timestamps_usec.size() / seconds : 0; }
+        uint32_t max_bodies() const;
+    };
+
+    #ifdef BODY
+    // SDK configuration of config. model_path points into config.
+    k4abt_tracker_configuration_t tracker_configuration(const TrackerConfig &config);
+
+    // Pack a skeleton, projecting the joints to the color and depth images
+    void pack_body(const k4abt_skeleton_t &skeleton, uint32_t id,
+                   const k4a_calibration_t &calibration, Body &body);
+    #endif
+
+    // Track the bodies of every capture of the recording at path. Returns
+    // false and sets error when the file cannot be read or the tracker
+    // does not start.
+    bool track_recording(const char *path, const TrackerConfig &config,
+                         TrackedRecording &result, std::string &error);
+}
+
+#endif // __KINZ_BODYTRACK_H__
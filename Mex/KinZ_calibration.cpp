@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_calibration.cpp
+///
+///		Description:
+///			Cache of raw device calibrations, see KinZ_calibration.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_calibration.h"
+#include "KinZ_log.h"
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace kz
+{
+
+namespace
+{
+#if defined(_WIN32)
+const char SEPARATORS[] = "\\/";
+#else
+const char SEPARATORS[] = "/";
+#endif
+
+// Create path and its parents; existing directories are fine
+void make_directories(const std::string &path)
+{
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos < path.size() && std::string(SEPARATORS).find(path[pos]) == std::string::npos)
+            continue;
+        std::string dir = path.substr(0, pos);
+#if defined(_WIN32)
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+}
+
+inline bool ends_with(const std::string &s, const char *suffix)
+{
+    std::string t(suffix);
+    return s.size() >= t.size() && s.compare(s.size() - t.size(), t.size(), t) == 0;
+}
+}
+
+std::string calibration_cache_dir()
+{
+    const char *dir = getenv("KINZ_CALIBRATION_DIR");
+    if (dir && *dir)
+        return dir;
+#if defined(_WIN32)
+    const char *base = getenv("LOCALAPPDATA");
+    return std::string(base ? base : ".") + "\\KinZ";
+#else
+    const char *cache = getenv("XDG_CACHE_HOME");
+    if (cache && *cache)
+        return std::string(cache) + "/kinz";
+    const char *home = getenv("HOME");
+    return std::string(home ? home : ".") + "/.cache/kinz";
+#endif
+}
+
+std::string calibration_cache_path(const std::string &serial)
+{
+    if (serial.find_first_of(SEPARATORS) != std::string::npos || ends_with(serial, ".json"))
+        return serial;
+    return calibration_cache_dir() + SEPARATORS[0] + serial + ".json";
+}
+
+///////// Function: readDeviceCalibration /////////////////////////////////
+// Both buffers are queried for their size first
+///////////////////////////////////////////////////////////////////////////
+bool read_device_calibration(k4a_device_t device, std::string &serial, std::vector<char> &raw)
+{
+    size_t size = 0;
+    if (k4a_device_get_serialnum(device, NULL, &size) != K4A_BUFFER_RESULT_TOO_SMALL)
+        return false;
+    std::vector<char> number(size);
+    if (k4a_device_get_serialnum(device, number.data(), &size) != K4A_BUFFER_RESULT_SUCCEEDED)
+        return false;
+    serial.assign(number.data());
+
+    size = 0;
+    if (k4a_device_get_raw_calibration(device, NULL, &size) != K4A_BUFFER_RESULT_TOO_SMALL)
+        return false;
+    raw.resize(size);
+    return k4a_device_get_raw_calibration(device, (uint8_t *)raw.data(), &size) ==
+           K4A_BUFFER_RESULT_SUCCEEDED;
+} // end readDeviceCalibration
+
+bool save_raw_calibration(const std::string &path, const std::vector<char> &raw)
+{
+    std::vector<char> cached;
+    if (load_raw_calibration(path, cached) && cached == raw)
+        return true;
+
+    size_t slash = path.find_last_of(SEPARATORS);
+    if (slash != std::string::npos)
+        make_directories(path.substr(0, slash));
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) {
+        KZ_LOG(LOG_WARNING, "Cannot write the calibration cache %s", path.c_str());
+        return false;
+    }
+    // Without the terminating null
+    size_t size = raw.size() && raw.back() == 0 ? raw.size() - 1 : raw.size();
+    bool ok = fwrite(raw.data(), 1, size, f) == size;
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+// raw is null terminated, as k4a_calibration_get_from_raw expects
+bool load_raw_calibration(const std::string &path, std::vector<char> &raw)
+{
+    raw.clear();
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        raw.insert(raw.end(), buffer, buffer + n);
+    bool ok = !ferror(f) && !raw.empty();
+    fclose(f);
+    raw.push_back(0);
+    return ok;
+}
+
+} // namespace kz
@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_calibration.h
+///
+///		Description:
+///			Cache of the raw calibration of each device, the JSON blob
+///         returned by k4a_device_get_raw_calibration, in one file per
+///         serial number. KinZ writes it when it opens a device, and an
+///         offline KinZ builds the calibration and the transformation from
+///         it with k4a_calibration_get_from_raw, for any depth mode and
+///         color resolution, without the device.
+///
+///         The cache directory is $KINZ_CALIBRATION_DIR, or by default
+///         ~/.cache/kinz on Linux and %LOCALAPPDATA%\KinZ on Windows.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_CALIBRATION_H__
+#define __KINZ_CALIBRATION_H__
+#include <k4a/k4a.h>
+#include <string>
+#include <vector>
+
+namespace kz
+{
+    std::string calibration_cache_dir();
+
+    // File of the calibration of serial in the cache. A name containing a
+    // path separator or ending in .json is returned as is, so a copied
+    // calibration file can be used directly.
+    std::string calibration_cache_path(const std::string &serial);
+
+    // Serial number and raw calibration of an open device
+    bool read_device_calibration(k4a_device_t device, std::string &serial,
+                                 std::vector<char> &raw);
+
+    // Write raw to path, creating the cache directory, unless the file
+    // already holds the same calibration
+    bool save_raw_calibration(const std::string &path, const std::vector<char> &raw);
+    bool load_raw_calibration(const std::string &path, std::vector<char> &raw);
+}
+
+#endif // __KINZ_CALIBRATION_H__
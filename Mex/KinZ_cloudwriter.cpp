@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_cloudwriter.cpp
+///
+///		Description:
+///			Background PLY/PCD writer, see KinZ_cloudwriter.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_cloudwriter.h"
+#include "KinZ_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace kz
+{
+
+namespace
+{
+inline bool valid_point(const float *p)
+{
+    return p[2] > 0;
+}
+
+template <typename T>
+inline uint8_t *put(uint8_t *out, T value)
+{
+    memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+}
+
+// PLY: x y z as float and red green blue as uchar, one vertex after the
+// other. Invalid points of a non-compact cloud are NaN.
+void format_ply(CloudJob &job, size_t num_points, size_t num_valid)
+{
+    size_t count = job.compact ? num_valid : num_points;
+    char header[256];
+    int header_size = snprintf(header, sizeof(header),
+        "ply\nformat binary_little_endian 1.0\ncomment KinZ, units mm\n"
+        "element vertex %zu\nproperty float x\nproperty float y\nproperty float z\n%s"
+        "end_header\n", count,
+        job.color ? "property uchar red\nproperty uchar green\nproperty uchar blue\n" : "");
+
+    size_t point_size = job.color ? 15 : 12;
+    job.file.resize(header_size + count * point_size);
+    memcpy(job.file.data(), header, header_size);
+
+    uint8_t *out = job.file.data() + header_size;
+    for (size_t i = 0; i < num_points; i++) {
+        const float *p = &job.xyz[3 * i];
+        bool valid = valid_point(p);
+        if (job.compact && !valid)
+            continue;
+        for (int c = 0; c < 3; c++)
+            out = put(out, valid ? p[c] : NAN);
+        if (job.color) {
+            memcpy(out, &job.rgb[3 * i], 3);
+            out += 3;
+        }
+    }
+}
+
+// PCD: organized (width x height) unless compact. rgb is packed in a float
+// as 0x00RRGGBB, following PCL.
+void format_pcd(CloudJob &job, size_t num_points, size_t num_valid)
+{
+    size_t count = job.compact ? num_valid : num_points;
+    int width = job.compact ? (int)count : job.width;
+    int height = job.compact ? 1 : job.height;
+    char header[320];
+    int header_size = snprintf(header, sizeof(header),
+        "# .PCD v0.7 - KinZ, units mm\nVERSION 0.7\n"
+        "FIELDS x y z%s\nSIZE 4 4 4%s\nTYPE F F F%s\nCOUNT 1 1 1%s\n"
+        "WIDTH %d\nHEIGHT %d\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS %zu\nDATA binary\n",
+        job.color ? " rgb" : "", job.color ? " 4" : "", job.color ? " F" : "",
+        job.color ? " 1" : "", width, height, count);
+
+    size_t point_size = job.color ? 16 : 12;
+    job.file.resize(header_size + count * point_size);
+    memcpy(job.file.data(), header, header_size);
+
+    uint8_t *out = job.file.data() + header_size;
+    for (size_t i = 0; i < num_points; i++) {
+        const float *p = &job.xyz[3 * i];
+        bool valid = valid_point(p);
+        if (job.compact && !valid)
+            continue;
+        for (int c = 0; c < 3; c++)
+            out = put(out, valid ? p[c] : NAN);
+        if (job.color) {
+            const uint8_t *rgb = &job.rgb[3 * i];
+            out = put(out, ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2]);
+        }
+    }
+}
+} // namespace
+
+bool cloud_format(const std::string &path, CloudFormat &format)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "ply")
+        format = CLOUD_PLY;
+    else if (ext == "pcd")
+        format = CLOUD_PCD;
+    else
+        return false;
+    return true;
+}
+
+CloudWriter::CloudWriter()
+{
+    m_thread = std::thread([this] { run(); });
+}
+
+CloudWriter::~CloudWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    for (size_t i = 0; i < m_jobs.size(); i++)
+        delete m_jobs[i];
+}
+
+void CloudWriter::configure(int queue_size, bool block)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.queue_size = std::max(1, queue_size);
+    m_block = block;
+}
+
+CloudJob *CloudWriter::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto full = [this] { return (int)m_queue.size() + m_acquired >= m_stats.queue_size; };
+    if (full()) {
+        if (!m_block) {
+            m_stats.dropped++;
+            return nullptr;
+        }
+        auto start = std::chrono::steady_clock::now();
+        m_cv.wait(lock, [&] { return !full(); });
+        m_stats.waited++;
+        m_stats.wait_ms += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    CloudJob *job;
+    if (m_free.empty()) {
+        job = new CloudJob;
+        m_jobs.push_back(job);
+    }
+    else {
+        job = m_free.back();
+        m_free.pop_back();
+    }
+    m_acquired++;
+    return job;
+}
+
+void CloudWriter::submit(CloudJob *job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_acquired--;
+        m_queue.push_back(job);
+        m_stats.submitted++;
+        int pending = (int)m_queue.size() + (m_writing ? 1 : 0);
+        m_stats.max_pending = std::max(m_stats.max_pending, pending);
+    }
+    m_cv.notify_all();
+}
+
+void CloudWriter::release(CloudJob *job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_acquired--;
+        m_free.push_back(job);
+    }
+    m_cv.notify_all();
+}
+
+void CloudWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+}
+
+CloudWriterStats CloudWriter::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CloudWriterStats stats = m_stats;
+    stats.pending = (int)m_queue.size() + (m_writing ? 1 : 0);
+    return stats;
+}
+
+void CloudWriter::run()
+{
+    for (;;) {
+        CloudJob *job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            job = m_queue.front();
+            m_queue.pop_front();
+            m_writing = true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = write(*job);
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (ok) {
+                m_stats.written++;
+                m_stats.bytes += job->file.size();
+                m_write_ms_total += ms;
+                m_stats.write_ms_mean = m_write_ms_total / m_stats.written;
+            }
+            else
+                m_stats.failed++;
+            m_writing = false;
+            m_free.push_back(job);
+        }
+        m_cv.notify_all();
+    }
+}
+
+bool CloudWriter::write(CloudJob &job)
+{
+    size_t num_points = (size_t)job.width * job.height;
+    size_t num_valid = 0;
+    if (job.compact)
+        for (size_t i = 0; i < num_points; i++)
+            num_valid += valid_point(&job.xyz[3 * i]);
+
+    if (job.format == CLOUD_PLY)
+        format_ply(job, num_points, num_valid);
+    else
+        format_pcd(job, num_points, num_valid);
+
+    FILE *file = fopen(job.path.c_str(), "wb");
+    if (!file) {
+        KZ_LOG(LOG_ERROR, "Cannot create %s", job.path.c_str());
+        return false;
+    }
+    bool ok = fwrite(job.file.data(), 1, job.file.size(), file) == job.file.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        KZ_LOG(LOG_ERROR, "Failed to write %s", job.path.c_str());
+    return ok;
+}
+
+} // namespace kz
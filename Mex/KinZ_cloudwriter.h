@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_cloudwriter.h
+///
+///		Description:
+///			Writes point clouds to binary PLY or PCD files on a background
+///         thread, so saving a cloud does not block the capture loop.
+///         KinZ fills a CloudJob with the xyz (float, mm) and rgb of every
+///         depth pixel and submits it; the writer thread optionally
+///         compacts the valid points, formats the file and writes it.
+///
+///         The queue holds at most queue_size jobs. When it is full, a new
+///         cloud is either dropped or the caller waits for a free place;
+///         both are counted in CloudWriterStats. Job buffers are reused,
+///         so steady-state saving does not allocate.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_CLOUDWRITER_H__
+#define __KINZ_CLOUDWRITER_H__
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kz
+{
+    enum CloudFormat {
+        CLOUD_PLY = 0,
+        CLOUD_PCD = 1
+    };
+
+    // Format from the extension of path (.ply or .pcd). Returns false if
+    // the extension is not known.
+    bool cloud_format(const std::string &path, CloudFormat &format);
+
+    // A cloud to write. Points are stored row by row of the depth image,
+    // invalid points have z = 0.
+    struct CloudJob {
+        std::string path;
+        CloudFormat format = CLOUD_PLY;
+        bool color = false;         // rgb holds the color of every point
+        bool compact = false;       // write only the valid points
+        int width = 0, height = 0;
+        std::vector<float> xyz;     // width*height x 3, interleaved
+        std::vector<uint8_t> rgb;   // width*height x 3, interleaved
+        std::vector<uint8_t> file;  // formatted file, reused between jobs
+    };
+
+    struct CloudWriterStats {
+        uint64_t submitted = 0;     // clouds queued
+        uint64_t written = 0;
+        uint64_t failed = 0;        // write errors
+        uint64_t dropped = 0;       // queue full, cloud not saved
+        uint64_t waited = 0;        // queue full, caller waited
+        double wait_ms = 0;         // total time the caller waited
+        double write_ms_mean = 0;   // formatting + writing, per cloud
+        uint64_t bytes = 0;
+        int queue_size = 4;
+        int pending = 0;            // clouds queued or being written
+        int max_pending = 0;
+    };
+
+    class CloudWriter
+    {
+    public:
+        CloudWriter();
+        // Writes the pending clouds, then stops the thread
+        ~CloudWriter();
+
+        // block: wait for a free place instead of dropping when the queue
+        // is full
+        void configure(int queue_size, bool block);
+
+        // A job to fill and submit, or nullptr when the queue is full and
+        // clouds are dropped
+        CloudJob *acquire();
+        void submit(CloudJob *job);
+        // Give back a job that will not be submitted
+        void release(CloudJob *job);
+
+        // Wait until all the submitted clouds were written
+        void flush();
+
+        CloudWriterStats stats();
+
+    private:
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<CloudJob *> m_queue;     // submitted
+        std::vector<CloudJob *> m_free;
+        std::vector<CloudJob *> m_jobs;     // owned
+        int m_acquired = 0;                 // filled by the caller
+        bool m_writing = false;
+        bool m_stop = false;
+        bool m_block = false;
+        CloudWriterStats m_stats;
+        double m_write_ms_total = 0;
+
+        void run();
+        bool write(CloudJob &job);
+    };
+}
+
+#endif // __KINZ_CLOUDWRITER_H__
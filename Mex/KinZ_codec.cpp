@@ -0,0 +1,261 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_codec.cpp
+///
+///		Description:
+///			RVL lossless codec for 16-bit images, see KinZ_codec.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_codec.h"
+#include "KinZ_kernels.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KZ_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace kz
+{
+
+static_assert(sizeof(CodecHeader) == 32, "codec header must be 32 bytes");
+
+namespace
+{
+inline int lowest_bit(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return (int)i;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// First pixel of [p, end) that is not zero (zero = true) or that is zero
+// (zero = false). The SSE2 path tests 8 pixels at a time, which skips the
+// long runs of invalid depth and of valid pixels quickly.
+template <bool zero>
+inline const uint16_t *skip_run(const uint16_t *p, const uint16_t *end)
+{
+#ifdef KZ_SSE2
+    const __m128i zeros = _mm_setzero_si128();
+    for (; end - p >= 8; p += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(v, zeros));
+        if (!zero)
+            mask = ~mask & 0xFFFF;
+        if (mask != 0xFFFF)
+            return p + lowest_bit(~mask & 0xFFFF) / 2;
+    }
+#endif
+    while (p < end && (*p == 0) == zero)
+        p++;
+    return p;
+}
+
+class NibbleWriter
+{
+public:
+    explicit NibbleWriter(uint8_t *out) : m_out(out) {}
+
+    void put(uint32_t nibble)
+    {
+        m_word = (m_word << 4) | nibble;
+        if (++m_nibbles == 8)
+            flush();
+    }
+
+    void put_vle(uint32_t value)
+    {
+        while (value >= 8) {
+            put((value & 7) | 8);
+            value >>= 3;
+        }
+        put(value);
+    }
+
+    // Pad the last word and return the end of the output
+    uint8_t *finish()
+    {
+        if (m_nibbles) {
+            m_word <<= 4 * (8 - m_nibbles);
+            flush();
+        }
+        return m_out;
+    }
+
+private:
+    uint8_t *m_out;
+    uint32_t m_word = 0;
+    int m_nibbles = 0;
+
+    void flush()
+    {
+        memcpy(m_out, &m_word, 4);
+        m_out += 4;
+        m_word = 0;
+        m_nibbles = 0;
+    }
+};
+
+class NibbleReader
+{
+public:
+    NibbleReader(const uint8_t *in, const uint8_t *end) : m_in(in), m_end(end) {}
+
+    uint32_t get()
+    {
+        if (!m_nibbles) {
+            if (m_end - m_in < 4) {
+                m_bad = true;
+                return 0;
+            }
+            memcpy(&m_word, m_in, 4);
+            m_in += 4;
+            m_nibbles = 8;
+        }
+        uint32_t nibble = m_word >> 28;
+        m_word <<= 4;
+        m_nibbles--;
+        return nibble;
+    }
+
+    uint32_t get_vle()
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 32; shift += 3) {
+            uint32_t nibble = get();
+            value |= (nibble & 7) << shift;
+            if (!(nibble & 8))
+                return value;
+        }
+        m_bad = true;
+        return 0;
+    }
+
+    bool bad() const { return m_bad; }
+
+private:
+    const uint8_t *m_in, *m_end;
+    uint32_t m_word = 0;
+    int m_nibbles = 0;
+    bool m_bad = false;
+};
+
+// Append the pixels [p, end) to the stream. prev is the last non-zero
+// value, carried across calls so rows can be encoded one after the other.
+void encode_span(const uint16_t *p, const uint16_t *end, NibbleWriter &writer, int &prev)
+{
+    while (p < end) {
+        const uint16_t *q = skip_run<true>(p, end);
+        writer.put_vle((uint32_t)(q - p));
+        p = q;
+        q = skip_run<false>(p, end);
+        writer.put_vle((uint32_t)(q - p));
+        for (; p < q; p++) {
+            int delta = (int)*p - prev;
+            writer.put_vle(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            prev = *p;
+        }
+    }
+}
+} // namespace
+
+size_t codec_bound(size_t num_pixels)
+{
+    // A value takes at most 6 nibbles (17-bit zigzag delta) and each
+    // isolated value adds two run lengths of one nibble
+    return sizeof(CodecHeader) + 4 * num_pixels + 8;
+}
+
+void codec_encode(const uint8_t *src, int width, int height, int stride,
+                  CodecLayout layout, std::vector<uint8_t> &out)
+{
+    size_t num_pixels = (size_t)width * height;
+    out.resize(codec_bound(num_pixels));
+
+    NibbleWriter writer(out.data() + sizeof(CodecHeader));
+    int prev = 0;
+    if (layout == CODEC_COLUMN_MAJOR || stride == 2 * width) {
+        const uint16_t *p = (const uint16_t *)src;
+        encode_span(p, p + num_pixels, writer, prev);
+    }
+    else {
+        for (int y = 0; y < height; y++) {
+            const uint16_t *row = (const uint16_t *)(src + (size_t)y * stride);
+            encode_span(row, row + width, writer, prev);
+        }
+    }
+    uint8_t *end = writer.finish();
+
+    CodecHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CODEC_MAGIC;
+    header.version = CODEC_VERSION;
+    header.layout = (uint16_t)layout;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.payload = (uint32_t)(end - out.data() - sizeof(CodecHeader));
+    memcpy(out.data(), &header, sizeof(header));
+    out.resize(end - out.data());
+}
+
+bool codec_header(const uint8_t *src, size_t size, CodecHeader &header)
+{
+    if (size < sizeof(CodecHeader))
+        return false;
+    memcpy(&header, src, sizeof(header));
+    return header.magic == CODEC_MAGIC && header.version == CODEC_VERSION &&
+           header.layout <= CODEC_COLUMN_MAJOR &&
+           header.payload <= size - sizeof(CodecHeader);
+}
+
+bool codec_decode(const uint8_t *src, size_t size, uint16_t *dst)
+{
+    CodecHeader header;
+    if (!codec_header(src, size, header))
+        return false;
+
+    size_t num_pixels = (size_t)header.width * header.height;
+    std::vector<uint16_t> rows;
+    uint16_t *out = dst;
+    if (header.layout == CODEC_ROW_MAJOR) {
+        rows.resize(num_pixels);
+        out = rows.data();
+    }
+
+    const uint8_t *payload = src + sizeof(CodecHeader);
+    NibbleReader reader(payload, payload + header.payload);
+    uint16_t *p = out, *end = out + num_pixels;
+    int prev = 0;
+    while (p < end) {
+        uint32_t zeros = reader.get_vle();
+        if (zeros > (size_t)(end - p))
+            return false;
+        memset(p, 0, zeros * sizeof(uint16_t));
+        p += zeros;
+
+        uint32_t values = reader.get_vle();
+        if (values > (size_t)(end - p) || reader.bad())
+            return false;
+        for (uint16_t *q = p + values; p < q; p++) {
+            uint32_t code = reader.get_vle();
+            prev += (int)(code >> 1) ^ -(int)(code & 1);
+            *p = (uint16_t)prev;
+        }
+    }
+    if (reader.bad())
+        return false;
+
+    if (header.layout == CODEC_ROW_MAJOR)
+        u16_to_matlab((const uint8_t *)out, 2 * header.width,
+                      Region(header.width, header.height), dst, 0, header.width);
+    return true;
+}
+
+} // namespace kz
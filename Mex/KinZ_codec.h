@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_codec.h
+///
+///		Description:
+///			Lossless codec for 16-bit depth and infrared images, based on
+///         RVL (Wilson, "Fast Lossless Depth Image Compression", 2017).
+///         Pixels are scanned as runs of zeros followed by runs of
+///         non-zero values. Each run length, and the zigzag-coded
+///         difference of each non-zero value to the previous non-zero
+///         value, is written as a variable length code of 3-bit groups
+///         plus a continuation bit, packed in nibbles.
+///         Zero runs are the invalid depth pixels, so depth images with
+///         large holes compress the most. Infrared has no zeros and only
+///         benefits from the delta coding.
+///
+///         Encoded frame: CodecHeader followed by the payload, a sequence
+///         of 32-bit little-endian words filled from the high nibble.
+///         The pixels are stored in the order of the source: row by row
+///         for SDK images, column by column for Matlab arrays. decode()
+///         always returns the Matlab layout.
+///
+///         A frame is encoded by a single thread; batches of frames are
+///         encoded concurrently, one frame per task.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_CODEC_H__
+#define __KINZ_CODEC_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace kz
+{
+    const uint32_t CODEC_MAGIC = 0x56525A4B;   // "KZRV"
+    const uint16_t CODEC_VERSION = 1;
+
+    // Scan order of the stored pixels
+    enum CodecLayout {
+        CODEC_ROW_MAJOR = 0,        // SDK images
+        CODEC_COLUMN_MAJOR = 1      // Matlab arrays
+    };
+
+    struct CodecHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t layout;            // CodecLayout
+        uint32_t width;
+        uint32_t height;
+        uint32_t payload;           // bytes after the header
+        uint32_t reserved[3];
+    };
+
+    // Largest encoded size of a frame of num_pixels pixels
+    size_t codec_bound(size_t num_pixels);
+
+    // Encode a 16-bit image. For CODEC_ROW_MAJOR, src has height rows of
+    // stride bytes; for CODEC_COLUMN_MAJOR, src is a contiguous Matlab
+    // (height x width) array and stride is ignored.
+    // The encoded frame replaces the content of out.
+    void codec_encode(const uint8_t *src, int width, int height, int stride,
+                      CodecLayout layout, std::vector<uint8_t> &out);
+
+    // Read and check the header of an encoded frame of size bytes
+    bool codec_header(const uint8_t *src, size_t size, CodecHeader &header);
+
+    // Decode a frame into a Matlab (height x width) array of the size given
+    // by its header. Returns false if the data is corrupted.
+    bool codec_decode(const uint8_t *src, size_t size, uint16_t *dst);
+}
+
+#endif // __KINZ_CODEC_H__
@@ -0,0 +1,355 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_filters.cpp
+///
+///		Description:
+///			Depth filtering pipeline: temporal, spatial and hole filling.
+///         Every stage processes bands of rows in parallel and uses SSE2
+///         for the interior pixels when available. The SSE2 code rounds
+///         and divides like the scalar code, so the output does not
+///         depend on the instruction set.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_filters.h"
+#include "KinZ_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KZ_SSE2
+#endif
+
+namespace kz
+{
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+inline uint16_t *row_ptr(uint8_t *image, int stride, int y)
+{
+    return (uint16_t *)(image + (size_t)y * stride);
+}
+
+inline const uint16_t *row_ptr(const uint8_t *image, int stride, int y)
+{
+    return (const uint16_t *)(image + (size_t)y * stride);
+}
+
+#ifdef KZ_SSE2
+// Pack 4 int32 in [0, 65535] to 4 uint16 (SSE2 only has signed saturation)
+inline __m128i pack_u16(__m128i v)
+{
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    __m128i s = _mm_packs_epi32(_mm_sub_epi32(v, bias32), _mm_sub_epi32(v, bias32));
+    return _mm_xor_si128(s, bias16);
+}
+
+inline __m128 load4_u16(const uint16_t *p)
+{
+    __m128i v = _mm_loadl_epi64((const __m128i *)p);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+///////// temporal ////////////////////////////////////////////////////////
+inline uint16_t temporal_pixel(uint16_t d, float &s, float alpha, float delta)
+{
+    if (d == 0)
+        return 0;
+    float diff = (float)d - s;
+    if (s == 0.0f || std::fabs(diff) > delta)
+        s = (float)d;
+    else
+        s += alpha * diff;
+    return (uint16_t)(s + 0.5f);
+}
+
+void temporal_rows(const uint8_t *src, int src_stride, uint8_t *depth, int w, int stride,
+                   int y0, int y1, float *state, float alpha, float delta)
+{
+    for (int y = y0; y < y1; y++) {
+        const uint16_t *in = row_ptr(src, src_stride, y);
+        uint16_t *row = row_ptr(depth, stride, y);
+        float *s = state + (size_t)y * w;
+        int x = 0;
+    #ifdef KZ_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        const __m128 alpha_v = _mm_set1_ps(alpha);
+        const __m128 delta_v = _mm_set1_ps(delta);
+        for (; x + 4 <= w; x += 4) {
+            __m128 d = load4_u16(in + x);
+            __m128 prev = _mm_loadu_ps(s + x);
+            __m128 diff = _mm_sub_ps(d, prev);
+            __m128 reset = _mm_or_ps(_mm_cmpeq_ps(prev, zero),
+                                     _mm_cmpgt_ps(_mm_and_ps(diff, abs_mask), delta_v));
+            __m128 next = select(reset, d, _mm_add_ps(prev, _mm_mul_ps(alpha_v, diff)));
+            __m128 valid = _mm_cmpgt_ps(d, zero);
+            next = select(valid, next, prev);
+            _mm_storeu_ps(s + x, next);
+
+            // invalid pixels stay 0, +0.5 and truncate as the scalar code
+            __m128i out = _mm_cvttps_epi32(_mm_add_ps(_mm_and_ps(valid, next), half));
+            _mm_storel_epi64((__m128i *)(row + x), pack_u16(out));
+        }
+    #endif
+        for (; x < w; x++)
+            row[x] = temporal_pixel(in[x], s[x], alpha, delta);
+    }
+}
+
+///////// spatial /////////////////////////////////////////////////////////
+inline uint16_t spatial_pixel(const uint16_t *src, int w, int h, int x, int y, int r,
+                              const float *space_weights, float inv_sigma_range)
+{
+    uint16_t c = src[(size_t)y * w + x];
+    if (c == 0)
+        return 0;
+
+    float sum = 0, wsum = 0;
+    for (int dy = -r; dy <= r; dy++) {
+        int yy = y + dy;
+        if (yy < 0 || yy >= h)
+            continue;
+        for (int dx = -r; dx <= r; dx++) {
+            int xx = x + dx;
+            if (xx < 0 || xx >= w)
+                continue;
+            uint16_t n = src[(size_t)yy * w + xx];
+            if (n == 0)
+                continue;
+            float diff = ((float)n - (float)c) * inv_sigma_range;
+            float weight = space_weights[(dy + r) * (2 * r + 1) + dx + r] / (1.0f + diff * diff);
+            sum += weight * n;
+            wsum += weight;
+        }
+    }
+    return (uint16_t)(sum / wsum + 0.5f);
+}
+
+void spatial_rows(const uint16_t *src, uint8_t *depth, int w, int h, int stride, int y0, int y1,
+                  int r, const float *space_weights, float inv_sigma_range)
+{
+    for (int y = y0; y < y1; y++) {
+        uint16_t *row = row_ptr(depth, stride, y);
+        bool border_row = y < r || y >= h - r;
+        int x = 0;
+
+    #ifdef KZ_SSE2
+        if (!border_row) {
+            for (; x < r; x++)
+                row[x] = spatial_pixel(src, w, h, x, y, r, space_weights, inv_sigma_range);
+
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 inv_sr = _mm_set1_ps(inv_sigma_range);
+            for (; x + 4 <= w - r; x += 4) {
+                __m128 c = load4_u16(src + (size_t)y * w + x);
+                __m128 sum = zero, wsum = zero;
+                for (int dy = -r; dy <= r; dy++) {
+                    const uint16_t *n_row = src + (size_t)(y + dy) * w + x;
+                    const float *ws_row = space_weights + (dy + r) * (2 * r + 1) + r;
+                    for (int dx = -r; dx <= r; dx++) {
+                        __m128 n = load4_u16(n_row + dx);
+                        __m128 diff = _mm_mul_ps(_mm_sub_ps(n, c), inv_sr);
+                        __m128 weight = _mm_div_ps(_mm_set1_ps(ws_row[dx]),
+                            _mm_add_ps(one, _mm_mul_ps(diff, diff)));
+                        weight = _mm_and_ps(_mm_cmpgt_ps(n, zero), weight);
+                        sum = _mm_add_ps(sum, _mm_mul_ps(weight, n));
+                        wsum = _mm_add_ps(wsum, weight);
+                    }
+                }
+                // the center pixel has weight > 0 whenever it is valid
+                __m128 valid = _mm_cmpgt_ps(c, zero);
+                __m128 out = _mm_and_ps(valid, _mm_div_ps(sum, select(valid, wsum, one)));
+                out = _mm_add_ps(out, half);
+                _mm_storel_epi64((__m128i *)(row + x), pack_u16(_mm_cvttps_epi32(out)));
+            }
+        }
+    #endif
+        for (; x < w; x++)
+            row[x] = spatial_pixel(src, w, h, x, y, r, space_weights, inv_sigma_range);
+    }
+}
+
+///////// hole filling ////////////////////////////////////////////////////
+inline uint16_t hole_pixel(const uint16_t *src, int w, int h, int x, int y, int r)
+{
+    uint16_t c = src[(size_t)y * w + x];
+    if (c != 0)
+        return c;
+
+    uint16_t farthest = 0;
+    for (int yy = std::max(0, y - r); yy <= std::min(h - 1, y + r); yy++)
+        for (int xx = std::max(0, x - r); xx <= std::min(w - 1, x + r); xx++)
+            farthest = std::max(farthest, src[(size_t)yy * w + xx]);
+    return farthest;
+}
+
+void hole_rows(const uint16_t *src, uint8_t *depth, int w, int h, int stride, int y0, int y1, int r)
+{
+    for (int y = y0; y < y1; y++) {
+        uint16_t *row = row_ptr(depth, stride, y);
+        bool border_row = y < r || y >= h - r;
+        int x = 0;
+
+    #ifdef KZ_SSE2
+        if (!border_row) {
+            for (; x < r; x++)
+                row[x] = hole_pixel(src, w, h, x, y, r);
+
+            // unsigned 16-bit max through the signed max with a bias
+            const __m128i bias = _mm_set1_epi16((short)0x8000);
+            const __m128i zero = _mm_setzero_si128();
+            for (; x + 8 <= w - r; x += 8) {
+                __m128i c = _mm_loadu_si128((const __m128i *)(src + (size_t)y * w + x));
+                __m128i farthest = _mm_xor_si128(zero, bias);
+                for (int dy = -r; dy <= r; dy++) {
+                    const uint16_t *n_row = src + (size_t)(y + dy) * w + x;
+                    for (int dx = -r; dx <= r; dx++) {
+                        __m128i n = _mm_loadu_si128((const __m128i *)(n_row + dx));
+                        farthest = _mm_max_epi16(farthest, _mm_xor_si128(n, bias));
+                    }
+                }
+                farthest = _mm_xor_si128(farthest, bias);
+                __m128i hole = _mm_cmpeq_epi16(c, zero);
+                __m128i out = _mm_or_si128(_mm_and_si128(hole, farthest), c);
+                _mm_storeu_si128((__m128i *)(row + x), out);
+            }
+        }
+    #endif
+        for (; x < w; x++)
+            row[x] = hole_pixel(src, w, h, x, y, r);
+    }
+}
+
+// Copy the strided image to a compact buffer used as input of a stage
+void copy_rows(const uint8_t *depth, int w, int h, int stride, std::vector<uint16_t> &dst)
+{
+    dst.resize((size_t)w * h);
+    for (int y = 0; y < h; y++)
+        memcpy(&dst[(size_t)y * w], depth + (size_t)y * stride, w * sizeof(uint16_t));
+}
+} // namespace
+
+void DepthFilter::configure(const DepthFilterConfig &config)
+{
+    m_config = config;
+    m_config.temporal_alpha = std::min(1.0f, std::max(0.01f, m_config.temporal_alpha));
+    m_config.spatial_radius = std::min(5, std::max(1, m_config.spatial_radius));
+    m_config.hole_filling_radius = std::min(5, std::max(1, m_config.hole_filling_radius));
+    m_config.spatial_sigma_range = std::max(1.0f, m_config.spatial_sigma_range);
+
+    // gaussian weights on the distance to the center pixel
+    int r = m_config.spatial_radius;
+    float inv_2s2 = 1.0f / (2.0f * m_config.spatial_sigma_space * m_config.spatial_sigma_space);
+    m_space_weights.resize((2 * r + 1) * (2 * r + 1));
+    for (int dy = -r; dy <= r; dy++)
+        for (int dx = -r; dx <= r; dx++)
+            m_space_weights[(dy + r) * (2 * r + 1) + dx + r] = std::exp(-(dx * dx + dy * dy) * inv_2s2);
+
+    if (!m_config.temporal)
+        m_temporal_state.clear();
+    m_mean = DepthFilterTimes();
+    m_frames = 0;
+}
+
+bool DepthFilter::enabled() const
+{
+    return m_config.temporal || m_config.spatial || m_config.hole_filling;
+}
+
+void DepthFilter::reset()
+{
+    std::fill(m_temporal_state.begin(), m_temporal_state.end(), 0.0f);
+}
+
+void DepthFilter::apply(const uint8_t *src, int src_stride, uint8_t *depth, int w, int h,
+                        int stride, ThreadPool &pool)
+{
+    if (!enabled())
+        return;
+
+    if (w != m_width || h != m_height) {
+        m_width = w;
+        m_height = h;
+        m_temporal_state.clear();
+    }
+
+    Clock::time_point start = Clock::now();
+    m_last = DepthFilterTimes();
+
+    // Input of the next stage: src until a stage wrote depth
+    const uint8_t *in = src;
+    int in_stride = src_stride;
+
+    if (m_config.temporal) {
+        Clock::time_point t = Clock::now();
+        if (m_temporal_state.size() != (size_t)w * h)
+            m_temporal_state.assign((size_t)w * h, 0.0f);
+        float *state = m_temporal_state.data();
+        float alpha = m_config.temporal_alpha;
+        float delta = (float)m_config.temporal_delta;
+        parallel_rows(pool, h, [&](int y0, int y1) {
+            temporal_rows(in, in_stride, depth, w, stride, y0, y1, state, alpha, delta);
+        });
+        in = depth;
+        in_stride = stride;
+        m_last.temporal = elapsed_ms(t);
+    }
+
+    if (m_config.spatial) {
+        Clock::time_point t = Clock::now();
+        copy_rows(in, w, h, in_stride, m_scratch);
+        const uint16_t *scratch = m_scratch.data();
+        int r = m_config.spatial_radius;
+        float inv_sigma_range = 1.0f / m_config.spatial_sigma_range;
+        const float *space_weights = m_space_weights.data();
+        parallel_rows(pool, h, [&](int y0, int y1) {
+            spatial_rows(scratch, depth, w, h, stride, y0, y1, r, space_weights, inv_sigma_range);
+        });
+        in = depth;
+        in_stride = stride;
+        m_last.spatial = elapsed_ms(t);
+    }
+
+    if (m_config.hole_filling) {
+        Clock::time_point t = Clock::now();
+        copy_rows(in, w, h, in_stride, m_scratch);
+        const uint16_t *scratch = m_scratch.data();
+        int r = m_config.hole_filling_radius;
+        parallel_rows(pool, h, [&](int y0, int y1) {
+            hole_rows(scratch, depth, w, h, stride, y0, y1, r);
+        });
+        m_last.hole_filling = elapsed_ms(t);
+    }
+
+    m_last.total = elapsed_ms(start);
+
+    // running mean of the stage times since the last configure
+    m_frames++;
+    double k = 1.0 / (double)m_frames;
+    m_mean.temporal += (m_last.temporal - m_mean.temporal) * k;
+    m_mean.spatial += (m_last.spatial - m_mean.spatial) * k;
+    m_mean.hole_filling += (m_last.hole_filling - m_mean.hole_filling) * k;
+    m_mean.total += (m_last.total - m_mean.total) * k;
+}
+
+} // namespace kz
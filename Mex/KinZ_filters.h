@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_filters.h
+///
+///		Description:
+///			Depth filtering pipeline applied to the depth image right
+///         after the capture, so every getter, alignment and point cloud
+///         sees the filtered depth.
+///         Stages, in order:
+///          * temporal: per-pixel exponential average. A pixel restarts
+///            from the new value when it moves more than temporal_delta.
+///          * spatial: edge-preserving smoothing. Neighbors are weighted
+///            by a gaussian on distance and a Cauchy weight on the depth
+///            difference, so depth edges are not blurred.
+///          * hole filling: invalid (zero) pixels take the farthest valid
+///            depth in their neighborhood, which avoids growing the
+///            foreground objects into the holes.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_FILTERS_H__
+#define __KINZ_FILTERS_H__
+#include <stdint.h>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace kz
+{
+    struct DepthFilterConfig {
+        bool temporal = false;
+        float temporal_alpha = 0.4f;        // weight of the new frame (0, 1]
+        uint16_t temporal_delta = 20;       // mm, larger changes reset the pixel
+
+        bool spatial = false;
+        int spatial_radius = 2;             // window of (2r+1)x(2r+1) pixels
+        float spatial_sigma_space = 1.5f;   // pixels
+        float spatial_sigma_range = 20.0f;  // mm
+
+        bool hole_filling = false;
+        int hole_filling_radius = 1;        // window of (2r+1)x(2r+1) pixels
+    };
+
+    // Execution time of each stage in milliseconds
+    struct DepthFilterTimes {
+        double temporal = 0;
+        double spatial = 0;
+        double hole_filling = 0;
+        double total = 0;
+    };
+
+    class DepthFilter
+    {
+    public:
+        void configure(const DepthFilterConfig &config);
+        const DepthFilterConfig &config() const { return m_config; }
+        bool enabled() const;
+
+        // Filter the 16-bit depth image src into depth, both width x
+        // height. src is only read; it may be depth to filter in place.
+        void apply(const uint8_t *src, int src_stride, uint8_t *depth, int width, int height,
+                   int stride, ThreadPool &pool);
+
+        // Clear the temporal history, e.g. after the camera moved
+        void reset();
+
+        const DepthFilterTimes &last_times() const { return m_last; }
+        const DepthFilterTimes &mean_times() const { return m_mean; }
+        uint64_t frames() const { return m_frames; }
+
+    private:
+        DepthFilterConfig m_config;
+        std::vector<float> m_temporal_state;  // filtered depth of previous frame
+        std::vector<uint16_t> m_scratch;      // copy of the input of a stage
+        std::vector<float> m_space_weights;
+        int m_width = 0, m_height = 0;
+
+        DepthFilterTimes m_last, m_mean;
+        uint64_t m_frames = 0;
+    };
+}
+
+#endif // __KINZ_FILTERS_H__
@@ -0,0 +1,438 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_kernels.cpp
+///
+///		Description: 
+///			Conversion kernels from Kinect image buffers to Matlab arrays.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KZ_SSE2
+#endif
+
+#if defined(KZ_AVX2_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace kz
+{
+
+#ifdef KZ_AVX2_KERNELS
+// KinZ_kernels_avx2.cpp, for regions with step 1 and no scale. origin is
+// the top-left pixel of the region and h its height.
+namespace avx2
+{
+void bgra_to_rgb(const uint8_t *origin, int stride, int h, size_t num_pix,
+                 uint8_t *dst, int x0, int x1);
+void u16_to_matlab(const uint8_t *origin, int stride, int h,
+                   uint16_t *dst, int x0, int x1);
+}
+#endif
+
+namespace
+{
+KernelIsa detect_isa()
+{
+#ifdef KZ_AVX2_KERNELS
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ISA_AVX2;
+#elif defined(_MSC_VER)
+    // AVX2 in CPUID leaf 7 and the YMM state enabled by the OS
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (avx2 && osxsave && (_xgetbv(0) & 6) == 6)
+            return ISA_AVX2;
+    }
+#endif
+#endif
+    return ISA_BASELINE;
+}
+
+std::atomic<int> &current_isa()
+{
+    static std::atomic<int> isa(best_kernel_isa());
+    return isa;
+}
+
+inline int log2_scale(int scale)
+{
+    return scale == 2 ? 1 : (scale == 4 ? 2 : 3);
+}
+
+// Rounded average of the F x F BGRA block at p, written to rgb[0..2]
+template <int F>
+inline void average_bgra_block(const uint8_t *p, int stride, uint8_t rgb[3])
+{
+    unsigned sum[3] = {0, 0, 0};
+    for (int r = 0; r < F; r++, p += stride)
+        for (int c = 0; c < F; c++) {
+            sum[0] += p[4 * c + 2];
+            sum[1] += p[4 * c + 1];
+            sum[2] += p[4 * c];
+        }
+    for (int i = 0; i < 3; i++)
+        rgb[i] = (uint8_t)((sum[i] + F * F / 2) / (F * F));
+}
+
+template <int F>
+void bgra_to_rgb_scaled(const uint8_t *src, int stride, const Region &roi,
+                        uint8_t *dst, int x0, int x1)
+{
+    int h = roi.out_height();
+    size_t num_pix = (size_t)roi.out_width() * h;
+    uint8_t *r = dst;
+    uint8_t *g = dst + num_pix;
+    uint8_t *b = dst + 2 * num_pix;
+    size_t row_step = (size_t)stride * F;
+    const uint8_t *origin = src + (size_t)roi.y * stride + 4 * roi.x;
+    int x = x0;
+
+#ifdef KZ_SSE2
+    // Four output columns per pass. A source row of their blocks is F
+    // vectors of 4 pixels; channels are summed as 16-bit lanes, which
+    // holds up to 8x8 blocks of 255.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(F * F / 2);
+    const __m128i shift = _mm_cvtsi32_si128(2 * log2_scale(F));
+    const int per_out = F / 2;   // pixel pairs in the row of a block
+    for (; x + 4 <= x1; x += 4) {
+        size_t k = (size_t)x * h;
+        const uint8_t *col = origin + 4 * (size_t)x * F;
+        for (int y = 0; y < h; y++, k++, col += row_step) {
+            __m128i acc[2 * F];
+            for (int j = 0; j < 2 * F; j++)
+                acc[j] = zero;
+            const uint8_t *p = col;
+            for (int rr = 0; rr < F; rr++, p += stride)
+                for (int j = 0; j < F; j++) {
+                    __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * j));
+                    acc[2 * j] = _mm_add_epi16(acc[2 * j], _mm_unpacklo_epi8(v, zero));
+                    acc[2 * j + 1] = _mm_add_epi16(acc[2 * j + 1], _mm_unpackhi_epi8(v, zero));
+                }
+            // Each acc holds two pixels; fold them into the low 4 lanes
+            // and add the pairs of every output pixel
+            __m128i out[4];
+            for (int o = 0; o < 4; o++) {
+                out[o] = zero;
+                for (int j = o * per_out; j < (o + 1) * per_out; j++)
+                    out[o] = _mm_add_epi16(out[o], _mm_add_epi16(acc[j], _mm_srli_si128(acc[j], 8)));
+            }
+            __m128i lo = _mm_unpacklo_epi64(out[0], out[1]);
+            __m128i hi = _mm_unpacklo_epi64(out[2], out[3]);
+            lo = _mm_srl_epi16(_mm_add_epi16(lo, round), shift);
+            hi = _mm_srl_epi16(_mm_add_epi16(hi, round), shift);
+
+            uint8_t bgra[16];
+            _mm_storeu_si128((__m128i *)bgra, _mm_packus_epi16(lo, hi));
+            for (int o = 0; o < 4; o++) {
+                size_t ko = k + (size_t)o * h;
+                r[ko] = bgra[4 * o + 2];
+                g[ko] = bgra[4 * o + 1];
+                b[ko] = bgra[4 * o];
+            }
+        }
+    }
+#endif
+
+    for (; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        const uint8_t *p = origin + 4 * (size_t)x * F;
+        for (int y = 0; y < h; y++, k++, p += row_step) {
+            uint8_t rgb[3];
+            average_bgra_block<F>(p, stride, rgb);
+            r[k] = rgb[0];
+            g[k] = rgb[1];
+            b[k] = rgb[2];
+        }
+    }
+}
+
+// Average of the scale x scale blocks of a 16-bit image. With skip_zero
+// only the non-zero pixels of a block are averaged, and a block without
+// any is zero.
+template <bool skip_zero>
+void u16_to_matlab_scaled(const uint8_t *src, int stride, const Region &roi,
+                          uint16_t *dst, int x0, int x1)
+{
+    int h = roi.out_height();
+    int f = roi.scale;
+    int area_shift = 2 * log2_scale(f);
+    size_t row_step = (size_t)stride * f;
+    const uint8_t *origin = src + (size_t)roi.y * stride + 2 * roi.x;
+
+    for (int x = x0; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        const uint8_t *col = origin + 2 * (size_t)x * f;
+        for (int y = 0; y < h; y++, k++, col += row_step) {
+            uint32_t sum = 0, count = 0;
+            const uint8_t *p = col;
+            for (int r = 0; r < f; r++, p += stride) {
+                const uint16_t *row = (const uint16_t *)p;
+                for (int c = 0; c < f; c++) {
+                    sum += row[c];
+                    if (skip_zero)
+                        count += row[c] != 0;
+                }
+            }
+            if (!skip_zero)
+                dst[k] = (uint16_t)((sum + (1u << (area_shift - 1))) >> area_shift);
+            else
+                dst[k] = count ? (uint16_t)((sum + count / 2) / count) : 0;
+        }
+    }
+}
+
+template <bool skip_zero>
+void u16_region_to_matlab(const uint8_t *src, int stride, const Region &roi,
+                          uint16_t *dst, int x0, int x1)
+{
+    if (roi.scale > 1) {
+        u16_to_matlab_scaled<skip_zero>(src, stride, roi, dst, x0, x1);
+        return;
+    }
+
+    int h = roi.out_height();
+    size_t row_step = (size_t)stride * roi.step;
+    const uint8_t *origin = src + (size_t)roi.y * stride + 2 * roi.x;
+
+#ifdef KZ_AVX2_KERNELS
+    if (roi.step == 1 && kernel_isa() == ISA_AVX2) {
+        avx2::u16_to_matlab(origin, stride, h, dst, x0, x1);
+        return;
+    }
+#endif
+
+    for (int x = x0; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        const uint8_t *p = origin + 2 * (size_t)x * roi.step;
+        for (int y = 0; y < h; y++, k++, p += row_step)
+            dst[k] = (uint16_t)(p[0] | (p[1] << 8));
+    }
+}
+} // namespace
+
+KernelIsa best_kernel_isa()
+{
+    static const KernelIsa best = detect_isa();
+    return best;
+}
+
+KernelIsa kernel_isa()
+{
+    return (KernelIsa)current_isa().load(std::memory_order_relaxed);
+}
+
+KernelIsa set_kernel_isa(KernelIsa isa)
+{
+    KernelIsa used = std::min(isa, best_kernel_isa());
+    current_isa().store(used);
+    return used;
+}
+
+const char *kernel_isa_name(KernelIsa isa)
+{
+    return isa == ISA_AVX2 ? "avx2" : "baseline";
+}
+
+void bgra_to_rgb(const uint8_t *src, int stride, const Region &roi,
+                 uint8_t *dst, int x0, int x1)
+{
+    switch (roi.scale) {
+    case 2: bgra_to_rgb_scaled<2>(src, stride, roi, dst, x0, x1); return;
+    case 4: bgra_to_rgb_scaled<4>(src, stride, roi, dst, x0, x1); return;
+    case 8: bgra_to_rgb_scaled<8>(src, stride, roi, dst, x0, x1); return;
+    }
+
+    int h = roi.out_height();
+    size_t num_pix = (size_t)roi.out_width() * h;
+    uint8_t *r = dst;
+    uint8_t *g = dst + num_pix;
+    uint8_t *b = dst + 2 * num_pix;
+    size_t row_step = (size_t)stride * roi.step;
+    const uint8_t *origin = src + (size_t)roi.y * stride + 4 * roi.x;
+
+#ifdef KZ_AVX2_KERNELS
+    if (roi.step == 1 && kernel_isa() == ISA_AVX2) {
+        avx2::bgra_to_rgb(origin, stride, h, num_pix, dst, x0, x1);
+        return;
+    }
+#endif
+
+    for (int x = x0; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        const uint8_t *p = origin + 4 * (size_t)x * roi.step;
+        for (int y = 0; y < h; y++, k++, p += row_step) {
+            r[k] = p[2];
+            g[k] = p[1];
+            b[k] = p[0];
+        }
+    }
+}
+
+void u16_to_matlab(const uint8_t *src, int stride, const Region &roi,
+                   uint16_t *dst, int x0, int x1)
+{
+    u16_region_to_matlab<false>(src, stride, roi, dst, x0, x1);
+}
+
+void depth_to_matlab(const uint8_t *src, int stride, const Region &roi,
+                     uint16_t *dst, int x0, int x1)
+{
+    u16_region_to_matlab<true>(src, stride, roi, dst, x0, x1);
+}
+
+void matlab_to_u16(const uint16_t *src, int w, int h, uint8_t *dst, int stride,
+                   int x0, int x1)
+{
+    (void)w;
+    for (int x = x0; x < x1; x++) {
+        const uint16_t *col = src + (size_t)x * h;
+        uint8_t *p = dst + 2 * (size_t)x;
+        for (int y = 0; y < h; y++, p += stride)
+            *(uint16_t *)p = col[y];
+    }
+}
+
+void matlab_to_bgra(const uint8_t *src, int w, int h, uint8_t *dst, int stride,
+                    int x0, int x1)
+{
+    size_t num_pix = (size_t)w * h;
+    for (int x = x0; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        uint8_t *p = dst + 4 * (size_t)x;
+        for (int y = 0; y < h; y++, k++, p += stride) {
+            p[0] = src[k + 2 * num_pix];
+            p[1] = src[k + num_pix];
+            p[2] = src[k];
+            p[3] = 255;
+        }
+    }
+}
+
+namespace
+{
+// 3D point of pixel (x, y), false if the pixel has no depth
+inline bool grid_point(const uint8_t *depth, int stride, const float *rays, int w,
+                       int x, int y, float p[3])
+{
+    float z = ((const uint16_t *)(depth + (size_t)y * stride))[x];
+    const float *ray = rays + 2 * ((size_t)y * w + x);
+    if (z <= 0 || std::isnan(ray[0]))
+        return false;
+    p[0] = ray[0] * z;
+    p[1] = ray[1] * z;
+    p[2] = z;
+    return true;
+}
+
+// Tangent at c from its neighbors before (a) and after (b): central
+// difference if both are usable, one-sided otherwise
+inline bool tangent(const float c[3], bool has_a, const float a[3],
+                    bool has_b, const float b[3], float t[3])
+{
+    if (!has_a && !has_b)
+        return false;
+    const float *from = has_a ? a : c;
+    const float *to = has_b ? b : c;
+    for (int i = 0; i < 3; i++)
+        t[i] = to[i] - from[i];
+    return true;
+}
+} // namespace
+
+void organized_normals(const uint8_t *depth, int stride, const float *rays,
+                       int w, int h, const Region &roi, int radius,
+                       float max_depth_change, double *normals, int y0, int y1)
+{
+    int out_w = roi.out_width();
+    size_t num_points = (size_t)out_w * roi.out_height();
+    int r = std::max(1, radius);
+
+    for (int oy = y0; oy < y1; oy++) {
+        int y = roi.y + oy * roi.step;
+        for (int ox = 0; ox < out_w; ox++) {
+            int x = roi.x + ox * roi.step;
+            size_t i = (size_t)oy * out_w + ox;
+            normals[i] = normals[i + num_points] = normals[i + 2 * num_points] = 0;
+
+            float c[3];
+            if (!grid_point(depth, stride, rays, w, x, y, c))
+                continue;
+            float max_change = max_depth_change * c[2] * r;
+            auto usable = [&](int nx, int ny, float p[3]) {
+                return nx >= 0 && nx < w && ny >= 0 && ny < h &&
+                       grid_point(depth, stride, rays, w, nx, ny, p) &&
+                       std::fabs(p[2] - c[2]) <= max_change;
+            };
+
+            float left[3], right[3], up[3], down[3], tx[3], ty[3];
+            bool has_left = usable(x - r, y, left);
+            bool has_right = usable(x + r, y, right);
+            bool has_up = usable(x, y - r, up);
+            bool has_down = usable(x, y + r, down);
+            if (!tangent(c, has_left, left, has_right, right, tx) ||
+                !tangent(c, has_up, up, has_down, down, ty))
+                continue;
+
+            float n[3] = {tx[1] * ty[2] - tx[2] * ty[1],
+                          tx[2] * ty[0] - tx[0] * ty[2],
+                          tx[0] * ty[1] - tx[1] * ty[0]};
+            float norm = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (norm == 0)
+                continue;
+            // Toward the camera at the origin
+            if (n[0] * c[0] + n[1] * c[1] + n[2] * c[2] > 0)
+                norm = -norm;
+            normals[i] = n[0] / norm;
+            normals[i + num_points] = n[1] / norm;
+            normals[i + 2 * num_points] = n[2] / norm;
+        }
+    }
+}
+
+void parallel_columns(ThreadPool &pool, int w,
+                      const std::function<void(int, int)> &fn,
+                      int min_tile_width)
+{
+    // Two tiles per thread to balance threads that get descheduled
+    int num_tiles = std::max(1, std::min((int)pool.size() * 2, w / min_tile_width));
+    int tile_width = (w + num_tiles - 1) / num_tiles;
+
+    pool.parallel_for(num_tiles, [&](int i) {
+        int x0 = i * tile_width;
+        int x1 = std::min(w, x0 + tile_width);
+        if (x0 < x1)
+            fn(x0, x1);
+    });
+}
+
+void parallel_rows(ThreadPool &pool, int h,
+                   const std::function<void(int, int)> &fn,
+                   int min_band_height)
+{
+    int num_bands = std::max(1, std::min((int)pool.size() * 2, h / min_band_height));
+    int band_height = (h + num_bands - 1) / num_bands;
+
+    pool.parallel_for(num_bands, [&](int i) {
+        int y0 = i * band_height;
+        int y1 = std::min(h, y0 + band_height);
+        if (y0 < y1)
+            fn(y0, y1);
+    });
+}
+
+} // namespace kz
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_kernels.h
+///
+///		Description: 
+///			Conversion kernels from Kinect image buffers to Matlab arrays.
+///         Matlab matrices are column-major, so every kernel transposes
+///         while copying. Kernels copy a region of the image, optionally
+///         decimated or downscaled, and work on a range of output columns
+///         [x0, x1) so a frame can be split in tiles processed by different
+///         threads.
+///
+///         The plain copies, the most frequent conversions, also have AVX2
+///         versions (KinZ_kernels_avx2.cpp) that transpose blocks of 8x8
+///         pixels in registers. They are used when the CPU supports AVX2,
+///         which is detected at runtime, so a single binary runs on any
+///         x86-64 CPU.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_KERNELS_H__
+#define __KINZ_KERNELS_H__
+#include <stdint.h>
+#include <functional>
+#include "thread_pool.hpp"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(KZ_NO_AVX2)
+#define KZ_AVX2_KERNELS
+#endif
+
+namespace kz
+{
+    // Instruction sets of the kernels
+    enum KernelIsa {
+        ISA_BASELINE = 0,   // SSE2 on x86-64
+        ISA_AVX2 = 1
+    };
+
+    // Best instruction set supported by the CPU and the build
+    KernelIsa best_kernel_isa();
+    // Instruction set used by the kernels, best_kernel_isa by default
+    KernelIsa kernel_isa();
+    // Use isa, or the best supported below it. Returns the one in use.
+    KernelIsa set_kernel_isa(KernelIsa isa);
+    const char *kernel_isa_name(KernelIsa isa);
+
+    // Window of an image taking one pixel every step pixels in x and y,
+    // or averaging blocks of scale x scale pixels (scale = 2, 4 or 8).
+    // step and scale are exclusive. A zero width or height selects the
+    // whole image.
+    struct Region {
+        int x = 0, y = 0;
+        int width = 0, height = 0;
+        int step = 1;
+        int scale = 1;
+
+        Region() {}
+        Region(int w, int h) : width(w), height(h) {}
+
+        // Clip to the image. Returns false if nothing is left.
+        bool clip(int image_width, int image_height)
+        {
+            if (width <= 0 || height <= 0) {
+                x = y = 0;
+                width = image_width;
+                height = image_height;
+            }
+            if (step < 1)
+                step = 1;
+            if (scale != 2 && scale != 4 && scale != 8)
+                scale = 1;
+            if (x < 0) { width += x; x = 0; }
+            if (y < 0) { height += y; y = 0; }
+            if (x + width > image_width) width = image_width - x;
+            if (y + height > image_height) height = image_height - y;
+            return out_width() > 0 && out_height() > 0;
+        }
+
+        bool is_full(int image_width, int image_height) const
+        {
+            return x == 0 && y == 0 && step == 1 && scale == 1 &&
+                   width == image_width && height == image_height;
+        }
+
+        // Size of the output array. Incomplete blocks of a scaled region
+        // are dropped.
+        int out_width() const { return scale > 1 ? width / scale : (width + step - 1) / step; }
+        int out_height() const { return scale > 1 ? height / scale : (height + step - 1) / step; }
+    };
+
+    // BGRA region to a planar (out_height x out_width x 3) RGB Matlab array.
+    // Scaled regions are area averaged.
+    void bgra_to_rgb(const uint8_t *src, int stride, const Region &roi,
+                     uint8_t *dst, int x0, int x1);
+
+    // 16-bit region (infrared) to a (out_height x out_width) Matlab array.
+    // Scaled regions are area averaged.
+    void u16_to_matlab(const uint8_t *src, int stride, const Region &roi,
+                       uint16_t *dst, int x0, int x1);
+
+    // Same as u16_to_matlab for depth: zero (invalid) pixels are left out
+    // of the averages of scaled regions.
+    void depth_to_matlab(const uint8_t *src, int stride, const Region &roi,
+                         uint16_t *dst, int x0, int x1);
+
+    // Inverse of u16_to_matlab and bgra_to_rgb for whole images: a
+    // (h x w) Matlab array, or a (h x w x 3) RGB one with alpha set to 255,
+    // to an image of rows of stride bytes, for the columns [x0, x1)
+    void matlab_to_u16(const uint16_t *src, int w, int h, uint8_t *dst, int stride,
+                       int x0, int x1);
+    void matlab_to_bgra(const uint8_t *src, int w, int h, uint8_t *dst, int stride,
+                        int x0, int x1);
+
+    // Normals of the organized point cloud of a w x h depth image, for the
+    // output rows [y0, y1) of the region roi (step only). rays holds the
+    // unit-depth ray (x, y) of each pixel, NaN if it does not unproject.
+    // The normal of a pixel is the cross product of the tangents to its
+    // neighbors radius pixels away in x and y, oriented toward the camera.
+    // A larger radius averages out the 1 mm quantization of the depth.
+    // Neighbors whose depth differs by more than
+    // max_depth_change * z * radius are across a depth discontinuity and
+    // are not used. normals is a (out_width*out_height x 3) Matlab array
+    // ordered row by row of the region; undefined normals are 0.
+    void organized_normals(const uint8_t *depth, int stride, const float *rays,
+                           int w, int h, const Region &roi, int radius,
+                           float max_depth_change, double *normals, int y0, int y1);
+
+    // Split the columns [0, w) in tiles and run fn(x0, x1) for each tile
+    // on the pool. Tiles are never narrower than min_tile_width.
+    void parallel_columns(ThreadPool &pool, int w,
+                          const std::function<void(int, int)> &fn,
+                          int min_tile_width = 64);
+
+    // Split the rows [0, h) in bands and run fn(y0, y1) for each band
+    void parallel_rows(ThreadPool &pool, int h,
+                       const std::function<void(int, int)> &fn,
+                       int min_band_height = 16);
+}
+
+#endif // __KINZ_KERNELS_H__
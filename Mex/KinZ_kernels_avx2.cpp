@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_kernels_avx2.cpp
+///
+///		Description:
+///			AVX2 versions of the plain (step 1, unscaled) copies of
+///         KinZ_kernels.cpp. The functions are compiled for AVX2 with a
+///         target attribute, so the file needs no special compiler flags,
+///         and are only called when the CPU supports it.
+///         An 8x8 block of pixels is loaded row by row, transposed in
+///         registers and stored column by column, so both the reads of
+///         the image and the writes of the Matlab array are contiguous.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_kernels.h"
+
+#ifdef KZ_AVX2_KERNELS
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KZ_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define KZ_TARGET_AVX2
+#endif
+
+namespace kz
+{
+namespace avx2
+{
+
+namespace
+{
+// Transpose 8 rows of 8 32-bit pixels into 8 columns
+KZ_TARGET_AVX2 inline void transpose_8x32(__m256i r[8])
+{
+    __m256i t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+// Transpose, in each 128-bit lane, 8 rows of 8 16-bit pixels
+KZ_TARGET_AVX2 inline void transpose_8x16_lanes(__m256i r[8])
+{
+    __m256i a[8], b[8];
+    for (int i = 0; i < 8; i += 2) {
+        a[i] = _mm256_unpacklo_epi16(r[i], r[i + 1]);
+        a[i + 1] = _mm256_unpackhi_epi16(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        b[i] = _mm256_unpacklo_epi32(a[i], a[i + 2]);
+        b[i + 1] = _mm256_unpackhi_epi32(a[i], a[i + 2]);
+        b[i + 2] = _mm256_unpacklo_epi32(a[i + 1], a[i + 3]);
+        b[i + 3] = _mm256_unpackhi_epi32(a[i + 1], a[i + 3]);
+    }
+    for (int i = 0; i < 4; i++) {
+        r[2 * i] = _mm256_unpacklo_epi64(b[i], b[i + 4]);
+        r[2 * i + 1] = _mm256_unpackhi_epi64(b[i], b[i + 4]);
+    }
+}
+} // namespace
+
+KZ_TARGET_AVX2
+void bgra_to_rgb(const uint8_t *origin, int stride, int h, size_t num_pix,
+                 uint8_t *dst, int x0, int x1)
+{
+    uint8_t *r = dst;
+    uint8_t *g = dst + num_pix;
+    uint8_t *b = dst + 2 * num_pix;
+
+    // R, G and B of the 4 pixels of a lane to its dwords 0, 1 and 2, then
+    // the dwords of both lanes side by side: 8 R, 8 G, 8 B
+    const __m256i split = _mm256_setr_epi8(2, 6, 10, 14, 1, 5, 9, 13, 0, 4, 8, 12, -1, -1, -1, -1,
+                                           2, 6, 10, 14, 1, 5, 9, 13, 0, 4, 8, 12, -1, -1, -1, -1);
+    const __m256i gather = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int h8 = h & ~7;
+
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        for (int y = 0; y < h8; y += 8) {
+            __m256i v[8];
+            const uint8_t *p = origin + (size_t)y * stride + 4 * (size_t)x;
+            for (int i = 0; i < 8; i++, p += stride)
+                v[i] = _mm256_loadu_si256((const __m256i *)p);
+            transpose_8x32(v);
+            for (int c = 0; c < 8; c++) {
+                __m256i planes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v[c], split), gather);
+                __m128i rg = _mm256_castsi256_si128(planes);
+                size_t k = (size_t)(x + c) * h + y;
+                _mm_storel_epi64((__m128i *)(r + k), rg);
+                _mm_storel_epi64((__m128i *)(g + k), _mm_srli_si128(rg, 8));
+                _mm_storel_epi64((__m128i *)(b + k), _mm256_extracti128_si256(planes, 1));
+            }
+        }
+        for (int c = x; c < x + 8; c++) {
+            const uint8_t *p = origin + (size_t)h8 * stride + 4 * (size_t)c;
+            for (int y = h8; y < h; y++, p += stride) {
+                size_t k = (size_t)c * h + y;
+                r[k] = p[2];
+                g[k] = p[1];
+                b[k] = p[0];
+            }
+        }
+    }
+
+    for (; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        const uint8_t *p = origin + 4 * (size_t)x;
+        for (int y = 0; y < h; y++, k++, p += stride) {
+            r[k] = p[2];
+            g[k] = p[1];
+            b[k] = p[0];
+        }
+    }
+}
+
+KZ_TARGET_AVX2
+void u16_to_matlab(const uint8_t *origin, int stride, int h,
+                   uint16_t *dst, int x0, int x1)
+{
+    int h8 = h & ~7;
+
+    // 16 columns per pass: lane 0 holds columns x..x+7, lane 1 x+8..x+15
+    int x = x0;
+    for (; x + 16 <= x1; x += 16) {
+        for (int y = 0; y < h8; y += 8) {
+            __m256i v[8];
+            const uint8_t *p = origin + (size_t)y * stride + 2 * (size_t)x;
+            for (int i = 0; i < 8; i++, p += stride)
+                v[i] = _mm256_loadu_si256((const __m256i *)p);
+            transpose_8x16_lanes(v);
+            for (int c = 0; c < 8; c++) {
+                _mm_storeu_si128((__m128i *)(dst + (size_t)(x + c) * h + y),
+                                 _mm256_castsi256_si128(v[c]));
+                _mm_storeu_si128((__m128i *)(dst + (size_t)(x + 8 + c) * h + y),
+                                 _mm256_extracti128_si256(v[c], 1));
+            }
+        }
+        for (int c = x; c < x + 16; c++) {
+            const uint8_t *p = origin + (size_t)h8 * stride + 2 * (size_t)c;
+            for (int y = h8; y < h; y++, p += stride)
+                dst[(size_t)c * h + y] = (uint16_t)(p[0] | (p[1] << 8));
+        }
+    }
+
+    for (; x < x1; x++) {
+        size_t k = (size_t)x * h;
+        const uint8_t *p = origin + 2 * (size_t)x;
+        for (int y = 0; y < h; y++, k++, p += stride)
+            dst[k] = (uint16_t)(p[0] | (p[1] << 8));
+    }
+}
+
+} // namespace avx2
+} // namespace kz
+
+#endif // KZ_AVX2_KERNELS
@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_log.cpp
+///
+///		Description:
+///			Bounded multi-producer single-consumer ring of log messages.
+///         Each slot carries a sequence number: a producer claims a slot
+///         by advancing the head, formats the text in place, then
+///         publishes the slot by updating its sequence.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_log.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace kz
+{
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+struct Slot {
+    std::atomic<size_t> sequence;
+    LogEntry entry;
+};
+
+class LogRing
+{
+public:
+    LogRing() : m_head(0), m_tail(0), m_dropped(0), m_level(LOG_INFO), m_start(Clock::now())
+    {
+        for (size_t i = 0; i < LOG_CAPACITY; i++)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Claim the next slot, or return null when the ring is full
+    Slot *claim()
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_slots[pos & (LOG_CAPACITY - 1)];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return &slot;
+            }
+            else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            else
+                pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Make a claimed slot visible to the consumer
+    void publish(Slot *slot)
+    {
+        size_t pos = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    bool pop(LogEntry &entry)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot &slot = m_slots[pos & (LOG_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+        entry = slot.entry;
+        slot.sequence.store(pos + LOG_CAPACITY, std::memory_order_release);
+        m_tail.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    double seconds(Clock::time_point t) const
+    {
+        return std::chrono::duration<double>(t - m_start).count();
+    }
+
+    Slot m_slots[LOG_CAPACITY];
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<int> m_level;
+    Clock::time_point m_start;
+};
+
+LogRing &ring()
+{
+    static LogRing instance;
+    return instance;
+}
+
+// Count the message against the one second window of its site
+bool rate_allowed(LogSite &site, Clock::time_point now)
+{
+    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     now.time_since_epoch()).count();
+    int64_t start = site.window_start.load(std::memory_order_relaxed);
+    if (ms - start >= 1000 &&
+        site.window_start.compare_exchange_strong(start, ms, std::memory_order_relaxed))
+        site.count.store(0, std::memory_order_relaxed);
+
+    if (site.count.fetch_add(1, std::memory_order_relaxed) < LOG_SITE_BURST)
+        return true;
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+} // namespace
+
+LogLevel log_level()
+{
+    return (LogLevel)ring().m_level.load(std::memory_order_relaxed);
+}
+
+void set_log_level(LogLevel level)
+{
+    ring().m_level.store(level, std::memory_order_relaxed);
+}
+
+void log_write(LogSite &site, LogLevel level, const char *format, ...)
+{
+    Clock::time_point now = Clock::now();
+    if (!rate_allowed(site, now))
+        return;
+
+    LogRing &r = ring();
+    Slot *slot = r.claim();
+    if (!slot) {
+        // Keep the suppressed count of the site for its next message
+        return;
+    }
+
+    LogEntry &e = slot->entry;
+    e.level = level;
+    e.time = r.seconds(now);
+    e.suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(e.text, LOG_TEXT_SIZE, format, args);
+    va_end(args);
+
+    // Messages are printed one per line
+    size_t n = strlen(e.text);
+    while (n > 0 && e.text[n - 1] == '\n')
+        e.text[--n] = '\0';
+
+    r.publish(slot);
+}
+
+size_t log_drain(const std::function<void(const LogEntry &)> &sink)
+{
+    LogRing &r = ring();
+    LogEntry entry;
+    size_t count = 0;
+    while (r.pop(entry)) {
+        sink(entry);
+        count++;
+    }
+    return count;
+}
+
+uint64_t log_dropped()
+{
+    return ring().m_dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace kz
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_log.h
+///
+///		Description:
+///			Deferred logging for the capture and conversion code.
+///         KZ_LOG formats the message into a bounded lock-free ring that
+///         any thread can write; nothing is printed there. The ring is
+///         drained on the MATLAB thread by KinZ_mex, at the start and end
+///         of every call, so the mex API is never used from a worker and
+///         a failing device cannot flood the console.
+///         Every call site prints at most LOG_SITE_BURST messages per
+///         second. The count of suppressed messages is attached to the
+///         next message of the site. Messages above the current level,
+///         or arriving when the ring is full, are dropped.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_LOG_H__
+#define __KINZ_LOG_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+namespace kz
+{
+    enum LogLevel {
+        LOG_ERROR = 0,
+        LOG_WARNING = 1,
+        LOG_INFO = 2,
+        LOG_DEBUG = 3
+    };
+
+    const size_t LOG_CAPACITY = 256;        // entries, power of two
+    const size_t LOG_TEXT_SIZE = 160;       // longer messages are truncated
+    const uint32_t LOG_SITE_BURST = 5;      // messages per second per site
+
+    struct LogEntry {
+        LogLevel level;
+        double time;                        // seconds since the first message
+        uint32_t suppressed;                // rate limited messages of the site
+        char text[LOG_TEXT_SIZE];
+    };
+
+    // Rate limiting state of one KZ_LOG call site
+    struct LogSite {
+        std::atomic<int64_t> window_start{0};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> suppressed{0};
+    };
+
+    LogLevel log_level();
+    void set_log_level(LogLevel level);
+
+    // Format a message into the ring. Use KZ_LOG instead.
+    void log_write(LogSite &site, LogLevel level, const char *format, ...)
+    #if defined(__GNUC__)
+        __attribute__((format(printf, 3, 4)))
+    #endif
+        ;
+
+    // Pop all pending messages in order and pass them to sink.
+    // Only one thread may drain at a time. Returns the number of messages.
+    size_t log_drain(const std::function<void(const LogEntry &)> &sink);
+
+    // Messages lost because the ring was full
+    uint64_t log_dropped();
+}
+
+#define KZ_LOG(level, ...)                                      \
+    do {                                                        \
+        static kz::LogSite kz_log_site_;                        \
+        if ((level) <= kz::log_level())                         \
+            kz::log_write(kz_log_site_, (level), __VA_ARGS__);  \
+    } while (0)
+
+#endif // __KINZ_LOG_H__
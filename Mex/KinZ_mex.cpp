@@ -1,12 +1,272 @@
 #include "KinZ.h"
+#include "KinZ_kernels.h"
+#include "KinZ_log.h"
+#include "KinZ_archive.h"
+#include "KinZ_codec.h"
+#include "KinZ_cloudwriter.h"
+#include "KinZ_reproject.h"
+#include "KinZ_bodytrack.h"
+#include "KinZ_allocator.h"
 #include <mex.h>
 #include "class_handle.hpp"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+///////// Function: read_region ////////////////////////////////////////////
+// Read the optional region of interest [x y w h] (0-based) at prhs[first],
+// decimation step at prhs[first+1] and downscale factor (1, 2, 4 or 8) at
+// prhs[first+2] of an image of width x height.
+///////////////////////////////////////////////////////////////////////////
+static kz::Region read_region(int nrhs, const mxArray *prhs[], int first, int width, int height)
+{
+    kz::Region roi;
+    if (nrhs > first && mxGetNumberOfElements(prhs[first]) == 4) {
+        double *r = mxGetPr(prhs[first]);
+        roi.x = (int)r[0];
+        roi.y = (int)r[1];
+        roi.width = (int)r[2];
+        roi.height = (int)r[3];
+    }
+    if (nrhs > first + 1)
+        roi.step = (int)mxGetScalar(prhs[first + 1]);
+    if (nrhs > first + 2)
+        roi.scale = (int)mxGetScalar(prhs[first + 2]);
+
+    if (roi.scale != 1 && roi.scale != 2 && roi.scale != 4 && roi.scale != 8)
+        mexErrMsgTxt("The scale must be 1, 1/2, 1/4 or 1/8.");
+    if (roi.scale > 1 && roi.step > 1)
+        mexErrMsgTxt("Decimation step and scale cannot be combined.");
+    if (!roi.clip(width, height))
+        mexErrMsgTxt("The region of interest is outside of the image.");
+    return roi;
+}
+
+///////// Function: bodies_to_struct ///////////////////////////////////////
+// Create the Matlab structure array returned by getbodies
+///////////////////////////////////////////////////////////////////////////
+static mxArray *bodies_to_struct(const std::vector<kz::Body> &bodies)
+{
+    //Assign field names
+    const char *field_names[] = {"Id", "Position3d", "Position2d_rgb", "Position2d_depth",
+                                 "Orientation", "Confidence"};
+
+    //Allocate memory for the structure
+    mwSize dims[2] = {1, bodies.size()};
+    mxArray *out = mxCreateStructArray(2, dims, 6, field_names);
+
+    // Copy the body data to the output matrices
+    for (size_t i = 0; i < bodies.size(); i++) {
+        const kz::Body &body = bodies[i];
+
+        //Create mxArray data structures to hold the data
+        //to be assigned for the structure.
+        mxArray *body_id_mx = mxCreateNumericMatrix(1, 1, mxUINT32_CLASS, mxREAL);
+        uint32_t *bodyIdptr = (uint32_t*)mxGetPr(body_id_mx);
+        mxArray *position3d_mx  = mxCreateDoubleMatrix(3, kz::NUM_JOINTS, mxREAL);
+        double* pos3dptr = (double*)mxGetPr(position3d_mx);
+        mxArray *position2d_rgb_mx  = mxCreateNumericMatrix(2, kz::NUM_JOINTS, mxUINT32_CLASS, mxREAL);
+        uint32_t* pos2d_rgbptr = (uint32_t*)mxGetPr(position2d_rgb_mx);
+        mxArray *position2d_depth_mx  = mxCreateNumericMatrix(2, kz::NUM_JOINTS, mxUINT32_CLASS, mxREAL);
+        uint32_t* pos2d_depthptr = (uint32_t*)mxGetPr(position2d_depth_mx);
+        mxArray *orientation_mx  = mxCreateDoubleMatrix(4, kz::NUM_JOINTS, mxREAL);
+        double* orientationptr = (double*)mxGetPr(orientation_mx);
+        mxArray *confidence_mx = mxCreateNumericMatrix(1, kz::NUM_JOINTS, mxUINT32_CLASS, mxREAL);
+        uint32_t *confidenceptr = (uint32_t*)mxGetPr(confidence_mx);
+
+        bodyIdptr[0] = body.id;
+
+        // For each joint
+        for (int j = 0; j < kz::NUM_JOINTS; j++) {
+            for (int c = 0; c < 3; c++)
+                pos3dptr[j*3 + c] = body.position3d[j][c];
+            for (int c = 0; c < 4; c++)
+                orientationptr[j*4 + c] = body.orientation[j][c];
+            confidenceptr[j] = body.confidence[j];
+            for (int c = 0; c < 2; c++) {
+                pos2d_rgbptr[j*2 + c] = (uint32_t)body.position2d_rgb[j][c];
+                pos2d_depthptr[j*2 + c] = (uint32_t)body.position2d_depth[j][c];
+            }
+        }
+
+        //Assign the output matrices to the struct
+        mxSetFieldByNumber(out, i, 0, body_id_mx);
+        mxSetFieldByNumber(out, i, 1, position3d_mx);
+        mxSetFieldByNumber(out, i, 2, position2d_rgb_mx);
+        mxSetFieldByNumber(out, i, 3, position2d_depth_mx);
+        mxSetFieldByNumber(out, i, 4, orientation_mx);
+        mxSetFieldByNumber(out, i, 5, confidence_mx);
+    }
+    return out;
+}
+
+///////// Function: bytes_to_mx ////////////////////////////////////////////
+// Copy a byte buffer to a uint8 column vector
+///////////////////////////////////////////////////////////////////////////
+static mxArray *bytes_to_mx(const std::vector<uint8_t> &bytes)
+{
+    mxArray *out = mxCreateNumericMatrix(bytes.size(), 1, mxUINT8_CLASS, mxREAL);
+    if (!bytes.empty())
+        memcpy(mxGetData(out), bytes.data(), bytes.size());
+    return out;
+}
+
+///////// Function: read_depth_stack ///////////////////////////////////////
+// Size of a stack of depth images, a (height x width x n) uint16 array
+///////////////////////////////////////////////////////////////////////////
+static bool read_depth_stack(const mxArray *stack, int &width, int &height, int &n)
+{
+    mwSize ndims = mxGetNumberOfDimensions(stack);
+    if (!mxIsUint16(stack) || ndims > 3)
+        return false;
+    const mwSize *dims = mxGetDimensions(stack);
+    height = (int)dims[0];
+    width = (int)dims[1];
+    n = ndims == 3 ? (int)dims[2] : 1;
+    return true;
+}
+
+///////// Function: read_tracker_config ////////////////////////////////////
+// Tracker options from a numeric vector [processingMode orientation
+// gpuDevice liteModel smoothing] at prhs[first] and the model path at
+// prhs[first + 1]
+///////////////////////////////////////////////////////////////////////////
+static kz::TrackerConfig read_tracker_config(int nrhs, const mxArray *prhs[], int first)
+{
+    if (nrhs < first + 2 || mxGetNumberOfElements(prhs[first]) != 5 || !mxIsChar(prhs[first + 1]))
+        mexErrMsgTxt("Unexpected tracker options.");
+    const double *v = mxGetPr(prhs[first]);
+    kz::TrackerConfig config;
+    config.processing_mode = (int)v[0];
+    config.sensor_orientation = (int)v[1];
+    config.gpu_device_id = (int)v[2];
+    config.lite_model = v[3] != 0;
+    config.smoothing = (float)std::max(0.0, std::min(1.0, v[4]));
+    char path[1024];
+    mxGetString(prhs[first + 1], path, sizeof(path));
+    config.model_path = path;
+    return config;
+}
+
+///////// Function: tracked_to_struct //////////////////////////////////////
+// Pack the skeletons of a tracked recording in arrays of N frames and up
+// to B bodies per frame. Missing bodies have id 0, NaN positions and
+// orientations, confidence 0 and 2D positions -1.
+///////////////////////////////////////////////////////////////////////////
+static mxArray *tracked_to_struct(const kz::TrackedRecording &r)
+{
+    const int n = (int)r.timestamps_usec.size();
+    const int b = (int)r.max_bodies();
+    const int J = kz::NUM_JOINTS;
+
+    int time_dims[2] = {n, 1};
+    int id_dims[2] = {b, n};
+    int pos_dims[4] = {3, J, b, n};
+    int rgb_dims[4] = {2, J, b, n};
+    int orientation_dims[4] = {4, J, b, n};
+    int confidence_dims[3] = {J, b, n};
+    mxArray *time_mx = mxCreateNumericArray(2, time_dims, mxUINT64_CLASS, mxREAL);
+    mxArray *num_mx = mxCreateNumericArray(2, time_dims, mxUINT32_CLASS, mxREAL);
+    mxArray *id_mx = mxCreateNumericArray(2, id_dims, mxUINT32_CLASS, mxREAL);
+    mxArray *pos_mx = mxCreateNumericArray(4, pos_dims, mxSINGLE_CLASS, mxREAL);
+    mxArray *rgb_mx = mxCreateNumericArray(4, rgb_dims, mxINT32_CLASS, mxREAL);
+    mxArray *depth_mx = mxCreateNumericArray(4, rgb_dims, mxINT32_CLASS, mxREAL);
+    mxArray *orientation_mx = mxCreateNumericArray(4, orientation_dims, mxSINGLE_CLASS, mxREAL);
+    mxArray *confidence_mx = mxCreateNumericArray(3, confidence_dims, mxUINT8_CLASS, mxREAL);
+
+    uint64_t *times = (uint64_t *)mxGetData(time_mx);
+    uint32_t *nums = (uint32_t *)mxGetData(num_mx);
+    uint32_t *ids = (uint32_t *)mxGetData(id_mx);
+    float *pos = (float *)mxGetData(pos_mx);
+    int32_t *rgb = (int32_t *)mxGetData(rgb_mx);
+    int32_t *depth = (int32_t *)mxGetData(depth_mx);
+    float *orientation = (float *)mxGetData(orientation_mx);
+    uint8_t *confidence = (uint8_t *)mxGetData(confidence_mx);
+
+    size_t slots = (size_t)b * n;
+    std::fill(pos, pos + slots * J * 3, NAN);
+    std::fill(orientation, orientation + slots * J * 4, NAN);
+    std::fill(rgb, rgb + slots * J * 2, -1);
+    std::fill(depth, depth + slots * J * 2, -1);
+
+    for (int f = 0; f < n; f++) {
+        times[f] = r.timestamps_usec[f];
+        nums[f] = (uint32_t)r.bodies[f].size();
+        for (size_t i = 0; i < r.bodies[f].size(); i++) {
+            const kz::Body &body = r.bodies[f][i];
+            size_t slot = (size_t)f * b + i;
+            ids[slot] = body.id;
+            for (int j = 0; j < J; j++) {
+                size_t k = slot * J + j;
+                for (int c = 0; c < 3; c++)
+                    pos[3 * k + c] = body.position3d[j][c];
+                for (int c = 0; c < 4; c++)
+                    orientation[4 * k + c] = body.orientation[j][c];
+                for (int c = 0; c < 2; c++) {
+                    rgb[2 * k + c] = body.position2d_rgb[j][c];
+                    depth[2 * k + c] = body.position2d_depth[j][c];
+                }
+                confidence[k] = (uint8_t)body.confidence[j];
+            }
+        }
+    }
+
+    const char *field_names[] = {"Timestamps", "NumBodies", "Id", "Position3d",
+                                 "Position2d_rgb", "Position2d_depth", "Orientation",
+                                 "Confidence", "frames", "captures", "skipped", "failed",
+                                 "seconds", "fps"};
+    mwSize dims[2] = {1, 1};
+    mxArray *out = mxCreateStructArray(2, dims, 14, field_names);
+    mxArray *arrays[] = {time_mx, num_mx, id_mx, pos_mx, rgb_mx, depth_mx,
+                         orientation_mx, confidence_mx};
+    for (int i = 0; i < 8; i++)
+        mxSetFieldByNumber(out, 0, i, arrays[i]);
+    double stats[] = {(double)n, (double)r.captures, (double)r.skipped, (double)r.failed,
+                      r.seconds, r.fps()};
+    for (int i = 0; i < 6; i++)
+        mxSetFieldByNumber(out, 0, 8 + i, mxCreateDoubleScalar(stats[i]));
+    return out;
+}
+
+///////// Function: drain_log ///////////////////////////////////////////
+// Print the messages logged with KZ_LOG since the last call.
+// Must run on the MATLAB thread.
+///////////////////////////////////////////////////////////////////////////
+static void drain_log()
+{
+    static uint64_t reported_dropped = 0;
+    static const char *prefix[] = {"KinZ error: ", "KinZ warning: ", "", ""};
+
+    kz::log_drain([](const kz::LogEntry &e) {
+        if (e.suppressed)
+            mexPrintf("%s%s (%u similar messages suppressed)\n", prefix[e.level], e.text, e.suppressed);
+        else
+            mexPrintf("%s%s\n", prefix[e.level], e.text);
+    });
+
+    uint64_t dropped = kz::log_dropped();
+    if (dropped != reported_dropped) {
+        mexPrintf("KinZ warning: %llu log messages lost, the log buffer was full\n",
+                  (unsigned long long)(dropped - reported_dropped));
+        reported_dropped = dropped;
+    }
+}
+
+// Drains the log when mexFunction returns
+struct LogDrainGuard {
+    ~LogDrainGuard() { drain_log(); }
+};
 
 ///////// Function: mexFunction ///////////////////////////////////////////
 // Provides the interface of Matlab code with C++ code
 ///////////////////////////////////////////////////////////////////////////
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {   
+    // Messages of background threads and of the previous call
+    drain_log();
+    LogDrainGuard log_guard;
+
     // Get the command string
     char cmd[64];
 	if (nrhs < 1 || mxGetString(prhs[0], cmd, sizeof(cmd)))
@@ -38,6 +298,429 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         return;
     }
     
+    // New client of a KinZ_server. Input: shared memory name.
+    // Outputs: handle and [depthWidth depthHeight colorWidth colorHeight]
+    if (!strcmp("newshm", cmd))
+    {
+        if (nrhs < 2 || !mxIsChar(prhs[1]))
+            mexErrMsgTxt("newshm: The shared memory name is expected.");
+        char name[256];
+        mxGetString(prhs[1], name, sizeof(name));
+
+        KinZ *kinz = new KinZ(name);
+        plhs[0] = convertPtr2Mat<KinZ>(kinz);
+        if (nlhs > 1) {
+            int sizes[4];
+            kinz->get_image_sizes(sizes[0], sizes[1], sizes[2], sizes[3]);
+            plhs[1] = mxCreateDoubleMatrix(1, 4, mxREAL);
+            double *out = mxGetPr(plhs[1]);
+            for (int i = 0; i < 4; i++)
+                out[i] = sizes[i];
+        }
+        return;
+    }
+
+    // New offline KinZ. Inputs: flags, serial number or calibration file.
+    // Outputs: handle and [depthWidth depthHeight colorWidth colorHeight],
+    // all 0 when the calibration could not be read.
+    if (!strcmp("newoffline", cmd))
+    {
+        if (nrhs < 3 || !mxIsChar(prhs[2]))
+            mexErrMsgTxt("newoffline: The flags and calibration are expected.");
+        unsigned short int flags = *(unsigned short int *)mxGetData(prhs[1]);
+        char calibration[1024];
+        mxGetString(prhs[2], calibration, sizeof(calibration));
+
+        KinZ *kinz = new KinZ(flags, calibration);
+        plhs[0] = convertPtr2Mat<KinZ>(kinz);
+        if (nlhs > 1) {
+            int sizes[4];
+            kinz->get_image_sizes(sizes[0], sizes[1], sizes[2], sizes[3]);
+            plhs[1] = mxCreateDoubleMatrix(1, 4, mxREAL);
+            double *out = mxGetPr(plhs[1]);
+            for (int i = 0; i < 4; i++)
+                out[i] = sizes[i];
+        }
+        return;
+    }
+
+    // Tiled conversion speed on synthetic frames. Does not need a device.
+    // Inputs: width, height, vector of thread counts, iterations.
+    // Output: ms per frame for [color, 16-bit] conversions, one row per thread count.
+    if (!strcmp("benchtiling", cmd))
+    {
+        if (nrhs < 5)
+            mexErrMsgTxt("benchtiling: Unexpected arguments.");
+
+        int w = (int)mxGetScalar(prhs[1]);
+        int h = (int)mxGetScalar(prhs[2]);
+        size_t num_configs = mxGetNumberOfElements(prhs[3]);
+        double *threads = mxGetPr(prhs[3]);
+        int iterations = (int)mxGetScalar(prhs[4]);
+
+        std::vector<uint8_t> bgra((size_t)w * h * 4);
+        std::vector<uint8_t> depth((size_t)w * h * 2);
+        for (size_t i = 0; i < bgra.size(); i++)
+            bgra[i] = (uint8_t)(i * 31);
+        for (size_t i = 0; i < depth.size(); i++)
+            depth[i] = (uint8_t)(i * 17);
+
+        plhs[0] = mxCreateDoubleMatrix(num_configs, 2, mxREAL);
+        double *ms = mxGetPr(plhs[0]);
+        mxArray *rgb_mx = mxCreateNumericMatrix((size_t)w * h * 3, 1, mxUINT8_CLASS, mxREAL);
+        mxArray *u16_mx = mxCreateNumericMatrix((size_t)w * h, 1, mxUINT16_CLASS, mxREAL);
+        uint8_t *rgb = (uint8_t*)mxGetData(rgb_mx);
+        uint16_t *u16 = (uint16_t*)mxGetData(u16_mx);
+
+        kz::Region full(w, h);
+        for (size_t c = 0; c < num_configs; c++) {
+            kz::ThreadPool pool((unsigned)threads[c]);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int it = 0; it < iterations; it++)
+                kz::parallel_columns(pool, w, [&](int x0, int x1) {
+                    kz::bgra_to_rgb(bgra.data(), 4 * w, full, rgb, x0, x1);
+                });
+            auto middle = std::chrono::steady_clock::now();
+            for (int it = 0; it < iterations; it++)
+                kz::parallel_columns(pool, w, [&](int x0, int x1) {
+                    kz::u16_to_matlab(depth.data(), 2 * w, full, u16, x0, x1);
+                });
+            auto end = std::chrono::steady_clock::now();
+
+            ms[c] = std::chrono::duration<double, std::milli>(middle - start).count() / iterations;
+            ms[c + num_configs] = std::chrono::duration<double, std::milli>(end - middle).count() / iterations;
+        }
+        mxDestroyArray(rgb_mx);
+        mxDestroyArray(u16_mx);
+        return;
+    }
+
+    // Archive write speed on synthetic frames. Does not need a device.
+    // Inputs: path, number of frames, optional [depthWidth depthHeight
+    // colorWidth colorHeight] (default 640x576 depth, 1920x1080 color).
+    // Every frame is converted to the Matlab layout and appended with the
+    // depth, infrared, color and point cloud streams.
+    // Output: [MB/s, frames/s].
+    if (!strcmp("bencharchive", cmd))
+    {
+        if (nrhs < 3 || !mxIsChar(prhs[1]))
+            mexErrMsgTxt("bencharchive: Unexpected arguments.");
+        char path[1024];
+        mxGetString(prhs[1], path, sizeof(path));
+        int frames = (int)mxGetScalar(prhs[2]);
+        int sizes[4] = {640, 576, 1920, 1080};
+        if (nrhs > 3 && mxGetNumberOfElements(prhs[3]) == 4)
+            for (int i = 0; i < 4; i++)
+                sizes[i] = (int)mxGetPr(prhs[3])[i];
+        int dw = sizes[0], dh = sizes[1], cw = sizes[2], ch = sizes[3];
+
+        std::vector<uint8_t> bgra((size_t)cw * ch * 4);
+        std::vector<uint8_t> depth((size_t)dw * dh * 2);
+        for (size_t i = 0; i < bgra.size(); i++)
+            bgra[i] = (uint8_t)(i * 31);
+        for (size_t i = 0; i < depth.size(); i++)
+            depth[i] = (uint8_t)(i * 17);
+
+        kz::ArchiveWriter archive;
+        uint32_t streams = kz::ARCHIVE_DEPTH | kz::ARCHIVE_INFRARED |
+                           kz::ARCHIVE_COLOR | kz::ARCHIVE_POINTCLOUD;
+        if (!archive.open(path, streams, dw, dh, cw, ch))
+            mexErrMsgTxt("bencharchive: Cannot create the archive.");
+        const kz::ArchiveHeader &h = archive.header();
+        uint8_t *record = archive.record();
+
+        kz::ThreadPool pool;
+        kz::Region depth_full(dw, dh), color_full(cw, ch);
+        size_t num_points = (size_t)dw * dh;
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames && ok; f++) {
+            kz::ThreadPool::Group group;
+            pool.submit(group, [&] {
+                kz::parallel_columns(pool, cw, [&](int x0, int x1) {
+                    kz::bgra_to_rgb(bgra.data(), 4 * cw, color_full, record + h.color_offset, x0, x1);
+                });
+            });
+            pool.submit(group, [&] {
+                kz::u16_to_matlab(depth.data(), 2 * dw, depth_full,
+                                  (uint16_t *)(record + h.depth_offset), 0, dw);
+                kz::u16_to_matlab(depth.data(), 2 * dw, depth_full,
+                                  (uint16_t *)(record + h.infrared_offset), 0, dw);
+            });
+            pool.submit(group, [&] {
+                const uint16_t *z = (const uint16_t *)depth.data();
+                float *cloud = (float *)(record + h.pointcloud_offset);
+                for (size_t i = 0; i < num_points; i++) {
+                    cloud[i] = (float)(i % dw);
+                    cloud[i + num_points] = (float)(i / dw);
+                    cloud[i + 2 * num_points] = z[i];
+                }
+            });
+            pool.wait(group);
+            archive.info().valid = streams;
+            archive.info().depth_time = (uint64_t)f * 33333;
+            ok = archive.append();
+        }
+        ok = archive.close() && ok;
+        auto end = std::chrono::steady_clock::now();
+        if (!ok)
+            mexErrMsgTxt("bencharchive: Failed to write the archive.");
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        plhs[0] = mxCreateDoubleMatrix(1, 2, mxREAL);
+        double *out = mxGetPr(plhs[0]);
+        out[0] = (double)h.record_size * frames / seconds / 1e6;
+        out[1] = frames / seconds;
+        return;
+    }
+
+    // Compress 16-bit images (depth or infrared) with the lossless codec of
+    // KinZ_codec.h. Input: uint16 (H x W x N) array. Output: 1 x N cell of
+    // uint8 vectors. The frames are encoded concurrently.
+    if (!strcmp("compress", cmd))
+    {
+        if (nrhs < 2 || !mxIsUint16(prhs[1]))
+            mexErrMsgTxt("compress: A uint16 array is expected.");
+        const mwSize *dims = mxGetDimensions(prhs[1]);
+        mwSize num_dims = mxGetNumberOfDimensions(prhs[1]);
+        int h = (int)dims[0], w = (int)dims[1];
+        int n = num_dims > 2 ? (int)dims[2] : 1;
+        const uint16_t *images = (const uint16_t *)mxGetData(prhs[1]);
+
+        std::vector<std::vector<uint8_t> > encoded(n);
+        kz::ThreadPool pool(n > 1 ? 0 : 1);
+        pool.parallel_for(n, [&](int i) {
+            kz::codec_encode((const uint8_t *)(images + (size_t)i * w * h), w, h, 0,
+                             kz::CODEC_COLUMN_MAJOR, encoded[i]);
+        });
+
+        plhs[0] = mxCreateCellMatrix(1, n);
+        for (int i = 0; i < n; i++)
+            mxSetCell(plhs[0], i, bytes_to_mx(encoded[i]));
+        return;
+    }
+
+    // Decompress frames of compress or getdepthencoded. Input: a uint8
+    // vector or a cell of them, all of the same size. Output: uint16
+    // (H x W x N) array.
+    if (!strcmp("decompress", cmd))
+    {
+        if (nrhs < 2)
+            mexErrMsgTxt("decompress: Unexpected arguments.");
+        std::vector<const mxArray *> frames;
+        if (mxIsCell(prhs[1]))
+            for (size_t i = 0; i < mxGetNumberOfElements(prhs[1]); i++)
+                frames.push_back(mxGetCell(prhs[1], i));
+        else
+            frames.push_back(prhs[1]);
+
+        kz::CodecHeader first = kz::CodecHeader();
+        for (size_t i = 0; i < frames.size(); i++) {
+            kz::CodecHeader header;
+            if (!frames[i] || !mxIsUint8(frames[i]) ||
+                !kz::codec_header((const uint8_t *)mxGetData(frames[i]),
+                                  mxGetNumberOfElements(frames[i]), header))
+                mexErrMsgTxt("decompress: Invalid compressed frame.");
+            if (i == 0)
+                first = header;
+            else if (header.width != first.width || header.height != first.height)
+                mexErrMsgTxt("decompress: All the frames must have the same size.");
+        }
+
+        int dims[3] = {frames.empty() ? 0 : (int)first.height, frames.empty() ? 0 : (int)first.width,
+                       (int)frames.size()};
+        plhs[0] = mxCreateNumericArray(3, dims, mxUINT16_CLASS, mxREAL);
+        uint16_t *images = (uint16_t *)mxGetData(plhs[0]);
+        size_t frame_pixels = (size_t)dims[0] * dims[1];
+
+        int num_frames = (int)frames.size();
+        std::vector<uint8_t> ok(num_frames);
+        kz::ThreadPool pool(num_frames > 1 ? 0 : 1);
+        pool.parallel_for(num_frames, [&](int i) {
+            ok[i] = kz::codec_decode((const uint8_t *)mxGetData(frames[i]),
+                                     mxGetNumberOfElements(frames[i]),
+                                     images + i * frame_pixels);
+        });
+        if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+            mexErrMsgTxt("decompress: Corrupted compressed frame.");
+        return;
+    }
+
+    // Codec speed on recorded frames. Inputs: uint16 (H x W x N) array and
+    // vector of thread counts. Output: one row per thread count with
+    // [compression ratio, encode GB/s, decode GB/s] of the raw data rate.
+    if (!strcmp("benchcodec", cmd))
+    {
+        if (nrhs < 3 || !mxIsUint16(prhs[1]))
+            mexErrMsgTxt("benchcodec: Unexpected arguments.");
+        const mwSize *dims = mxGetDimensions(prhs[1]);
+        int h = (int)dims[0], w = (int)dims[1];
+        int n = mxGetNumberOfDimensions(prhs[1]) > 2 ? (int)dims[2] : 1;
+        const uint16_t *images = (const uint16_t *)mxGetData(prhs[1]);
+        size_t num_configs = mxGetNumberOfElements(prhs[2]);
+        double *threads = mxGetPr(prhs[2]);
+
+        std::vector<std::vector<uint8_t> > encoded(n);
+        std::vector<uint16_t> decoded((size_t)w * h * n);
+        double raw_bytes = 2.0 * w * h * n;
+
+        plhs[0] = mxCreateDoubleMatrix(num_configs, 3, mxREAL);
+        double *out = mxGetPr(plhs[0]);
+        for (size_t c = 0; c < num_configs; c++) {
+            kz::ThreadPool pool((unsigned)threads[c]);
+
+            auto start = std::chrono::steady_clock::now();
+            pool.parallel_for(n, [&](int i) {
+                kz::codec_encode((const uint8_t *)(images + (size_t)i * w * h), w, h, 0,
+                                 kz::CODEC_COLUMN_MAJOR, encoded[i]);
+            });
+            auto middle = std::chrono::steady_clock::now();
+            pool.parallel_for(n, [&](int i) {
+                kz::codec_decode(encoded[i].data(), encoded[i].size(),
+                                 decoded.data() + (size_t)i * w * h);
+            });
+            auto end = std::chrono::steady_clock::now();
+
+            double encoded_bytes = 0;
+            for (int i = 0; i < n; i++)
+                encoded_bytes += encoded[i].size();
+            out[c] = raw_bytes / encoded_bytes;
+            out[c + num_configs] = raw_bytes / std::chrono::duration<double>(middle - start).count() / 1e9;
+            out[c + 2 * num_configs] = raw_bytes / std::chrono::duration<double>(end - middle).count() / 1e9;
+        }
+        if (memcmp(decoded.data(), images, decoded.size() * sizeof(uint16_t)))
+            mexErrMsgTxt("benchcodec: The decoded frames differ from the input.");
+        return;
+    }
+
+    // Track the bodies of a recording as fast as the tracker goes. Does not
+    // need a device. Inputs: path, tracker options (see
+    // read_tracker_config). Output: struct of packed skeletons.
+    if (!strcmp("trackrecording", cmd))
+    {
+        if (nrhs < 4 || !mxIsChar(prhs[1]))
+            mexErrMsgTxt("trackrecording: Unexpected arguments.");
+        char path[1024];
+        mxGetString(prhs[1], path, sizeof(path));
+        kz::TrackerConfig config = read_tracker_config(nrhs, prhs, 2);
+
+        kz::TrackedRecording result;
+        std::string error;
+        if (!kz::track_recording(path, config, result, error))
+            mexErrMsgTxt(("trackrecording: " + error + ".").c_str());
+        plhs[0] = tracked_to_struct(result);
+        return;
+    }
+
+    // Print the pending log messages or, with an output, return them as a
+    // struct array with fields level, time (s), message and suppressed.
+    if (!strcmp("drainlog", cmd))
+    {
+        if (nlhs == 0) {
+            drain_log();
+            return;
+        }
+
+        std::vector<kz::LogEntry> entries;
+        kz::log_drain([&](const kz::LogEntry &e) { entries.push_back(e); });
+
+        static const char *level_names[] = {"error", "warning", "info", "debug"};
+        const char *field_names[] = {"level", "time", "message", "suppressed"};
+        mwSize dims[2] = {1, entries.size()};
+        plhs[0] = mxCreateStructArray(2, dims, 4, field_names);
+        for (size_t i = 0; i < entries.size(); i++) {
+            mxSetFieldByNumber(plhs[0], i, 0, mxCreateString(level_names[entries[i].level]));
+            mxSetFieldByNumber(plhs[0], i, 1, mxCreateDoubleScalar(entries[i].time));
+            mxSetFieldByNumber(plhs[0], i, 2, mxCreateString(entries[i].text));
+            mxSetFieldByNumber(plhs[0], i, 3, mxCreateDoubleScalar(entries[i].suppressed));
+        }
+        return;
+    }
+
+    // Set the most detailed level logged: 0 error, 1 warning, 2 info, 3 debug
+    if (!strcmp("setloglevel", cmd))
+    {
+        if (nrhs < 2)
+            mexErrMsgTxt("setloglevel: Unexpected arguments.");
+        int level = (int)mxGetScalar(prhs[1]);
+        kz::set_log_level((kz::LogLevel)std::max(0, std::min(3, level)));
+        return;
+    }
+
+    // Instruction set of the conversion kernels. Input (optional):
+    // 'auto', 'baseline' or 'avx2'. Output: name of the one in use.
+    if (!strcmp("setkernelisa", cmd))
+    {
+        if (nrhs > 1) {
+            char name[16];
+            if (!mxIsChar(prhs[1]) || mxGetString(prhs[1], name, sizeof(name)))
+                mexErrMsgTxt("setkernelisa: Unexpected arguments.");
+            if (!strcmp(name, "baseline"))
+                kz::set_kernel_isa(kz::ISA_BASELINE);
+            else if (!strcmp(name, "avx2") || !strcmp(name, "auto"))
+                kz::set_kernel_isa(kz::ISA_AVX2);
+            else
+                mexErrMsgTxt("setkernelisa: Unknown instruction set.");
+        }
+        plhs[0] = mxCreateString(kz::kernel_isa_name(kz::kernel_isa()));
+        return;
+    }
+
+    // Frame pool of the SDK images. Inputs: enable, huge pages, maximum
+    // cached MB. Output: true if the pool is in the requested state.
+    // The mex file stays loaded while the SDK uses the pool callbacks.
+    if (!strcmp("setframepool", cmd))
+    {
+        if (nrhs < 4)
+            mexErrMsgTxt("setframepool: Unexpected arguments.");
+        kz::FramePool &pool = kz::FramePool::instance();
+        bool was_enabled = pool.enabled();
+        bool ok;
+        if (mxGetScalar(prhs[1]) != 0) {
+            kz::FramePoolConfig config;
+            config.huge_pages = mxGetScalar(prhs[2]) != 0;
+            config.max_cached_bytes = (size_t)(std::max(0.0, mxGetScalar(prhs[3])) * (1 << 20));
+            ok = pool.enable(config);
+        }
+        else
+            ok = pool.disable();
+        if (pool.enabled() && !was_enabled)
+            mexLock();
+        else if (!pool.enabled() && was_enabled)
+            mexUnlock();
+        plhs[0] = mxCreateLogicalScalar(ok);
+        return;
+    }
+
+    // Counters of the frame pool, see kz::FramePoolStats
+    if (!strcmp("getframepoolstats", cmd))
+    {
+        kz::FramePool &pool = kz::FramePool::instance();
+        kz::FramePoolStats st = pool.stats();
+        const char *field_names[] = {"enabled", "allocations", "hits", "misses", "frees",
+                                     "released", "huge_page_buffers", "outstanding",
+                                     "bytes_in_use", "bytes_cached", "peak_bytes",
+                                     "page_faults"};
+        double values[] = {(double)pool.enabled(), (double)st.allocations, (double)st.hits,
+                           (double)st.misses, (double)st.frees, (double)st.released,
+                           (double)st.huge_page_buffers, (double)st.outstanding,
+                           (double)st.bytes_in_use, (double)st.bytes_cached,
+                           (double)st.peak_bytes, (double)st.page_faults};
+        const int num_fields = sizeof(field_names) / sizeof(field_names[0]);
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, num_fields, field_names);
+        for (int i = 0; i < num_fields; i++)
+            mxSetFieldByNumber(plhs[0], 0, i, mxCreateDoubleScalar(values[i]));
+        return;
+    }
+
+    if (!strcmp("resetframepoolstats", cmd))
+    {
+        kz::FramePool::instance().reset_stats();
+        return;
+    }
+
     // Check there is a second input, which should be the class instance handle
     if (nrhs < 2)
 		mexErrMsgTxt("Second input should be a class instance handle.");
@@ -54,6 +737,55 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     
     // Get the class instance pointer from the second input
     KinZ *KinZ_instance = convertMat2Ptr<KinZ>(prhs[1]);
+
+    // isReady method. Output: true once the initialization finished,
+    // without waiting for an asynchronous one.
+    if (!strcmp("isready", cmd))
+    {
+        plhs[0] = mxCreateLogicalScalar(KinZ_instance->is_ready());
+        return;
+    }
+
+    // Any other command waits for the initialization
+    KinZ_instance->wait_ready();
+
+    // getInitTiming method. Output: struct with ok and the ms of each step
+    if (!strcmp("getinittiming", cmd))
+    {
+        kz::InitTiming t = KinZ_instance->get_init_timing();
+        const char *field_names[] = {"ok", "open_ms", "calibration_ms", "start_ms",
+                                     "imu_ms", "tracker_ms", "warmup_ms", "total_ms"};
+        double values[] = {(double)t.ok, t.open_ms, t.calibration_ms, t.start_ms,
+                           t.imu_ms, t.tracker_ms, t.warmup_ms, t.total_ms};
+        const int num_fields = sizeof(field_names) / sizeof(field_names[0]);
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, num_fields, field_names);
+        for (int i = 0; i < num_fields; i++)
+            mxSetFieldByNumber(plhs[0], 0, i, mxCreateDoubleScalar(values[i]));
+        return;
+    }
+
+    // Command on a pinned frame: KinZ_mex('withframe', handle, frame, cmd,
+    // args...) runs cmd(handle, args...) with the getters reading frame
+    std::vector<const mxArray *> frame_args;
+    uint64_t frame = 0;
+    if (!strcmp("withframe", cmd))
+    {
+        if (nrhs < 4 || !mxIsNumeric(prhs[2]) || mxGetString(prhs[3], cmd, sizeof(cmd)))
+            mexErrMsgTxt("withframe: Unexpected arguments.");
+        if (!strcmp("getframes", cmd) || !strcmp("getall", cmd) || !strcmp("withframe", cmd))
+            mexErrMsgTxt("withframe: The command acquires frames.");
+        frame = (uint64_t)mxGetScalar(prhs[2]);
+        frame_args.push_back(prhs[3]);
+        frame_args.push_back(prhs[1]);
+        frame_args.insert(frame_args.end(), prhs + 4, prhs + nrhs);
+        prhs = frame_args.data();
+        nrhs = (int)frame_args.size();
+    }
+    kz::FrameScope::reset(*KinZ_instance);
+    kz::FrameScope frame_scope(*KinZ_instance, frame);
+    if (frame && !frame_scope.selected())
+        mexErrMsgTxt("withframe: Unknown or released frame.");
     
     // Call the KinZ methods
     
@@ -71,19 +803,424 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         
         // Call the class function
         KinZ_instance->get_frames(capture_flags, valid);
+
+        // Optional handle pinning the frame, 0 if not pinned
+        if (nlhs > 1) {
+            plhs[1] = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+            *(uint64_t *)mxGetData(plhs[1]) = valid[0] ? KinZ_instance->pin_frame() : 0;
+        }
         
         return;
     }
+
+    // releaseFrame method. Input: vector of frame handles, empty to
+    // release all the pinned frames. Output: number released.
+    if (!strcmp("releaseframe", cmd))
+    {
+        if (nrhs < 3 || !mxIsNumeric(prhs[2]))
+            mexErrMsgTxt("releaseframe: Unexpected arguments.");
+        size_t n = mxGetNumberOfElements(prhs[2]);
+        size_t released = 0;
+        if (n == 0) {
+            released = KinZ_instance->get_pinned_frames();
+            KinZ_instance->release_frames();
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t handle = mxIsUint64(prhs[2]) ? ((const uint64_t *)mxGetData(prhs[2]))[i]
+                                                  : (uint64_t)mxGetPr(prhs[2])[i];
+            released += KinZ_instance->release_frame(handle) ? 1 : 0;
+        }
+        plhs[0] = mxCreateDoubleScalar((double)released);
+        return;
+    }
+
+    // setMaxPinnedFrames method. Input: maximum number of pinned frames
+    if (!strcmp("setmaxpinnedframes", cmd))
+    {
+        if (nrhs < 3)
+            mexErrMsgTxt("setmaxpinnedframes: Unexpected arguments.");
+        KinZ_instance->set_max_pinned_frames((size_t)std::max(0.0, mxGetScalar(prhs[2])));
+        return;
+    }
+
+    // getPinnedFrames method. Output: [pinned, maximum]
+    if (!strcmp("getpinnedframes", cmd))
+    {
+        plhs[0] = mxCreateDoubleMatrix(1, 2, mxREAL);
+        mxGetPr(plhs[0])[0] = (double)KinZ_instance->get_pinned_frames();
+        mxGetPr(plhs[0])[1] = (double)KinZ_instance->get_max_pinned_frames();
+        return;
+    }
     
+    // getAll method
+    if (!strcmp("getall", cmd))
+    {
+        // Check parameters
+        if (nrhs < 7)
+            mexErrMsgTxt("getall: Unexpected arguments.");
+
+        uint16_t capture_flags = (int)mxGetScalar(prhs[2]);
+        int depthDim[2] = {(int)mxGetScalar(prhs[3]), (int)mxGetScalar(prhs[4])};
+        int colorDim[3] = {(int)mxGetScalar(prhs[5]), (int)mxGetScalar(prhs[6]), 3};
+        int emptyDim[3] = {0, 0, 0};
+
+        // Reserve space for the requested streams before capturing, so
+        // the conversions can write directly into the Matlab arrays
+        mxArray *depth_mx = NULL, *color_mx = NULL, *infrared_mx = NULL;
+        kz::Products products;
+        if (capture_flags & kz::DEPTH) {
+            depth_mx = mxCreateNumericArray(2, depthDim, mxUINT16_CLASS, mxREAL);
+            products.depth = (uint16_t*)mxGetData(depth_mx);
+        }
+        if (capture_flags & kz::COLOR) {
+            color_mx = mxCreateNumericArray(3, colorDim, mxUINT8_CLASS, mxREAL);
+            products.color = (uint8_t*)mxGetData(color_mx);
+        }
+        if (capture_flags & kz::INFRARED) {
+            infrared_mx = mxCreateNumericArray(2, depthDim, mxUINT16_CLASS, mxREAL);
+            products.infrared = (uint16_t*)mxGetData(infrared_mx);
+        }
+        products.bodies_requested = (capture_flags & kz::BODY_TRACKING) != 0;
+
+        // Call the class function
+        uint8_t valid;
+        KinZ_instance->get_all(capture_flags, products, &valid);
+
+        // Invalid or not requested streams are returned empty
+        if (!products.depth_valid) {
+            if (depth_mx) mxDestroyArray(depth_mx);
+            depth_mx = mxCreateNumericArray(2, emptyDim, mxUINT16_CLASS, mxREAL);
+        }
+        if (!products.color_valid) {
+            if (color_mx) mxDestroyArray(color_mx);
+            color_mx = mxCreateNumericArray(3, emptyDim, mxUINT8_CLASS, mxREAL);
+        }
+        if (!products.infrared_valid) {
+            if (infrared_mx) mxDestroyArray(infrared_mx);
+            infrared_mx = mxCreateNumericArray(2, emptyDim, mxUINT16_CLASS, mxREAL);
+        }
+
+        const char *field_names[] = {"valid", "depth", "depth_timestamp",
+                                     "color", "color_timestamp",
+                                     "infrared", "infrared_timestamp", "bodies"};
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, 8, field_names);
+
+        mxArray *valid_mx = mxCreateNumericMatrix(1, 1, mxINT8_CLASS, mxREAL);
+        *(uint8_t*)mxGetData(valid_mx) = valid;
+        mxArray *times_mx[3];
+        uint64_t times[3] = {products.depth_time, products.color_time, products.infrared_time};
+        for (int i = 0; i < 3; i++) {
+            times_mx[i] = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+            *(uint64_t*)mxGetData(times_mx[i]) = times[i];
+        }
+
+        mxSetFieldByNumber(plhs[0], 0, 0, valid_mx);
+        mxSetFieldByNumber(plhs[0], 0, 1, depth_mx);
+        mxSetFieldByNumber(plhs[0], 0, 2, times_mx[0]);
+        mxSetFieldByNumber(plhs[0], 0, 3, color_mx);
+        mxSetFieldByNumber(plhs[0], 0, 4, times_mx[1]);
+        mxSetFieldByNumber(plhs[0], 0, 5, infrared_mx);
+        mxSetFieldByNumber(plhs[0], 0, 6, times_mx[2]);
+        mxSetFieldByNumber(plhs[0], 0, 7, bodies_to_struct(products.bodies));
+
+        return;
+    }
+
+    // Burst capture. Inputs: capture flags, number of frames n, depth
+    // height and width, color height and width. Output: structure with
+    // the (h x w x n) depth and infrared and (h x w x 3 x n) color stacks
+    // of the requested streams (empty otherwise), (n x 3) uint64
+    // timestamps and logical valid, columns depth, color and infrared, and
+    // the number of captures received.
+    if (!strcmp("getburst", cmd))
+    {
+        if (nrhs < 8)
+            mexErrMsgTxt("getburst: Unexpected arguments.");
+
+        uint16_t capture_flags = (int)mxGetScalar(prhs[2]);
+        int n = (int)mxGetScalar(prhs[3]);
+        if (n < 1)
+            mexErrMsgTxt("getburst: The number of frames must be positive.");
+        int depthDim[3] = {(int)mxGetScalar(prhs[4]), (int)mxGetScalar(prhs[5]), n};
+        int colorDim[4] = {(int)mxGetScalar(prhs[6]), (int)mxGetScalar(prhs[7]), 3, n};
+        int emptyDim[2] = {0, 0};
+
+        // All the stacks are allocated before the first capture
+        kz::BurstStacks stacks;
+        stacks.n = n;
+        mxArray *depth_mx, *color_mx, *infrared_mx;
+        if (capture_flags & kz::DEPTH) {
+            depth_mx = mxCreateNumericArray(3, depthDim, mxUINT16_CLASS, mxREAL);
+            stacks.depth = (uint16_t*)mxGetData(depth_mx);
+        }
+        else
+            depth_mx = mxCreateNumericArray(2, emptyDim, mxUINT16_CLASS, mxREAL);
+        if (capture_flags & kz::COLOR) {
+            color_mx = mxCreateNumericArray(4, colorDim, mxUINT8_CLASS, mxREAL);
+            stacks.color = (uint8_t*)mxGetData(color_mx);
+        }
+        else
+            color_mx = mxCreateNumericArray(2, emptyDim, mxUINT8_CLASS, mxREAL);
+        if (capture_flags & kz::INFRARED) {
+            infrared_mx = mxCreateNumericArray(3, depthDim, mxUINT16_CLASS, mxREAL);
+            stacks.infrared = (uint16_t*)mxGetData(infrared_mx);
+        }
+        else
+            infrared_mx = mxCreateNumericArray(2, emptyDim, mxUINT16_CLASS, mxREAL);
+        mxArray *time_mx = mxCreateNumericMatrix(n, 3, mxUINT64_CLASS, mxREAL);
+        stacks.time = (uint64_t*)mxGetData(time_mx);
+        mxArray *valid_mx = mxCreateLogicalMatrix(n, 3);
+        stacks.valid = (uint8_t*)mxGetLogicals(valid_mx);
+
+        int received = KinZ_instance->get_burst(capture_flags, stacks);
+
+        const char *field_names[] = {"depth", "color", "infrared", "timestamps",
+                                     "valid", "captured"};
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, 6, field_names);
+        mxSetFieldByNumber(plhs[0], 0, 0, depth_mx);
+        mxSetFieldByNumber(plhs[0], 0, 1, color_mx);
+        mxSetFieldByNumber(plhs[0], 0, 2, infrared_mx);
+        mxSetFieldByNumber(plhs[0], 0, 3, time_mx);
+        mxSetFieldByNumber(plhs[0], 0, 4, valid_mx);
+        mxSetFieldByNumber(plhs[0], 0, 5, mxCreateDoubleScalar(received));
+        return;
+    }
+
+    // setThreads method
+    if (!strcmp("setthreads", cmd))
+    {
+        if (nrhs < 3)
+            mexErrMsgTxt("setthreads: Unexpected arguments.");
+
+        unsigned num_threads = (unsigned)mxGetScalar(prhs[2]);
+        std::vector<int> cpus;
+        if (nrhs > 3) {
+            double *cpu_list = mxGetPr(prhs[3]);
+            for (size_t i = 0; i < mxGetNumberOfElements(prhs[3]); i++)
+                cpus.push_back((int)cpu_list[i]);
+        }
+
+        if (!KinZ_instance->set_threads(num_threads, cpus))
+            mexErrMsgTxt("setthreads: The thread pool is busy.");
+        return;
+    }
+
+    // setDepthFilter method
+    // Input: structure with the fields of kz::DepthFilterConfig.
+    // Missing fields keep their default value.
+    if (!strcmp("setdepthfilter", cmd))
+    {
+        if (nrhs < 3 || !mxIsStruct(prhs[2]))
+            mexErrMsgTxt("setdepthfilter: Expected a configuration structure.");
+
+        kz::DepthFilterConfig config;
+        const mxArray *field;
+        if ((field = mxGetField(prhs[2], 0, "temporal")))
+            config.temporal = mxGetScalar(field) != 0;
+        if ((field = mxGetField(prhs[2], 0, "temporal_alpha")))
+            config.temporal_alpha = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "temporal_delta")))
+            config.temporal_delta = (uint16_t)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "spatial")))
+            config.spatial = mxGetScalar(field) != 0;
+        if ((field = mxGetField(prhs[2], 0, "spatial_radius")))
+            config.spatial_radius = (int)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "spatial_sigma_space")))
+            config.spatial_sigma_space = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "spatial_sigma_range")))
+            config.spatial_sigma_range = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "hole_filling")))
+            config.hole_filling = mxGetScalar(field) != 0;
+        if ((field = mxGetField(prhs[2], 0, "hole_filling_radius")))
+            config.hole_filling_radius = (int)mxGetScalar(field);
+
+        KinZ_instance->set_depth_filter(config);
+        return;
+    }
+
+    // getDepthFilterStats method
+    // Output: structure with the last and mean time (ms) of each stage
+    if (!strcmp("getdepthfilterstats", cmd))
+    {
+        kz::DepthFilterTimes last, mean;
+        uint64_t frames;
+        KinZ_instance->get_depth_filter_times(last, mean, frames);
+
+        const char *field_names[] = {"frames", "last", "mean"};
+        const char *time_names[] = {"temporal", "spatial", "hole_filling", "total"};
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, 3, field_names);
+
+        kz::DepthFilterTimes *times[2] = {&last, &mean};
+        for (int i = 0; i < 2; i++) {
+            mxArray *t = mxCreateStructArray(2, dims, 4, time_names);
+            mxSetFieldByNumber(t, 0, 0, mxCreateDoubleScalar(times[i]->temporal));
+            mxSetFieldByNumber(t, 0, 1, mxCreateDoubleScalar(times[i]->spatial));
+            mxSetFieldByNumber(t, 0, 2, mxCreateDoubleScalar(times[i]->hole_filling));
+            mxSetFieldByNumber(t, 0, 3, mxCreateDoubleScalar(times[i]->total));
+            mxSetFieldByNumber(plhs[0], 0, i + 1, t);
+        }
+        mxSetFieldByNumber(plhs[0], 0, 0, mxCreateDoubleScalar((double)frames));
+        return;
+    }
+
+    // setBackground method
+    // Input: structure with the fields of kz::BackgroundConfig. Missing
+    // fields keep their default value.
+    if (!strcmp("setbackground", cmd))
+    {
+        if (nrhs < 3 || !mxIsStruct(prhs[2]))
+            mexErrMsgTxt("setbackground: Expected a configuration structure.");
+
+        kz::BackgroundConfig config;
+        const mxArray *field;
+        if ((field = mxGetField(prhs[2], 0, "enabled")))
+            config.enabled = mxGetScalar(field) != 0;
+        if ((field = mxGetField(prhs[2], 0, "learning_rate")))
+            config.learning_rate = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "foreground_learning_rate")))
+            config.foreground_learning_rate = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "threshold")))
+            config.threshold = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "min_deviation")))
+            config.min_deviation = (float)mxGetScalar(field);
+        if ((field = mxGetField(prhs[2], 0, "relative_deviation")))
+            config.relative_deviation = (float)mxGetScalar(field);
+
+        KinZ_instance->set_background(config);
+        return;
+    }
+
+    if (!strcmp("resetbackground", cmd))
+    {
+        KinZ_instance->reset_background();
+        return;
+    }
+
+    // getForeground method. Outputs: logical mask (depth height x width)
+    // and timestamp, empty and 0 without depth or background model.
+    if (!strcmp("getforeground", cmd))
+    {
+        int dw, dh, cw, ch;
+        KinZ_instance->get_image_sizes(dw, dh, cw, ch);
+        uint64_t time = 0;
+        bool valid;
+        plhs[0] = mxCreateLogicalMatrix(dh, dw);
+        KinZ_instance->get_foreground((uint8_t *)mxGetLogicals(plhs[0]), time, valid);
+        if (!valid) {
+            mxDestroyArray(plhs[0]);
+            plhs[0] = mxCreateLogicalMatrix(0, 0);
+            time = 0;
+        }
+        if (nlhs > 1) {
+            plhs[1] = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+            *(uint64_t *)mxGetData(plhs[1]) = time;
+        }
+        return;
+    }
+
+    // getBackground method. Outputs: mean and standard deviation (single,
+    // depth height x width) and the number of frames learned
+    if (!strcmp("getbackground", cmd))
+    {
+        int dw, dh, cw, ch;
+        KinZ_instance->get_image_sizes(dw, dh, cw, ch);
+        plhs[0] = mxCreateNumericMatrix(dh, dw, mxSINGLE_CLASS, mxREAL);
+        mxArray *deviation = mxCreateNumericMatrix(dh, dw, mxSINGLE_CLASS, mxREAL);
+        uint64_t frames;
+        bool valid;
+        KinZ_instance->get_background((float *)mxGetData(plhs[0]), (float *)mxGetData(deviation),
+                                      frames, valid);
+        if (!valid) {
+            mxDestroyArray(plhs[0]);
+            mxDestroyArray(deviation);
+            plhs[0] = mxCreateNumericMatrix(0, 0, mxSINGLE_CLASS, mxREAL);
+            deviation = mxCreateNumericMatrix(0, 0, mxSINGLE_CLASS, mxREAL);
+        }
+        if (nlhs > 1) plhs[1] = deviation; else mxDestroyArray(deviation);
+        if (nlhs > 2) plhs[2] = mxCreateDoubleScalar((double)frames);
+        return;
+    }
+
+    // getframestats method
+    if (!strcmp("getframestats", cmd))
+    {
+        kz::FrameStats st;
+        KinZ_instance->get_frame_stats(st);
+
+        const char *field_names[] = {"captured", "timeouts", "failures", "sensor_dropped",
+                                     "consumer_skipped", "period_usec",
+                                     "last_timestamp_usec", "jitter_mean_usec",
+                                     "jitter_max_usec", "sync_offset_usec",
+                                     "sync_offset_mean_usec", "sync_offset_max_usec"};
+        double values[] = {(double)st.captured, (double)st.timeouts, (double)st.failures,
+                           (double)st.sensor_dropped, (double)st.consumer_skipped,
+                           (double)st.period_usec, (double)st.last_timestamp_usec,
+                           st.jitter_mean_usec, st.jitter_max_usec,
+                           (double)st.sync_offset_usec, st.sync_offset_mean_usec,
+                           (double)st.sync_offset_max_usec};
+        const int num_fields = sizeof(field_names) / sizeof(field_names[0]);
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, num_fields, field_names);
+        for (int i = 0; i < num_fields; i++)
+            mxSetFieldByNumber(plhs[0], 0, i, mxCreateDoubleScalar(values[i]));
+        return;
+    }
+
+    // resetframestats method
+    if (!strcmp("resetframestats", cmd))
+    {
+        KinZ_instance->reset_frame_stats();
+        return;
+    }
+
+    // archiveOpen method. Inputs: path and kz::ARCHIVE_* streams
+    if (!strcmp("archiveopen", cmd))
+    {
+        if (nrhs < 4 || !mxIsChar(prhs[2]))
+            mexErrMsgTxt("archiveopen: Unexpected arguments.");
+        char path[1024];
+        mxGetString(prhs[2], path, sizeof(path));
+        uint32_t streams = (uint32_t)mxGetScalar(prhs[3]);
+        if (!KinZ_instance->archive_open(path, streams))
+            mexErrMsgTxt("archiveopen: Cannot create the archive.");
+        return;
+    }
+
+    // archiveWrite method. Outputs: 1-based frame number and valid streams
+    if (!strcmp("archivewrite", cmd))
+    {
+        uint64_t frame;
+        uint32_t valid;
+        if (!KinZ_instance->archive_write(frame, valid))
+            mexErrMsgTxt("archivewrite: Failed to write the frame.");
+        plhs[0] = mxCreateDoubleScalar((double)(frame + 1));
+        if (nlhs > 1)
+            plhs[1] = mxCreateDoubleScalar(valid);
+        return;
+    }
+
+    // archiveClose method. Output: number of frames written
+    if (!strcmp("archiveclose", cmd))
+    {
+        uint64_t frames = KinZ_instance->archive_close();
+        if (nlhs > 0)
+            plhs[0] = mxCreateDoubleScalar((double)frames);
+        return;
+    }
+
     // getDepth method
     if (!strcmp("getdepth", cmd)) 
     {        
          int height, width;
          height = (int)mxGetScalar(prhs[2]); 
          width = (int)mxGetScalar(prhs[3]); 
+         kz::Region roi = read_region(nrhs, prhs, 4, width, height);
 
          uint16_t *depth; // pointer to output data 0
-         int depthDim[2]={height,width};
+         int depthDim[2]={roi.out_height(),roi.out_width()};
          int invalidDepth[2] = {0,0};
          int timeDim[2] = {1,1};
          
@@ -100,7 +1237,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         
         // Call the class function
         bool validDepth;
-        KinZ_instance->get_depth(depth, *timeStamp, validDepth);
+        KinZ_instance->get_depth(depth, *timeStamp, validDepth, roi);
         
         if(!validDepth)
         {
@@ -111,15 +1248,85 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         return;
     }
 
+    // Replace the depth of the frame. Input: uint16 depth image.
+    if (!strcmp("setdepth", cmd))
+    {
+        if (nrhs < 3 || !mxIsUint16(prhs[2]) || mxGetNumberOfDimensions(prhs[2]) != 2)
+            mexErrMsgTxt("setdepth: A uint16 depth image is expected.");
+        int height = (int)mxGetM(prhs[2]);
+        int width = (int)mxGetN(prhs[2]);
+        if (!KinZ_instance->set_depth((uint16_t *)mxGetData(prhs[2]), width, height))
+            mexErrMsgTxt("setdepth: The image size does not match the depth camera.");
+        return;
+    }
+
+    // Replace the color of the frame. Input: uint8 RGB image.
+    if (!strcmp("setcolor", cmd))
+    {
+        if (nrhs < 3 || !mxIsUint8(prhs[2]) || mxGetNumberOfDimensions(prhs[2]) != 3 ||
+            mxGetDimensions(prhs[2])[2] != 3)
+            mexErrMsgTxt("setcolor: A uint8 RGB image is expected.");
+        const mwSize *dims = mxGetDimensions(prhs[2]);
+        if (!KinZ_instance->set_color((uint8_t *)mxGetData(prhs[2]), (int)dims[1], (int)dims[0]))
+            mexErrMsgTxt("setcolor: The image size does not match the color camera.");
+        return;
+    }
+
+    if (!strcmp("getserialnumber", cmd))
+    {
+        plhs[0] = mxCreateString(KinZ_instance->get_serial_number().c_str());
+        return;
+    }
+
+    // Batch geometry of stored depth images. Input: (h x w x n) uint16
+    // depth of the size of the depth camera. Output: single (w*h x 3 x n)
+    // point clouds, uint16 (colorHeight x colorWidth x n) aligned depth or
+    // uint16 (h x w x n) undistorted depth.
+    if (!strcmp("batchpointcloud", cmd) || !strcmp("batchdepthaligned", cmd) ||
+        !strcmp("batchundistort", cmd))
+    {
+        int width, height, n;
+        if (nrhs < 3 || !read_depth_stack(prhs[2], width, height, n))
+            mexErrMsgTxt("batch: A (height x width x n) uint16 depth array is expected.");
+        const uint16_t *depth = (const uint16_t *)mxGetData(prhs[2]);
+        bool ok;
+        if (!strcmp("batchpointcloud", cmd)) {
+            int dims[3] = {width * height, 3, n};
+            plhs[0] = mxCreateNumericArray(3, dims, mxSINGLE_CLASS, mxREAL);
+            ok = KinZ_instance->batch_pointcloud(depth, width, height, n,
+                                                 (float *)mxGetData(plhs[0]));
+        }
+        else if (!strcmp("batchdepthaligned", cmd)) {
+            int dw, dh, cw, ch;
+            KinZ_instance->get_image_sizes(dw, dh, cw, ch);
+            int dims[3] = {ch, cw, n};
+            plhs[0] = mxCreateNumericArray(3, dims, mxUINT16_CLASS, mxREAL);
+            ok = KinZ_instance->batch_depth_aligned(depth, width, height, n,
+                                                    (uint16_t *)mxGetData(plhs[0]));
+        }
+        else {
+            int dims[3] = {height, width, n};
+            plhs[0] = mxCreateNumericArray(3, dims, mxUINT16_CLASS, mxREAL);
+            ok = KinZ_instance->batch_undistort_depth(depth, width, height, n,
+                                                      (uint16_t *)mxGetData(plhs[0]));
+        }
+        if (!ok) {
+            mxDestroyArray(plhs[0]);
+            mexErrMsgTxt("batch: The depth size does not match the calibration, or a camera is not calibrated.");
+        }
+        return;
+    }
+
     // getDepthAligned method
     if (!strcmp("getdepthaligned", cmd)) 
     {        
          int height, width;
          height = (int)mxGetScalar(prhs[2]); 
          width = (int)mxGetScalar(prhs[3]); 
+         kz::Region roi = read_region(nrhs, prhs, 4, width, height);
 
          uint16_t *depth; // pointer to output data 0
-         int depthDim[2]={height,width};
+         int depthDim[2]={roi.out_height(),roi.out_width()};
          int invalidDepth[2] = {0,0};
          int timeDim[2] = {1,1};
          
@@ -136,7 +1343,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         
         // Call the class function
         bool validDepth;
-        KinZ_instance->get_depth_aligned(depth, *timeStamp, validDepth);
+        KinZ_instance->get_depth_aligned(depth, *timeStamp, validDepth, roi);
         
         if(!validDepth)
         {
@@ -153,9 +1360,10 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         int height, width;  
         height = (int)mxGetScalar(prhs[2]); 
         width = (int)mxGetScalar(prhs[3]); 
+        kz::Region roi = read_region(nrhs, prhs, 4, width, height);
 
         uint8_t *rgbImage;    // pointer to output data
-        int colorDim[3]={height,width,3};
+        int colorDim[3]={roi.out_height(),roi.out_width(),3};
         int invalidColor[3] = {0,0,0};
         int timeDim[2] = {1,1};
         
@@ -174,7 +1382,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
       
         // Call the class function
         bool validColor;
-        KinZ_instance->get_color(rgbImage, *timeStamp, validColor);
+        KinZ_instance->get_color(rgbImage, *timeStamp, validColor, roi);
         
         if(!validColor)
         {
@@ -191,9 +1399,10 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
          int height, width;
          height = (int)mxGetScalar(prhs[2]); 
          width = (int)mxGetScalar(prhs[3]); 
+         kz::Region roi = read_region(nrhs, prhs, 4, width, height);
 
          uint8_t *color; // pointer to output data 0
-         int colorDim[3]={height,width,3};
+         int colorDim[3]={roi.out_height(),roi.out_width(),3};
          int invalidColor[3] = {0,0,0};
          int timeDim[2] = {1,1};
          
@@ -210,7 +1419,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         
         // Call the class function
         bool validColor;
-        KinZ_instance->get_color_aligned(color, *timeStamp, validColor);
+        KinZ_instance->get_color_aligned(color, *timeStamp, validColor, roi);
         
         if(!validColor)
         {
@@ -227,9 +1436,10 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         int height, width;  
         height = (int)mxGetScalar(prhs[2]); 
         width = (int)mxGetScalar(prhs[3]); 
+        kz::Region roi = read_region(nrhs, prhs, 4, width, height);
 
         uint16_t *infrared;   // pointer to output data
-        int infraredDim[2]={height,width};
+        int infraredDim[2]={roi.out_height(),roi.out_width()};
         int invalidInfrared[2] = {0,0};
         int timeDim[2] = {1,1};
         
@@ -248,7 +1458,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
       
         // Call the class function
         bool validInfrared;
-        KinZ_instance->get_infrared(infrared, *timeStamp, validInfrared);
+        KinZ_instance->get_infrared(infrared, *timeStamp, validInfrared, roi);
         
         if(!validInfrared)
         {
@@ -259,6 +1469,66 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         return;
     }
 
+    // getDepthEncoded / getInfraredEncoded methods.
+    // Outputs: compressed frame (uint8 vector) and timestamp
+    if (!strcmp("getdepthencoded", cmd) || !strcmp("getinfraredencoded", cmd))
+    {
+        std::vector<uint8_t> data;
+        uint64_t time = 0;
+        bool valid;
+        if (!strcmp("getdepthencoded", cmd))
+            KinZ_instance->get_depth_encoded(data, time, valid);
+        else
+            KinZ_instance->get_infrared_encoded(data, time, valid);
+        if (!valid) {
+            data.clear();
+            time = 0;
+        }
+
+        plhs[0] = bytes_to_mx(data);
+        if (nlhs > 1) {
+            plhs[1] = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+            *(uint64_t *)mxGetData(plhs[1]) = time;
+        }
+        return;
+    }
+
+    // Undistorted depth, infrared or color of the frame, the size of the
+    // camera. Outputs: image and timestamp, empty and 0 without a frame.
+    if (!strcmp("getdepthundistorted", cmd) || !strcmp("getinfraredundistorted", cmd) ||
+        !strcmp("getcolorundistorted", cmd))
+    {
+        int dw, dh, cw, ch;
+        KinZ_instance->get_image_sizes(dw, dh, cw, ch);
+        bool color = !strcmp("getcolorundistorted", cmd);
+        int dims[3] = {color ? ch : dh, color ? cw : dw, 3};
+        int emptyDim[3] = {0, 0, 0};
+        uint64_t time = 0;
+        bool valid;
+        if (color) {
+            plhs[0] = mxCreateNumericArray(3, dims, mxUINT8_CLASS, mxREAL);
+            KinZ_instance->get_color_undistorted((uint8_t *)mxGetData(plhs[0]), time, valid);
+        }
+        else {
+            plhs[0] = mxCreateNumericArray(2, dims, mxUINT16_CLASS, mxREAL);
+            if (!strcmp("getdepthundistorted", cmd))
+                KinZ_instance->get_depth_undistorted((uint16_t *)mxGetData(plhs[0]), time, valid);
+            else
+                KinZ_instance->get_infrared_undistorted((uint16_t *)mxGetData(plhs[0]), time, valid);
+        }
+        if (!valid) {
+            mxDestroyArray(plhs[0]);
+            plhs[0] = mxCreateNumericArray(color ? 3 : 2, emptyDim,
+                                           color ? mxUINT8_CLASS : mxUINT16_CLASS, mxREAL);
+            time = 0;
+        }
+        if (nlhs > 1) {
+            plhs[1] = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+            *(uint64_t *)mxGetData(plhs[1]) = time;
+        }
+        return;
+    }
+
     // getDepthCalibration method
     if (!strcmp("getcalibration", cmd)) 
     { 
@@ -380,6 +1650,15 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     }
 
     #ifdef BODY
+    // setTrackerConfig method. Inputs: tracker options (see
+    // read_tracker_config). Output: false if the tracker did not restart.
+    if (!strcmp("settrackerconfig", cmd))
+    {
+        kz::TrackerConfig config = read_tracker_config(nrhs, prhs, 2);
+        plhs[0] = mxCreateLogicalScalar(KinZ_instance->set_tracker_config(config));
+        return;
+    }
+
     // getNumBodies method
     if (!strcmp("getnumbodies", cmd)) 
     {
@@ -395,105 +1674,9 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     // getBodies method
     if (!strcmp("getbodies", cmd)) 
     {
-        //Assign field names
-        const char *field_names[] = {"Id", "Position3d", "Position2d_rgb", "Position2d_depth",
-                                     "Orientation", "Confidence"};
-        
-        // Call the class function
-        k4abt_frame_t body_frame;
-        k4a_calibration_t calibration;
-        KinZ_instance->get_bodies(body_frame, calibration);
-
-        // number of bodies detected        
-        int num_bodies = k4abt_frame_get_num_bodies(body_frame);
-        
-        //Allocate memory for the structure
-        mwSize dims[2] = {1, num_bodies};
-        plhs[0] = mxCreateStructArray(2,dims,6,field_names);
-        
-        // Copy the body data to the output matrices
-        for (uint32_t i = 0; i < num_bodies; i++) {
-            k4abt_body_t body;
-            if (k4abt_frame_get_body_skeleton(body_frame, i, &body.skeleton) == K4A_RESULT_SUCCEEDED) {
-                body.id = k4abt_frame_get_body_id(body_frame, i);
-
-                // output data
-                mxArray *body_id_mx, *position3d_mx, *orientation_mx, *confidence_mx;
-                mxArray *position2d_rgb_mx, *position2d_depth_mx;
-            
-                //Create mxArray data structures to hold the data
-                //to be assigned for the structure.
-                body_id_mx = mxCreateNumericMatrix(1, 1, mxUINT32_CLASS, mxREAL);
-                uint32_t *bodyIdptr = (uint32_t*)mxGetPr(body_id_mx);
-                position3d_mx  = mxCreateDoubleMatrix(3, 32, mxREAL);
-                double* pos3dptr = (double*)mxGetPr(position3d_mx);
-                position2d_rgb_mx  = mxCreateNumericMatrix(2, 32, mxUINT32_CLASS, mxREAL);
-                uint32_t* pos2d_rgbptr = (uint32_t*)mxGetPr(position2d_rgb_mx);
-                position2d_depth_mx  = mxCreateNumericMatrix(2, 32, mxUINT32_CLASS, mxREAL);
-                uint32_t* pos2d_depthptr = (uint32_t*)mxGetPr(position2d_depth_mx);
-                orientation_mx  = mxCreateDoubleMatrix(4,32,mxREAL);
-                double* orientationptr = (double*)mxGetPr(orientation_mx);
-                confidence_mx = mxCreateNumericMatrix(1, 32, mxUINT32_CLASS, mxREAL);
-                uint32_t *confidenceptr = (uint32_t*)mxGetPr(confidence_mx);
-
-                bodyIdptr[0] = (uint32_t)body.id;
-        
-                // For each joint
-                for(int j=0; j<32; j++)
-                {
-                    k4a_float3_t position = body.skeleton.joints[j].position;
-                    k4a_quaternion_t orientation = body.skeleton.joints[j].orientation;
-                    k4abt_joint_confidence_level_t confidence_level = body.skeleton.joints[j].confidence_level;
-
-                    // Copy joints position to output matrix 
-                    pos3dptr[j*3] = position.v[0];
-                    pos3dptr[j*3 + 1] = position.v[1];
-                    pos3dptr[j*3 + 2] = position.v[2];
-                    
-                    // Copy joints orientations to output matrix
-                    orientationptr[j*4] = orientation.v[0];
-                    orientationptr[j*4 + 1] = orientation.v[1];
-                    orientationptr[j*4 + 2] = orientation.v[2];
-                    orientationptr[j*4 + 3] = orientation.v[3];
-
-                    // Copy joints tracking state to output matrix
-                    confidenceptr[j] = (uint32_t)confidence_level;
-
-                    // project the 3D coordinates to the color and depth cameras
-                    k4a_float2_t color_coords, depth_coords;
-                    int val;
-                    if (k4a_calibration_3d_to_2d(&calibration, &position, 
-                                                K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_COLOR,
-                                                &color_coords, &val) == K4A_RESULT_SUCCEEDED) {
-                        pos2d_rgbptr[j*2] = (int)color_coords.xy.x;
-                        pos2d_rgbptr[j*2 + 1] = (int)color_coords.xy.y;
-                    }
-                    else {
-                        pos2d_rgbptr[j*2] = -1;
-                        pos2d_rgbptr[j*2 + 1] = -1;
-                    }
-
-                    if (k4a_calibration_3d_to_2d(&calibration, &position, 
-                                                K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH,
-                                                &depth_coords, &val) == K4A_RESULT_SUCCEEDED) {
-                        pos2d_depthptr[j*2] = (int)depth_coords.xy.x;
-                        pos2d_depthptr[j*2 + 1] = (int)depth_coords.xy.y;
-                    }
-                    else {
-                        pos2d_depthptr[j*2] = -1;
-                        pos2d_depthptr[j*2 + 1] = -1;
-                    }
-                }
-                
-                //Assign the output matrices to the struct
-                mxSetFieldByNumber(plhs[0],i,0, body_id_mx);
-                mxSetFieldByNumber(plhs[0],i,1, position3d_mx);
-                mxSetFieldByNumber(plhs[0],i,2, position2d_rgb_mx);
-                mxSetFieldByNumber(plhs[0],i,3, position2d_depth_mx);
-                mxSetFieldByNumber(plhs[0],i,4, orientation_mx);
-                mxSetFieldByNumber(plhs[0],i,5, confidence_mx);
-            } // if valid body_frame
-        } // for each body
+        std::vector<kz::Body> bodies;
+        KinZ_instance->get_bodies(bodies);
+        plhs[0] = bodies_to_struct(bodies);
         
         return;
     }
@@ -538,12 +1721,205 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     }
     #endif
 
+    // savePointCloud method. Inputs: path (.ply or .pcd), with color,
+    // compact. Output: true if the cloud was queued.
+    if (!strcmp("savepointcloud", cmd))
+    {
+        if (nrhs < 5 || !mxIsChar(prhs[2]))
+            mexErrMsgTxt("savepointcloud: Unexpected arguments.");
+        char path[1024];
+        mxGetString(prhs[2], path, sizeof(path));
+        bool color = mxGetScalar(prhs[3]) != 0;
+        bool compact = mxGetScalar(prhs[4]) != 0;
+
+        bool queued;
+        KinZ_instance->save_pointcloud(path, color, compact, queued);
+        plhs[0] = mxCreateLogicalScalar(queued);
+        return;
+    }
+
+    // setCloudWriter method. Inputs: queue size, block when full
+    if (!strcmp("setcloudwriter", cmd))
+    {
+        if (nrhs < 4)
+            mexErrMsgTxt("setcloudwriter: Unexpected arguments.");
+        KinZ_instance->set_cloud_writer((int)mxGetScalar(prhs[2]), mxGetScalar(prhs[3]) != 0);
+        return;
+    }
+
+    // getCloudWriterStats method
+    if (!strcmp("getcloudwriterstats", cmd))
+    {
+        kz::CloudWriterStats st;
+        KinZ_instance->get_cloud_writer_stats(st);
+
+        const char *field_names[] = {"submitted", "written", "failed", "dropped",
+                                     "waited", "wait_ms", "write_ms_mean", "bytes",
+                                     "queue_size", "pending", "max_pending"};
+        double values[] = {(double)st.submitted, (double)st.written, (double)st.failed,
+                           (double)st.dropped, (double)st.waited, st.wait_ms,
+                           st.write_ms_mean, (double)st.bytes, (double)st.queue_size,
+                           (double)st.pending, (double)st.max_pending};
+        const int num_fields = sizeof(field_names) / sizeof(field_names[0]);
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, num_fields, field_names);
+        for (int i = 0; i < num_fields; i++)
+            mxSetFieldByNumber(plhs[0], 0, i, mxCreateDoubleScalar(values[i]));
+        return;
+    }
+
+    // flushClouds method
+    if (!strcmp("flushclouds", cmd))
+    {
+        KinZ_instance->flush_clouds();
+        return;
+    }
+
+    // setReprojection method. Input: 1 = native engine, 0 = SDK
+    if (!strcmp("setreprojection", cmd))
+    {
+        if (nrhs < 3)
+            mexErrMsgTxt("setreprojection: Unexpected arguments.");
+        KinZ_instance->set_reprojection(mxGetScalar(prhs[2]) != 0);
+        return;
+    }
+
+    // validateReprojection method. Output: struct comparing the native
+    // engine with the SDK on the last frames
+    if (!strcmp("validatereprojection", cmd))
+    {
+        kz::ReprojectionReport r;
+        if (!KinZ_instance->validate_reprojection(r))
+            mexErrMsgTxt("validatereprojection: Needs depth, color and a calibrated device.");
+
+        const char *field_names[] = {"depth_common", "depth_sdk_only", "depth_native_only",
+                                     "depth_mean_abs_mm", "depth_p99_abs_mm", "depth_agreement",
+                                     "depth_sdk_ms", "depth_native_ms", "color_common",
+                                     "color_mean_abs", "color_agreement", "color_sdk_ms",
+                                     "color_native_ms", "pass"};
+        double values[] = {(double)r.depth_common, (double)r.depth_sdk_only,
+                           (double)r.depth_native_only, r.depth_mean_abs_mm,
+                           r.depth_p99_abs_mm, r.depth_agreement, r.depth_sdk_ms,
+                           r.depth_native_ms, (double)r.color_common, r.color_mean_abs,
+                           r.color_agreement, r.color_sdk_ms, r.color_native_ms};
+        const int num_fields = sizeof(field_names) / sizeof(field_names[0]);
+        mwSize dims[2] = {1, 1};
+        plhs[0] = mxCreateStructArray(2, dims, num_fields, field_names);
+        for (int i = 0; i < num_fields - 1; i++)
+            mxSetFieldByNumber(plhs[0], 0, i, mxCreateDoubleScalar(values[i]));
+        mxSetFieldByNumber(plhs[0], 0, num_fields - 1, mxCreateLogicalScalar(r.pass));
+        return;
+    }
+
+    // mapPixels method. Inputs: camera of the pixels (1 depth, 2 color)
+    // and the (n x 2) double 0-based pixels. Outputs: points (n x 3),
+    // pixels in the other camera (n x 2) and valid (n x 1), all NaN and
+    // false without a depth frame.
+    if (!strcmp("mappixels", cmd))
+    {
+        if (nrhs < 4 || !mxIsDouble(prhs[3]) || mxGetN(prhs[3]) != 2)
+            mexErrMsgTxt("mappixels: pixels must be an n x 2 double matrix.");
+        k4a_calibration_type_t camera = mxGetScalar(prhs[2]) == 2 ?
+            K4A_CALIBRATION_TYPE_COLOR : K4A_CALIBRATION_TYPE_DEPTH;
+        size_t n = mxGetM(prhs[3]);
+        plhs[0] = mxCreateDoubleMatrix(n, 3, mxREAL);
+        mxArray *other = mxCreateDoubleMatrix(n, 2, mxREAL);
+        mxArray *valid = mxCreateLogicalMatrix(n, 1);
+        if (!KinZ_instance->map_pixels(camera, mxGetPr(prhs[3]), n, mxGetPr(plhs[0]),
+                                       mxGetPr(other), (uint8_t *)mxGetLogicals(valid))) {
+            std::fill(mxGetPr(plhs[0]), mxGetPr(plhs[0]) + 3 * n, NAN);
+            std::fill(mxGetPr(other), mxGetPr(other) + 2 * n, NAN);
+            std::fill(mxGetLogicals(valid), mxGetLogicals(valid) + n, false);
+        }
+        if (nlhs > 1) plhs[1] = other; else mxDestroyArray(other);
+        if (nlhs > 2) plhs[2] = valid; else mxDestroyArray(valid);
+        return;
+    }
+
+    // getForegroundPointCloud method. Inputs: depth height and width, with
+    // color and the region. Outputs: xyz (n x 3) and rgb (n x 3) of the
+    // foreground pixels only.
+    if (!strcmp("getforegroundpointcloud", cmd))
+    {
+        if (nrhs < 5)
+            mexErrMsgTxt("getforegroundpointcloud: Unexpected arguments.");
+        int height = (int)mxGetScalar(prhs[2]);
+        int width = (int)mxGetScalar(prhs[3]);
+        bool withColor = mxGetScalar(prhs[4]) != 0;
+        kz::Region roi = read_region(nrhs, prhs, 5, width, height);
+        if (roi.scale > 1)
+            mexErrMsgTxt("getforegroundpointcloud: Use 'step' to decimate the cloud.");
+
+        mxArray *xyz_mx = NULL, *rgb_mx = NULL;
+        bool validData;
+        KinZ_instance->get_foreground_pointcloud(roi, withColor,
+            [&](size_t num_points, double *&xyz, uint8_t *&rgb) {
+                xyz_mx = mxCreateDoubleMatrix(num_points, 3, mxREAL);
+                rgb_mx = mxCreateNumericMatrix(withColor ? num_points : 0, 3, mxUINT8_CLASS, mxREAL);
+                xyz = mxGetPr(xyz_mx);
+                rgb = withColor ? (uint8_t *)mxGetData(rgb_mx) : NULL;
+            }, validData);
+
+        if (!validData) {
+            if (xyz_mx) mxDestroyArray(xyz_mx);
+            if (rgb_mx) mxDestroyArray(rgb_mx);
+            xyz_mx = mxCreateDoubleMatrix(0, 3, mxREAL);
+            rgb_mx = mxCreateNumericMatrix(0, 3, mxUINT8_CLASS, mxREAL);
+        }
+        plhs[0] = xyz_mx;
+        if (nlhs > 1)
+            plhs[1] = rgb_mx;
+        else
+            mxDestroyArray(rgb_mx);
+        return;
+    }
+
+    // getPointCloudColor method. Inputs: color height and width, with
+    // color, compact and the region. Outputs: xyz (n x 3) and rgb (n x 3)
+    // in the color camera geometry.
+    if (!strcmp("getpointcloudcolor", cmd))
+    {
+        if (nrhs < 6)
+            mexErrMsgTxt("getpointcloudcolor: Unexpected arguments.");
+        int height = (int)mxGetScalar(prhs[2]);
+        int width = (int)mxGetScalar(prhs[3]);
+        bool withColor = mxGetScalar(prhs[4]) != 0;
+        bool compact = mxGetScalar(prhs[5]) != 0;
+        kz::Region roi = read_region(nrhs, prhs, 6, width, height);
+        if (roi.scale > 1)
+            mexErrMsgTxt("getpointcloudcolor: Use 'step' to decimate the cloud.");
+
+        mxArray *xyz_mx = NULL, *rgb_mx = NULL;
+        bool validData;
+        KinZ_instance->get_pointcloud_color(roi, compact,
+            [&](size_t num_points, double *&xyz, uint8_t *&rgb) {
+                xyz_mx = mxCreateDoubleMatrix(num_points, 3, mxREAL);
+                rgb_mx = mxCreateNumericMatrix(withColor ? num_points : 0, 3, mxUINT8_CLASS, mxREAL);
+                xyz = mxGetPr(xyz_mx);
+                rgb = withColor ? (uint8_t *)mxGetData(rgb_mx) : NULL;
+            }, validData);
+
+        if (!validData) {
+            if (xyz_mx) mxDestroyArray(xyz_mx);
+            if (rgb_mx) mxDestroyArray(rgb_mx);
+            xyz_mx = mxCreateDoubleMatrix(0, 3, mxREAL);
+            rgb_mx = mxCreateNumericMatrix(0, 3, mxUINT8_CLASS, mxREAL);
+        }
+        plhs[0] = xyz_mx;
+        if (nlhs > 1)
+            plhs[1] = rgb_mx;
+        else
+            mxDestroyArray(rgb_mx);
+        return;
+    }
+
     // getPointCloud method
     if (!strcmp("getpointcloud", cmd)) 
     {        
         int height, width;
         height = (int)mxGetScalar(prhs[2]); 
         width = (int)mxGetScalar(prhs[3]);
+        kz::Region roi = read_region(nrhs, prhs, 5, width, height);
          
         // Get input parameter:
         // 0 = no color
@@ -559,7 +1935,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         // Prepare output arrays
         double *pointCloud;   // pointer to output data
         unsigned char *colors;
-        int size = width * height;
+        int size = roi.out_width() * roi.out_height();
         int outDim[2]={size,3};    // three values (row vector)
         
          // Reserve space for output array
@@ -569,6 +1945,20 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         // Assign pointers to the output parameters
         pointCloud = (double*)mxGetPr(plhs[0]);   
         colors = (unsigned char*)mxGetPr(plhs[1]);
+
+        // Optional normals, with the neighbor radius at prhs[8] and the
+        // depth discontinuity threshold at prhs[9]
+        double *normals = NULL;
+        int normalRadius = 3;
+        float maxDepthChange = 0.02f;
+        if (nlhs > 2) {
+            plhs[2] = mxCreateNumericArray(2, outDim, mxDOUBLE_CLASS, mxREAL);
+            normals = mxGetPr(plhs[2]);
+            if (nrhs > 8)
+                normalRadius = (int)mxGetScalar(prhs[8]);
+            if (nrhs > 9)
+                maxDepthChange = (float)mxGetScalar(prhs[9]);
+        }
                 
         // Check parameters
         if (nlhs < 0 || nrhs < 2)
@@ -576,12 +1966,15 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
       
         // Call the class function
         bool validData;
-        KinZ_instance->get_pointcloud(pointCloud, colors, bwithColor, validData);
+        KinZ_instance->get_pointcloud(pointCloud, colors, bwithColor, validData, roi,
+                                      normals, normalRadius, maxDepthChange);
         
         if(!validData)
         {
             plhs[0] = mxCreateNumericArray(2, outDim, mxDOUBLE_CLASS, mxREAL); 
             plhs[1] = mxCreateNumericArray(2, outDim, mxUINT8_CLASS, mxREAL);
+            if (nlhs > 2)
+                plhs[2] = mxCreateNumericArray(2, outDim, mxDOUBLE_CLASS, mxREAL);
         }
         return;
     }    
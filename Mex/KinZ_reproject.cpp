@@ -0,0 +1,288 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_reproject.cpp
+///
+///		Description:
+///			Depth to color splat and color to depth gather computed from
+///         the calibration, in bands of rows on the thread pool.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_reproject.h"
+#include "KinZ_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace kz
+{
+
+namespace
+{
+// Signed doubled area of the triangle (a, b, p)
+inline float edge(float ax, float ay, float bx, float by, float px, float py)
+{
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+// True if p lies inside or on the border of the triangle (a, b, c)
+inline bool inside(const float u[4], const float v[4], int a, int b, int c,
+                   float px, float py)
+{
+    float area = edge(u[a], v[a], u[b], v[b], u[c], v[c]);
+    if (area == 0)
+        return false;
+    float s = area > 0 ? 1.f : -1.f;
+    return s * edge(u[a], v[a], u[b], v[b], px, py) >= 0 &&
+           s * edge(u[b], v[b], u[c], v[c], px, py) >= 0 &&
+           s * edge(u[c], v[c], u[a], v[a], px, py) >= 0;
+}
+} // namespace
+
+///////// Function: configure /////////////////////////////////////////////
+// Copy the color intrinsics and the depth to color extrinsics, and build
+// the rays of the depth pixel corners rotated to the color camera.
+///////////////////////////////////////////////////////////////////////////
+bool Reprojector::configure(const k4a_calibration_t &calibration, ThreadPool &pool)
+{
+    const k4a_calibration_camera_t &depth = calibration.depth_camera_calibration;
+    const k4a_calibration_camera_t &color = calibration.color_camera_calibration;
+    m_color_width = m_color_height = 0;
+    if (depth.resolution_width <= 0 || depth.resolution_height <= 0 ||
+        color.resolution_width <= 0 || color.resolution_height <= 0 ||
+        !(color.intrinsics.parameters.param.fx > 0))
+        return false;
+
+    m_depth_width = depth.resolution_width;
+    m_depth_height = depth.resolution_height;
+    m_color = color.intrinsics.parameters;
+    m_model = color.intrinsics.type;
+    m_max_radius2 = color.metric_radius * color.metric_radius;
+
+    const k4a_calibration_extrinsics_t &ex =
+        calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR];
+    std::copy(ex.rotation, ex.rotation + 9, m_rotation);
+    std::copy(ex.translation, ex.translation + 3, m_translation);
+
+    // Corner (i, j) is the top-left corner of depth pixel (i, j), at
+    // (i - 0.5, j - 0.5) as pixel centers are at integer coordinates
+    int cw = m_depth_width + 1;
+    int ch = m_depth_height + 1;
+    m_corner_rays.resize((size_t)cw * ch * 3);
+    parallel_rows(pool, ch, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++)
+            for (int x = 0; x < cw; x++) {
+                float *r = &m_corner_rays[((size_t)y * cw + x) * 3];
+                k4a_float2_t p;
+                k4a_float3_t ray;
+                int valid = 0;
+                p.xy.x = x - 0.5f;
+                p.xy.y = y - 0.5f;
+                if (K4A_RESULT_SUCCEEDED != k4a_calibration_2d_to_3d(&calibration, &p, 1.f,
+                        K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH, &ray, &valid))
+                    valid = 0;
+                if (!valid) {
+                    r[0] = r[1] = r[2] = NAN;
+                    continue;
+                }
+                for (int k = 0; k < 3; k++)
+                    r[k] = m_rotation[3 * k] * ray.xyz.x + m_rotation[3 * k + 1] * ray.xyz.y +
+                           m_rotation[3 * k + 2];
+            }
+    });
+
+    m_footprints.resize((size_t)m_depth_width * m_depth_height);
+    m_row_min.resize(m_depth_height);
+    m_row_max.resize(m_depth_height);
+    m_color_width = color.resolution_width;
+    m_color_height = color.resolution_height;
+    return true;
+} // end configure
+
+///////// Function: project ///////////////////////////////////////////////
+// Project the point p of the color camera to pixel coordinates with the
+// distortion model of the SDK (Brown-Conrady or rational 6KT). Returns
+// false behind the camera or outside of the calibrated radius.
+///////////////////////////////////////////////////////////////////////////
+inline bool Reprojector::project(const float p[3], float &u, float &v) const
+{
+    if (!(p[2] > 0))
+        return false;
+    const float cx = m_color.param.cx, cy = m_color.param.cy;
+    const float fx = m_color.param.fx, fy = m_color.param.fy;
+
+    float xp = p[0] / p[2] - m_color.param.codx;
+    float yp = p[1] / p[2] - m_color.param.cody;
+    float xp2 = xp * xp, yp2 = yp * yp, xyp = xp * yp;
+    float rs = xp2 + yp2;
+    if (m_max_radius2 > 0 && rs > m_max_radius2)
+        return false;
+    float rss = rs * rs, rsc = rss * rs;
+    float a = 1.f + m_color.param.k1 * rs + m_color.param.k2 * rss + m_color.param.k3 * rsc;
+    float b = 1.f + m_color.param.k4 * rs + m_color.param.k5 * rss + m_color.param.k6 * rsc;
+    float d = b != 0.f ? a / b : a;
+
+    float xp_d = xp * d, yp_d = yp * d;
+    float rs_2xp2 = rs + 2.f * xp2, rs_2yp2 = rs + 2.f * yp2;
+    if (m_model == K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT) {
+        xp_d += rs_2xp2 * m_color.param.p2 + xyp * m_color.param.p1;
+        yp_d += rs_2yp2 * m_color.param.p1 + xyp * m_color.param.p2;
+    }
+    else {
+        xp_d += rs_2xp2 * m_color.param.p2 + 2.f * xyp * m_color.param.p1;
+        yp_d += rs_2yp2 * m_color.param.p1 + 2.f * xyp * m_color.param.p2;
+    }
+    u = (xp_d + m_color.param.codx) * fx + cx;
+    v = (yp_d + m_color.param.cody) * fy + cy;
+    return true;
+} // end project
+
+///////// Function: projectFootprints /////////////////////////////////////
+// Footprints of the depth rows [y0, y1) and their range of color rows
+///////////////////////////////////////////////////////////////////////////
+void Reprojector::project_footprints(const uint8_t *depth, int depth_stride, int y0, int y1)
+{
+    const int w = m_depth_width;
+    const int cw = w + 1;
+    // Corner k of a pixel is at (dx[k], dy[k]) from its top-left corner
+    static const int dx[4] = {0, 1, 1, 0};
+    static const int dy[4] = {0, 0, 1, 1};
+
+    for (int y = y0; y < y1; y++) {
+        const uint16_t *row = (const uint16_t *)(depth + (size_t)y * depth_stride);
+        Footprint *f = &m_footprints[(size_t)y * w];
+        float vmin = INFINITY, vmax = -INFINITY;
+        for (int x = 0; x < w; x++, f++) {
+            f->z = 0;
+            float z = row[x];
+            if (z == 0)
+                continue;
+            float zsum = 0;
+            bool valid = true;
+            for (int k = 0; k < 4 && valid; k++) {
+                const float *r = &m_corner_rays[((size_t)(y + dy[k]) * cw + x + dx[k]) * 3];
+                float p[3] = {r[0] * z + m_translation[0],
+                              r[1] * z + m_translation[1],
+                              r[2] * z + m_translation[2]};
+                valid = project(p, f->u[k], f->v[k]);   // false for NaN rays
+                zsum += p[2];
+            }
+            if (!valid)
+                continue;
+            f->z = 0.25f * zsum;
+            vmin = std::min(vmin, std::min(std::min(f->v[0], f->v[1]), std::min(f->v[2], f->v[3])));
+            vmax = std::max(vmax, std::max(std::max(f->v[0], f->v[1]), std::max(f->v[2], f->v[3])));
+        }
+        m_row_min[y] = vmin;
+        m_row_max[y] = vmax;
+    }
+} // end projectFootprints
+
+///////// Function: splatBand /////////////////////////////////////////////
+// Fill the color rows [v0, v1) of out with the nearest footprint covering
+// each pixel center
+///////////////////////////////////////////////////////////////////////////
+void Reprojector::splat_band(uint16_t *out, int out_stride, int v0, int v1) const
+{
+    const int w = m_depth_width;
+    for (int v = v0; v < v1; v++)
+        memset((uint8_t *)out + (size_t)v * out_stride, 0, (size_t)m_color_width * sizeof(uint16_t));
+
+    for (int y = 0; y < m_depth_height; y++) {
+        if (m_row_max[y] < v0 || m_row_min[y] > v1 - 1)
+            continue;
+        const Footprint *f = &m_footprints[(size_t)y * w];
+        for (int x = 0; x < w; x++, f++) {
+            if (f->z <= 0)
+                continue;
+            float umin = std::min(std::min(f->u[0], f->u[1]), std::min(f->u[2], f->u[3]));
+            float umax = std::max(std::max(f->u[0], f->u[1]), std::max(f->u[2], f->u[3]));
+            float vmin = std::min(std::min(f->v[0], f->v[1]), std::min(f->v[2], f->v[3]));
+            float vmax = std::max(std::max(f->v[0], f->v[1]), std::max(f->v[2], f->v[3]));
+            // Clamp before converting, footprints may project far outside
+            if (vmax < v0 || vmin > v1 - 1 || umax < 0 || umin > m_color_width - 1)
+                continue;
+            int py0 = (int)std::ceil(std::max((float)v0, vmin));
+            int py1 = (int)std::floor(std::min((float)(v1 - 1), vmax));
+            int px0 = (int)std::ceil(std::max(0.f, umin));
+            int px1 = (int)std::floor(std::min((float)(m_color_width - 1), umax));
+            if (py0 > py1 || px0 > px1)
+                continue;
+
+            uint16_t z = (uint16_t)std::min(65535.f, f->z + 0.5f);
+            for (int py = py0; py <= py1; py++) {
+                uint16_t *dst = (uint16_t *)((uint8_t *)out + (size_t)py * out_stride);
+                for (int px = px0; px <= px1; px++) {
+                    if (dst[px] != 0 && dst[px] <= z)
+                        continue;
+                    // The quad split in two triangles also covers concave
+                    // footprints, seen at grazing angles
+                    if (inside(f->u, f->v, 0, 1, 2, (float)px, (float)py) ||
+                        inside(f->u, f->v, 0, 2, 3, (float)px, (float)py))
+                        dst[px] = z;
+                }
+            }
+        }
+    }
+} // end splatBand
+
+///////// Function: depthToColor //////////////////////////////////////////
+// Project the footprints in bands of depth rows, then splat them in bands
+// of color rows
+///////////////////////////////////////////////////////////////////////////
+void Reprojector::depth_to_color(const uint8_t *depth, int depth_stride,
+                                 uint16_t *out, int out_stride, ThreadPool &pool)
+{
+    parallel_rows(pool, m_depth_height, [&](int y0, int y1) {
+        project_footprints(depth, depth_stride, y0, y1);
+    });
+    parallel_rows(pool, m_color_height, [&](int v0, int v1) {
+        splat_band(out, out_stride, v0, v1);
+    });
+} // end depthToColor
+
+///////// Function: colorToDepth //////////////////////////////////////////
+// Sample the color image at the projection of each depth pixel
+///////////////////////////////////////////////////////////////////////////
+void Reprojector::color_to_depth(const uint8_t *depth, int depth_stride, const float *rays,
+                                 const uint8_t *bgra, int bgra_stride,
+                                 uint8_t *out, int out_stride, ThreadPool &pool)
+{
+    const int w = m_depth_width;
+    const float umax = (float)(m_color_width - 1);
+    const float vmax = (float)(m_color_height - 1);
+
+    parallel_rows(pool, m_depth_height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const uint16_t *row = (const uint16_t *)(depth + (size_t)y * depth_stride);
+            const float *ray = rays + (size_t)y * w * 2;
+            uint8_t *dst = out + (size_t)y * out_stride;
+            for (int x = 0; x < w; x++, ray += 2, dst += 4) {
+                dst[0] = dst[1] = dst[2] = dst[3] = 0;
+                float z = row[x];
+                if (z == 0 || std::isnan(ray[0]))
+                    continue;
+                float q[3] = {ray[0] * z, ray[1] * z, z};
+                float p[3];
+                for (int k = 0; k < 3; k++)
+                    p[k] = m_rotation[3 * k] * q[0] + m_rotation[3 * k + 1] * q[1] +
+                           m_rotation[3 * k + 2] * q[2] + m_translation[k];
+                float u, v;
+                if (!project(p, u, v) || !(u >= 0 && u <= umax && v >= 0 && v <= vmax))
+                    continue;
+
+                int u0 = std::min((int)u, m_color_width - 2);
+                int v0 = std::min((int)v, m_color_height - 2);
+                float fu = u - u0, fv = v - v0;
+                const uint8_t *s0 = bgra + (size_t)v0 * bgra_stride + 4 * (size_t)u0;
+                const uint8_t *s1 = s0 + bgra_stride;
+                for (int c = 0; c < 4; c++) {
+                    float top = s0[c] + fu * (s0[c + 4] - s0[c]);
+                    float bottom = s1[c] + fu * (s1[c + 4] - s1[c]);
+                    dst[c] = (uint8_t)(top + fv * (bottom - top) + 0.5f);
+                }
+            }
+        }
+    });
+} // end colorToDepth
+
+} // namespace kz
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_reproject.h
+///
+///		Description:
+///			Reprojection between the depth and color cameras computed from
+///         the calibration, used in place of k4a_transformation_* for the
+///         aligned images.
+///          * depth_to_color splats every depth pixel in the color image:
+///            the four corners of the pixel are unprojected at its depth,
+///            moved to the color camera with the extrinsics and projected
+///            with the color intrinsics, and the quad they form is filled
+///            with the color camera depth, keeping the nearest surface
+///            (z-buffer). Corner rays are precomputed, rotated to the color
+///            camera, by configure.
+///          * color_to_depth gathers, for each depth pixel, the bilinear
+///            interpolation of the color image at the projection of the
+///            pixel center.
+///         Work is split in row bands: bands of color rows for the splat,
+///         so no two threads write the same pixel, and bands of depth rows
+///         for the projection and the gather.
+///
+///         Tolerance against the SDK (see KinZ::validate_reprojection):
+///         depth of the pixels valid in both images agrees within
+///         REPROJECTION_DEPTH_TOLERANCE of the depth, and at least
+///         REPROJECTION_DEPTH_MIN_MM, for REPROJECTION_MIN_AGREEMENT of
+///         them. The rest lie on depth edges, where a color pixel may be
+///         given to either surface. Color channels agree within
+///         REPROJECTION_COLOR_TOLERANCE levels on the same fraction.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_REPROJECT_H__
+#define __KINZ_REPROJECT_H__
+#include <k4a/k4a.h>
+#include <stdint.h>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace kz
+{
+    const float REPROJECTION_DEPTH_TOLERANCE = 0.01f;   // fraction of the depth
+    const float REPROJECTION_DEPTH_MIN_MM = 2.0f;
+    const int REPROJECTION_COLOR_TOLERANCE = 8;         // levels out of 255
+    const double REPROJECTION_MIN_AGREEMENT = 0.98;
+
+    // Comparison of the engine with the SDK on one frame
+    struct ReprojectionReport {
+        // Depth to color: pixels with depth in both images or in one only
+        uint64_t depth_common = 0;
+        uint64_t depth_sdk_only = 0;
+        uint64_t depth_native_only = 0;
+        double depth_mean_abs_mm = 0;       // over the common pixels
+        double depth_p99_abs_mm = 0;
+        double depth_agreement = 0;         // fraction within tolerance
+        double depth_sdk_ms = 0;
+        double depth_native_ms = 0;
+
+        // Color to depth: pixels colored in both images
+        uint64_t color_common = 0;
+        double color_mean_abs = 0;          // levels, over the channels
+        double color_agreement = 0;         // fraction within tolerance
+        double color_sdk_ms = 0;
+        double color_native_ms = 0;
+
+        bool pass = false;
+    };
+
+    class Reprojector
+    {
+    public:
+        // Take the intrinsics and extrinsics of calibration and build the
+        // corner rays. Returns false if a camera is not calibrated.
+        bool configure(const k4a_calibration_t &calibration, ThreadPool &pool);
+        bool configured() const { return m_color_width > 0; }
+        int color_width() const { return m_color_width; }
+        int color_height() const { return m_color_height; }
+
+        // Depth image to a color geometry depth image, in mm along the
+        // color camera axis, 0 where no depth pixel projects.
+        void depth_to_color(const uint8_t *depth, int depth_stride,
+                            uint16_t *out, int out_stride, ThreadPool &pool);
+
+        // BGRA color image to depth geometry. rays are the unit-depth rays
+        // (x, y) of the depth pixel centers, NaN if the pixel does not
+        // unproject. Pixels without depth, or projecting outside of the
+        // color image, are 0.
+        void color_to_depth(const uint8_t *depth, int depth_stride, const float *rays,
+                            const uint8_t *bgra, int bgra_stride,
+                            uint8_t *out, int out_stride, ThreadPool &pool);
+
+    private:
+        // Color pixel footprint of a depth pixel: corners in order
+        // top-left, top-right, bottom-right, bottom-left. z <= 0 if the
+        // pixel is invalid.
+        struct Footprint {
+            float u[4], v[4];
+            float z;
+        };
+
+        int m_depth_width = 0, m_depth_height = 0;
+        int m_color_width = 0, m_color_height = 0;
+        k4a_calibration_intrinsic_parameters_t m_color;
+        k4a_calibration_model_type_t m_model = K4A_CALIBRATION_LENS_DISTORTION_MODEL_UNKNOWN;
+        float m_max_radius2 = 0;    // squared metric radius, 0 = no limit
+        float m_rotation[9];        // depth to color, row major
+        float m_translation[3];     // mm
+
+        // Rotated unit-depth rays of the (w+1)x(h+1) depth pixel corners
+        std::vector<float> m_corner_rays;
+        std::vector<Footprint> m_footprints;
+        // Range of color rows covered by the footprints of each depth row
+        std::vector<float> m_row_min, m_row_max;
+
+        bool project(const float p[3], float &u, float &v) const;
+        void project_footprints(const uint8_t *depth, int depth_stride, int y0, int y1);
+        void splat_band(uint16_t *out, int out_stride, int v0, int v1) const;
+    };
+}
+
+#endif // __KINZ_REPROJECT_H__
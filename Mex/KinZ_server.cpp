@@ -0,0 +1,467 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_server.cpp
+///
+///		Description:
+///			Standalone frame server. Captures depth, infrared, color, IMU
+///         and (with -DBODY) body data and publishes every capture in a
+///         shared-memory ring (see KinZ_shm.h). Any number of Matlab
+///         sessions, created with KinZ('shm'), and C++ readers can then
+///         consume the frames without copies.
+///
+///         Sources:
+///          * device (default): the Kinect, through the KinZ class.
+///          * --playback file.mkv: a recording, at its original rate.
+///          * --synthetic: generated frames, no Kinect or recording needed.
+///         --pool allocates the SDK images from the frame pool (see
+///         KinZ_allocator.h).
+///
+///		Usage:
+///			KinZ_server [--name /kinz] [--slots 4] [--frames N]
+///                     [--synthetic [--fps 5|15|30]] [--playback file.mkv]
+///                     [--color 720p|1080p|1440p|1536p|2160p|3072p]
+///                     [--wfov] [--binned] [--imu] [--body] [--pool]
+///         Stop with Ctrl+C.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ.h"
+#include "KinZ_log.h"
+#include "KinZ_shm.h"
+#include "KinZ_allocator.h"
+#include <k4arecord/playback.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int)
+{
+    g_stop = 1;
+}
+
+struct Options {
+    std::string name = kz::SHM_DEFAULT_NAME;
+    uint32_t slots = 4;
+    uint64_t frames = 0;            // 0 = until stopped
+    bool synthetic = false;
+    int fps = 30;
+    std::string playback;
+    bool pool = false;              // SDK images from kz::FramePool
+    uint16_t flags = kz::C720;      // KinZ source flags of the device
+};
+
+void print_log()
+{
+    kz::log_drain([](const kz::LogEntry &e) {
+        fprintf(stderr, "%s\n", e.text);
+    });
+}
+
+bool parse_options(int argc, char *argv[], Options &opt)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--name" && has_value)
+            opt.name = argv[++i];
+        else if (arg == "--slots" && has_value)
+            opt.slots = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--frames" && has_value)
+            opt.frames = strtoull(argv[++i], NULL, 10);
+        else if (arg == "--synthetic")
+            opt.synthetic = true;
+        else if (arg == "--fps" && has_value)
+            opt.fps = atoi(argv[++i]);
+        else if (arg == "--playback" && has_value)
+            opt.playback = argv[++i];
+        else if (arg == "--color" && has_value) {
+            std::string res = argv[++i];
+            opt.flags &= ~(kz::C720 | kz::C1080 | kz::C1440 | kz::C1536 | kz::C2160 | kz::C3072);
+            if (res == "720p") opt.flags |= kz::C720;
+            else if (res == "1080p") opt.flags |= kz::C1080;
+            else if (res == "1440p") opt.flags |= kz::C1440;
+            else if (res == "1536p") opt.flags |= kz::C1536;
+            else if (res == "2160p") opt.flags |= kz::C2160;
+            else if (res == "3072p") opt.flags |= kz::C3072;
+            else return false;
+        }
+        else if (arg == "--wfov")
+            opt.flags |= kz::D_WFOV;
+        else if (arg == "--binned")
+            opt.flags |= kz::D_BINNED;
+        else if (arg == "--imu")
+            opt.flags |= kz::IMU_ON;
+        else if (arg == "--pool")
+            opt.pool = true;
+        else if (arg == "--body")
+            opt.flags |= kz::BODY_TRACKING;
+        else
+            return false;
+    }
+    return opt.slots >= 2 && (opt.fps == 5 || opt.fps == 15 || opt.fps == 30);
+}
+
+k4a_fps_t to_k4a_fps(int fps)
+{
+    return fps == 5 ? K4A_FRAMES_PER_SECOND_5 :
+           (fps == 15 ? K4A_FRAMES_PER_SECOND_15 : K4A_FRAMES_PER_SECOND_30);
+}
+
+uint64_t now_nsec()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+// Number of frames published with each image stream, to check at exit
+// that every stream of the ring was published
+struct PublishStats {
+    uint64_t depth = 0, color = 0, infrared = 0;
+};
+
+// Image sizes of a depth mode and a color resolution, 0 when disabled
+void mode_sizes(k4a_depth_mode_t depth_mode, k4a_color_resolution_t color_resolution,
+                int &dw, int &dh, int &cw, int &ch)
+{
+    static const int depth_sizes[][2] = {{0, 0}, {320, 288}, {640, 576}, {512, 512},
+                                         {1024, 1024}, {1024, 1024}};
+    static const int color_sizes[][2] = {{0, 0}, {1280, 720}, {1920, 1080}, {2560, 1440},
+                                         {2048, 1536}, {3840, 2160}, {4096, 3072}};
+    int d = depth_mode <= K4A_DEPTH_MODE_PASSIVE_IR ? (int)depth_mode : 0;
+    int c = color_resolution <= K4A_COLOR_RESOLUTION_3072P ? (int)color_resolution : 0;
+    dw = depth_sizes[d][0];
+    dh = depth_sizes[d][1];
+    cw = color_sizes[c][0];
+    ch = color_sizes[c][1];
+}
+
+// Create the ring for the configured streams before the first capture.
+// The first captures of a device often lack color or infrared, so the
+// layout cannot be taken from them. Sizes of 0 leave a stream out.
+bool create_ring(kz::ShmWriter &writer, const Options &opt, int dw, int dh, int iw, int ih,
+                 int cw, int ch, uint32_t streams, k4a_fps_t fps,
+                 const k4a_calibration_t *calibration)
+{
+    kz::ShmHeader format;
+    format.num_slots = opt.slots;
+    format.streams = streams & ~(kz::SHM_DEPTH | kz::SHM_COLOR | kz::SHM_INFRARED);
+    if (dw > 0 && dh > 0) {
+        format.depth.width = dw;
+        format.depth.height = dh;
+        format.depth.stride = 2 * dw;
+        format.streams |= kz::SHM_DEPTH;
+    }
+    if (iw > 0 && ih > 0) {
+        format.infrared.width = iw;
+        format.infrared.height = ih;
+        format.infrared.stride = 2 * iw;
+        format.streams |= kz::SHM_INFRARED;
+    }
+    if (cw > 0 && ch > 0) {
+        format.color.width = cw;
+        format.color.height = ch;
+        format.color.stride = 4 * cw;
+        format.streams |= kz::SHM_COLOR;
+    }
+    format.camera_fps = fps;
+    format.has_calibration = calibration != NULL;
+    if (calibration)
+        format.calibration = *calibration;
+    if (!writer.create(opt.name.c_str(), format))
+        return false;
+    fprintf(stderr, "Publishing in shared memory %s\n", opt.name.c_str());
+    return true;
+}
+
+// Data and timestamps of an image of a capture (may be null). Images that
+// do not match the slot of their stream are left out of the frame.
+bool add_image(k4a_image_t image, uint32_t stream, const kz::ShmImageFormat &f,
+               const uint8_t *&data, int &stride, uint64_t &device_usec, uint64_t &system_nsec,
+               kz::ShmFrameInfo &info)
+{
+    if (!image || f.size() == 0 || k4a_image_get_width_pixels(image) != f.width ||
+        k4a_image_get_height_pixels(image) != f.height ||
+        k4a_image_get_stride_bytes(image) < f.stride)
+        return false;
+    data = k4a_image_get_buffer(image);
+    stride = k4a_image_get_stride_bytes(image);
+    device_usec = k4a_image_get_device_timestamp_usec(image);
+    system_nsec = k4a_image_get_system_timestamp_nsec(image);
+    info.streams |= stream;
+    return true;
+}
+
+// Publish the images of a capture in the ring created by create_ring
+void publish_images(kz::ShmWriter &writer, k4a_image_t depth, k4a_image_t color,
+                    k4a_image_t infrared, kz::ShmFrameInfo &info, PublishStats &stats)
+{
+    const kz::ShmHeader &format = *writer.header();
+    kz::ShmImages images;
+    stats.depth += add_image(depth, kz::SHM_DEPTH, format.depth, images.depth,
+                             images.depth_stride, info.depth_timestamp_usec,
+                             info.depth_system_nsec, info);
+    stats.color += add_image(color, kz::SHM_COLOR, format.color, images.color,
+                             images.color_stride, info.color_timestamp_usec,
+                             info.color_system_nsec, info);
+    stats.infrared += add_image(infrared, kz::SHM_INFRARED, format.infrared, images.infrared,
+                                images.infrared_stride, info.infrared_timestamp_usec,
+                                info.infrared_system_nsec, info);
+    writer.publish(info, images);
+}
+
+// Report the frames of each stream and warn about a stream of the ring
+// that was never published
+void check_published(const kz::ShmWriter &writer, const PublishStats &stats)
+{
+    const kz::ShmHeader *format = writer.header();
+    if (!format)
+        return;
+    fprintf(stderr, "Published %llu depth, %llu color and %llu infrared frames\n",
+            (unsigned long long)stats.depth, (unsigned long long)stats.color,
+            (unsigned long long)stats.infrared);
+    const struct { uint32_t stream; uint64_t frames; const char *name; } streams[] = {
+        {kz::SHM_DEPTH, stats.depth, "depth"},
+        {kz::SHM_COLOR, stats.color, "color"},
+        {kz::SHM_INFRARED, stats.infrared, "infrared"}};
+    for (const auto &s : streams)
+        if ((format->streams & s.stream) && s.frames == 0)
+            fprintf(stderr, "Warning: the %s stream was never published\n", s.name);
+}
+
+int run_device(const Options &opt, kz::ShmWriter &writer)
+{
+    uint16_t flags = opt.flags | kz::COLOR | kz::DEPTH | kz::INFRARED;
+    KinZ kinz(flags);
+    print_log();
+
+    k4a_calibration_t calibration;
+    kinz.get_calibration(calibration);
+    int dw, dh, cw, ch;
+    kinz.get_image_sizes(dw, dh, cw, ch);
+    uint32_t streams = (opt.flags & kz::IMU_ON) ? kz::SHM_IMU : 0;
+    #ifdef BODY
+    if (opt.flags & kz::BODY_TRACKING)
+        streams |= kz::SHM_BODIES;
+    #endif
+    if (!create_ring(writer, opt, dw, dh, dw, dh, cw, ch, streams,
+                     kinz.get_configuration().camera_fps, &calibration))
+        return 1;
+
+    PublishStats stats;
+    uint16_t capture_flags = kz::COLOR | kz::DEPTH | kz::INFRARED |
+                             (opt.flags & (kz::IMU_ON | kz::BODY_TRACKING));
+    for (uint64_t n = 0; !g_stop && (opt.frames == 0 || n < opt.frames); n++) {
+        uint8_t valid[1];
+        kinz.get_frames(capture_flags, valid);
+        print_log();
+        if (!valid[0])
+            continue;
+
+        k4a_image_t depth, color, infrared;
+        kinz.get_images(depth, color, infrared);
+        if (!depth && !color && !infrared)
+            continue;
+
+        kz::ShmFrameInfo info;
+        memset(&info, 0, sizeof(info));
+        if (opt.flags & kz::IMU_ON) {
+            kinz.get_sensor_data(info.imu);
+            info.streams |= kz::SHM_IMU;
+        }
+        #ifdef BODY
+        if (opt.flags & kz::BODY_TRACKING) {
+            std::vector<kz::Body> bodies;
+            kinz.get_bodies(bodies);
+            info.num_bodies = (uint32_t)std::min<size_t>(bodies.size(), kz::SHM_MAX_BODIES);
+            for (uint32_t i = 0; i < info.num_bodies; i++)
+                info.bodies[i] = bodies[i];
+            info.streams |= kz::SHM_BODIES;
+        }
+        #endif
+
+        publish_images(writer, depth, color, infrared, info, stats);
+    }
+    check_published(writer, stats);
+    return 0;
+}
+
+int run_playback(const Options &opt, kz::ShmWriter &writer)
+{
+    k4a_playback_t playback = NULL;
+    if (k4a_playback_open(opt.playback.c_str(), &playback) != K4A_RESULT_SUCCEEDED) {
+        fprintf(stderr, "Cannot open the recording %s\n", opt.playback.c_str());
+        return 1;
+    }
+    k4a_calibration_t calibration;
+    k4a_record_configuration_t config;
+    bool has_calibration = k4a_playback_get_calibration(playback, &calibration) == K4A_RESULT_SUCCEEDED;
+    k4a_playback_get_record_configuration(playback, &config);
+
+    // Tracks of the recording; color is published as BGRA only
+    int dw, dh, cw, ch;
+    mode_sizes(config.depth_mode, config.color_resolution, dw, dh, cw, ch);
+    int iw = config.ir_track_enabled ? dw : 0, ih = config.ir_track_enabled ? dh : 0;
+    if (!config.depth_track_enabled || config.depth_mode == K4A_DEPTH_MODE_PASSIVE_IR)
+        dw = dh = 0;
+    if (!config.color_track_enabled || config.color_format != K4A_IMAGE_FORMAT_COLOR_BGRA32)
+        cw = ch = 0;
+    if (!create_ring(writer, opt, dw, dh, iw, ih, cw, ch, 0, config.camera_fps,
+                     has_calibration ? &calibration : NULL)) {
+        k4a_playback_close(playback);
+        return 1;
+    }
+    PublishStats stats;
+
+    // Replay at the rate of the device timestamps of one stream, the
+    // first published one. Captures without it are published at once.
+    enum { REF_DEPTH, REF_COLOR, REF_INFRARED } ref = dw ? REF_DEPTH : (cw ? REF_COLOR : REF_INFRARED);
+    Clock::time_point start = Clock::now();
+    bool has_first = false;
+    uint64_t first_usec = 0;
+    for (uint64_t n = 0; !g_stop && (opt.frames == 0 || n < opt.frames); n++) {
+        k4a_capture_t capture = NULL;
+        if (k4a_playback_get_next_capture(playback, &capture) != K4A_STREAM_RESULT_SUCCEEDED)
+            break;
+
+        k4a_image_t depth = k4a_capture_get_depth_image(capture);
+        k4a_image_t color = k4a_capture_get_color_image(capture);
+        k4a_image_t infrared = k4a_capture_get_ir_image(capture);
+
+        k4a_image_t reference = ref == REF_DEPTH ? depth : (ref == REF_COLOR ? color : infrared);
+        if (reference) {
+            uint64_t usec = k4a_image_get_device_timestamp_usec(reference);
+            if (!has_first) {
+                first_usec = usec;
+                has_first = true;
+            }
+            // Timestamps may go back a little, never wait before start
+            int64_t offset = std::max<int64_t>(0, (int64_t)usec - (int64_t)first_usec);
+            std::this_thread::sleep_until(start + std::chrono::microseconds(offset));
+        }
+
+        kz::ShmFrameInfo info;
+        memset(&info, 0, sizeof(info));
+        publish_images(writer, depth, color, infrared, info, stats);
+
+        if (depth) k4a_image_release(depth);
+        if (color) k4a_image_release(color);
+        if (infrared) k4a_image_release(infrared);
+        k4a_capture_release(capture);
+    }
+    k4a_playback_close(playback);
+    check_published(writer, stats);
+    return 0;
+}
+
+// Moving ramps in NFOV unbinned depth and infrared, and 720p color
+int run_synthetic(const Options &opt, kz::ShmWriter &writer)
+{
+    const int dw = 640, dh = 576, cw = 1280, ch = 720;
+    std::vector<uint16_t> depth((size_t)dw * dh), infrared((size_t)dw * dh);
+    std::vector<uint8_t> color((size_t)cw * ch * 4);
+
+    kz::ShmHeader format;
+    format.num_slots = opt.slots;
+    format.streams = kz::SHM_DEPTH | kz::SHM_COLOR | kz::SHM_INFRARED | kz::SHM_IMU;
+    format.depth.width = format.infrared.width = dw;
+    format.depth.height = format.infrared.height = dh;
+    format.depth.stride = format.infrared.stride = 2 * dw;
+    format.color.width = cw;
+    format.color.height = ch;
+    format.color.stride = 4 * cw;
+    format.camera_fps = to_k4a_fps(opt.fps);
+    format.has_calibration = 0;
+    if (!writer.create(opt.name.c_str(), format))
+        return 1;
+    fprintf(stderr, "Publishing synthetic frames in shared memory %s\n", opt.name.c_str());
+
+    kz::ShmImages images;
+    images.depth = (const uint8_t *)depth.data();
+    images.depth_stride = 2 * dw;
+    images.infrared = (const uint8_t *)infrared.data();
+    images.infrared_stride = 2 * dw;
+    images.color = color.data();
+    images.color_stride = 4 * cw;
+
+    const uint64_t period_usec = 1000000 / opt.fps;
+    Clock::time_point start = Clock::now();
+    for (uint64_t n = 0; !g_stop && (opt.frames == 0 || n < opt.frames); n++) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(n * period_usec));
+
+        for (int y = 0; y < dh; y++)
+            for (int x = 0; x < dw; x++) {
+                size_t i = (size_t)y * dw + x;
+                depth[i] = (uint16_t)(500 + (x + y + 8 * n) % 3000);
+                infrared[i] = (uint16_t)((x * 4 + n * 16) & 0xFFF);
+            }
+        for (int y = 0; y < ch; y++)
+            for (int x = 0; x < cw; x++) {
+                uint8_t *p = &color[((size_t)y * cw + x) * 4];
+                p[0] = (uint8_t)(x + n);
+                p[1] = (uint8_t)y;
+                p[2] = (uint8_t)(4 * n);
+                p[3] = 255;
+            }
+
+        kz::ShmFrameInfo info;
+        memset(&info, 0, sizeof(info));
+        info.streams = format.streams;
+        uint64_t usec = n * period_usec;
+        info.depth_timestamp_usec = info.color_timestamp_usec = info.infrared_timestamp_usec = usec;
+        info.depth_system_nsec = info.color_system_nsec = info.infrared_system_nsec = now_nsec();
+        info.imu.temperature = 30.0f;
+        info.imu.acc_z = -9.81f;
+        info.imu.acc_timestamp_usec = info.imu.gyro_timestamp_usec = usec;
+        writer.publish(info, images);
+    }
+    return 0;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    if (!parse_options(argc, argv, opt)) {
+        fprintf(stderr,
+                "Usage: KinZ_server [--name /kinz] [--slots 4] [--frames N]\n"
+                "                   [--synthetic [--fps 5|15|30]] [--playback file.mkv]\n"
+                "                   [--color 720p|1080p|1440p|1536p|2160p|3072p]\n"
+                "                   [--wfov] [--binned] [--imu] [--body] [--pool]\n");
+        return 2;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    if (opt.pool && !kz::FramePool::instance().enable(kz::FramePoolConfig()))
+        print_log();
+
+    kz::ShmWriter writer;
+    int status;
+    if (opt.synthetic)
+        status = run_synthetic(opt, writer);
+    else if (!opt.playback.empty())
+        status = run_playback(opt, writer);
+    else
+        status = run_device(opt, writer);
+
+    writer.close();
+    if (opt.pool) {
+        kz::FramePoolStats st = kz::FramePool::instance().stats();
+        fprintf(stderr, "Frame pool: %llu allocations, %llu recycled, %llu new\n",
+                (unsigned long long)st.allocations, (unsigned long long)st.hits,
+                (unsigned long long)st.misses);
+        kz::FramePool::instance().disable();
+    }
+    print_log();
+    return status;
+}
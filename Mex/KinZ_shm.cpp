@@ -0,0 +1,276 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_shm.cpp
+///
+///		Description:
+///			Shared-memory ring of captures, see KinZ_shm.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_shm.h"
+#include "KinZ_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kz
+{
+
+namespace
+{
+inline size_t align64(size_t n)
+{
+    return (n + 63) & ~(size_t)63;
+}
+
+// Layout of a slot: sequence, frame info, depth, color, infrared
+struct SlotLayout {
+    size_t info, depth, color, infrared, size;
+
+    SlotLayout(const ShmImageFormat &d, const ShmImageFormat &c, const ShmImageFormat &ir)
+    {
+        info = 64;
+        depth = align64(info + sizeof(ShmFrameInfo));
+        color = align64(depth + d.size());
+        infrared = align64(color + c.size());
+        size = align64(infrared + ir.size());
+    }
+
+    explicit SlotLayout(const ShmHeader &h) : SlotLayout(h.depth, h.color, h.infrared) {}
+};
+
+inline uint8_t *slot_base(ShmHeader *h, uint64_t frame)
+{
+    return (uint8_t *)h + align64(sizeof(ShmHeader)) + ((frame - 1) % h->num_slots) * h->slot_size;
+}
+
+inline std::atomic<uint64_t> &slot_sequence(uint8_t *slot)
+{
+    return *(std::atomic<uint64_t> *)slot;
+}
+
+void copy_rows(uint8_t *dst, const ShmImageFormat &format, const uint8_t *src, int src_stride)
+{
+    if (!src)
+        return;
+    if (src_stride == format.stride) {
+        memcpy(dst, src, format.size());
+        return;
+    }
+    size_t row = (size_t)std::min(src_stride, format.stride);
+    for (int y = 0; y < format.height; y++)
+        memcpy(dst + (size_t)y * format.stride, src + (size_t)y * src_stride, row);
+}
+} // namespace
+
+#if !defined(_WIN32)
+
+bool ShmWriter::create(const char *name, const ShmHeader &format)
+{
+    close();
+
+    uint32_t num_slots = format.num_slots > 0 ? format.num_slots : 4;
+    uint64_t slot_size = SlotLayout(format.depth, format.color, format.infrared).size;
+    size_t size = align64(sizeof(ShmHeader)) + num_slots * slot_size;
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0) {
+        KZ_LOG(LOG_ERROR, "Cannot create shared memory %s", name);
+        return false;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        ::close(fd);
+        shm_unlink(name);
+        KZ_LOG(LOG_ERROR, "Cannot allocate %zu bytes of shared memory", size);
+        return false;
+    }
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name);
+        KZ_LOG(LOG_ERROR, "Cannot map shared memory %s", name);
+        return false;
+    }
+
+    // The pages are zero: every slot sequence starts at 0 (empty)
+    ShmHeader *h = new (p) ShmHeader;
+    h->magic = SHM_MAGIC;
+    h->version = SHM_VERSION;
+    h->num_slots = num_slots;
+    h->slot_size = slot_size;
+    h->streams = format.streams;
+    h->depth = format.depth;
+    h->color = format.color;
+    h->infrared = format.infrared;
+    h->camera_fps = format.camera_fps;
+    h->has_calibration = format.has_calibration;
+    h->calibration = format.calibration;
+    h->latest.store(0);
+    h->closed.store(0);
+
+    m_header = h;
+    m_size = size;
+    m_name = name;
+    m_frames = 0;
+    return true;
+}
+
+void ShmWriter::publish(ShmFrameInfo &info, const ShmImages &images)
+{
+    if (!m_header)
+        return;
+
+    uint64_t n = ++m_frames;
+    uint8_t *slot = slot_base(m_header, n);
+    std::atomic<uint64_t> &sequence = slot_sequence(slot);
+    SlotLayout layout(*m_header);
+
+    sequence.store(2 * n - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    info.frame = n;
+    memcpy(slot + layout.info, &info, sizeof(info));
+    copy_rows(slot + layout.depth, m_header->depth, images.depth, images.depth_stride);
+    copy_rows(slot + layout.color, m_header->color, images.color, images.color_stride);
+    copy_rows(slot + layout.infrared, m_header->infrared, images.infrared, images.infrared_stride);
+
+    sequence.store(2 * n, std::memory_order_release);
+    m_header->latest.store(n, std::memory_order_release);
+}
+
+void ShmWriter::close()
+{
+    if (!m_header)
+        return;
+    m_header->closed.store(1, std::memory_order_release);
+    munmap(m_header, m_size);
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+}
+
+bool ShmReader::open(const char *name)
+{
+    close();
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        KZ_LOG(LOG_ERROR, "No KinZ server at shared memory %s", name);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+        ::close(fd);
+        KZ_LOG(LOG_ERROR, "Shared memory %s is not a KinZ ring", name);
+        return false;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        KZ_LOG(LOG_ERROR, "Cannot map shared memory %s", name);
+        return false;
+    }
+
+    ShmHeader *h = (ShmHeader *)p;
+    size_t needed = align64(sizeof(ShmHeader)) + (size_t)h->num_slots * h->slot_size;
+    if (h->magic != SHM_MAGIC || h->version != SHM_VERSION || needed > (size_t)st.st_size) {
+        munmap(p, (size_t)st.st_size);
+        KZ_LOG(LOG_ERROR, "Shared memory %s is not a KinZ ring of version %u", name, SHM_VERSION);
+        return false;
+    }
+
+    m_header = h;
+    m_size = (size_t)st.st_size;
+    m_last = h->latest.load(std::memory_order_acquire);
+    if (m_last > 0)
+        m_last--;       // the current frame is new to this reader
+    return true;
+}
+
+void ShmReader::close()
+{
+    if (!m_header)
+        return;
+    munmap(m_header, m_size);
+    m_header = nullptr;
+}
+
+bool ShmReader::acquire(ShmFrame &frame, int timeout_ms)
+{
+    if (!m_header)
+        return false;
+
+    SlotLayout layout(*m_header);
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    for (;;) {
+        uint64_t n = m_header->latest.load(std::memory_order_acquire);
+        if (n > m_last) {
+            uint8_t *slot = slot_base(m_header, n);
+            std::atomic<uint64_t> &sequence = slot_sequence(slot);
+
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before == 2 * n) {
+                memcpy(&frame.info, slot + layout.info, sizeof(ShmFrameInfo));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before) {
+                    m_skipped += n - m_last - 1;
+                    m_last = n;
+                    frame.sequence = before;
+                    frame.depth = slot + layout.depth;
+                    frame.color = slot + layout.color;
+                    frame.infrared = slot + layout.infrared;
+                    return true;
+                }
+            }
+            // The slot was reused while reading: take the newer frame
+            continue;
+        }
+
+        if (m_header->closed.load(std::memory_order_acquire) ||
+            std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+bool ShmReader::intact(const ShmFrame &frame) const
+{
+    if (!m_header || frame.sequence == 0)
+        return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint8_t *slot = slot_base(m_header, frame.sequence / 2);
+    return slot_sequence(slot).load(std::memory_order_relaxed) == frame.sequence;
+}
+
+#else // _WIN32
+
+bool ShmWriter::create(const char *, const ShmHeader &)
+{
+    KZ_LOG(LOG_ERROR, "Shared memory frames are only available on Linux");
+    return false;
+}
+void ShmWriter::publish(ShmFrameInfo &, const ShmImages &) {}
+void ShmWriter::close() {}
+
+bool ShmReader::open(const char *)
+{
+    KZ_LOG(LOG_ERROR, "Shared memory frames are only available on Linux");
+    return false;
+}
+void ShmReader::close() {}
+bool ShmReader::acquire(ShmFrame &, int) { return false; }
+bool ShmReader::intact(const ShmFrame &) const { return false; }
+
+#endif
+
+} // namespace kz
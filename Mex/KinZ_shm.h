@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_shm.h
+///
+///		Description:
+///			Ring of captures in POSIX shared memory, written by
+///         KinZ_server and read by any number of KinZ clients.
+///         The segment starts with a ShmHeader describing the streams
+///         and the calibration, followed by num_slots slots. Each slot
+///         holds a ShmFrameInfo (timestamps, IMU, bodies) and the depth,
+///         color and infrared images, row by row as the SDK stores them.
+///
+///         Frame n (1-based) goes to slot (n - 1) % num_slots. Slots are
+///         protected by a seqlock: the sequence is odd while the server
+///         writes the slot and 2n once frame n is complete. Readers never
+///         block the server. They check the sequence before and after
+///         reading, and a frame whose slot was reused is discarded.
+///
+///         Only available on Linux.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_SHM_H__
+#define __KINZ_SHM_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include "KinZ.h"
+
+namespace kz
+{
+    const uint32_t SHM_MAGIC = 0x4B5A5348;     // "KZSH"
+    const uint32_t SHM_VERSION = 1;
+    const int SHM_MAX_BODIES = 8;
+    const char *const SHM_DEFAULT_NAME = "/kinz";
+
+    // Streams published in a frame
+    enum {
+        SHM_DEPTH = 1,
+        SHM_COLOR = 2,
+        SHM_INFRARED = 4,
+        SHM_IMU = 8,
+        SHM_BODIES = 16
+    };
+
+    struct ShmImageFormat {
+        int32_t width = 0;
+        int32_t height = 0;
+        int32_t stride = 0;     // bytes per row
+        size_t size() const { return (size_t)stride * height; }
+    };
+
+    struct ShmHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t num_slots;
+        uint64_t slot_size;             // bytes between consecutive slots
+        uint32_t streams;               // SHM_* published by the server
+        ShmImageFormat depth, color, infrared;
+        int32_t camera_fps;             // k4a_fps_t
+        uint32_t has_calibration;       // 0 for synthetic sources
+        k4a_calibration_t calibration;
+        std::atomic<uint64_t> latest;   // last complete frame, 0 = none
+        std::atomic<uint32_t> closed;   // the server exited
+    };
+
+    struct ShmFrameInfo {
+        uint64_t frame;
+        uint32_t streams;               // SHM_* present in this frame
+        uint64_t depth_timestamp_usec;  // device timestamps
+        uint64_t color_timestamp_usec;
+        uint64_t infrared_timestamp_usec;
+        uint64_t depth_system_nsec;     // host timestamps
+        uint64_t color_system_nsec;
+        uint64_t infrared_system_nsec;
+        Imu_sample imu;
+        uint32_t num_bodies;
+        Body bodies[SHM_MAX_BODIES];
+    };
+
+    // Images of a frame as passed to ShmWriter::publish
+    struct ShmImages {
+        const uint8_t *depth = nullptr;
+        int depth_stride = 0;
+        const uint8_t *color = nullptr;
+        int color_stride = 0;
+        const uint8_t *infrared = nullptr;
+        int infrared_stride = 0;
+    };
+
+    class ShmWriter
+    {
+    public:
+        ~ShmWriter() { close(); }
+
+        // Create the segment. format provides num_slots, streams, the
+        // image formats, camera_fps and the calibration; the rest is
+        // filled here. An existing segment with the same name is replaced.
+        bool create(const char *name, const ShmHeader &format);
+
+        // Copy a frame into the next slot and publish it.
+        // info.frame is assigned here.
+        void publish(ShmFrameInfo &info, const ShmImages &images);
+
+        // Mark the ring closed and remove the segment
+        void close();
+
+        const ShmHeader *header() const { return m_header; }
+
+    private:
+        ShmHeader *m_header = nullptr;
+        size_t m_size = 0;
+        std::string m_name;
+        uint64_t m_frames = 0;
+    };
+
+    // A frame acquired by ShmReader. The image pointers point into the
+    // shared memory and stay valid until the server reuses the slot,
+    // which ShmReader::intact detects.
+    struct ShmFrame {
+        uint64_t sequence = 0;
+        ShmFrameInfo info;
+        uint8_t *depth = nullptr;
+        uint8_t *color = nullptr;
+        uint8_t *infrared = nullptr;
+    };
+
+    class ShmReader
+    {
+    public:
+        ~ShmReader() { close(); }
+
+        bool open(const char *name);
+        void close();
+        bool is_open() const { return m_header != nullptr; }
+        const ShmHeader &header() const { return *m_header; }
+
+        // Wait up to timeout_ms for a frame newer than the last acquired
+        // one and take the most recent. Returns false on timeout or when
+        // the server closed the ring.
+        bool acquire(ShmFrame &frame, int timeout_ms);
+
+        // True while the slot of frame was not reused by the server.
+        // Call it after reading the images.
+        bool intact(const ShmFrame &frame) const;
+
+        // Frames published but not acquired because a newer one was
+        // available, and acquired frames overwritten while being read
+        uint64_t skipped() const { return m_skipped; }
+        uint64_t overruns() const { return m_overruns.load(); }
+        void count_overrun() { m_overruns++; }
+
+    private:
+        ShmHeader *m_header = nullptr;
+        size_t m_size = 0;
+        uint64_t m_last = 0;
+        uint64_t m_skipped = 0;
+        std::atomic<uint64_t> m_overruns{0};
+    };
+}
+
+#endif // __KINZ_SHM_H__
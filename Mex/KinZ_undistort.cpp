@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_undistort.cpp
+///
+///		Description:
+///			Remap tables of the undistorted images, see KinZ_undistort.h.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_undistort.h"
+#include "KinZ_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KZ_SSE2
+#endif
+
+namespace kz
+{
+
+namespace
+{
+const int WEIGHT_BITS = 7;
+const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+// Call fn(k) for the output pixels of the columns [x0, x1) of a
+// column-major image of height h, in memory order
+template <typename Fn>
+inline void for_each_output(int h, int x0, int x1, Fn fn)
+{
+    size_t end = (size_t)x1 * h;
+    for (size_t k = (size_t)x0 * h; k < end; k++)
+        fn(k);
+}
+}
+
+///////// Function: configure /////////////////////////////////////////////
+// Project the ray of each pinhole pixel with the camera distortion
+///////////////////////////////////////////////////////////////////////////
+bool Undistorter::configure(const k4a_calibration_t &calibration, k4a_calibration_type_t camera,
+                            unsigned tables, ThreadPool &pool)
+{
+    const k4a_calibration_camera_t &c = camera == K4A_CALIBRATION_TYPE_DEPTH ?
+        calibration.depth_camera_calibration : calibration.color_camera_calibration;
+    const int w = c.resolution_width;
+    const int h = c.resolution_height;
+    const float fx = c.intrinsics.parameters.param.fx;
+    const float fy = c.intrinsics.parameters.param.fy;
+    const float cx = c.intrinsics.parameters.param.cx;
+    const float cy = c.intrinsics.parameters.param.cy;
+    m_width = m_height = 0;
+    m_tables = 0;
+    if (w <= 1 || h <= 1 || fx <= 0 || fy <= 0)
+        return false;
+
+    const size_t num_pix = (size_t)w * h;
+    m_nearest.assign((tables & NEAREST) ? num_pix : 0, Pixel());
+    m_bilinear.assign((tables & BILINEAR) ? num_pix : 0, Pixel());
+    m_weights.assign((tables & BILINEAR) ? 2 * num_pix : 0, 0);
+
+    parallel_columns(pool, w, [&](int x0, int x1) {
+        for (int x = x0; x < x1; x++)
+            for (int y = 0; y < h; y++) {
+                size_t k = (size_t)x * h + y;
+                k4a_float3_t ray;
+                ray.xyz.x = (x - cx) / fx;
+                ray.xyz.y = (y - cy) / fy;
+                ray.xyz.z = 1.f;
+                k4a_float2_t p;
+                int valid = 0;
+                k4a_calibration_3d_to_2d(&calibration, &ray, camera, camera, &p, &valid);
+                float sx = p.xy.x, sy = p.xy.y;
+                if (!valid || !(sx >= 0 && sx <= w - 1 && sy >= 0 && sy <= h - 1))
+                    sx = sy = -1;
+
+                if (tables & NEAREST) {
+                    Pixel &n = m_nearest[k];
+                    n.x = sx < 0 ? -1 : (int16_t)std::min(w - 1, (int)(sx + 0.5f));
+                    n.y = sx < 0 ? -1 : (int16_t)std::min(h - 1, (int)(sy + 0.5f));
+                }
+                if (tables & BILINEAR) {
+                    // The top-left pixel leaves room for the right and
+                    // bottom ones; a weight of WEIGHT_ONE reaches the edge
+                    Pixel &b = m_bilinear[k];
+                    int ix = std::min(w - 2, (int)sx);
+                    int iy = std::min(h - 2, (int)sy);
+                    b.x = sx < 0 ? -1 : (int16_t)ix;
+                    b.y = sx < 0 ? -1 : (int16_t)iy;
+                    m_weights[2 * k] = sx < 0 ? 0 : (uint8_t)std::lround((sx - ix) * WEIGHT_ONE);
+                    m_weights[2 * k + 1] = sx < 0 ? 0 : (uint8_t)std::lround((sy - iy) * WEIGHT_ONE);
+                }
+            }
+    });
+    m_width = w;
+    m_height = h;
+    m_tables = tables;
+    return true;
+} // end configure
+
+void Undistorter::nearest_u16(const uint8_t *src, size_t row_step, size_t col_step,
+                              uint16_t *dst, int x0, int x1) const
+{
+    for_each_output(m_height, x0, x1, [&](size_t k) {
+        Pixel p = m_nearest[k];
+        dst[k] = p.x >= 0 ? *(const uint16_t *)(src + p.y * row_step + p.x * col_step) : 0;
+    });
+}
+
+void Undistorter::bilinear_u16(const uint8_t *src, int stride, uint16_t *dst, int x0, int x1) const
+{
+    for_each_output(m_height, x0, x1, [&](size_t k) {
+        Pixel p = m_bilinear[k];
+        if (p.x < 0) {
+            dst[k] = 0;
+            return;
+        }
+        const uint16_t *top = (const uint16_t *)(src + (size_t)p.y * stride) + p.x;
+        const uint16_t *bottom = (const uint16_t *)((const uint8_t *)top + stride);
+        uint32_t wx = m_weights[2 * k], wy = m_weights[2 * k + 1];
+        uint32_t t = top[0] * (WEIGHT_ONE - wx) + top[1] * wx;
+        uint32_t b = bottom[0] * (WEIGHT_ONE - wx) + bottom[1] * wx;
+        dst[k] = (uint16_t)((t * (WEIGHT_ONE - wy) + b * wy + (1u << (2 * WEIGHT_BITS - 1)))
+                            >> (2 * WEIGHT_BITS));
+    });
+}
+
+///////// Function: bilinearBgraToRgb /////////////////////////////////////
+// The 4 channels of a pixel are interpolated together: the left and right
+// pixels are interleaved in 16-bit lanes and weighted with madd, first
+// along x, then, rounded to 8 bits, along y
+///////////////////////////////////////////////////////////////////////////
+void Undistorter::bilinear_bgra_to_rgb(const uint8_t *src, int stride, uint8_t *dst,
+                                       int x0, int x1) const
+{
+    const size_t num_pix = (size_t)m_width * m_height;
+    uint8_t *r = dst;
+    uint8_t *g = dst + num_pix;
+    uint8_t *b = dst + 2 * num_pix;
+
+#ifdef KZ_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+    for_each_output(m_height, x0, x1, [&](size_t k) {
+        Pixel p = m_bilinear[k];
+        if (p.x < 0) {
+            r[k] = g[k] = b[k] = 0;
+            return;
+        }
+        const uint8_t *row = src + (size_t)p.y * stride + 4 * p.x;
+        int wx = m_weights[2 * k], wy = m_weights[2 * k + 1];
+        __m128i weights_x = _mm_set1_epi32((wx << 16) | (WEIGHT_ONE - wx));
+        __m128i weights_y = _mm_set1_epi32((wy << 16) | (WEIGHT_ONE - wy));
+
+        // Left and right pixels as (left, right) pairs of each channel
+        __m128i top = _mm_loadl_epi64((const __m128i *)row);
+        __m128i bottom = _mm_loadl_epi64((const __m128i *)(row + stride));
+        top = _mm_unpacklo_epi8(_mm_unpacklo_epi8(top, _mm_srli_si128(top, 4)), zero);
+        bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi8(bottom, _mm_srli_si128(bottom, 4)), zero);
+        __m128i t = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(top, weights_x), half), WEIGHT_BITS);
+        __m128i u = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(bottom, weights_x), half), WEIGHT_BITS);
+
+        // (top, bottom) pairs of each channel
+        __m128i v = _mm_unpacklo_epi16(_mm_packs_epi32(t, zero), _mm_packs_epi32(u, zero));
+        v = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(v, weights_y), half), WEIGHT_BITS);
+        b[k] = (uint8_t)_mm_cvtsi128_si32(v);
+        g[k] = (uint8_t)_mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+        r[k] = (uint8_t)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    });
+#else
+    const int half = 1 << (WEIGHT_BITS - 1);
+    for_each_output(m_height, x0, x1, [&](size_t k) {
+        Pixel p = m_bilinear[k];
+        if (p.x < 0) {
+            r[k] = g[k] = b[k] = 0;
+            return;
+        }
+        const uint8_t *top = src + (size_t)p.y * stride + 4 * p.x;
+        const uint8_t *bottom = top + stride;
+        int wx = m_weights[2 * k], wy = m_weights[2 * k + 1];
+        uint8_t out[3];
+        for (int c = 0; c < 3; c++) {
+            int t = (top[c] * (WEIGHT_ONE - wx) + top[c + 4] * wx + half) >> WEIGHT_BITS;
+            int u = (bottom[c] * (WEIGHT_ONE - wx) + bottom[c + 4] * wx + half) >> WEIGHT_BITS;
+            out[c] = (uint8_t)((t * (WEIGHT_ONE - wy) + u * wy + half) >> WEIGHT_BITS);
+        }
+        b[k] = out[0];
+        g[k] = out[1];
+        r[k] = out[2];
+    });
+#endif
+} // end bilinearBgraToRgb
+
+} // namespace kz
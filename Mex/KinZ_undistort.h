@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////
+///		KinZ_undistort.h
+///
+///		Description:
+///			Undistortion of the images of a K4A camera with remap tables.
+///         The undistorted image is that of the pinhole camera with the
+///         same size and intrinsics (fx, fy, cx, cy) and no distortion.
+///         The tables hold, for each of its pixels, where the same ray
+///         lands in the camera image, found once per calibration with
+///         k4a_calibration_3d_to_2d; remapping a frame is then a gather.
+///          * nearest: the source pixel, for depth, where interpolating
+///            would mix surfaces.
+///          * bilinear: the top-left of the 4 source pixels and the
+///            weights of the right and bottom ones in 1/128, for infrared
+///            and color.
+///         Tables are stored in the column-major order of the Matlab
+///         output, so the remap writes it sequentially and the transpose
+///         of the getters comes for free.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __KINZ_UNDISTORT_H__
+#define __KINZ_UNDISTORT_H__
+#include <k4a/k4a.h>
+#include <stdint.h>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace kz
+{
+    class Undistorter
+    {
+    public:
+        enum { NEAREST = 1, BILINEAR = 2 };     // tables of configure
+
+        // Build the tables of camera from calibration. Returns false if
+        // the camera is not calibrated.
+        bool configure(const k4a_calibration_t &calibration, k4a_calibration_type_t camera,
+                       unsigned tables, ThreadPool &pool);
+        bool configured() const { return m_width > 0; }
+        bool has(unsigned tables) const { return configured() && (m_tables & tables) == tables; }
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+
+        // The remaps write the output columns [x0, x1) of a
+        // (height x width) Matlab array, 0 where the ray does not land in
+        // the camera image.
+
+        // 16-bit image whose pixel (x, y) is at src + y*row_step +
+        // x*col_step bytes: row_step is the stride and col_step 2 for an
+        // image of the SDK; 2 and 2*height for a Matlab array.
+        void nearest_u16(const uint8_t *src, size_t row_step, size_t col_step,
+                         uint16_t *dst, int x0, int x1) const;
+        void bilinear_u16(const uint8_t *src, int stride, uint16_t *dst, int x0, int x1) const;
+        // BGRA image to a planar (height x width x 3) RGB Matlab array
+        void bilinear_bgra_to_rgb(const uint8_t *src, int stride, uint8_t *dst,
+                                  int x0, int x1) const;
+
+    private:
+        struct Pixel {
+            int16_t x, y;       // x < 0 when the ray does not land in the image
+        };
+
+        int m_width = 0, m_height = 0;
+        unsigned m_tables = 0;
+        std::vector<Pixel> m_nearest;
+        std::vector<Pixel> m_bilinear;
+        std::vector<uint8_t> m_weights;     // right and bottom weight of each pixel
+    };
+}
+
+#endif // __KINZ_UNDISTORT_H__
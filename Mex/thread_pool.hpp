@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////////////////////////////
+///		thread_pool.hpp
+///
+///		Description:
+///			Persistent pool of worker threads used by KinZ to run frame
+///         conversions concurrently.
+///         Tasks are submitted into a Group and the caller waits on that
+///         group. While waiting, the caller executes queued tasks itself,
+///         so waiting from inside a task never deadlocks.
+///
+///         Tasks must not call any mex/mx function: those are only safe
+///         on the MATLAB thread.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace kz
+{
+class ThreadPool
+{
+public:
+    // Set of submitted tasks that can be waited on together
+    class Group
+    {
+    public:
+        Group() : m_pending(0) {}
+    private:
+        friend class ThreadPool;
+        std::atomic<int> m_pending;
+    };
+
+    // num_threads counts the calling thread, 0 = one per hardware thread
+    explicit ThreadPool(unsigned num_threads = 0) { start(num_threads); }
+    ~ThreadPool() { stop(); }
+
+    // Number of threads taking part in parallel_for (workers + caller)
+    unsigned size() const { return (unsigned)m_workers.size() + 1; }
+
+    // Restart the pool with num_threads threads. Worker i is pinned to
+    // cpus[i % cpus.size()]; an empty list leaves the OS scheduling them.
+    // Only the thread that submits to the pool (the MATLAB thread for
+    // KinZ) may call it. Returns false and leaves the pool unchanged
+    // while tasks are queued or another thread waits on a group.
+    bool resize(unsigned num_threads, const std::vector<int> &cpus = std::vector<int>())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_tasks.empty() || m_waiting > 0)
+                return false;
+        }
+        stop();
+        start(num_threads);
+        for (size_t i = 0; i < m_workers.size() && !cpus.empty(); i++)
+            pin(m_workers[i], cpus[i % cpus.size()]);
+        return true;
+    }
+
+    void submit(Group &group, std::function<void()> task)
+    {
+        group.m_pending++;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(Task{&group, std::move(task)});
+        }
+        m_cv.notify_all();
+    }
+
+    // Block until all the tasks of the group finished
+    void wait(Group &group)
+    {
+        m_waiting++;
+        while (group.m_pending.load() > 0) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_tasks.empty()) {
+                    m_cv.wait(lock, [&] { return group.m_pending.load() == 0 || !m_tasks.empty(); });
+                    continue;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            execute(task);
+        }
+        m_waiting--;
+    }
+
+    // Call fn(i) for i in [0, n) and return when all calls finished
+    void parallel_for(int n, const std::function<void(int)> &fn)
+    {
+        if (n <= 0)
+            return;
+        if (n == 1 || m_workers.empty()) {
+            for (int i = 0; i < n; i++)
+                fn(i);
+            return;
+        }
+
+        Group group;
+        group.m_pending += n - 1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (int i = 1; i < n; i++)
+                m_tasks.push_back(Task{&group, [&fn, i] { fn(i); }});
+        }
+        m_cv.notify_all();
+
+        fn(0);
+        wait(group);
+    }
+
+private:
+    struct Task
+    {
+        Group *group;
+        std::function<void()> fn;
+    };
+
+    std::vector<std::thread> m_workers;
+    std::deque<Task> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<int> m_waiting{0};   // threads inside wait()
+    bool m_stop = false;
+
+    void start(unsigned num_threads)
+    {
+        if (num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        m_stop = false;
+        for (unsigned i = 1; i < num_threads; i++)
+            m_workers.emplace_back([this] { worker_loop(); });
+    }
+
+    static bool pin(std::thread &thread, int cpu)
+    {
+    #if defined(_WIN32)
+        return SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << cpu) != 0;
+    #elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+    #else
+        return false;
+    #endif
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        for (size_t i = 0; i < m_workers.size(); i++)
+            m_workers[i].join();
+        m_workers.clear();
+    }
+
+    void execute(Task &task)
+    {
+        task.fn();
+        if (--task.group->m_pending == 0) {
+            // Notify under the lock so a waiter cannot miss the wake-up
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cv.notify_all();
+        }
+    }
+
+    void worker_loop()
+    {
+        for (;;) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                if (m_stop && m_tasks.empty())
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            execute(task);
+        }
+    }
+}; // ThreadPool
+} // namespace kz
+
+#endif // __THREAD_POOL_HPP__
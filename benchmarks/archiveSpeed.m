@@ -0,0 +1,51 @@
+% ARCHIVESPEED Write throughput of the frame archive and random access
+% read time with KinZArchive.
+% The first part writes synthetic 1080p frames (depth, infrared, color and
+% point cloud) and does not need a device. The second part records frames
+% from the device with getframes + archivewrite.
+%
+addpath('../Mex');
+clear all
+close all
+
+filename = fullfile(tempdir, 'kinz_archive_speed.kza');
+numFrames = 300;
+
+%% Synthetic 1080p frames, converted and written
+speed = KinZ_mex('bencharchive', filename, numFrames, [640 576 1920 1080]);
+fprintf('Synthetic: %.0f MB/s, %.1f frames/s (30 fps needed)\n', speed(1), speed(2));
+
+%% Random access
+ar = KinZArchive(filename);
+idx = randi(ar.NumFrames, 1, 100);
+tic
+for i = idx
+    f = ar.frame(i);
+end
+fprintf('Random access: %.2f ms per frame over %d frames\n', ...
+    1000*toc/numel(idx), ar.NumFrames);
+clear ar
+
+%% Device frames
+useDevice = false;
+if useDevice
+    kz = KinZ('1080p', 'unbinned', 'imu_off');
+    kz.archiveopen(filename, 'depth', 'infrared', 'color', 'pointcloud');
+    t_write = zeros(numFrames, 1);
+    for n = 1:numFrames
+        validData = kz.getframes('color', 'depth', 'infrared');
+        if ~validData
+            continue
+        end
+        tic
+        kz.archivewrite();
+        t_write(n) = toc;
+    end
+    written = kz.archiveclose();
+    stats = kz.getframestats;
+    kz.delete;
+    fprintf('Device: %d frames, archivewrite %.2f ms (max %.2f ms), %d skipped\n', ...
+        written, 1000*mean(t_write), 1000*max(t_write), stats.consumer_skipped);
+end
+
+delete(filename);
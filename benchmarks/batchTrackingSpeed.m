@@ -0,0 +1,31 @@
+% BATCHTRACKINGSPEED Frames per second of the offline body tracking of a
+% recording with each processing mode and network. Does not need a
+% device. Record a file first, e.g. with
+%   k4arecorder -d NFOV_UNBINNED -c OFF -l 30 session.mkv
+%
+addpath('../Mex');
+clear all
+close all
+
+filename = 'session.mkv';
+configs = {{'processingMode', 'gpu'}, ...
+           {'processingMode', 'gpu', 'liteModel', true}, ...
+           {'processingMode', 'cpu'}, ...
+           {'processingMode', 'cpu', 'liteModel', true}};
+
+for c = 1:numel(configs)
+    try
+        tracked = KinZ.trackrecording(filename, configs{c}{:});
+    catch err
+        fprintf('%-30s %s\n', strjoin(cellfun(@num2str, configs{c}, 'UniformOutput', false), ' '), ...
+            err.message);
+        continue
+    end
+    fprintf('%-30s %d frames, %.1f fps, %d skipped, max %d bodies\n', ...
+        strjoin(cellfun(@num2str, configs{c}, 'UniformOutput', false), ' '), ...
+        tracked.frames, tracked.fps, tracked.skipped, size(tracked.Id, 1));
+end
+
+% Trajectory of the pelvis (joint 1) of the first body slot
+figure, plot(double(tracked.Timestamps) / 1e6, squeeze(tracked.Position3d(:, 1, 1, :))');
+xlabel('time (s)'), ylabel('pelvis (mm)'), legend('x', 'y', 'z');
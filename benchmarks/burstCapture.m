@@ -0,0 +1,38 @@
+% BURSTCAPTURE Frames lost when logging n consecutive frames with one
+% getframes + getdepth + getcolor round trip per frame, against a single
+% getburst call. Missing frames are found from the gaps between the depth
+% device timestamps.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('1080p', 'unbinned', 'nfov', 'imu_off');
+numFrames = 150;
+period = 1e6 / 30;      % usec at 30 fps
+
+% Round trips from Matlab
+times = zeros(numFrames, 1, 'uint64');
+depth = zeros(kz.DepthHeight, kz.DepthWidth, numFrames, 'uint16');
+color = zeros(kz.ColorHeight, kz.ColorWidth, 3, numFrames, 'uint8');
+tic
+for n = 1:numFrames
+    while ~kz.getframes('color', 'depth')
+    end
+    [depth(:,:,n), times(n)] = kz.getdepth;
+    color(:,:,:,n) = kz.getcolor;
+end
+t_loop = toc;
+lost_loop = sum(round(double(diff(times)) / period) - 1);
+
+% One call
+tic
+burst = kz.getburst(numFrames, 'depth', 'color');
+t_burst = toc;
+burstTimes = burst.timestamps(burst.valid(:,1), 1);
+lost_burst = sum(round(double(diff(burstTimes)) / period) - 1);
+
+fprintf('getframes loop: %.2f s, %d frames lost\n', t_loop, lost_loop);
+fprintf('getburst:       %.2f s, %d frames lost, %d captured\n', t_burst, ...
+        lost_burst, burst.captured);
+kz.delete;
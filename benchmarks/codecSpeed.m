@@ -0,0 +1,54 @@
+% CODECSPEED Compression ratio and speed of the lossless depth/infrared
+% codec on recorded frames. The frames are recorded from the device, or
+% read from a KinZ archive (see archiveSpeed.m) when archiveFile is set.
+%
+addpath('../Mex');
+clear all
+close all
+
+numFrames = 100;
+threads = [1 2 4 0];    % 0 = one thread per core
+archiveFile = '';
+
+if isempty(archiveFile)
+    kz = KinZ('720p', 'unbinned', 'wfov', 'imu_off');
+    depth = zeros(kz.DepthHeight, kz.DepthWidth, numFrames, 'uint16');
+    infrared = zeros(kz.DepthHeight, kz.DepthWidth, numFrames, 'uint16');
+    n = 0;
+    while n < numFrames
+        validData = kz.getframes('depth', 'infrared');
+        if validData
+            n = n + 1;
+            depth(:,:,n) = kz.getdepth;
+            infrared(:,:,n) = kz.getinfrared;
+        end
+    end
+    % Compression straight from the SDK buffers
+    tic
+    for i = 1:30
+        data = kz.getdepthencoded;
+    end
+    fprintf('getdepthencoded: %.2f ms, %.1f:1\n', 1000*toc/30, 2*numel(depth(:,:,1))/numel(data));
+    kz.delete;
+else
+    ar = KinZArchive(archiveFile);
+    numFrames = min(numFrames, ar.NumFrames);
+    for n = 1:numFrames
+        f = ar.frame(n);
+        depth(:,:,n) = f.depth;
+        infrared(:,:,n) = f.infrared;
+    end
+end
+
+names = {'depth', 'infrared'};
+stacks = {depth, infrared};
+for s = 1:2
+    r = KinZ_mex('benchcodec', stacks{s}, threads);
+    for t = 1:numel(threads)
+        fprintf('%s, %d threads: ratio %.2f:1, encode %.2f GB/s, decode %.2f GB/s\n', ...
+            names{s}, threads(t), r(t,1), r(t,2), r(t,3));
+    end
+end
+
+rawRate = 2 * size(depth,1) * size(depth,2) * 30 / 1e6;
+fprintf('Raw depth at 30 fps: %.1f MB/s\n', rawRate);
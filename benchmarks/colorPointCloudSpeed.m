@@ -0,0 +1,39 @@
+% COLORPOINTCLOUDSPEED Time of the point cloud in color geometry at
+% 1080p, full resolution and decimated, against the depth geometry cloud.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('1080p', 'unbinned', 'nfov', 'imu_off');
+
+numFrames = 50;
+steps = [1 2 4];
+t_depth = nan(1, numFrames);
+t_color = nan(numFrames, numel(steps));
+numPoints = zeros(1, numel(steps));
+for n = 1:numFrames
+    validData = kz.getframes('color', 'depth');
+    if ~validData
+        continue
+    end
+    tic
+    [xyz, rgb] = kz.getpointcloud('color', 'true');
+    t_depth(n) = toc;
+
+    for s = 1:numel(steps)
+        tic
+        [xyz, rgb] = kz.getpointcloud('geometry', 'color', 'color', 'true', ...
+                                      'compact', true, 'step', steps(s));
+        t_color(n, s) = toc;
+        numPoints(s) = size(xyz, 1);
+    end
+end
+kz.delete;
+
+fprintf('depth geometry: %.1f ms\n', 1000*mean(t_depth, 'omitnan'));
+for s = 1:numel(steps)
+    fprintf('color geometry, step %d: %.1f ms, %d points\n', steps(s), ...
+        1000*mean(t_color(:, s), 'omitnan'), numPoints(s));
+end
+figure, pcshow(xyz, rgb);
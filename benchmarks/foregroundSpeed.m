@@ -0,0 +1,61 @@
+% FOREGROUNDSPEED Background model and foreground points maintained by
+% KinZ in C++ on every getframes, against the same running mean and
+% variance updated in Matlab from getdepth. Step in front of the camera
+% after the first second to see foreground.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('720p', 'nfov', 'unbinned', 'imu_off');
+numFrames = 150;
+rate = 0.02;
+k = 3;
+minDeviation = 20;
+relDeviation = 0.01;
+
+t_kinz = zeros(numFrames, 1);
+t_matlab = zeros(numFrames, 1);
+numPoints = zeros(numFrames, 2);
+for pass = 1:2
+    kz.setbackground('enabled', pass == 1, 'learningRate', rate, 'threshold', k, ...
+                     'minDeviation', minDeviation, 'relativeDeviation', relDeviation);
+    bgMean = zeros(kz.DepthHeight, kz.DepthWidth, 'single');
+    bgVar = zeros(kz.DepthHeight, kz.DepthWidth, 'single');
+    count = zeros(kz.DepthHeight, kz.DepthWidth, 'single');
+    for n = 1:numFrames
+        while ~kz.getframes('depth')
+        end
+        tic
+        if pass == 1
+            % getframes already updated the model
+            mask = kz.getforeground;
+            pc = kz.getpointcloud('foreground', true);
+            t_kinz(n) = toc;
+        else
+            depth = single(kz.getdepth);
+            valid = depth > 0;
+            diff = depth - bgMean;
+            deviation = max(minDeviation, relDeviation * bgMean);
+            mask = valid & count > 0 & diff < 0 & ...
+                   diff.^2 > max(k^2 * bgVar, deviation.^2);
+            r = max(rate, 1 ./ (count + 1));
+            r(mask) = 0;
+            r(~valid) = 0;
+            bgMean = bgMean + r .* diff;
+            bgVar = (1 - r) .* (bgVar + r .* diff.^2);
+            count = min(count + single(valid & ~mask), ceil(1 / rate));
+            pc = kz.getpointcloud;
+            pc = pc(mask', :);
+            t_matlab(n) = toc;
+        end
+        numPoints(n, pass) = size(pc, 1);
+    end
+end
+kz.delete;
+
+fprintf('KinZ model + mask + foreground cloud: %.2f ms\n', 1000*median(t_kinz));
+fprintf('Matlab model + mask + foreground cloud: %.2f ms\n', 1000*median(t_matlab));
+plot(numPoints);
+legend('KinZ', 'Matlab');
+xlabel('frame'); ylabel('foreground points');
@@ -0,0 +1,55 @@
+% FRAMEPOOLSPEED Page faults and capture-to-copy latency of 3072p frames
+% with the SDK allocator and with the KinZ frame pool.
+% The latency is the time of getframes plus the copy of the color and
+% depth images to MATLAB. The page faults are those of the whole MATLAB
+% process during the loop.
+%
+addpath('../Mex');
+clear all
+close all
+
+numFrames = 100;
+warmup = 10;
+pools = [false true];
+faults = nan(1, numel(pools));
+latency = nan(numFrames, numel(pools));
+for p = 1:numel(pools)
+    if pools(p) && ~KinZ.setframepool(true)
+        error('The SDK did not accept the frame pool');
+    end
+    kz = KinZ('3072p', 'unbinned', 'nfov', 'imu_off');
+
+    n = 0;
+    while n < warmup
+        n = n + kz.getframes('color', 'depth');
+    end
+    startFaults = KinZ.getframepoolstats(true).page_faults;
+    n = 0;
+    while n < numFrames
+        tic
+        validData = kz.getframes('color', 'depth');
+        if ~validData
+            continue
+        end
+        color = kz.getcolor;
+        depth = kz.getdepth;
+        n = n + 1;
+        latency(n, p) = toc;
+    end
+    stats = KinZ.getframepoolstats;
+    faults(p) = (stats.page_faults - startFaults) / numFrames;
+    kz.delete;
+
+    if pools(p)
+        fprintf('pool: %d allocations, %d recycled, %d new, %d on huge pages, peak %.0f MB\n', ...
+            stats.allocations, stats.hits, stats.misses, stats.huge_page_buffers, ...
+            stats.peak_bytes / 2^20);
+        KinZ.setframepool(false);
+    end
+end
+
+names = {'SDK allocator', 'frame pool'};
+for p = 1:numel(pools)
+    fprintf('%-13s: %8.0f page faults/frame, latency %.1f ms (median), %.1f ms (99%%)\n', ...
+        names{p}, faults(p), 1000*median(latency(:, p)), 1000*prctile(latency(:, p), 99));
+end
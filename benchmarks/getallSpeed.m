@@ -0,0 +1,52 @@
+% GETALLSPEED Compares the multi-call acquisition pattern of videoSpeed.m
+% against a single getall call per frame.
+%
+addpath('../Mex');
+clear all
+close all
+
+% Create KinZ object and initialize it
+% Available options: 
+% '720p', '1080p', '1440p', '1535p', '2160p', '3072p'
+% 'binned' or 'unbinned'
+% 'wfov' or 'nfov'
+% 'sensors_on' or 'sensors_off'
+kz = KinZ('3072p', 'unbinned', 'wfov', 'imu_off');
+
+numFrames = 100;
+
+% Multi-call pattern: getframes + one getter per stream
+t_multi = zeros(1, numFrames);
+for n = 1:numFrames
+    tic
+    validData = kz.getframes('color','depth','infrared');
+    if validData
+        [depth, depth_timestamp] = kz.getdepth;
+        [color, color_timestamp] = kz.getcolor;
+        [infrared, infrared_timestamp] = kz.getinfrared;
+    end
+    t_multi(n) = toc;
+end
+
+% Single call with parallel conversion
+t_all = zeros(1, numFrames);
+for n = 1:numFrames
+    tic
+    data = kz.getall('color','depth','infrared');
+    if data.valid
+        depth = data.depth;
+        color = data.color;
+        infrared = data.infrared;
+    end
+    t_all(n) = toc;
+end
+
+% Close kinect object
+kz.delete;
+
+plot(1:numFrames, t_multi, 1:numFrames, t_all)
+legend('getframes + getters', 'getall')
+xlabel('frame'); ylabel('seconds')
+
+fprintf('getframes + getters: %.2f FPS (%.2f ms/frame)\n', 1/mean(t_multi), 1000*mean(t_multi));
+fprintf('getall:              %.2f FPS (%.2f ms/frame)\n', 1/mean(t_all), 1000*mean(t_all));
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////
+///		kernelSpeed.cpp
+///
+///		Description:
+///			Time of the frame conversion kernels for every instruction set
+///         supported by the CPU, on synthetic frames, without MATLAB or a
+///         device. Also checks that all instruction sets give the same
+///         output. Built by CMake as kinz_kernel_speed.
+///
+///		Usage:
+///			kinz_kernel_speed [colorWidth colorHeight [iterations [threads]]]
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ_kernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    int cw = argc > 2 ? atoi(argv[1]) : 3840;
+    int ch = argc > 2 ? atoi(argv[2]) : 2160;
+    int iterations = argc > 3 ? atoi(argv[3]) : 50;
+    unsigned threads = argc > 4 ? (unsigned)atoi(argv[4]) : 1;
+    int dw = 640, dh = 576;
+
+    std::vector<uint8_t> bgra((size_t)cw * ch * 4);
+    std::vector<uint8_t> depth((size_t)dw * dh * 2);
+    for (size_t i = 0; i < bgra.size(); i++)
+        bgra[i] = (uint8_t)(i * 31 + (i >> 12));
+    for (size_t i = 0; i < depth.size(); i++)
+        depth[i] = (uint8_t)(i * 17 + (i >> 10));
+
+    kz::ThreadPool pool(threads);
+    kz::Region color_full(cw, ch), depth_full(dw, dh);
+    std::vector<uint8_t> rgb((size_t)cw * ch * 3), rgb_ref;
+    std::vector<uint16_t> u16((size_t)dw * dh), u16_ref;
+
+    printf("color %dx%d, depth %dx%d, %u threads\n", cw, ch, dw, dh, pool.size());
+    bool same = true;
+    for (int isa = kz::ISA_BASELINE; isa <= kz::best_kernel_isa(); isa++) {
+        kz::set_kernel_isa((kz::KernelIsa)isa);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++)
+            kz::parallel_columns(pool, cw, [&](int x0, int x1) {
+                kz::bgra_to_rgb(bgra.data(), 4 * cw, color_full, rgb.data(), x0, x1);
+            });
+        auto middle = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++)
+            kz::parallel_columns(pool, dw, [&](int x0, int x1) {
+                kz::u16_to_matlab(depth.data(), 2 * dw, depth_full, u16.data(), x0, x1);
+            });
+        auto end = std::chrono::steady_clock::now();
+
+        printf("%-8s: color %.2f ms, 16-bit %.3f ms\n", kz::kernel_isa_name((kz::KernelIsa)isa),
+               std::chrono::duration<double, std::milli>(middle - start).count() / iterations,
+               std::chrono::duration<double, std::milli>(end - middle).count() / iterations);
+
+        if (isa == kz::ISA_BASELINE) {
+            rgb_ref = rgb;
+            u16_ref = u16;
+        }
+        else if (rgb != rgb_ref || u16 != u16_ref) {
+            printf("%s output differs from the baseline\n", kz::kernel_isa_name((kz::KernelIsa)isa));
+            same = false;
+        }
+    }
+    return same ? 0 : 1;
+}
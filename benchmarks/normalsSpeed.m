@@ -0,0 +1,35 @@
+% NORMALSSPEED Compares pcnormals on the cloud of getpointcloud with the
+% normals estimated in C++ on the depth grid.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('720p', 'unbinned', 'wfov', 'imu_off');
+
+numFrames = 50;
+t_pcnormals = nan(1, numFrames);
+t_grid = nan(1, numFrames);
+for n = 1:numFrames
+    validData = kz.getframes('depth');
+    if ~validData
+        continue
+    end
+    tic
+    pc = kz.getpointcloud('output', 'pointCloud');
+    normals = pcnormals(pc, 9);
+    t_pcnormals(n) = toc;
+
+    tic
+    [xyz, ~, normals] = kz.getpointcloud;
+    t_grid(n) = toc;
+end
+kz.delete;
+
+fprintf('%d points\n', size(xyz, 1));
+fprintf('getpointcloud + pcnormals: %.1f ms\n', 1000*mean(t_pcnormals, 'omitnan'));
+fprintf('getpointcloud with normals: %.1f ms\n', 1000*mean(t_grid, 'omitnan'));
+
+valid = any(normals, 2);
+figure, pcshow(xyz(valid,:), abs(normals(valid,:)));
+title('Normals (absolute value as color)');
@@ -0,0 +1,41 @@
+% POINTCLOUDSAVE Compares the time the capture loop spends saving point
+% clouds with getpointcloud + pcwrite against savepointcloud, which
+% writes the file on a background thread.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('720p', 'unbinned', 'nfov', 'imu_off');
+outDir = fullfile(tempdir, 'kinz_clouds');
+if ~exist(outDir, 'dir')
+    mkdir(outDir);
+end
+
+numFrames = 60;
+t_pcwrite = nan(1, numFrames);
+t_save = nan(1, numFrames);
+
+for n = 1:numFrames
+    validData = kz.getframes('color', 'depth');
+    if ~validData
+        continue
+    end
+    tic
+    pc = kz.getpointcloud('output', 'pointCloud', 'color', 'true');
+    pcwrite(pc, fullfile(outDir, sprintf('pcwrite%03d.pcd', n)), 'Encoding', 'binary');
+    t_pcwrite(n) = toc;
+
+    tic
+    kz.savepointcloud(fullfile(outDir, sprintf('kinz%03d.pcd', n)), 'color', true);
+    t_save(n) = toc;
+end
+kz.flushclouds;
+stats = kz.getcloudwriterstats;
+kz.delete;
+
+fprintf('getpointcloud + pcwrite: %.1f ms per frame\n', 1000*mean(t_pcwrite, 'omitnan'));
+fprintf('savepointcloud: %.1f ms per frame (writer %.1f ms per cloud)\n', ...
+    1000*mean(t_save, 'omitnan'), stats.write_ms_mean);
+fprintf('written %d, dropped %d, max pending %d\n', ...
+    stats.written, stats.dropped, stats.max_pending);
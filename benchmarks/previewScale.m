@@ -0,0 +1,37 @@
+% PREVIEWSCALE Compares a full resolution getcolor followed by imresize
+% against the downscaled getcolor, which averages the pixels in the copy.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('2160p', 'unbinned', 'wfov', 'imu_off');
+
+numFrames = 100;
+scales = [1/2 1/4 1/8];
+
+t_resize = zeros(numFrames, numel(scales));
+t_scale = zeros(numFrames, numel(scales));
+for n = 1:numFrames
+    validData = kz.getframes('color');
+    if ~validData
+        continue
+    end
+    for s = 1:numel(scales)
+        tic
+        color = imresize(kz.getcolor, scales(s), 'box');
+        t_resize(n,s) = toc;
+
+        tic
+        color = kz.getcolor('scale', scales(s));
+        t_scale(n,s) = toc;
+    end
+end
+
+% Close kinect object
+kz.delete;
+
+for s = 1:numel(scales)
+    fprintf('1/%d: getcolor + imresize %.2f ms, getcolor scale %.2f ms\n', ...
+        round(1/scales(s)), 1000*mean(t_resize(:,s)), 1000*mean(t_scale(:,s)));
+end
@@ -0,0 +1,45 @@
+% REPROJECTIONSPEED Time of the aligned images with the SDK transformation
+% and the native engine, for 1 thread and all the cores, and agreement of
+% both on the last frame.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('1080p', 'unbinned', 'nfov', 'imu_off');
+
+numFrames = 50;
+engines = {'sdk', 'native'};
+threads = [1 0];
+t_depth = nan(numFrames, numel(engines), numel(threads));
+t_color = nan(numFrames, numel(engines), numel(threads));
+for n = 1:numFrames
+    validData = kz.getframes('color', 'depth');
+    if ~validData
+        continue
+    end
+    for e = 1:numel(engines)
+        kz.setreprojection(engines{e});
+        for t = 1:numel(threads)
+            kz.setthreads(threads(t));
+            tic
+            depthAligned = kz.getdepthaligned;
+            t_depth(n, e, t) = toc;
+            tic
+            colorAligned = kz.getcoloraligned;
+            t_color(n, e, t) = toc;
+        end
+    end
+end
+report = kz.validatereprojection;
+kz.delete;
+
+for e = 1:numel(engines)
+    for t = 1:numel(threads)
+        fprintf('%-6s threads %d: depth to color %.1f ms, color to depth %.1f ms\n', ...
+            engines{e}, threads(t), 1000*mean(t_depth(:, e, t), 'omitnan'), ...
+            1000*mean(t_color(:, e, t), 'omitnan'));
+    end
+end
+disp(report);
+figure, imshow(depthAligned, [0 3000]);
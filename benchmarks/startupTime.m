@@ -0,0 +1,42 @@
+% STARTUPTIME Time until KinZ returns control to MATLAB and latency of the
+% first frames, with the blocking initialization and with 'async' and
+% 'warmup'. Body tracking makes the difference larger; remove
+% 'bodyTracking' if KinZ was compiled without it.
+%
+addpath('../Mex');
+clear all
+close all
+
+sources = {'720p', 'unbinned', 'nfov', 'bodyTracking'};
+modes = {{}, {'async', 'warmup'}};
+names = {'blocking', 'async + warmup'};
+numFrames = 10;
+firstFrames = nan(numFrames, numel(modes));
+for m = 1:numel(modes)
+    tic
+    kz = KinZ(sources{:}, modes{m}{:});
+    returned = toc;
+    while ~kz.isready
+        pause(0.01);
+    end
+    ready = toc;
+    timing = kz.getinittiming;
+
+    for n = 1:numFrames
+        tic
+        while ~kz.getframes('color', 'depth', 'bodies')
+        end
+        depthAligned = kz.getdepthaligned;
+        bodies = kz.getbodies;
+        firstFrames(n, m) = toc;
+    end
+    kz.delete;
+
+    fprintf('%s: constructor %.0f ms, ready %.0f ms\n', names{m}, 1000*returned, 1000*ready);
+    disp(timing);
+end
+
+plot(1000*firstFrames, '-o');
+legend(names);
+xlabel('frame'); ylabel('getframes + aligned depth + bodies (ms)');
+title('Latency of the first frames');
@@ -0,0 +1,30 @@
+% TILINGSCALING Measures how the tiled frame conversions scale with the
+% number of threads, with the best instruction set of the CPU and with the
+% baseline kernels. Uses synthetic 4096x3072 frames, no Kinect needed.
+%
+addpath('../Mex');
+clear all
+close all
+
+width = 4096;
+height = 3072;
+iterations = 20;
+maxThreads = feature('numcores');
+threads = 1:maxThreads;
+
+% ms per frame: column 1 = BGRA to RGB, column 2 = 16-bit (aligned depth)
+KinZ.setkernelisa('baseline');
+msBaseline = KinZ_mex('benchtiling', width, height, threads, iterations);
+isa = KinZ.setkernelisa('auto');
+ms = KinZ_mex('benchtiling', width, height, threads, iterations);
+fprintf('%s / baseline time, 1 thread: color %.2f, 16-bit %.2f\n', isa, ...
+    ms(1,1) / msBaseline(1,1), ms(1,2) / msBaseline(1,2));
+
+speedup = ms(1,:) ./ ms;
+disp('threads   color(ms)  16-bit(ms)  color speedup  16-bit speedup');
+disp([threads' ms speedup]);
+
+plot(threads, speedup(:,1), '-o', threads, speedup(:,2), '-o', threads, threads, '--')
+legend('BGRA to RGB', '16-bit', 'linear', 'Location', 'northwest')
+xlabel('threads'); ylabel('speedup')
+title(sprintf('%dx%d conversion scaling', width, height))
@@ -0,0 +1,56 @@
+% UNDISTORTSPEED Undistorted depth, infrared and color from KinZ remap
+% tables against undistorting the frames in Matlab with interp2 on the
+% same pinhole cameras. Uses WFOV depth, where the distortion is largest.
+%
+addpath('../Mex');
+clear all
+close all
+
+kz = KinZ('1080p', 'unbinned', 'wfov', 'imu_off');
+K = kz.getcalibration('depth');
+numFrames = 30;
+
+% Source pixel of each pinhole pixel, computed in Matlab once, as the
+% Matlab pipeline would
+[u, v] = meshgrid(0:kz.DepthWidth-1, 0:kz.DepthHeight-1);
+[su, sv] = kz_distort(K, (u - K.cx) / K.fx, (v - K.cy) / K.fy);
+
+t_kinz = zeros(numFrames, 1);
+t_matlab = zeros(numFrames, 1);
+for n = 1:numFrames
+    while ~kz.getframes('depth', 'infrared', 'color')
+    end
+    tic
+    depthU = kz.getdepthundistorted;
+    infraredU = kz.getinfraredundistorted;
+    colorU = kz.getcolorundistorted;
+    t_kinz(n) = toc;
+
+    tic
+    depth = kz.getdepth;
+    infrared = kz.getinfrared;
+    depthM = interp2(double(depth), su + 1, sv + 1, 'nearest', 0);
+    infraredM = interp2(double(infrared), su + 1, sv + 1, 'linear', 0);
+    t_matlab(n) = toc;
+end
+kz.delete;
+
+% The first call builds the tables
+fprintf('KinZ remap (depth, IR, color): first %.1f ms, then %.1f ms\n', ...
+        1000*t_kinz(1), 1000*median(t_kinz(2:end)));
+fprintf('Matlab interp2 (depth, IR only): %.1f ms\n', 1000*median(t_matlab));
+
+function [su, sv] = kz_distort(K, x, y)
+    % Rational Brown-Conrady model of the K4A cameras (without the
+    % distortion center offset)
+    k = K.radDist;
+    p1 = K.tanDist(1);
+    p2 = K.tanDist(2);
+    r2 = x.^2 + y.^2;
+    radial = (1 + k(1)*r2 + k(2)*r2.^2 + k(3)*r2.^3) ./ ...
+             (1 + k(4)*r2 + k(5)*r2.^2 + k(6)*r2.^3);
+    xd = x .* radial + 2*p1*x.*y + p2*(r2 + 2*x.^2);
+    yd = y .* radial + p1*(r2 + 2*y.^2) + 2*p2*x.*y;
+    su = K.fx * xd + K.cx;
+    sv = K.fy * yd + K.cy;
+end
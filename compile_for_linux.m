@@ -1,9 +1,27 @@
 function compile_for_linux
 % compile_for_linux compiles the KinZ toolbox.
-% The C++ code is located in 3 files:
+% The C++ code is located in the following files:
 %   KinZ.h:  KinZ class definition.
 %   KinZ_base.cpp: KinZ class implementation of the base functionality including body data.
 %   KinZ_mex.cpp: MexFunction implementation.
+%   KinZ_kernels.cpp, KinZ_kernels_avx2.cpp: frame conversion kernels, with
+%   AVX2 versions chosen at runtime.
+%   KinZ_filters.cpp: depth filters.
+%   KinZ_background.cpp: background depth model and foreground mask.
+%   KinZ_log.cpp: deferred logging.
+%   KinZ_shm.cpp: shared-memory ring of a KinZ_server (Linux only).
+%   KinZ_archive.cpp: memory-mappable frame archive.
+%   KinZ_codec.cpp: lossless depth and infrared codec.
+%   KinZ_cloudwriter.cpp: background PLY/PCD writer.
+%   KinZ_reproject.cpp: native depth/color reprojection.
+%   KinZ_bodytrack.cpp: body tracker options and batch tracking of recordings.
+%   KinZ_allocator.cpp: pool of SDK image buffers.
+%   KinZ_calibration.cpp: cache of the raw device calibrations.
+%   KinZ_undistort.cpp: remap tables of the undistorted images.
+%   KinZ_batch.cpp: geometry of stacks of stored depth images.
+% plus the header-only helpers class_handle.hpp and thread_pool.hpp.
+% With BUILD_SERVER = true it also builds the standalone KinZ_server
+% (KinZ_server.cpp) with the system g++.
 %
 % Requirements:
 % - Kinect for Azure SDK
@@ -15,6 +33,7 @@ function compile_for_linux
 %   Diana M. Cordova, diana_mce@hotmail.com
 
 USE_BODY = false;
+BUILD_SERVER = false;
 
 % Specify the libraries versions
 Azure_kinect_lib = 'libk4a.so.1.4';
@@ -23,11 +42,36 @@ Azure_body_sdk = 'libk4abt.so.1.1';
 IncludePath = '/usr/bin/';
 LibPath = '/usr/bin/';
 
+SourceFiles = {'KinZ_mex.cpp', 'KinZ_base.cpp', 'KinZ_kernels.cpp', 'KinZ_kernels_avx2.cpp', ...
+               'KinZ_filters.cpp', 'KinZ_background.cpp', 'KinZ_log.cpp', 'KinZ_shm.cpp', ...
+               'KinZ_archive.cpp', 'KinZ_codec.cpp', ...
+               'KinZ_cloudwriter.cpp', 'KinZ_reproject.cpp', 'KinZ_bodytrack.cpp', ...
+               'KinZ_allocator.cpp', 'KinZ_calibration.cpp', 'KinZ_undistort.cpp', ...
+               'KinZ_batch.cpp'};
+
 cd Mex
 if ~USE_BODY
-    mex ('-compatibleArrayDims', '-v', 'KinZ_mex.cpp', 'KinZ_base.cpp', ...
-        ['-L' LibPath],['-l:' Azure_kinect_lib], ['-I' IncludePath]);
+    mex ('-compatibleArrayDims', '-v', SourceFiles{:}, ...
+        ['-L' LibPath],['-l:' Azure_kinect_lib], ['-I' IncludePath], '-lrt');
 else
-    mex ('-compatibleArrayDims', '-v', 'CXXFLAGS=$CXXFLAGS -DBODY', 'KinZ_mex.cpp', 'KinZ_base.cpp', ...
-        ['-L' LibPath],['-l:' Azure_kinect_lib], ['-l:' Azure_body_sdk] ,['-I' IncludePath]);
+    mex ('-compatibleArrayDims', '-v', 'CXXFLAGS=$CXXFLAGS -DBODY', SourceFiles{:}, ...
+        ['-L' LibPath],['-l:' Azure_kinect_lib], ['-l:' Azure_body_sdk], '-lk4arecord', ...
+        ['-I' IncludePath], '-lrt');
+end
+
+if BUILD_SERVER
+    ServerFiles = {'KinZ_server.cpp', 'KinZ_base.cpp', 'KinZ_kernels.cpp', 'KinZ_kernels_avx2.cpp', ...
+                   'KinZ_filters.cpp', 'KinZ_background.cpp', 'KinZ_log.cpp', 'KinZ_shm.cpp', ...
+                   'KinZ_archive.cpp', 'KinZ_codec.cpp', ...
+                   'KinZ_cloudwriter.cpp', 'KinZ_reproject.cpp', 'KinZ_bodytrack.cpp', ...
+                   'KinZ_allocator.cpp', 'KinZ_calibration.cpp', 'KinZ_undistort.cpp', ...
+                   'KinZ_batch.cpp'};
+    cmd = ['g++ -O2 -std=c++14 -pthread -o KinZ_server ' strjoin(ServerFiles, ' ') ...
+           ' -I' IncludePath ' -L' LibPath ' -l:' Azure_kinect_lib ' -lk4arecord -lrt'];
+    if USE_BODY
+        cmd = [cmd ' -DBODY -l:' Azure_body_sdk];
+    end
+    if system(cmd) ~= 0
+        error('Failed to build KinZ_server');
+    end
 end
@@ -1,9 +1,25 @@
 function compile_for_windows
 % compile_cpp_files compiles the KinZ toolbox.
-% The C++ code is located in 3 files:
+% The C++ code is located in the following files:
 %   KinZ.h:  KinZ class definition.
 %   KinZ_base.cpp: KinZ class implementation of the base functionality including body data.
 %   KinZ_mex.cpp: MexFunction implementation.
+%   KinZ_kernels.cpp, KinZ_kernels_avx2.cpp: frame conversion kernels, with
+%   AVX2 versions chosen at runtime.
+%   KinZ_filters.cpp: depth filters.
+%   KinZ_background.cpp: background depth model and foreground mask.
+%   KinZ_log.cpp: deferred logging.
+%   KinZ_shm.cpp: shared-memory ring of a KinZ_server (Linux only).
+%   KinZ_archive.cpp: memory-mappable frame archive.
+%   KinZ_codec.cpp: lossless depth and infrared codec.
+%   KinZ_cloudwriter.cpp: background PLY/PCD writer.
+%   KinZ_reproject.cpp: native depth/color reprojection.
+%   KinZ_bodytrack.cpp: body tracker options and batch tracking of recordings.
+%   KinZ_allocator.cpp: pool of SDK image buffers.
+%   KinZ_calibration.cpp: cache of the raw device calibrations.
+%   KinZ_undistort.cpp: remap tables of the undistorted images.
+%   KinZ_batch.cpp: geometry of stacks of stored depth images.
+% plus the header-only helpers class_handle.hpp and thread_pool.hpp.
 %
 % Requirements:
 % - Kinect for Azure SDK
@@ -40,12 +56,20 @@ LibPathKinect = 'C:\Program Files\Azure Kinect SDK v1.4.1\sdk\windows-desktop\am
 IncludePathBody = 'C:\Program Files\Azure Kinect Body Tracking SDK\sdk\include';
 LibPathBody = 'C:\Program Files\Azure Kinect Body Tracking SDK\sdk\windows-desktop\amd64\release\lib';
 
+SourceFiles = {'KinZ_mex.cpp', 'KinZ_base.cpp', 'KinZ_kernels.cpp', 'KinZ_kernels_avx2.cpp', ...
+               'KinZ_filters.cpp', 'KinZ_background.cpp', 'KinZ_log.cpp', 'KinZ_shm.cpp', ...
+               'KinZ_archive.cpp', 'KinZ_codec.cpp', ...
+               'KinZ_cloudwriter.cpp', 'KinZ_reproject.cpp', 'KinZ_bodytrack.cpp', ...
+               'KinZ_allocator.cpp', 'KinZ_calibration.cpp', 'KinZ_undistort.cpp', ...
+               'KinZ_batch.cpp'};
+
 cd Mex
 if ~USE_BODY
-    mex ('-compatibleArrayDims', '-v', 'KinZ_mex.cpp', 'KinZ_base.cpp', ...
+    mex ('-compatibleArrayDims', '-v', SourceFiles{:}, ...
         ['-L' LibPathKinect],['-l' Azure_kinect_lib], ['-I' IncludePathKinect]);
 else
-    mex ('-compatibleArrayDims', '-v', 'COMPFLAGS=$COMPFLAGS -DBODY', 'KinZ_mex.cpp', 'KinZ_base.cpp', ...
+    mex ('-compatibleArrayDims', '-v', 'COMPFLAGS=$COMPFLAGS -DBODY', SourceFiles{:}, ...
         ['-L' LibPathKinect],['-L' LibPathBody],['-l' Azure_kinect_lib], ['-l' Azure_body_sdk], ...
+        '-lk4arecord', ...
         ['-I' IncludePathKinect], ['-I' IncludePathBody]);
 end
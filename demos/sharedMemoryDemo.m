@@ -0,0 +1,50 @@
+% SHAREDMEMORYDEMO Reads the frames published by a KinZ_server, so this
+%   demo can run in several Matlab sessions at the same time.
+%
+%   Build the server with BUILD_SERVER = true in compile_for_linux.m and
+%   start it before running the demo, for example:
+%     ./KinZ_server                      (Kinect)
+%     ./KinZ_server --playback rec.mkv   (recording)
+%     ./KinZ_server --synthetic          (generated frames)
+%
+addpath('../Mex');
+clear all
+close all
+
+% Connect to the server publishing in /kinz
+kz = KinZ('shm', '/kinz');
+
+depth = zeros(kz.DepthHeight, kz.DepthWidth, 'uint16');
+color = zeros(kz.ColorHeight, kz.ColorWidth, 3, 'uint8');
+
+f1 = figure;
+h1 = imshow(depth, [0 3000]);
+title(f1.CurrentAxes, 'Depth from the KinZ server (press q to exit)');
+colormap(f1.CurrentAxes, 'Jet')
+set(f1,'keypress','k=get(f1,''currentchar'');'); % listen keypress
+
+f2 = figure;
+h2 = imshow(color);
+title(f2.CurrentAxes, 'Color from the KinZ server');
+
+k = [];
+while true
+    validData = kz.getframes('color', 'depth');
+    if validData
+        set(h1, 'CData', kz.getdepth);
+        set(h2, 'CData', kz.getcolor);
+    end
+    
+    % If user presses 'q', exit loop
+    if ~isempty(k)
+        if strcmp(k,'q'); break; end
+    end
+    pause(0.01)
+end
+
+% Frames lost by this reader
+disp(kz.getframestats)
+
+% Close the connection to the server
+kz.delete;
+close all;
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////
+///		pinnedShmFrame.cpp
+///
+///		Description:
+///			Checks that a frame pinned by a client of a KinZ_server keeps
+///         its images after the server reused every slot of the ring.
+///         Publishes synthetic depth and infrared frames in a ring of 4
+///         slots from this process, without a device. Built by CMake as
+///         kinz_pinned_shm_test and run by ctest.
+///
+///		Creation Date: Oct/18/2026
+///////////////////////////////////////////////////////////////////////////
+#include "KinZ.h"
+#include "KinZ_shm.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+const int W = 64, H = 48, NUM_SLOTS = 4;
+
+// Every pixel of frame n is 1000 + n, 2000 + n in infrared
+void publish(kz::ShmWriter &writer, uint64_t n)
+{
+    std::vector<uint16_t> depth((size_t)W * H, (uint16_t)(1000 + n));
+    std::vector<uint16_t> infrared((size_t)W * H, (uint16_t)(2000 + n));
+    kz::ShmImages images;
+    images.depth = (const uint8_t *)depth.data();
+    images.depth_stride = 2 * W;
+    images.infrared = (const uint8_t *)infrared.data();
+    images.infrared_stride = 2 * W;
+
+    kz::ShmFrameInfo info;
+    memset(&info, 0, sizeof(info));
+    info.streams = kz::SHM_DEPTH | kz::SHM_INFRARED;
+    info.depth_timestamp_usec = info.infrared_timestamp_usec = 33333 * n;
+    info.depth_system_nsec = info.infrared_system_nsec = 1000 + n;
+    writer.publish(info, images);
+}
+
+bool all_equal(const std::vector<uint16_t> &image, uint16_t value)
+{
+    for (size_t i = 0; i < image.size(); i++)
+        if (image[i] != value)
+            return false;
+    return true;
+}
+
+// Depth and infrared of the current frame of kinz are those of frame n
+bool check_frame(KinZ &kinz, uint64_t n, const char *what)
+{
+    std::vector<uint16_t> depth((size_t)W * H), infrared((size_t)W * H);
+    uint64_t depth_time = 0, infrared_time = 0;
+    bool depth_ok = false, infrared_ok = false;
+    kinz.get_depth(depth.data(), depth_time, depth_ok);
+    kinz.get_infrared(infrared.data(), infrared_time, infrared_ok);
+
+    bool ok = depth_ok && infrared_ok && all_equal(depth, (uint16_t)(1000 + n)) &&
+              all_equal(infrared, (uint16_t)(2000 + n)) &&
+              depth_time == 1000 + n && infrared_time == 1000 + n;
+    printf("%s: %s (depth %u, valid %d)\n", what, ok ? "ok" : "FAILED",
+           (unsigned)depth[0], (int)depth_ok);
+    return ok;
+}
+} // namespace
+
+int main()
+{
+    std::string name = "/kinz_pin_test_" + std::to_string((long)getpid());
+
+    kz::ShmHeader format;
+    format.num_slots = NUM_SLOTS;
+    format.streams = kz::SHM_DEPTH | kz::SHM_INFRARED;
+    format.depth.width = format.infrared.width = W;
+    format.depth.height = format.infrared.height = H;
+    format.depth.stride = format.infrared.stride = 2 * W;
+    format.camera_fps = K4A_FRAMES_PER_SECOND_30;
+    format.has_calibration = 0;
+
+    kz::ShmWriter writer;
+    if (!writer.create(name.c_str(), format)) {
+        printf("Cannot create the shared memory %s\n", name.c_str());
+        return 1;
+    }
+
+    KinZ kinz(name.c_str());
+    const uint16_t flags = kz::DEPTH | kz::INFRARED;
+    uint8_t valid[1];
+
+    publish(writer, 1);
+    kinz.get_frames(flags, valid);
+    uint64_t handle = kinz.pin_frame();
+    bool ok = valid[0] && handle != 0;
+    printf("pin frame 1: %s\n", ok ? "ok" : "FAILED");
+
+    // The server goes around the ring twice
+    const uint64_t last = 2 + 2 * NUM_SLOTS;
+    for (uint64_t n = 2; n <= last; n++) {
+        publish(writer, n);
+        kinz.get_frames(flags, valid);
+    }
+
+    {
+        kz::FrameScope scope(kinz, handle);
+        ok = scope.selected() && check_frame(kinz, 1, "pinned frame 1") && ok;
+    }
+    ok = check_frame(kinz, last, "current frame") && ok;
+    ok = kinz.release_frame(handle) && ok;
+
+    writer.close();
+    printf(ok ? "PASSED\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}